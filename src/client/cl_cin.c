@@ -22,12 +22,18 @@
  * This file implements the .cin video codec and the corresponding .pcx
  * bitmap decoder. .cin files are just a bunch of .pcx images.
  *
+ * The frames of a .cin are read and decompressed ahead by a decoder
+ * thread, into a small ring of pictures and sound samples. The main
+ * thread only shows them and passes the samples on to the sound
+ * system. If the thread can't be started, the main thread decodes.
+ *
  * =======================================================================
  */
 
 #include <limits.h>
 
 #include "header/client.h"
+#include "header/threads.h"
 #include "input/header/input.h"
 
 // don't need HDR stuff
@@ -49,11 +55,35 @@ extern cvar_t *vid_renderer;
 cvar_t *cin_force43;
 int abort_cinematic;
 
+/* Frames decoded ahead, must be a power of two. */
+#define CIN_NUMFRAMES 4
+
+typedef enum
+{
+	CINFRAME_PIC,
+	CINFRAME_END,   /* last frame marker or end of file */
+	CINFRAME_ERROR  /* broken frame, the cinematic is dropped */
+} cinframetype_t;
+
 typedef struct
 {
-	byte *data;
-	int count;
-} cblock_t;
+	cinframetype_t type;
+	qboolean newpalette;
+	byte palette[768];
+	byte *pic;          /* width * height */
+	int overread;       /* reported by the main thread */
+	int numsamples;
+
+	/* used as bytes or shorts, depending on cin.s_width */
+	short samples[22050 / 14 * 2];
+} cinframe_t;
+
+/* Huff1Decompress() decodes up to 8 bits at once */
+typedef struct
+{
+	short node;  /* decoded byte if < 256, else the node after 8 bits */
+	byte bits;   /* bits used */
+} hufflookup_t;
 
 typedef struct
 {
@@ -66,7 +96,6 @@ typedef struct
 	int height;
 	int color_bits;
 	byte *pic;
-	byte *pic_pending;
 
 	/* order 1 huffman stuff */
 	int *hnodes1;
@@ -74,8 +103,26 @@ typedef struct
 	/* [256][256][2]; */
 	int numhnodes1[256];
 
+	/* [256][256], indexed by the previous byte and the next 8 bits */
+	hufflookup_t *hlookup;
+
 	int h_used[512];
 	int h_count[512];
+
+	/* Decoder thread. The frame ring has one producer
+	   (the decoder) and one consumer (the main thread)
+	   and needs no lock. Only the decoder touches the
+	   file while it runs. */
+	SDL_Thread *thread;
+	yq2_sem_t *wake;
+	fileHandle_t file;       /* cl.cinematic_file, survives CL_ClearState() */
+	yq2_atomic_t quit;
+	cinframe_t frames[CIN_NUMFRAMES];
+	yq2_atomic_t framehead;  /* written by the decoder */
+	yq2_atomic_t frametail;  /* shown frame, written by the main thread */
+	qboolean decoded;        /* the decoder reached the end */
+	int audioframe;          /* next frame to queue the samples of */
+	byte compressed[0x20000];
 } cinematics_t;
 
 cinematics_t cin;
@@ -185,23 +232,57 @@ SCR_LoadPCX(char *filename, byte **pic, byte **palette, int *width, int *height)
 	FS_FreeFile(pcx);
 }
 
+/*
+ * Stops the decoder thread and frees the frame ring.
+ */
+void
+SCR_StopDecoder(void)
+{
+	int i;
+
+	if (cin.thread)
+	{
+		YQ2_AtomicSet(&cin.quit, 1);
+		YQ2_SemPost(cin.wake);
+		SDL_WaitThread(cin.thread, NULL);
+		cin.thread = NULL;
+	}
+
+	if (cin.wake)
+	{
+		SDL_DestroySemaphore(cin.wake);
+		cin.wake = NULL;
+	}
+
+	for (i = 0; i < CIN_NUMFRAMES; i++)
+	{
+		if (cin.frames[i].pic)
+		{
+			/* cin.pic is one of them */
+			if (cin.pic == cin.frames[i].pic)
+			{
+				cin.pic = NULL;
+			}
+
+			Z_Free(cin.frames[i].pic);
+			cin.frames[i].pic = NULL;
+		}
+	}
+}
+
 void
 SCR_StopCinematic(void)
 {
 	cl.cinematictime = 0; /* done */
 
+	SCR_StopDecoder();
+
 	if (cin.pic)
 	{
 		Z_Free(cin.pic);
 		cin.pic = NULL;
 	}
 
-	if (cin.pic_pending)
-	{
-		Z_Free(cin.pic_pending);
-		cin.pic_pending = NULL;
-	}
-
 	if (cl.cinematicpalette_active)
 	{
 		R_SetPalette(NULL);
@@ -220,6 +301,12 @@ SCR_StopCinematic(void)
 		cin.hnodes1 = NULL;
 	}
 
+	if (cin.hlookup)
+	{
+		Z_Free(cin.hlookup);
+		cin.hlookup = NULL;
+	}
+
 	/* switch back down to 11 khz sound if necessary */
 	if (cin.restart_sound)
 	{
@@ -273,6 +360,38 @@ SmallestNode1(int numhnodes)
 	return bestnode;
 }
 
+/*
+ * Fills the lookup table of the node tree for prev:
+ * Which byte the next 8 bits decode to and how
+ * many of them the code uses. Codes longer than
+ * 8 bits are left at the node they got to.
+ */
+static void
+Huff1LookupInit(int prev)
+{
+	hufflookup_t *lookup;
+	int *nodebase;
+	int i;
+
+	lookup = cin.hlookup + (prev << 8);
+	nodebase = cin.hnodes1 + prev * 256 * 2;
+
+	for (i = 0; i < 256; i++)
+	{
+		int nodenum = cin.numhnodes1[prev];
+		int bits = 0;
+
+		while ((nodenum >= 256) && (bits < 8))
+		{
+			nodenum = nodebase[(nodenum - 256) * 2 + ((i >> bits) & 1)];
+			bits++;
+		}
+
+		lookup[i].node = nodenum;
+		lookup[i].bits = bits;
+	}
+}
+
 /*
  * Reads the 64k counts table and initializes the node trees
  */
@@ -288,6 +407,8 @@ Huff1TableInit(void)
 	cin.hnodes1 = Z_Malloc(256 * 256 * 2 * 4);
 	memset(cin.hnodes1, 0, 256 * 256 * 2 * 4);
 
+	cin.hlookup = Z_Malloc(256 * 256 * sizeof(hufflookup_t));
+
 	for (prev = 0; prev < 256; prev++)
 	{
 		memset(cin.h_count, 0, sizeof(cin.h_count));
@@ -330,152 +451,344 @@ Huff1TableInit(void)
 		}
 
 		cin.numhnodes1[prev] = numhnodes - 1;
+
+		Huff1LookupInit(prev);
 	}
 }
 
-cblock_t
-Huff1Decompress(cblock_t in)
+/*
+ * Decompresses count bytes from the insize bytes at
+ * in into out, the first 4 bytes of in are the count.
+ * The bits are read LSB first, each byte is decoded
+ * with the tree of the byte before it. Up to 8 bits
+ * are decoded at once through cin.hlookup, longer
+ * codes walk the tree for the rest. Returns by how
+ * many bytes the data was overread, 0 if it fits.
+ * Runs in the decoder thread, so it doesn't print.
+ */
+static int
+Huff1Decompress(const byte *in, int insize, byte *out, int count)
 {
-	byte *input;
-	byte *out_p;
-	int nodenum;
-	int count;
-	cblock_t out;
-	int inbyte;
-	int *hnodes, *hnodesbase;
-
-	/* get decompressed count */
-	count = in.data[0] + (in.data[1] << 8) + (in.data[2] << 16) + (in.data[3] << 24);
-	input = in.data + 4;
-	out_p = out.data = Z_Malloc(count);
-
-	/* read bits */
-	hnodesbase = cin.hnodes1 - 256 * 2; /* nodes 0-255 aren't stored */
+	uint64_t bitbuf;
+	int numbits, used;
+	int pos, i;
+	int prev;
 
-	hnodes = hnodesbase;
-	nodenum = cin.numhnodes1[0];
+	bitbuf = 0;
+	numbits = 0;
+	used = 0;
+	pos = 4;
+	prev = 0;
 
-	while (count)
+	for (i = 0; i < count; i++)
 	{
-		inbyte = *input++;
-
-		int i = 0;
+		const hufflookup_t *lookup;
+		int nodenum;
 
-		for (i = 0; i < 8; i++)
+		/* The trees are built from 8 bit counts, so no
+		   code is longer than 24 bits and one refill is
+		   always enough. Past the end, zeros are read. */
+		if (numbits < 32)
 		{
-			if (nodenum < 256)
+			while (numbits <= 56)
 			{
-				hnodes = hnodesbase + (nodenum << 9);
-				*out_p++ = nodenum;
-
-				if (!--count)
+				if (pos < insize)
 				{
-					break;
+					bitbuf |= (uint64_t)in[pos] << numbits;
 				}
 
-				nodenum = cin.numhnodes1[nodenum];
+				pos++;
+				numbits += 8;
 			}
+		}
+
+		lookup = &cin.hlookup[(prev << 8) | (int)(bitbuf & 255)];
+		nodenum = lookup->node;
+
+		bitbuf >>= lookup->bits;
+		numbits -= lookup->bits;
+		used += lookup->bits;
 
-			nodenum = hnodes[nodenum * 2 + (inbyte & 1)];
-			inbyte >>= 1;
+		while (nodenum >= 256)
+		{
+			nodenum = cin.hnodes1[(prev << 9) + (nodenum - 256) * 2 + (int)(bitbuf & 1)];
+
+			bitbuf >>= 1;
+			numbits--;
+			used++;
 		}
+
+		out[i] = prev = nodenum;
 	}
 
-	if ((input - in.data != in.count) && (input - in.data != in.count + 1))
+	/* the old bitwise decoder read one byte
+	   more than the last bit was in */
+	if ((count > 0) && (4 + used / 8 + 1 != insize) && (4 + used / 8 + 1 != insize + 1))
 	{
-		Com_Printf("Decompression overread by %i", (int)(input - in.data) - in.count);
+		return 4 + used / 8 + 1 - insize;
 	}
 
-	out.count = out_p - out.data;
+	return 0;
+}
 
-	return out;
+/*
+ * Reads size bytes from the cinematic, without
+ * erroring out on a short read. Called by the
+ * decoder thread.
+ */
+static qboolean
+SCR_ReadCinematic(void *buffer, int size)
+{
+	return FS_FRead(buffer, size, 1, cin.file) == size;
 }
 
-byte *
-SCR_ReadNextFrame(void)
+/*
+ * Reads frame into f: The palette if it changes,
+ * the sound samples and the decompressed picture.
+ */
+static cinframetype_t
+SCR_ReadFrame(cinframe_t *f, int frame)
 {
 	int r;
 	int command;
-
-	// the samples array is used as bytes or shorts, depending on bitrate (cin.s_width)
-	// so we need to make sure to align it correctly
-	YQ2_ALIGNAS_TYPE(short) byte samples[22050 / 14 * 4];
-
-	byte compressed[0x20000];
 	int size;
-	byte *pic;
-	cblock_t in, huf1;
 	int start, end, count;
 
 	/* read the next frame */
-	r = FS_FRead(&command, 4, 1, cl.cinematic_file);
+	r = FS_FRead(&command, 4, 1, cin.file);
 
 	if (r == 0)
 	{
 		/* we'll give it one more chance */
-		r = FS_FRead(&command, 4, 1, cl.cinematic_file);
+		r = FS_FRead(&command, 4, 1, cin.file);
 	}
 
 	if (r != 4)
 	{
-		return NULL;
+		return CINFRAME_END;
 	}
 
 	command = LittleLong(command);
 
 	if (command == 2)
 	{
-		return NULL;  /* last frame marker */
+		return CINFRAME_END;  /* last frame marker */
 	}
 
-	if (command == 1)
+	/* read palette */
+	f->newpalette = (command == 1);
+
+	if (f->newpalette && !SCR_ReadCinematic(f->palette, sizeof(f->palette)))
 	{
-		/* read palette */
-		FS_Read(cl.cinematicpalette, sizeof(cl.cinematicpalette),
-				cl.cinematic_file);
-		cl.cinematicpalette_active = 0;
+		return CINFRAME_ERROR;
+	}
+
+	/* read the compressed frame */
+	if (!SCR_ReadCinematic(&size, 4))
+	{
+		return CINFRAME_ERROR;
 	}
 
-	/* decompress the next frame */
-	FS_Read(&size, 4, cl.cinematic_file);
 	size = LittleLong(size);
 
-	if (((size_t)size > sizeof(compressed)) || (size < 1))
+	if (((size_t)size > sizeof(cin.compressed)) || (size < 4) ||
+		!SCR_ReadCinematic(cin.compressed, size))
 	{
-		Com_Error(ERR_DROP, "Bad compressed frame size");
+		return CINFRAME_ERROR;
 	}
 
-	FS_Read(compressed, size, cl.cinematic_file);
-
 	/* read sound */
-	start = cl.cinematicframe * cin.s_rate / 14;
-	end = (cl.cinematicframe + 1) * cin.s_rate / 14;
+	start = frame * cin.s_rate / 14;
+	end = (frame + 1) * cin.s_rate / 14;
 	count = end - start;
 
-	FS_Read(samples, count * cin.s_width * cin.s_channels,
-			cl.cinematic_file);
+	r = count * cin.s_width * cin.s_channels;
+
+	if ((r < 0) || ((size_t)r > sizeof(f->samples)) ||
+		!SCR_ReadCinematic(f->samples, r))
+	{
+		return CINFRAME_ERROR;
+	}
 
 	if (cin.s_width == 2)
 	{
 		for (r = 0; r < count * cin.s_channels; r++)
 		{
-			((short *)samples)[r] = LittleShort(((short *)samples)[r]);
+			f->samples[r] = LittleShort(f->samples[r]);
 		}
 	}
 
-	S_RawSamples(count, cin.s_rate, cin.s_width, cin.s_channels,
-			samples, Cvar_VariableValue("s_volume"));
+	f->numsamples = count;
+
+	/* get decompressed count */
+	count = cin.compressed[0] + (cin.compressed[1] << 8) +
+		(cin.compressed[2] << 16) + (cin.compressed[3] << 24);
 
-	in.data = compressed;
-	in.count = size;
+	if ((count < 0) || (count > cin.width * cin.height))
+	{
+		return CINFRAME_ERROR;
+	}
 
-	huf1 = Huff1Decompress(in);
+	/* decompress the next frame */
+	f->overread = Huff1Decompress(cin.compressed, size, f->pic, count);
 
-	pic = huf1.data;
+	return CINFRAME_PIC;
+}
 
-	cl.cinematicframe++;
+/*
+ * One step of the decoder: Decodes the next frame into
+ * the ring. Returns false if there is nothing to do.
+ * Runs in the decoder thread or, if that couldn't be
+ * started, in SCR_RunCinematic().
+ */
+static qboolean
+SCR_DecodeFrame(void)
+{
+	int head = YQ2_AtomicGet(&cin.framehead);
+	cinframe_t *f;
 
-	return pic;
+	if (cin.decoded || (head - YQ2_AtomicGet(&cin.frametail) >= CIN_NUMFRAMES))
+	{
+		return false;
+	}
+
+	f = &cin.frames[head & (CIN_NUMFRAMES - 1)];
+	f->type = SCR_ReadFrame(f, head);
+
+	if (f->type != CINFRAME_PIC)
+	{
+		cin.decoded = true;
+	}
+
+	/* hand it to the main thread */
+	YQ2_AtomicAdd(&cin.framehead, 1);
+
+	return true;
+}
+
+/*
+ * The decoder thread. Keeps the frame
+ * ring filled and sleeps otherwise.
+ */
+static int SDLCALL
+SCR_DecodeThread(void *data)
+{
+	while (!YQ2_AtomicGet(&cin.quit))
+	{
+		if (!SCR_DecodeFrame())
+		{
+			YQ2_SemWaitTimeout(cin.wake, 100);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Allocates the frame ring and starts decoding.
+ */
+static void
+SCR_StartDecoder(void)
+{
+	int i;
+
+	for (i = 0; i < CIN_NUMFRAMES; i++)
+	{
+		cin.frames[i].pic = Z_Malloc(cin.width * cin.height);
+	}
+
+	cin.file = cl.cinematic_file;
+
+	YQ2_AtomicSet(&cin.framehead, 0);
+	YQ2_AtomicSet(&cin.frametail, 0);
+	YQ2_AtomicSet(&cin.quit, 0);
+	cin.decoded = false;
+	cin.audioframe = 0;
+
+	cin.wake = SDL_CreateSemaphore(0);
+
+	if (cin.wake)
+	{
+		cin.thread = SDL_CreateThread(SCR_DecodeThread, "yq2cin", NULL);
+	}
+
+	if (!cin.thread)
+	{
+		Com_DPrintf("Couldn't start the cinematic decoder thread: %s\n", SDL_GetError());
+	}
+}
+
+/*
+ * Passes the samples of the decoded frames up
+ * to the one after the shown frame on to the
+ * sound system.
+ */
+static void
+SCR_QueueSamples(void)
+{
+	int head = YQ2_AtomicGet(&cin.framehead);
+
+	while ((cin.audioframe <= cl.cinematicframe + 1) && (cin.audioframe < head))
+	{
+		cinframe_t *f = &cin.frames[cin.audioframe & (CIN_NUMFRAMES - 1)];
+
+		if (f->type != CINFRAME_PIC)
+		{
+			break;
+		}
+
+		S_RawSamples(f->numsamples, cin.s_rate, cin.s_width, cin.s_channels,
+				(byte *)f->samples, Cvar_VariableValue("s_volume"));
+
+		cin.audioframe++;
+	}
+}
+
+/*
+ * Shows a decoded frame. Returns false
+ * if the cinematic is over.
+ */
+static qboolean
+SCR_ShowFrame(int frame)
+{
+	cinframe_t *f = &cin.frames[frame & (CIN_NUMFRAMES - 1)];
+
+	if (f->type == CINFRAME_ERROR)
+	{
+		SCR_StopCinematic();
+		Com_Error(ERR_DROP, "Bad cinematic frame %i", frame);
+	}
+
+	if (f->type == CINFRAME_END)
+	{
+		return false;
+	}
+
+	if (f->overread)
+	{
+		Com_Printf("Decompression overread by %i\n", f->overread);
+	}
+
+	if (f->newpalette)
+	{
+		memcpy(cl.cinematicpalette, f->palette, sizeof(cl.cinematicpalette));
+		cl.cinematicpalette_active = 0;
+	}
+
+	cin.pic = f->pic;
+	cl.cinematicframe = frame;
+
+	/* the decoder may reuse the slot before */
+	YQ2_AtomicSet(&cin.frametail, frame);
+
+	if (cin.thread)
+	{
+		YQ2_SemPost(cin.wake);
+	}
+
+	SCR_QueueSamples();
+
+	return true;
 }
 
 void
@@ -501,10 +814,18 @@ SCR_RunCinematic(void)
 		return;
 	}
 
+	if (!cin.thread)
+	{
+		while (SCR_DecodeFrame())
+		{
+		}
+	}
+
 	frame = (cls.realtime - cl.cinematictime) * 14.0 / 1000;
 
 	if (frame <= cl.cinematicframe)
 	{
+		SCR_QueueSamples();
 		return;
 	}
 
@@ -514,16 +835,14 @@ SCR_RunCinematic(void)
 		cl.cinematictime = cls.realtime - cl.cinematicframe * 1000 / 14;
 	}
 
-	if (cin.pic)
+	if (cl.cinematicframe + 1 >= YQ2_AtomicGet(&cin.framehead))
 	{
-		Z_Free(cin.pic);
+		/* not decoded yet, show it as soon as it is */
+		cl.cinematictime = cls.realtime - (cl.cinematicframe + 1) * 1000 / 14;
+		return;
 	}
 
-	cin.pic = cin.pic_pending;
-	cin.pic_pending = NULL;
-	cin.pic_pending = SCR_ReadNextFrame();
-
-	if (!cin.pic_pending)
+	if (!SCR_ShowFrame(cl.cinematicframe + 1))
 	{
 		SCR_StopCinematic();
 		SCR_FinishCinematic();
@@ -698,6 +1017,9 @@ SCR_PlayCinematic(char *arg)
 	In_FlushQueue();
 	abort_cinematic = INT_MAX;
 
+	/* a cinematic still running must not be decoded further */
+	SCR_StopDecoder();
+
 	/* make sure background music is not playing */
 	OGG_Stop();
 
@@ -787,10 +1109,37 @@ SCR_PlayCinematic(char *arg)
 	FS_Read(&cin.s_channels, 4, cl.cinematic_file);
 	cin.s_channels = LittleLong(cin.s_channels);
 
+	if ((cin.width <= 0) || (cin.height <= 0))
+	{
+		SCR_StopCinematic();
+		Com_Error(ERR_DROP, "Bad cinematic size %ix%i", cin.width, cin.height);
+	}
+
 	Huff1TableInit();
 
-	cl.cinematicframe = 0;
-	cin.pic = SCR_ReadNextFrame();
+	SCR_StartDecoder();
+
+	/* wait for the first frame */
+	while (YQ2_AtomicGet(&cin.framehead) == 0)
+	{
+		if (!cin.thread)
+		{
+			SCR_DecodeFrame();
+		}
+		else
+		{
+			SDL_Delay(1);
+		}
+	}
+
+	if (!SCR_ShowFrame(0))
+	{
+		/* empty */
+		SCR_StopCinematic();
+		SCR_FinishCinematic();
+		return;
+	}
+
 	cl.cinematictime = Sys_Milliseconds();
 }
 
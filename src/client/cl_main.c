@@ -343,6 +343,9 @@ CL_ClearState(void)
 	memset(&cl, 0, sizeof(cl));
 	memset(&cl_entities, 0, sizeof(cl_entities));
 
+	SCR_StatusbarChanged();
+	SCR_LayoutChanged();
+
 	SZ_Clear(&cls.netchan.message);
 }
 
@@ -974,6 +977,9 @@ CL_Shutdown(void)
 
 	OGG_Stop();
 
+	/* quitting doesn't always disconnect first */
+	SCR_StopDecoder();
+
 	S_Shutdown();
 	IN_Shutdown();
 	VID_Shutdown();
@@ -308,6 +308,8 @@ CL_Disconnect(void)
 					cl.timedemo_frames, time / 1000.0,
 					cl.timedemo_frames * 1000.0 / time);
 		}
+
+		SCR_TimedemoEnd();
 	}
 
 	VectorClear(cl.refdef.blend);
@@ -1058,6 +1058,10 @@ CL_ParseClientinfo(int player)
 	ci = &cl.clientinfo[player];
 
 	CL_LoadClientinfo(ci, s);
+
+	/* the model may have changed, and with
+	   it the player's sounds */
+	S_RegisterClientSounds(player);
 }
 
 void
@@ -1084,6 +1088,14 @@ CL_ParseConfigString(void)
 		Com_Error(ERR_DROP, "CL_ParseConfigString: oversize configstring");
 	}
 
+	/* long configstrings run into the following ones, the status
+	   bar changes if this overwrites any part of it */
+	if ((i + length / MAX_QPATH >= CS_STATUSBAR) &&
+		(i <= CS_STATUSBAR + (int)strlen(cl.configstrings[CS_STATUSBAR]) / MAX_QPATH))
+	{
+		SCR_StatusbarChanged();
+	}
+
 	strcpy(cl.configstrings[i], s);
 
 	/* do something apropriate */
@@ -1379,6 +1391,7 @@ CL_ParseServerMessage(void)
 			case svc_layout:
 				s = MSG_ReadString(&net_message);
 				Q_strlcpy(cl.layout, s, sizeof(cl.layout));
+				SCR_LayoutChanged();
 				break;
 
 			case svc_playerinfo:
@@ -27,7 +27,7 @@
 #include "header/client.h"
 
 cparticle_t *active_particles, *free_particles;
-cparticle_t particles[MAX_PARTICLES];
+cparticle_t particles[MAX_PARTICLES_LIMIT];
 int cl_numparticles = MAX_PARTICLES;
 
 void
@@ -49,6 +49,22 @@ CL_ClearParticles(void)
 	particles[cl_numparticles - 1].next = NULL;
 }
 
+/*
+ * Sets the particle budget to what the
+ * renderer says it can draw per frame.
+ */
+void
+CL_SetMaxParticles(int max)
+{
+	max = Q_max(MAX_PARTICLES, Q_min(max, MAX_PARTICLES_LIMIT));
+
+	if (max != cl_numparticles)
+	{
+		cl_numparticles = max;
+		CL_ClearParticles();
+	}
+}
+
 void
 CL_ParticleEffect(vec3_t org, vec3_t dir, int color, int count)
 {
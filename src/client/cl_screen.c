@@ -49,6 +49,8 @@ cvar_t *scr_graphheight;
 cvar_t *scr_graphscale;
 cvar_t *scr_graphshift;
 cvar_t *scr_drawall;
+cvar_t *scr_timedemocsv;
+cvar_t *scr_timedemoshots;
 
 cvar_t *r_hudscale; /* named for consistency with R1Q2 */
 cvar_t *r_consolescale;
@@ -436,6 +438,8 @@ SCR_Init(void)
 	r_hudscale = Cvar_Get("r_hudscale", "-1", CVAR_ARCHIVE);
 	r_consolescale = Cvar_Get("r_consolescale", "-1", CVAR_ARCHIVE);
 	r_menuscale = Cvar_Get("r_menuscale", "-1", CVAR_ARCHIVE);
+	scr_timedemocsv = Cvar_Get("timedemo_csv", "", 0);
+	scr_timedemoshots = Cvar_Get("timedemo_screenshots", "0", 0);
 
 	/* register our commands */
 	Cmd_AddCommand("timerefresh", SCR_TimeRefresh_f);
@@ -641,6 +645,103 @@ SCR_Loading_f(void)
 	SCR_BeginLoadingPlaque();
 }
 
+static FILE *scr_timedemofile;
+static int scr_timedemolast;
+
+/*
+ * Takes a reference screenshot every timedemo_screenshots
+ * timedemo frames. The names depend on the frame only, so
+ * two runs of the same demo can be compared. Called before
+ * the frame is presented, while it's still in the backbuffer.
+ */
+static void
+SCR_TimedemoScreenshot(void)
+{
+	int every = (int)scr_timedemoshots->value;
+
+	if (!cl_timedemo->value || (every <= 0) ||
+		(cl.timedemo_frames == scr_timedemolast) ||
+		(cl.timedemo_frames % every))
+	{
+		return;
+	}
+
+	/* not part of any phase */
+	VID_MarkPhase(PHASE_NUM);
+
+	VID_SetScreenshotName(va("timedemo_%05i", cl.timedemo_frames));
+	Cmd_ExecuteString("screenshot png");
+}
+
+/*
+ * Writes the timings of the last frame
+ * as a line of the timedemo_csv file.
+ */
+static void
+SCR_TimedemoFrame(void)
+{
+	float times[PHASE_NUM];
+	float total;
+
+	total = VID_EndFrameTimings(times);
+
+	if (!cl_timedemo->value || (cl.timedemo_frames == scr_timedemolast))
+	{
+		return;
+	}
+
+	scr_timedemolast = cl.timedemo_frames;
+
+	if (!scr_timedemocsv->string[0])
+	{
+		return;
+	}
+
+	if (!scr_timedemofile)
+	{
+		char path[MAX_OSPATH];
+
+		Com_sprintf(path, sizeof(path), "%s/%s", FS_Gamedir(), scr_timedemocsv->string);
+
+		if (!(scr_timedemofile = Q_fopen(path, "w")))
+		{
+			Com_Printf("Couldn't open %s, no timedemo CSV written.\n", path);
+			Cvar_Set("timedemo_csv", "");
+
+			return;
+		}
+
+		fprintf(scr_timedemofile, "frame,world,entities,particles,2d,present,total\n");
+	}
+
+	fprintf(scr_timedemofile, "%i,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", cl.timedemo_frames,
+			times[PHASE_WORLD], times[PHASE_ENTITIES], times[PHASE_PARTICLES],
+			times[PHASE_2D], times[PHASE_PRESENT], total);
+}
+
+/*
+ * The timedemo is over. Closes the CSV and,
+ * when running headless, quits the game.
+ */
+void
+SCR_TimedemoEnd(void)
+{
+	if (scr_timedemofile)
+	{
+		fclose(scr_timedemofile);
+		scr_timedemofile = NULL;
+
+		Com_Printf("Wrote timedemo timings to %s.\n", scr_timedemocsv->string);
+	}
+
+	scr_timedemolast = 0;
+
+	if (Cvar_VariableValue("vid_headless"))
+	{
+		Cbuf_AddText("quit\n");
+	}
+}
+
 void
 SCR_TimeRefresh_f(void)
 {
@@ -1056,374 +1157,740 @@ SCR_TouchPics(void)
 	}
 }
 
-void
-SCR_ExecuteLayoutString(char *s)
+/*
+ * Layout programs (the status bar and the layouts the
+ * server sends) are compiled once when they change and
+ * the compiled code is run each frame. The compiler uses
+ * COM_Parse() and the code behaves exactly like the
+ * tokens did when they were interpreted each frame.
+ */
+typedef enum
 {
-	int x, y;
-	int value;
-	char *token;
-	int width;
-	int index;
-	clientinfo_t *ci;
+	LO_END,          /* */
+	LO_JUMP,         /* target */
+	LO_XL,           /* value */
+	LO_XR,           /* value */
+	LO_XV,           /* value */
+	LO_YT,           /* value */
+	LO_YB,           /* value */
+	LO_YV,           /* value */
+	LO_PIC,          /* stat */
+	LO_CLIENT,       /* x, y, client, score, ping, time */
+	LO_CTF,          /* x, y, client, score, ping */
+	LO_PICN,         /* string */
+	LO_NUM,          /* width, stat */
+	LO_HNUM,         /* */
+	LO_ANUM,         /* */
+	LO_RNUM,         /* */
+	LO_STAT_STRING,  /* stat */
+	LO_CSTRING,      /* string */
+	LO_STRING,       /* string */
+	LO_CSTRING2,     /* string */
+	LO_STRING2,      /* string */
+	LO_IF            /* stat, target if the stat is 0 */
+} layoutop_t;
 
-	float scale = SCR_GetHUDScale();
+typedef struct
+{
+	char *strings;  /* all tokens, strings are offsets into this */
+	int *code;
+	qboolean valid;
+} layoutprogram_t;
 
-	if ((cls.state != ca_active) || !cl.refresh_prepped)
+static layoutprogram_t scr_statusbar;
+static layoutprogram_t scr_layout;
+
+typedef struct
+{
+	char *source;
+	int *tokens;    /* offsets into strings */
+	int numtokens;
+	int *start;     /* code offset of the instruction starting at a token */
+	int *pending;   /* code offsets of jump targets not resolved yet */
+	int *pendingtokens;
+	int numpending;
+	layoutprogram_t *prog;
+	int numcode;
+} layoutcompiler_t;
+
+static void
+SCR_FreeLayout(layoutprogram_t *prog)
+{
+	if (prog->strings)
 	{
-		return;
+		Z_Free(prog->strings);
 	}
 
-	if (!s[0])
+	if (prog->code)
 	{
-		return;
+		Z_Free(prog->code);
 	}
 
-	x = 0;
-	y = 0;
+	memset(prog, 0, sizeof(*prog));
+}
+
+/*
+ * Called when the status bar configstring changed
+ */
+void
+SCR_StatusbarChanged(void)
+{
+	scr_statusbar.valid = false;
+}
 
-	while (s)
+/*
+ * Called when the server sent a new layout
+ */
+void
+SCR_LayoutChanged(void)
+{
+	scr_layout.valid = false;
+}
+
+/*
+ * Returns the next token, past the end that's the
+ * empty token, just like COM_Parse() returns ""
+ */
+static const char *
+SCR_LayoutToken(layoutcompiler_t *c, int *pos)
+{
+	if (*pos >= c->numtokens)
 	{
-		token = COM_Parse(&s);
+		return c->prog->strings;
+	}
 
-		if (!strcmp(token, "xl"))
+	return c->prog->strings + c->tokens[(*pos)++];
+}
+
+static int
+SCR_LayoutNumber(layoutcompiler_t *c, int *pos)
+{
+	return (int)strtol(SCR_LayoutToken(c, pos), (char **)NULL, 10);
+}
+
+static void
+SCR_LayoutEmit(layoutcompiler_t *c, int value)
+{
+	c->prog->code[c->numcode++] = value;
+}
+
+/*
+ * Emits a jump target for the token at pos,
+ * it's filled in when that token was compiled.
+ */
+static void
+SCR_LayoutEmitTarget(layoutcompiler_t *c, int pos)
+{
+	c->pending[c->numpending] = c->numcode;
+	c->pendingtokens[c->numpending] = pos;
+	c->numpending++;
+
+	SCR_LayoutEmit(c, 0);
+}
+
+/*
+ * Compiles the instructions starting at the token pos, until the end
+ * of the tokens or a token that was already compiled is reached.
+ */
+static void
+SCR_CompileLayoutFrom(layoutcompiler_t *c, int pos)
+{
+	const char *token;
+	int k;
+
+	while (1)
+	{
+		if (c->start[pos] >= 0)
 		{
-			token = COM_Parse(&s);
-			x = scale*(int)strtol(token, (char **)NULL, 10);
-			continue;
+			SCR_LayoutEmit(c, LO_JUMP);
+			SCR_LayoutEmit(c, c->start[pos]);
+			return;
 		}
 
-		if (!strcmp(token, "xr"))
+		c->start[pos] = c->numcode;
+
+		if (pos >= c->numtokens)
 		{
-			token = COM_Parse(&s);
-			x = viddef.width + scale*(int)strtol(token, (char **)NULL, 10);
-			continue;
+			SCR_LayoutEmit(c, LO_END);
+			return;
 		}
 
-		if (!strcmp(token, "xv"))
+		token = SCR_LayoutToken(c, &pos);
+
+		if (!strcmp(token, "xl"))
 		{
-			token = COM_Parse(&s);
-			x = viddef.width / 2 - scale*160 + scale*(int)strtol(token, (char **)NULL, 10);
-			continue;
+			SCR_LayoutEmit(c, LO_XL);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
 		}
-
-		if (!strcmp(token, "yt"))
+		else if (!strcmp(token, "xr"))
 		{
-			token = COM_Parse(&s);
-			y = scale*(int)strtol(token, (char **)NULL, 10);
-			continue;
+			SCR_LayoutEmit(c, LO_XR);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
 		}
-
-		if (!strcmp(token, "yb"))
+		else if (!strcmp(token, "xv"))
 		{
-			token = COM_Parse(&s);
-			y = viddef.height + scale*(int)strtol(token, (char **)NULL, 10);
-			continue;
+			SCR_LayoutEmit(c, LO_XV);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
 		}
-
-		if (!strcmp(token, "yv"))
+		else if (!strcmp(token, "yt"))
 		{
-			token = COM_Parse(&s);
-			y = viddef.height / 2 - scale*120 + scale*(int)strtol(token, (char **)NULL, 10);
-			continue;
+			SCR_LayoutEmit(c, LO_YT);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
 		}
-
-		if (!strcmp(token, "pic"))
+		else if (!strcmp(token, "yb"))
+		{
+			SCR_LayoutEmit(c, LO_YB);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
+		}
+		else if (!strcmp(token, "yv"))
+		{
+			SCR_LayoutEmit(c, LO_YV);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
+		}
+		else if (!strcmp(token, "pic"))
+		{
+			SCR_LayoutEmit(c, LO_PIC);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
+		}
+		else if (!strcmp(token, "client"))
 		{
-			/* draw a pic from a stat number */
-			token = COM_Parse(&s);
-			index = (int)strtol(token, (char **)NULL, 10);
+			SCR_LayoutEmit(c, LO_CLIENT);
 
-			if ((index < 0) || (index >= MAX_STATS))
+			for (k = 0; k < 6; k++)
 			{
-				Com_Error(ERR_DROP, "bad stats index %d (0x%x)", index, index);
+				SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
 			}
+		}
+		else if (!strcmp(token, "ctf"))
+		{
+			SCR_LayoutEmit(c, LO_CTF);
 
-			value = cl.frame.playerstate.stats[index];
-
-			if (value >= MAX_IMAGES)
+			for (k = 0; k < 5; k++)
 			{
-				Com_Error(ERR_DROP, "Pic >= MAX_IMAGES");
+				SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
 			}
+		}
+		else if (!strcmp(token, "picn"))
+		{
+			SCR_LayoutEmit(c, LO_PICN);
+			SCR_LayoutEmit(c, SCR_LayoutToken(c, &pos) - c->prog->strings);
+		}
+		else if (!strcmp(token, "num"))
+		{
+			SCR_LayoutEmit(c, LO_NUM);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
+		}
+		else if (!strcmp(token, "hnum"))
+		{
+			SCR_LayoutEmit(c, LO_HNUM);
+		}
+		else if (!strcmp(token, "anum"))
+		{
+			SCR_LayoutEmit(c, LO_ANUM);
+		}
+		else if (!strcmp(token, "rnum"))
+		{
+			SCR_LayoutEmit(c, LO_RNUM);
+		}
+		else if (!strcmp(token, "stat_string"))
+		{
+			SCR_LayoutEmit(c, LO_STAT_STRING);
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
+		}
+		else if (!strcmp(token, "cstring"))
+		{
+			SCR_LayoutEmit(c, LO_CSTRING);
+			SCR_LayoutEmit(c, SCR_LayoutToken(c, &pos) - c->prog->strings);
+		}
+		else if (!strcmp(token, "string"))
+		{
+			SCR_LayoutEmit(c, LO_STRING);
+			SCR_LayoutEmit(c, SCR_LayoutToken(c, &pos) - c->prog->strings);
+		}
+		else if (!strcmp(token, "cstring2"))
+		{
+			SCR_LayoutEmit(c, LO_CSTRING2);
+			SCR_LayoutEmit(c, SCR_LayoutToken(c, &pos) - c->prog->strings);
+		}
+		else if (!strcmp(token, "string2"))
+		{
+			SCR_LayoutEmit(c, LO_STRING2);
+			SCR_LayoutEmit(c, SCR_LayoutToken(c, &pos) - c->prog->strings);
+		}
+		else if (!strcmp(token, "if"))
+		{
+			SCR_LayoutEmit(c, LO_IF);
 
-			if (cl.configstrings[CS_IMAGES + value][0] != '\0')
+			/* if the stat is 0, everything up to and including the
+			   next endif is skipped, starting with the stat itself */
+			for (k = pos; k < c->numtokens; k++)
 			{
-				SCR_AddDirtyPoint(x, y);
-				SCR_AddDirtyPoint(x + 23*scale, y + 23*scale);
-				Draw_PicScaled(x, y, cl.configstrings[CS_IMAGES + value], scale);
+				if (!strcmp(c->prog->strings + c->tokens[k], "endif"))
+				{
+					k++;
+					break;
+				}
 			}
 
-			continue;
+			SCR_LayoutEmit(c, SCR_LayoutNumber(c, &pos));
+			SCR_LayoutEmitTarget(c, k);
 		}
 
-		if (!strcmp(token, "client"))
-		{
-			/* draw a deathmatch client block */
-			int score, ping, time;
+		/* unknown tokens are ignored */
+	}
+}
 
-			token = COM_Parse(&s);
-			x = viddef.width / 2 - scale*160 + scale*(int)strtol(token, (char **)NULL, 10);
-			token = COM_Parse(&s);
-			y = viddef.height / 2 - scale*120 + scale*(int)strtol(token, (char **)NULL, 10);
-			SCR_AddDirtyPoint(x, y);
-			SCR_AddDirtyPoint(x + scale*159, y + scale*31);
+/*
+ * Compiles the layout string s into prog
+ */
+static void
+SCR_CompileLayout(layoutprogram_t *prog, char *s)
+{
+	layoutcompiler_t c;
+	char *data, *end;
+	int len, i;
 
-			token = COM_Parse(&s);
-			value = (int)strtol(token, (char **)NULL, 10);
+	SCR_FreeLayout(prog);
 
-			if ((value >= MAX_CLIENTS) || (value < 0))
-			{
-				Com_Error(ERR_DROP, "client >= MAX_CLIENTS");
-			}
+	memset(&c, 0, sizeof(c));
+	c.prog = prog;
 
-			ci = &cl.clientinfo[value];
+	len = strlen(s);
+	end = s + len;
 
-			token = COM_Parse(&s);
-			score = (int)strtol(token, (char **)NULL, 10);
+	/* the tokens are never longer than the string, plus
+	   their terminators and the empty token at strings[0] */
+	prog->strings = Z_Malloc(2 * len + 2);
+	c.tokens = Z_Malloc((len / 2 + 2) * sizeof(int));
 
-			token = COM_Parse(&s);
-			ping = (int)strtol(token, (char **)NULL, 10);
+	data = s;
+	len = 1; /* strings[0] is the empty token */
 
-			token = COM_Parse(&s);
-			time = (int)strtol(token, (char **)NULL, 10);
+	while (data)
+	{
+		const char *token = COM_Parse(&data);
 
-			DrawAltStringScaled(x + scale*32, y, ci->name, scale);
-			DrawAltStringScaled(x + scale*32, y + scale*8, "Score: ", scale);
-			DrawAltStringScaled(x + scale*(32 + 7 * 8), y + scale*8, va("%i", score), scale);
-			DrawStringScaled(x + scale*32, y + scale*16, va("Ping:  %i", ping), scale);
-			DrawStringScaled(x + scale*32, y + scale*24, va("Time:  %i", time), scale);
+		if (!data)
+		{
+			break;
+		}
 
-			if (!ci->icon)
-			{
-				ci = &cl.baseclientinfo;
-			}
+		c.tokens[c.numtokens++] = len;
+		strcpy(prog->strings + len, token);
+		len += strlen(token) + 1;
 
-			Draw_PicScaled(x, y, ci->iconname, scale);
-			continue;
+		if (data > end)
+		{
+			/* unterminated quoted string at the end */
+			break;
 		}
+	}
 
-		if (!strcmp(token, "ctf"))
-		{
-			/* draw a ctf client block */
-			int score, ping;
-			char block[80];
+	/* each token is compiled at most once into at most 7
+	   values, each path of the code ends with a jump or end */
+	prog->code = Z_Malloc((c.numtokens * 9 + 2) * sizeof(int));
 
-			token = COM_Parse(&s);
-			x = viddef.width / 2 - scale*160 + scale*(int)strtol(token, (char **)NULL, 10);
-			token = COM_Parse(&s);
-			y = viddef.height / 2 - scale*120 + scale*(int)strtol(token, (char **)NULL, 10);
-			SCR_AddDirtyPoint(x, y);
-			SCR_AddDirtyPoint(x + scale*159, y + scale*31);
+	c.start = Z_Malloc((c.numtokens + 1) * sizeof(int));
+	c.pending = Z_Malloc((c.numtokens + 1) * sizeof(int));
+	c.pendingtokens = Z_Malloc((c.numtokens + 1) * sizeof(int));
 
-			token = COM_Parse(&s);
-			value = (int)strtol(token, (char **)NULL, 10);
+	for (i = 0; i <= c.numtokens; i++)
+	{
+		c.start[i] = -1;
+	}
 
-			if ((value >= MAX_CLIENTS) || (value < 0))
-			{
-				Com_Error(ERR_DROP, "client >= MAX_CLIENTS");
-			}
+	SCR_CompileLayoutFrom(&c, 0);
 
-			ci = &cl.clientinfo[value];
+	/* compile the code the ifs jump to, if it's not
+	   at the start of an instruction compiled before */
+	for (i = 0; i < c.numpending; i++)
+	{
+		int target = c.pendingtokens[i];
 
-			token = COM_Parse(&s);
-			score = (int)strtol(token, (char **)NULL, 10);
+		if (c.start[target] < 0)
+		{
+			SCR_CompileLayoutFrom(&c, target);
+		}
 
-			token = COM_Parse(&s);
-			ping = (int)strtol(token, (char **)NULL, 10);
+		prog->code[c.pending[i]] = c.start[target];
+	}
 
-			if (ping > 999)
-			{
-				ping = 999;
-			}
+	Z_Free(c.tokens);
+	Z_Free(c.start);
+	Z_Free(c.pending);
+	Z_Free(c.pendingtokens);
 
-			sprintf(block, "%3d %3d %-12.12s", score, ping, ci->name);
+	prog->valid = true;
+}
 
-			if (value == cl.playernum)
-			{
-				DrawAltStringScaled(x, y, block, scale);
-			}
+static int
+SCR_LayoutStat(int index)
+{
+	/* the layout comes from the server, don't trust it */
+	if ((index < 0) || (index >= MAX_STATS))
+	{
+		return 0;
+	}
 
-			else
-			{
-				DrawStringScaled(x, y, block, scale);
-			}
+	return cl.frame.playerstate.stats[index];
+}
 
-			continue;
-		}
+/*
+ * Runs a compiled layout program
+ */
+static void
+SCR_ExecuteLayout(const layoutprogram_t *prog)
+{
+	const int *code = prog->code;
+	char *strings = prog->strings;
+	int x, y;
+	int value;
+	int width;
+	int index;
+	int pc;
+	clientinfo_t *ci;
 
-		if (!strcmp(token, "picn"))
-		{
-			/* draw a pic from a name */
-			token = COM_Parse(&s);
-			SCR_AddDirtyPoint(x, y);
-			SCR_AddDirtyPoint(x + scale*23, y + scale*23);
-			Draw_PicScaled(x, y, (char *)token, scale);
-			continue;
-		}
+	float scale = SCR_GetHUDScale();
 
-		if (!strcmp(token, "num"))
-		{
-			/* draw a number */
-			token = COM_Parse(&s);
-			width = (int)strtol(token, (char **)NULL, 10);
-			token = COM_Parse(&s);
-			value = cl.frame.playerstate.stats[(int)strtol(token, (char **)NULL, 10)];
-			SCR_DrawFieldScaled(x, y, 0, width, value, scale);
-			continue;
-		}
+	x = 0;
+	y = 0;
+	pc = 0;
 
-		if (!strcmp(token, "hnum"))
+	while (1)
+	{
+		const int *args = &code[pc + 1];
+
+		switch (code[pc])
 		{
-			/* health number */
-			int color;
+			case LO_END:
+				return;
 
-			width = 3;
-			value = cl.frame.playerstate.stats[STAT_HEALTH];
+			case LO_JUMP:
+				pc = args[0];
+				break;
 
-			if (value > 25)
-			{
-				color = 0;  /* green */
-			}
-			else if (value > 0)
-			{
-				color = (cl.frame.serverframe >> 2) & 1; /* flash */
-			}
-			else
-			{
-				color = 1;
-			}
+			case LO_XL:
+				x = scale*args[0];
+				pc += 2;
+				break;
 
-			if (cl.frame.playerstate.stats[STAT_FLASHES] & 1)
-			{
-				Draw_PicScaled(x, y, "field_3", scale);
-			}
+			case LO_XR:
+				x = viddef.width + scale*args[0];
+				pc += 2;
+				break;
 
-			SCR_DrawFieldScaled(x, y, color, width, value, scale);
-			continue;
-		}
+			case LO_XV:
+				x = viddef.width / 2 - scale*160 + scale*args[0];
+				pc += 2;
+				break;
 
-		if (!strcmp(token, "anum"))
-		{
-			/* ammo number */
-			int color;
+			case LO_YT:
+				y = scale*args[0];
+				pc += 2;
+				break;
+
+			case LO_YB:
+				y = viddef.height + scale*args[0];
+				pc += 2;
+				break;
+
+			case LO_YV:
+				y = viddef.height / 2 - scale*120 + scale*args[0];
+				pc += 2;
+				break;
+
+			case LO_PIC:
+				/* draw a pic from a stat number */
+				index = args[0];
+				pc += 2;
 
-			width = 3;
-			value = cl.frame.playerstate.stats[STAT_AMMO];
+				if ((index < 0) || (index >= MAX_STATS))
+				{
+					Com_Error(ERR_DROP, "bad stats index %d (0x%x)", index, index);
+				}
+
+				value = cl.frame.playerstate.stats[index];
+
+				if (value >= MAX_IMAGES)
+				{
+					Com_Error(ERR_DROP, "Pic >= MAX_IMAGES");
+				}
 
-			if (value > 5)
+				if (cl.configstrings[CS_IMAGES + value][0] != '\0')
+				{
+					SCR_AddDirtyPoint(x, y);
+					SCR_AddDirtyPoint(x + 23*scale, y + 23*scale);
+					Draw_PicScaled(x, y, cl.configstrings[CS_IMAGES + value], scale);
+				}
+
+				break;
+
+			case LO_CLIENT:
 			{
-				color = 0; /* green */
+				/* draw a deathmatch client block */
+				int score, ping, time;
+
+				x = viddef.width / 2 - scale*160 + scale*args[0];
+				y = viddef.height / 2 - scale*120 + scale*args[1];
+				SCR_AddDirtyPoint(x, y);
+				SCR_AddDirtyPoint(x + scale*159, y + scale*31);
+
+				value = args[2];
+
+				if ((value >= MAX_CLIENTS) || (value < 0))
+				{
+					Com_Error(ERR_DROP, "client >= MAX_CLIENTS");
+				}
+
+				ci = &cl.clientinfo[value];
+
+				score = args[3];
+				ping = args[4];
+				time = args[5];
+				pc += 7;
+
+				DrawAltStringScaled(x + scale*32, y, ci->name, scale);
+				DrawAltStringScaled(x + scale*32, y + scale*8, "Score: ", scale);
+				DrawAltStringScaled(x + scale*(32 + 7 * 8), y + scale*8, va("%i", score), scale);
+				DrawStringScaled(x + scale*32, y + scale*16, va("Ping:  %i", ping), scale);
+				DrawStringScaled(x + scale*32, y + scale*24, va("Time:  %i", time), scale);
+
+				if (!ci->icon)
+				{
+					ci = &cl.baseclientinfo;
+				}
+
+				Draw_PicScaled(x, y, ci->iconname, scale);
+				break;
 			}
-			else if (value >= 0)
+
+			case LO_CTF:
 			{
-				color = (cl.frame.serverframe >> 2) & 1; /* flash */
+				/* draw a ctf client block */
+				int score, ping;
+				char block[80];
+
+				x = viddef.width / 2 - scale*160 + scale*args[0];
+				y = viddef.height / 2 - scale*120 + scale*args[1];
+				SCR_AddDirtyPoint(x, y);
+				SCR_AddDirtyPoint(x + scale*159, y + scale*31);
+
+				value = args[2];
+
+				if ((value >= MAX_CLIENTS) || (value < 0))
+				{
+					Com_Error(ERR_DROP, "client >= MAX_CLIENTS");
+				}
+
+				ci = &cl.clientinfo[value];
+
+				score = args[3];
+				ping = args[4];
+				pc += 6;
+
+				if (ping > 999)
+				{
+					ping = 999;
+				}
+
+				sprintf(block, "%3d %3d %-12.12s", score, ping, ci->name);
+
+				if (value == cl.playernum)
+				{
+					DrawAltStringScaled(x, y, block, scale);
+				}
+				else
+				{
+					DrawStringScaled(x, y, block, scale);
+				}
+
+				break;
 			}
-			else
+
+			case LO_PICN:
+				/* draw a pic from a name */
+				SCR_AddDirtyPoint(x, y);
+				SCR_AddDirtyPoint(x + scale*23, y + scale*23);
+				Draw_PicScaled(x, y, strings + args[0], scale);
+				pc += 2;
+				break;
+
+			case LO_NUM:
+				/* draw a number */
+				width = args[0];
+				value = SCR_LayoutStat(args[1]);
+				SCR_DrawFieldScaled(x, y, 0, width, value, scale);
+				pc += 3;
+				break;
+
+			case LO_HNUM:
 			{
-				continue; /* negative number = don't show */
+				/* health number */
+				int color;
+
+				width = 3;
+				value = cl.frame.playerstate.stats[STAT_HEALTH];
+				pc += 1;
+
+				if (value > 25)
+				{
+					color = 0;  /* green */
+				}
+				else if (value > 0)
+				{
+					color = (cl.frame.serverframe >> 2) & 1; /* flash */
+				}
+				else
+				{
+					color = 1;
+				}
+
+				if (cl.frame.playerstate.stats[STAT_FLASHES] & 1)
+				{
+					Draw_PicScaled(x, y, "field_3", scale);
+				}
+
+				SCR_DrawFieldScaled(x, y, color, width, value, scale);
+				break;
 			}
 
-			if (cl.frame.playerstate.stats[STAT_FLASHES] & 4)
+			case LO_ANUM:
 			{
-				Draw_PicScaled(x, y, "field_3", scale);
-			}
+				/* ammo number */
+				int color;
 
-			SCR_DrawFieldScaled(x, y, color, width, value, scale);
-			continue;
-		}
+				width = 3;
+				value = cl.frame.playerstate.stats[STAT_AMMO];
+				pc += 1;
 
-		if (!strcmp(token, "rnum"))
-		{
-			/* armor number */
-			int color;
+				if (value > 5)
+				{
+					color = 0; /* green */
+				}
+				else if (value >= 0)
+				{
+					color = (cl.frame.serverframe >> 2) & 1; /* flash */
+				}
+				else
+				{
+					break; /* negative number = don't show */
+				}
 
-			width = 3;
-			value = cl.frame.playerstate.stats[STAT_ARMOR];
+				if (cl.frame.playerstate.stats[STAT_FLASHES] & 4)
+				{
+					Draw_PicScaled(x, y, "field_3", scale);
+				}
 
-			if (value < 1)
-			{
-				continue;
+				SCR_DrawFieldScaled(x, y, color, width, value, scale);
+				break;
 			}
 
-			color = 0; /* green */
-
-			if (cl.frame.playerstate.stats[STAT_FLASHES] & 2)
+			case LO_RNUM:
 			{
-				Draw_PicScaled(x, y, "field_3", scale);
-			}
+				/* armor number */
+				int color;
 
-			SCR_DrawFieldScaled(x, y, color, width, value, scale);
-			continue;
-		}
+				width = 3;
+				value = cl.frame.playerstate.stats[STAT_ARMOR];
+				pc += 1;
 
-		if (!strcmp(token, "stat_string"))
-		{
-			token = COM_Parse(&s);
-			index = (int)strtol(token, (char **)NULL, 10);
+				if (value < 1)
+				{
+					break;
+				}
 
-			if ((index < 0) || (index >= MAX_STATS))
-			{
-				Com_Error(ERR_DROP, "Bad stat_string index");
-			}
+				color = 0; /* green */
 
-			index = cl.frame.playerstate.stats[index];
+				if (cl.frame.playerstate.stats[STAT_FLASHES] & 2)
+				{
+					Draw_PicScaled(x, y, "field_3", scale);
+				}
 
-			if ((index < 0) || (index >= MAX_CONFIGSTRINGS))
-			{
-				Com_Error(ERR_DROP, "Bad stat_string index");
+				SCR_DrawFieldScaled(x, y, color, width, value, scale);
+				break;
 			}
 
-			DrawStringScaled(x, y, cl.configstrings[index], scale);
-			continue;
-		}
+			case LO_STAT_STRING:
+				index = args[0];
+				pc += 2;
 
-		if (!strcmp(token, "cstring"))
-		{
-			token = COM_Parse(&s);
-			DrawHUDStringScaled(token, x, y, 320, 0, scale); // FIXME: or scale 320 here?
-			continue;
-		}
+				if ((index < 0) || (index >= MAX_STATS))
+				{
+					Com_Error(ERR_DROP, "Bad stat_string index");
+				}
 
-		if (!strcmp(token, "string"))
-		{
-			token = COM_Parse(&s);
-			DrawStringScaled(x, y, token, scale);
-			continue;
-		}
+				index = cl.frame.playerstate.stats[index];
 
-		if (!strcmp(token, "cstring2"))
-		{
-			token = COM_Parse(&s);
-			DrawHUDStringScaled(token, x, y, 320, 0x80, scale); // FIXME: or scale 320 here?
-			continue;
-		}
+				if ((index < 0) || (index >= MAX_CONFIGSTRINGS))
+				{
+					Com_Error(ERR_DROP, "Bad stat_string index");
+				}
 
-		if (!strcmp(token, "string2"))
-		{
-			token = COM_Parse(&s);
-			DrawAltStringScaled(x, y, token, scale);
-			continue;
-		}
+				DrawStringScaled(x, y, cl.configstrings[index], scale);
+				break;
 
-		if (!strcmp(token, "if"))
-		{
-			/* draw a number */
-			token = COM_Parse(&s);
-			value = cl.frame.playerstate.stats[(int)strtol(token, (char **)NULL, 10)];
+			case LO_CSTRING:
+				DrawHUDStringScaled(strings + args[0], x, y, 320, 0, scale); // FIXME: or scale 320 here?
+				pc += 2;
+				break;
 
-			if (!value)
-			{
-				/* skip to endif */
-				while (s && strcmp(token, "endif"))
+			case LO_STRING:
+				DrawStringScaled(x, y, strings + args[0], scale);
+				pc += 2;
+				break;
+
+			case LO_CSTRING2:
+				DrawHUDStringScaled(strings + args[0], x, y, 320, 0x80, scale); // FIXME: or scale 320 here?
+				pc += 2;
+				break;
+
+			case LO_STRING2:
+				DrawAltStringScaled(x, y, strings + args[0], scale);
+				pc += 2;
+				break;
+
+			case LO_IF:
+				if (!SCR_LayoutStat(args[0]))
 				{
-					token = COM_Parse(&s);
+					/* skip to endif */
+					pc = args[1];
+				}
+				else
+				{
+					pc += 3;
 				}
-			}
 
-			continue;
+				break;
+
+			default:
+				Com_Error(ERR_FATAL, "%s: bad opcode %i", __func__, code[pc]);
+				break;
 		}
 	}
 }
 
+static void
+SCR_DrawLayoutProgram(layoutprogram_t *prog, char *s)
+{
+	if ((cls.state != ca_active) || !cl.refresh_prepped)
+	{
+		return;
+	}
+
+	if (!s[0])
+	{
+		return;
+	}
+
+	if (!prog->valid)
+	{
+		SCR_CompileLayout(prog, s);
+	}
+
+	SCR_ExecuteLayout(prog);
+}
+
 /*
  * The status bar is a small layout program that
  * is based on the stats array
@@ -1431,7 +1898,7 @@ SCR_ExecuteLayoutString(char *s)
 void
 SCR_DrawStats(void)
 {
-	SCR_ExecuteLayoutString(cl.configstrings[CS_STATUSBAR]);
+	SCR_DrawLayoutProgram(&scr_statusbar, cl.configstrings[CS_STATUSBAR]);
 }
 
 #define STAT_LAYOUTS 13
@@ -1444,7 +1911,7 @@ SCR_DrawLayout(void)
 		return;
 	}
 
-	SCR_ExecuteLayoutString(cl.layout);
+	SCR_DrawLayoutProgram(&scr_layout, cl.layout);
 }
 
 // ----
@@ -1616,6 +2083,8 @@ SCR_UpdateScreen(void)
 		return; /* not initialized yet */
 	}
 
+	VID_BeginFrameTimings();
+
 	if ( gl1_stereo->value )
 	{
 		numframes = 2;
@@ -1699,6 +2168,7 @@ SCR_UpdateScreen(void)
 			SCR_TileClear();
 
 			V_RenderView(separation[i]);
+			VID_MarkPhase(PHASE_2D);
 
 			SCR_DrawStats();
 			SCR_DrawSpeed();
@@ -1738,7 +2208,12 @@ SCR_UpdateScreen(void)
 	}
 
 	SCR_Framecounter();
+	SCR_TimedemoScreenshot();
+
+	VID_MarkPhase(PHASE_PRESENT);
 	R_EndFrame();
+
+	SCR_TimedemoFrame();
 }
 
 static float
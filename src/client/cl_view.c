@@ -53,7 +53,7 @@ int r_numentities;
 entity_t r_entities[MAX_ENTITIES];
 
 int r_numparticles;
-particle_t r_particles[MAX_PARTICLES];
+particle_t r_particles[MAX_PARTICLES_LIMIT];
 
 lightstyle_t r_lightstyles[MAX_LIGHTSTYLES];
 
@@ -89,7 +89,7 @@ V_AddParticle(vec3_t org, unsigned int color, float alpha)
 {
 	particle_t *p;
 
-	if (r_numparticles >= MAX_PARTICLES)
+	if (r_numparticles >= cl_numparticles)
 	{
 		return;
 	}
@@ -137,7 +137,7 @@ V_AddLightStyle(int style, float r, float g, float b)
 }
 
 /*
- *If cl_testparticles is set, create 4096 particles in the view
+ * If cl_testparticles is set, fill the view with particles
  */
 void
 V_TestParticles(void)
@@ -146,7 +146,7 @@ V_TestParticles(void)
 	int i, j;
 	float d, r, u;
 
-	r_numparticles = MAX_PARTICLES;
+	r_numparticles = cl_numparticles;
 
 	for (i = 0; i < r_numparticles; i++)
 	{
@@ -36,10 +36,13 @@ void	SCR_SizeDown(void);
 void	SCR_CenterPrint(char *str);
 void	SCR_BeginLoadingPlaque(void);
 void	SCR_EndLoadingPlaque(void);
+void	SCR_TimedemoEnd(void);
 
 void	SCR_DebugGraph(float value, int color);
 
 void	SCR_TouchPics(void);
+void	SCR_StatusbarChanged(void);
+void	SCR_LayoutChanged(void);
 
 void	SCR_RunConsole(void);
 
@@ -63,6 +66,7 @@ void SCR_PlayCinematic(char *name);
 qboolean SCR_DrawCinematic(void);
 void SCR_RunCinematic(void);
 void SCR_StopCinematic(void);
+void SCR_StopDecoder(void);
 void SCR_FinishCinematic(void);
 
 void SCR_DrawCrosshair(void);
@@ -0,0 +1,61 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ * USA.
+ *
+ * =======================================================================
+ *
+ * Threads, semaphores and atomics used by the client. These are thin
+ * wrappers around SDL that hide the API differences between SDL 2 and 3.
+ * Atomic gets and sets are full memory barriers, so an index set after
+ * filling a slot publishes the slot to another thread.
+ *
+ * =======================================================================
+ */
+
+#ifndef CL_HEADER_THREADS_H
+#define CL_HEADER_THREADS_H
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+
+typedef SDL_AtomicInt yq2_atomic_t;
+typedef SDL_Semaphore yq2_sem_t;
+typedef SDL_Mutex yq2_mutex_t;
+
+#define YQ2_AtomicGet SDL_GetAtomicInt
+#define YQ2_AtomicSet SDL_SetAtomicInt
+#define YQ2_AtomicAdd SDL_AddAtomicInt
+#define YQ2_SemPost SDL_SignalSemaphore
+#define YQ2_SemWait SDL_WaitSemaphore
+#define YQ2_SemWaitTimeout SDL_WaitSemaphoreTimeout
+#define YQ2_SetThreadPriority SDL_SetCurrentThreadPriority
+#else
+#include <SDL2/SDL.h>
+
+typedef SDL_atomic_t yq2_atomic_t;
+typedef SDL_sem yq2_sem_t;
+typedef SDL_mutex yq2_mutex_t;
+
+#define YQ2_AtomicGet SDL_AtomicGet
+#define YQ2_AtomicSet SDL_AtomicSet
+#define YQ2_AtomicAdd SDL_AtomicAdd
+#define YQ2_SemPost SDL_SemPost
+#define YQ2_SemWait SDL_SemWait
+#define YQ2_SemWaitTimeout SDL_SemWaitTimeout
+#define YQ2_SetThreadPriority SDL_SetThreadPriority
+#endif
+
+#endif
@@ -0,0 +1,614 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * World culling shared by the renderers.
+ *
+ * Frustum: R_CullNodeBox() tests a node's bounds against the planes
+ * of the view frustum whose bit is set in clipflags, all 4 at once
+ * with SSE where available. Planes the node is completely in front
+ * of are cleared from the returned flags. The children inherit them,
+ * so subtrees completely inside the frustum aren't tested at all.
+ * The results are exactly those of R_CullBox().
+ *
+ * PVS: R_MarkVisibleLeaves() marks the leaves and nodes visible from
+ * a pair of view clusters and remembers the marked nodes. When the
+ * view moves back into a recently visited pair of clusters,
+ * R_MarkCachedLeaves() marks them again from that list, without
+ * decompressing the PVS and walking all leaves.
+ *
+ * `r_cullbench` records the camera path of the following frames and
+ * compares the old and the new culling over it.
+ *
+ * =======================================================================
+ */
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#include "../ref_shared.h"
+
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define CULL_SSE
+#include <xmmintrin.h>
+#endif
+
+#define VISCACHE_ENTRIES 8
+#define CULLBENCH_FRAMES 4096
+
+/* the view frustum, one array per component for SSE */
+typedef struct
+{
+	float normal[3][4];
+	float dist[4];
+} cullfrustum_t;
+
+typedef struct
+{
+	const mleaf_t *leafs; /* of the world the list belongs to */
+	int cluster1, cluster2;
+	mnode_t **nodes; /* leaves and nodes to mark */
+	int numnodes;
+	int lastused;
+} viscache_t;
+
+typedef struct
+{
+	vec3_t origin;
+	cplane_t frustum[4];
+} cullbenchframe_t;
+
+static cullfrustum_t r_cullfrustum;
+
+static viscache_t r_viscache[VISCACHE_ENTRIES];
+static int r_viscacheuses;
+
+static cullbenchframe_t *r_cullbenchframes;
+static int r_cullbenchnumframes;
+static qboolean r_cullbenchrecording;
+
+/*
+ * Called by R_SetFrustum() for the view frustum.
+ */
+void
+R_SetCullFrustum(const cplane_t *frustum, const vec3_t origin)
+{
+	int i, j;
+
+	for (i = 0; i < 4; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			r_cullfrustum.normal[j][i] = frustum[i].normal[j];
+		}
+
+		r_cullfrustum.dist[i] = frustum[i].dist;
+	}
+
+	if (r_cullbenchrecording)
+	{
+		cullbenchframe_t *frame = &r_cullbenchframes[r_cullbenchnumframes++];
+
+		VectorCopy(origin, frame->origin);
+		memcpy(frame->frustum, frustum, sizeof(frame->frustum));
+
+		if (r_cullbenchnumframes == CULLBENCH_FRAMES)
+		{
+			R_Printf(PRINT_ALL, "Recorded %d frames for r_cullbench.\n",
+				r_cullbenchnumframes);
+			r_cullbenchrecording = false;
+		}
+	}
+}
+
+/*
+ * The reference for R_CullNodeBox(), the
+ * same as BoxOnPlaneSide() for each plane.
+ */
+static int
+R_CullNodeBoxC(const float *minmaxs, int clipflags)
+{
+	int i, j;
+
+	for (i = 0; i < 4; i++)
+	{
+		float outer[3], inner[3];
+		float dist1, dist2;
+
+		if (!(clipflags & (1 << i)))
+		{
+			continue;
+		}
+
+		for (j = 0; j < 3; j++)
+		{
+			if (r_cullfrustum.normal[j][i] < 0)
+			{
+				outer[j] = minmaxs[j];
+				inner[j] = minmaxs[3 + j];
+			}
+			else
+			{
+				outer[j] = minmaxs[3 + j];
+				inner[j] = minmaxs[j];
+			}
+		}
+
+		dist1 = r_cullfrustum.normal[0][i] * outer[0] +
+			r_cullfrustum.normal[1][i] * outer[1] +
+			r_cullfrustum.normal[2][i] * outer[2];
+
+		if (dist1 < r_cullfrustum.dist[i])
+		{
+			return -1;
+		}
+
+		dist2 = r_cullfrustum.normal[0][i] * inner[0] +
+			r_cullfrustum.normal[1][i] * inner[1] +
+			r_cullfrustum.normal[2][i] * inner[2];
+
+		if (dist2 >= r_cullfrustum.dist[i])
+		{
+			clipflags &= ~(1 << i);
+		}
+	}
+
+	return clipflags;
+}
+
+#ifdef CULL_SSE
+static int
+R_CullNodeBoxSSE(const float *minmaxs, int clipflags)
+{
+	__m128 nx, ny, nz, negx, negy, negz;
+	__m128 minx, miny, minz, maxx, maxy, maxz;
+	__m128 fx, fy, fz, cx, cy, cz;
+	__m128 dist, dist1, dist2;
+	int outside, inside;
+
+	nx = _mm_loadu_ps(r_cullfrustum.normal[0]);
+	ny = _mm_loadu_ps(r_cullfrustum.normal[1]);
+	nz = _mm_loadu_ps(r_cullfrustum.normal[2]);
+	dist = _mm_loadu_ps(r_cullfrustum.dist);
+
+	negx = _mm_cmplt_ps(nx, _mm_setzero_ps());
+	negy = _mm_cmplt_ps(ny, _mm_setzero_ps());
+	negz = _mm_cmplt_ps(nz, _mm_setzero_ps());
+
+	minx = _mm_set1_ps(minmaxs[0]);
+	miny = _mm_set1_ps(minmaxs[1]);
+	minz = _mm_set1_ps(minmaxs[2]);
+	maxx = _mm_set1_ps(minmaxs[3]);
+	maxy = _mm_set1_ps(minmaxs[4]);
+	maxz = _mm_set1_ps(minmaxs[5]);
+
+	/* the corner farthest along each normal... */
+	fx = _mm_or_ps(_mm_and_ps(negx, minx), _mm_andnot_ps(negx, maxx));
+	fy = _mm_or_ps(_mm_and_ps(negy, miny), _mm_andnot_ps(negy, maxy));
+	fz = _mm_or_ps(_mm_and_ps(negz, minz), _mm_andnot_ps(negz, maxz));
+
+	/* ...and the one closest */
+	cx = _mm_or_ps(_mm_and_ps(negx, maxx), _mm_andnot_ps(negx, minx));
+	cy = _mm_or_ps(_mm_and_ps(negy, maxy), _mm_andnot_ps(negy, miny));
+	cz = _mm_or_ps(_mm_and_ps(negz, maxz), _mm_andnot_ps(negz, minz));
+
+	dist1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, fx), _mm_mul_ps(ny, fy)),
+		_mm_mul_ps(nz, fz));
+	dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+		_mm_mul_ps(nz, cz));
+
+	outside = _mm_movemask_ps(_mm_cmplt_ps(dist1, dist));
+	inside = _mm_movemask_ps(_mm_cmpge_ps(dist2, dist));
+
+	if (outside & clipflags)
+	{
+		return -1;
+	}
+
+	return clipflags & ~inside;
+}
+#endif
+
+/*
+ * Tests the bounds of a node against the frustum planes in
+ * clipflags. Returns -1 if it's completely outside of one of
+ * them, otherwise clipflags without the planes it's completely
+ * in front of. The children of the node only need those.
+ */
+int
+R_CullNodeBox(const float *minmaxs, int clipflags)
+{
+#ifdef CULL_SSE
+	return R_CullNodeBoxSSE(minmaxs, clipflags);
+#else
+	return R_CullNodeBoxC(minmaxs, clipflags);
+#endif
+}
+
+void
+R_FreeVisCache(void)
+{
+	int i;
+
+	for (i = 0; i < VISCACHE_ENTRIES; i++)
+	{
+		free(r_viscache[i].nodes);
+	}
+
+	memset(r_viscache, 0, sizeof(r_viscache));
+	r_viscacheuses = 0;
+}
+
+/*
+ * Marks the leaves and nodes visible from the clusters with
+ * visframe, if they are in the cache. Returns false otherwise,
+ * the caller must call R_MarkVisibleLeaves() instead.
+ */
+qboolean
+R_MarkCachedLeaves(const mleaf_t *leafs, int cluster1, int cluster2, int visframe)
+{
+	viscache_t *entry;
+	int i;
+
+	for (i = 0, entry = r_viscache; i < VISCACHE_ENTRIES; i++, entry++)
+	{
+		if (entry->nodes && (entry->leafs == leafs) &&
+			(entry->cluster1 == cluster1) && (entry->cluster2 == cluster2))
+		{
+			break;
+		}
+	}
+
+	if (i == VISCACHE_ENTRIES)
+	{
+		return false;
+	}
+
+	entry->lastused = ++r_viscacheuses;
+
+	for (i = 0; i < entry->numnodes; i++)
+	{
+		entry->nodes[i]->visframe = visframe;
+	}
+
+	return true;
+}
+
+/*
+ * Marks the leaves in vis and their parents with visframe and
+ * caches the marked nodes for R_MarkCachedLeaves(). vis is the
+ * (combined) PVS of cluster1 and cluster2.
+ */
+void
+R_MarkVisibleLeaves(mleaf_t *leafs, int numleafs, int numnodes, const byte *vis,
+	int cluster1, int cluster2, int visframe)
+{
+	viscache_t *entry;
+	mnode_t **list;
+	mleaf_t *leaf;
+	int i, count;
+
+	/* replace the least recently used entry */
+	entry = r_viscache;
+
+	for (i = 1; i < VISCACHE_ENTRIES; i++)
+	{
+		if (r_viscache[i].lastused < entry->lastused)
+		{
+			entry = &r_viscache[i];
+		}
+	}
+
+	free(entry->nodes);
+	memset(entry, 0, sizeof(*entry));
+
+	/* each node is marked only once */
+	list = malloc((numleafs + numnodes) * sizeof(mnode_t *));
+	count = 0;
+
+	for (i = 0, leaf = leafs; i < numleafs; i++, leaf++)
+	{
+		int cluster = leaf->cluster;
+		mnode_t *node;
+
+		if (cluster == -1)
+		{
+			continue;
+		}
+
+		if (!(vis[cluster >> 3] & (1 << (cluster & 7))))
+		{
+			continue;
+		}
+
+		node = (mnode_t *)leaf;
+
+		do
+		{
+			if (node->visframe == visframe)
+			{
+				break;
+			}
+
+			node->visframe = visframe;
+
+			if (list)
+			{
+				list[count++] = node;
+			}
+
+			node = node->parent;
+		}
+		while (node);
+	}
+
+	if (!list)
+	{
+		return;
+	}
+
+	entry->nodes = realloc(list, Q_max(count, 1) * sizeof(mnode_t *));
+
+	if (!entry->nodes)
+	{
+		entry->nodes = list;
+	}
+
+	entry->leafs = leafs;
+	entry->cluster1 = cluster1;
+	entry->cluster2 = cluster2;
+	entry->numnodes = count;
+	entry->lastused = ++r_viscacheuses;
+}
+
+/*
+ * The world walk of the renderers without the surfaces.
+ * Returns the number of leaves reached.
+ */
+static int
+R_CullBenchWalk(mnode_t *node, int clipflags, int visframe,
+	int (*cullnodebox)(const float *minmaxs, int clipflags))
+{
+	int count = 0;
+
+	while (1)
+	{
+		if ((node->contents == CONTENTS_SOLID) || (node->visframe != visframe))
+		{
+			return count;
+		}
+
+		if (clipflags)
+		{
+			clipflags = cullnodebox(node->minmaxs, clipflags);
+
+			if (clipflags < 0)
+			{
+				return count;
+			}
+		}
+
+		if (node->contents != CONTENTS_NODE)
+		{
+			return count + 1;
+		}
+
+		count += R_CullBenchWalk(node->children[0], clipflags, visframe, cullnodebox);
+		node = node->children[1];
+	}
+}
+
+/* like R_CullBox(), without inheriting planes */
+static const cplane_t *r_cullbenchfrustum;
+
+static int
+R_CullNodeBoxRef(const float *minmaxs, int clipflags)
+{
+	if (R_CullBox((float *)minmaxs, (float *)minmaxs + 3,
+		(cplane_t *)r_cullbenchfrustum))
+	{
+		return -1;
+	}
+
+	return FRUSTUM_ALLPLANES;
+}
+
+/*
+ * The old way of marking the leaves: decompress
+ * the PVS and walk all leaves on each change.
+ */
+static void
+R_CullBenchMarkRef(mleaf_t *leafs, int numleafs, const byte *vis, int visframe)
+{
+	mleaf_t *leaf;
+	int i;
+
+	for (i = 0, leaf = leafs; i < numleafs; i++, leaf++)
+	{
+		int cluster = leaf->cluster;
+		mnode_t *node;
+
+		if ((cluster == -1) || !(vis[cluster >> 3] & (1 << (cluster & 7))))
+		{
+			continue;
+		}
+
+		node = (mnode_t *)leaf;
+
+		do
+		{
+			if (node->visframe == visframe)
+			{
+				break;
+			}
+
+			node->visframe = visframe;
+			node = node->parent;
+		}
+		while (node);
+	}
+}
+
+/*
+ * Backend of the r_cullbench command. Without arguments,
+ * starts recording the camera path. With the number of
+ * iterations, culls the world along the recorded path with
+ * the old and the new code and prints how long it took.
+ * Changes the visframe of the nodes, the renderer must mark
+ * them again afterwards.
+ */
+void
+R_CullBench(mnode_t *nodes, mleaf_t *leafs, int numleafs, int numnodes,
+	clusterpvs_t cluster_pvs)
+{
+	const char *names[3] = {"old", "C", "SSE"};
+	int (*cullfuncs[3])(const float *minmaxs, int clipflags) = {
+		R_CullNodeBoxRef, R_CullNodeBoxC,
+#ifdef CULL_SSE
+		R_CullNodeBoxSSE
+#else
+		NULL
+#endif
+	};
+	cullfrustum_t saved;
+	int iterations, visframe, reference = 0;
+	Uint64 refmark = 1, refcull = 1;
+	int i, j, k;
+
+	if (ri.Cmd_Argc() < 2 || !strcmp(ri.Cmd_Argv(1), "record"))
+	{
+		if (!r_cullbenchframes)
+		{
+			r_cullbenchframes = malloc(CULLBENCH_FRAMES * sizeof(cullbenchframe_t));
+
+			if (!r_cullbenchframes)
+			{
+				return;
+			}
+		}
+
+		r_cullbenchnumframes = 0;
+		r_cullbenchrecording = true;
+
+		R_Printf(PRINT_ALL, "Recording up to %d frames, run `r_cullbench <iterations>` "
+			"to stop.\n", CULLBENCH_FRAMES);
+		return;
+	}
+
+	r_cullbenchrecording = false;
+
+	if (!r_cullbenchnumframes)
+	{
+		R_Printf(PRINT_ALL, "Nothing recorded, run `r_cullbench record` first.\n");
+		return;
+	}
+
+	iterations = Q_max((int)strtol(ri.Cmd_Argv(1), NULL, 10), 1);
+	saved = r_cullfrustum;
+
+	/* far away from what the renderer uses */
+	visframe = -0x40000000;
+
+	R_Printf(PRINT_ALL, "Culling %d frames %d times.\n", r_cullbenchnumframes, iterations);
+
+	for (i = 0; i < 3; i++)
+	{
+		Uint64 mark = 0, cull = 0, start;
+		int lastcluster = -2, leaves = 0;
+
+		if (!cullfuncs[i])
+		{
+			continue;
+		}
+
+		R_FreeVisCache();
+
+		for (j = 0; j < iterations; j++)
+		{
+			for (k = 0; k < r_cullbenchnumframes; k++)
+			{
+				const cullbenchframe_t *frame = &r_cullbenchframes[k];
+				int cluster = Mod_PointInLeaf(frame->origin, nodes)->cluster;
+
+				start = SDL_GetPerformanceCounter();
+
+				/* like the renderers, only when the cluster changes */
+				if (cluster != lastcluster)
+				{
+					lastcluster = cluster;
+					visframe++;
+
+					if (cluster == -1)
+					{
+						int n;
+
+						for (n = 0; n < numleafs; n++)
+						{
+							leafs[n].visframe = visframe;
+						}
+
+						for (n = 0; n < numnodes; n++)
+						{
+							nodes[n].visframe = visframe;
+						}
+					}
+					else if (cullfuncs[i] == R_CullNodeBoxRef)
+					{
+						R_CullBenchMarkRef(leafs, numleafs, cluster_pvs(cluster), visframe);
+					}
+					else if (!R_MarkCachedLeaves(leafs, cluster, cluster, visframe))
+					{
+						R_MarkVisibleLeaves(leafs, numleafs, numnodes,
+							cluster_pvs(cluster), cluster, cluster, visframe);
+					}
+				}
+
+				mark += SDL_GetPerformanceCounter() - start;
+				start = SDL_GetPerformanceCounter();
+
+				r_cullbenchfrustum = frame->frustum;
+				R_SetCullFrustum(frame->frustum, frame->origin);
+				leaves += R_CullBenchWalk(nodes, FRUSTUM_ALLPLANES, visframe, cullfuncs[i]);
+
+				cull += SDL_GetPerformanceCounter() - start;
+			}
+		}
+
+		mark = Q_max(mark, 1);
+		cull = Q_max(cull, 1);
+
+		if (i == 0)
+		{
+			reference = leaves;
+			refmark = mark;
+			refcull = cull;
+		}
+
+		R_Printf(PRINT_ALL, "%-3s %8.2f ms marking (%.2fx) %8.2f ms culling (%.2fx) %d leaves%s\n",
+			names[i], 1000.0 * mark / SDL_GetPerformanceFrequency(), (float)refmark / mark,
+			1000.0 * cull / SDL_GetPerformanceFrequency(), (float)refcull / cull,
+			leaves / iterations, (leaves != reference) ? " MISMATCH" : "");
+	}
+
+	r_cullfrustum = saved;
+	R_FreeVisCache();
+}
@@ -0,0 +1,439 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Light grid. With r_lightgrid set, the lighting of models is sampled
+ * once at map load on a regular grid over the world, instead of tracing
+ * into the BSP for each model each frame. Each grid point keeps the raw
+ * lightmap samples of up to MAXLIGHTMAPS styles, so animated lightstyles
+ * still work. Points in solid space are left out, looking up a position
+ * interpolates trilinearly between the other 8 surrounding points.
+ * With r_lightgrid 2, the grid is saved next to the map in the game dir
+ * and loaded from there as long as the BSP doesn't change.
+ *
+ * =======================================================================
+ */
+
+#include "../ref_shared.h"
+
+#define LIGHTGRID_IDENT (('D' << 24) + ('R' << 16) + ('G' << 8) + 'L')
+#define LIGHTGRID_VERSION 1
+
+// the grid gets coarser on huge maps
+#define LIGHTGRID_MAX_POINTS (1024 * 1024)
+
+typedef struct
+{
+	int ident;
+	int version;
+	unsigned checksum; // of the BSP file
+	int step[3];
+	int size[3];
+	int numsamples;
+} lightgridheader_t;
+
+// in the file, the header is followed by the cells and the samples
+typedef struct
+{
+	char name[MAX_QPATH];
+	unsigned checksum;
+	vec3_t origin; // position of the first grid point
+	int step[3];
+	int size[3];
+	int *cells; // index into samples, -1 in solid space
+	lightsample_t *samples;
+	int numsamples;
+} lightgrid_t;
+
+static cvar_t *r_lightgrid;
+static lightgrid_t lightgrid;
+
+/*
+ * Adds up the lightmap samples, each style
+ * weighted by its current value and scale.
+ */
+void
+R_LightSampleColor(const lightsample_t *sample, const lightstyle_t *lightstyles,
+	float scale, vec3_t color)
+{
+	int maps, j;
+
+	VectorClear(color);
+
+	for (maps = 0; maps < MAXLIGHTMAPS && sample->styles[maps] != 255; maps++)
+	{
+		const float *rgb = lightstyles[sample->styles[maps]].rgb;
+
+		for (j = 0; j < 3; j++)
+		{
+			color[j] += sample->rgb[maps][j] * rgb[j] * scale * (1.0 / 255);
+		}
+	}
+}
+
+void
+Mod_FreeLightGrid(void)
+{
+	free(lightgrid.cells);
+	free(lightgrid.samples);
+
+	memset(&lightgrid, 0, sizeof(lightgrid));
+}
+
+static void
+Mod_LightGridPath(const char *name, char *path, size_t size)
+{
+	char base[MAX_QPATH];
+
+	Q_strlcpy(base, name, sizeof(base));
+	COM_StripExtension(base, base);
+
+	Com_sprintf(path, size, "%s/%s.lightgrid", ri.FS_Gamedir(), base);
+}
+
+static qboolean
+Mod_ReadLightGrid(const char *path, int numcells)
+{
+	lightgridheader_t header;
+	qboolean ok;
+	FILE *f;
+	int i;
+
+	f = fopen(path, "rb");
+
+	if (!f)
+	{
+		return false;
+	}
+
+	if ((fread(&header, sizeof(header), 1, f) != 1) ||
+		(header.ident != LIGHTGRID_IDENT) ||
+		(header.version != LIGHTGRID_VERSION) ||
+		(header.checksum != lightgrid.checksum) ||
+		memcmp(header.step, lightgrid.step, sizeof(header.step)) ||
+		memcmp(header.size, lightgrid.size, sizeof(header.size)) ||
+		(header.numsamples < 0) || (header.numsamples > numcells))
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: %s is outdated, ignoring it\n", __func__, path);
+		fclose(f);
+
+		return false;
+	}
+
+	lightgrid.numsamples = header.numsamples;
+	lightgrid.samples = malloc(sizeof(lightsample_t) * (header.numsamples + 1));
+
+	ok = lightgrid.samples &&
+		(fread(lightgrid.cells, sizeof(int), numcells, f) == (size_t)numcells) &&
+		(fread(lightgrid.samples, sizeof(lightsample_t), header.numsamples, f) ==
+			(size_t)header.numsamples);
+
+	fclose(f);
+
+	for (i = 0; ok && i < numcells; i++)
+	{
+		ok = (lightgrid.cells[i] >= -1) && (lightgrid.cells[i] < lightgrid.numsamples);
+	}
+
+	if (!ok)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: %s is broken, ignoring it\n", __func__, path);
+
+		free(lightgrid.samples);
+		lightgrid.samples = NULL;
+		lightgrid.numsamples = 0;
+	}
+
+	return ok;
+}
+
+static void
+Mod_WriteLightGrid(const char *path, int numcells)
+{
+	lightgridheader_t header;
+	char dir[MAX_OSPATH];
+	char *slash;
+	qboolean ok;
+	FILE *f;
+
+	Q_strlcpy(dir, path, sizeof(dir));
+	slash = strrchr(dir, '/');
+
+	if (slash)
+	{
+		*slash = '\0';
+		Mod_Mkdir(dir);
+	}
+
+	f = fopen(path, "wb");
+
+	if (!f)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: Couldn't open %s for writing\n", __func__, path);
+		return;
+	}
+
+	header.ident = LIGHTGRID_IDENT;
+	header.version = LIGHTGRID_VERSION;
+	header.checksum = lightgrid.checksum;
+	memcpy(header.step, lightgrid.step, sizeof(header.step));
+	memcpy(header.size, lightgrid.size, sizeof(header.size));
+	header.numsamples = lightgrid.numsamples;
+
+	ok = (fwrite(&header, sizeof(header), 1, f) == 1) &&
+		(fwrite(lightgrid.cells, sizeof(int), numcells, f) == (size_t)numcells) &&
+		(fwrite(lightgrid.samples, sizeof(lightsample_t), lightgrid.numsamples, f) ==
+			(size_t)lightgrid.numsamples);
+
+	fclose(f);
+
+	if (!ok)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: Couldn't write %s\n", __func__, path);
+		remove(path);
+	}
+}
+
+/*
+ * Samples the light at all grid points outside of solid space.
+ */
+static qboolean
+Mod_BakeLightGrid(mnode_t *nodes, int numcells, samplelight_t sample_light)
+{
+	lightsample_t *samples;
+	int x, y, z, i;
+
+	samples = malloc(sizeof(lightsample_t) * numcells);
+
+	if (!samples)
+	{
+		return false;
+	}
+
+	i = 0;
+
+	for (z = 0; z < lightgrid.size[2]; z++)
+	{
+		for (y = 0; y < lightgrid.size[1]; y++)
+		{
+			for (x = 0; x < lightgrid.size[0]; x++, i++)
+			{
+				vec3_t p;
+
+				p[0] = lightgrid.origin[0] + x * lightgrid.step[0];
+				p[1] = lightgrid.origin[1] + y * lightgrid.step[1];
+				p[2] = lightgrid.origin[2] + z * lightgrid.step[2];
+
+				if (Mod_PointInLeaf(p, nodes)->contents & CONTENTS_SOLID)
+				{
+					lightgrid.cells[i] = -1;
+					continue;
+				}
+
+				sample_light(p, &samples[lightgrid.numsamples]);
+				lightgrid.cells[i] = lightgrid.numsamples++;
+			}
+		}
+	}
+
+	/* give back what solid space didn't need */
+	lightgrid.samples = realloc(samples,
+		sizeof(lightsample_t) * (lightgrid.numsamples + 1));
+
+	if (!lightgrid.samples)
+	{
+		lightgrid.samples = samples;
+	}
+
+	return true;
+}
+
+/*
+ * Sets up the light grid for the world model name, either
+ * loaded from the game dir or baked with sample_light.
+ * Does nothing if the grid for this map is already set up.
+ */
+void
+Mod_LoadLightGrid(const char *name, unsigned checksum, mnode_t *nodes,
+	const vec3_t mins, const vec3_t maxs, samplelight_t sample_light)
+{
+	char path[MAX_OSPATH];
+	int numcells, i;
+
+	if (!r_lightgrid)
+	{
+		r_lightgrid = ri.Cvar_Get("r_lightgrid", "0", CVAR_ARCHIVE);
+	}
+
+	if (!r_lightgrid->value)
+	{
+		Mod_FreeLightGrid();
+		return;
+	}
+
+	if (lightgrid.cells && (lightgrid.checksum == checksum) &&
+		!strcmp(lightgrid.name, name))
+	{
+		return;
+	}
+
+	Mod_FreeLightGrid();
+
+	Q_strlcpy(lightgrid.name, name, sizeof(lightgrid.name));
+	lightgrid.checksum = checksum;
+
+	lightgrid.step[0] = lightgrid.step[1] = 32;
+	lightgrid.step[2] = 64;
+
+	while (1)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			lightgrid.origin[i] = floor(mins[i] / lightgrid.step[i]) * lightgrid.step[i];
+			lightgrid.size[i] = (int)ceil((maxs[i] - lightgrid.origin[i]) /
+				lightgrid.step[i]) + 1;
+		}
+
+		numcells = lightgrid.size[0] * lightgrid.size[1] * lightgrid.size[2];
+
+		if (numcells <= LIGHTGRID_MAX_POINTS)
+		{
+			break;
+		}
+
+		for (i = 0; i < 3; i++)
+		{
+			lightgrid.step[i] *= 2;
+		}
+	}
+
+	lightgrid.cells = malloc(sizeof(int) * numcells);
+
+	if (!lightgrid.cells)
+	{
+		Mod_FreeLightGrid();
+		return;
+	}
+
+	Mod_LightGridPath(name, path, sizeof(path));
+
+	if ((r_lightgrid->value > 1) && Mod_ReadLightGrid(path, numcells))
+	{
+		return;
+	}
+
+	if (!Mod_BakeLightGrid(nodes, numcells, sample_light))
+	{
+		R_Printf(PRINT_ALL, "%s: Couldn't bake the light grid of %s\n",
+			__func__, name);
+		Mod_FreeLightGrid();
+
+		return;
+	}
+
+	R_Printf(PRINT_DEVELOPER, "%s: Baked %d of %d light grid points for %s\n",
+		__func__, lightgrid.numsamples, numcells, name);
+
+	if (r_lightgrid->value > 1)
+	{
+		Mod_WriteLightGrid(path, numcells);
+	}
+}
+
+/*
+ * Interpolates the light at p from the grid, in the same
+ * units as R_LightSampleColor(). Returns false if there's
+ * no grid or p isn't near any grid point outside of solid
+ * space, the caller must trace into the world instead.
+ */
+qboolean
+R_LightGridPoint(const vec3_t p, const lightstyle_t *lightstyles, float scale,
+	vec3_t color)
+{
+	float frac[3], total;
+	int base[3];
+	int corner, i;
+
+	if (!lightgrid.cells || !r_lightgrid->value)
+	{
+		return false;
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		float f = (p[i] - lightgrid.origin[i]) / lightgrid.step[i];
+
+		base[i] = (int)floor(f);
+		frac[i] = f - base[i];
+	}
+
+	VectorClear(color);
+	total = 0;
+
+	for (corner = 0; corner < 8; corner++)
+	{
+		vec3_t cornercolor;
+		float weight = 1.0f;
+		int c[3], cell;
+
+		for (i = 0; i < 3; i++)
+		{
+			if (corner & (1 << i))
+			{
+				c[i] = base[i] + 1;
+				weight *= frac[i];
+			}
+			else
+			{
+				c[i] = base[i];
+				weight *= 1.0f - frac[i];
+			}
+
+			if ((c[i] < 0) || (c[i] >= lightgrid.size[i]))
+			{
+				break;
+			}
+		}
+
+		if ((i < 3) || (weight <= 0))
+		{
+			continue;
+		}
+
+		cell = lightgrid.cells[(c[2] * lightgrid.size[1] + c[1]) *
+			lightgrid.size[0] + c[0]];
+
+		if (cell < 0)
+		{
+			continue;
+		}
+
+		R_LightSampleColor(&lightgrid.samples[cell], lightstyles, scale, cornercolor);
+		VectorMA(color, weight, cornercolor, color);
+		total += weight;
+	}
+
+	if (total < 0.001f)
+	{
+		return false;
+	}
+
+	VectorScale(color, 1.0f / total, color);
+
+	return true;
+}
@@ -38,6 +38,598 @@ static inline void endianSwap2(float* dst, const float* src) {
 }
 #endif
 
+/*
+==============================================================================
+
+BAKED ALIAS MODELS
+
+==============================================================================
+*/
+
+/* Size of the simulated post transform cache. */
+#define BAKE_CACHE_SIZE 32
+
+/* The baked data starts at the next 16 byte boundary after the MD2 data. */
+#define BAKED_OFS(ofs_end) (((ofs_end) + 15) & ~15)
+
+typedef struct
+{
+	int xyz;
+	int s, t; /* float bits from the glcmds */
+} bakevert_t;
+
+/*
+ * Returns the baked data of a model loaded
+ * by Mod_LoadMD2() with bake set. Models
+ * loaded without it have no baked data.
+ */
+const dmdlbaked_t *
+Mod_GetBakedMD2(const dmdl_t *pheader)
+{
+	return (const dmdlbaked_t *)((const byte *)pheader + BAKED_OFS(pheader->ofs_end));
+}
+
+/*
+ * Score of a vertex when ordering the triangles,
+ * see Tom Forsyth's "Linear-Speed Vertex Cache
+ * Optimisation". Vertices recently used and with
+ * few triangles left are preferred.
+ */
+static float
+Mod_BakeVertexScore(int cachepos, int remaining)
+{
+	float score = 0;
+
+	if (!remaining)
+	{
+		return -1.0f;
+	}
+
+	if (cachepos >= 0)
+	{
+		if (cachepos < 3)
+		{
+			/* the last triangle, using it again
+			   doesn't help much */
+			score = 0.75f;
+		}
+		else
+		{
+			score = powf(1.0f - (cachepos - 3) *
+				(1.0f / (BAKE_CACHE_SIZE - 3)), 1.5f);
+		}
+	}
+
+	return score + 2.0f / sqrtf((float)remaining);
+}
+
+/*
+ * Reorders the triangles in indices for
+ * the post transform vertex cache.
+ */
+static void
+Mod_BakeOptimizeTris(int *indices, int numtris, int numverts)
+{
+	int *remaining, *adjofs, *adj, *cachepos, *order;
+	int cache[BAKE_CACHE_SIZE + 3], newcache[BAKE_CACHE_SIZE + 3];
+	int cachesize, newsize, next, best, i, j, k;
+	float *vertscore, *triscore, bestscore;
+	qboolean *added;
+
+	remaining = calloc(numverts * 3 + 1, sizeof(int));
+	adj = malloc(numtris * 3 * sizeof(int));
+	order = malloc(numtris * 3 * sizeof(int));
+	vertscore = malloc(numverts * sizeof(float));
+	triscore = malloc(numtris * sizeof(float));
+	added = calloc(numtris, sizeof(qboolean));
+
+	if (!remaining || !adj || !order || !vertscore || !triscore || !added)
+	{
+		/* keep the original order */
+		goto out;
+	}
+
+	adjofs = remaining + numverts;
+	cachepos = adjofs + numverts + 1;
+
+	/* triangles using each vertex */
+	for (i = 0; i < numtris * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+
+	for (i = 0; i < numverts; i++)
+	{
+		adjofs[i + 1] = adjofs[i] + remaining[i];
+		remaining[i] = 0;
+		cachepos[i] = -1;
+	}
+
+	for (i = 0; i < numtris * 3; i++)
+	{
+		int v = indices[i];
+
+		adj[adjofs[v] + remaining[v]++] = i / 3;
+	}
+
+	for (i = 0; i < numverts; i++)
+	{
+		vertscore[i] = Mod_BakeVertexScore(-1, remaining[i]);
+	}
+
+	best = 0;
+	bestscore = -1.0f;
+
+	for (i = 0; i < numtris; i++)
+	{
+		triscore[i] = vertscore[indices[i * 3]] + vertscore[indices[i * 3 + 1]] +
+			vertscore[indices[i * 3 + 2]];
+
+		if (triscore[i] > bestscore)
+		{
+			bestscore = triscore[i];
+			best = i;
+		}
+	}
+
+	cachesize = 0;
+	next = 0;
+
+	for (i = 0; i < numtris; i++)
+	{
+		if (best < 0)
+		{
+			/* nothing connected to the cache
+			   left, take the next unused one */
+			while (added[next])
+			{
+				next++;
+			}
+
+			best = next;
+		}
+
+		added[best] = true;
+		memcpy(&order[i * 3], &indices[best * 3], 3 * sizeof(int));
+
+		/* the triangle's vertices go to the front
+		   of the cache, the others move back */
+		newsize = 0;
+
+		for (j = 0; j < 3; j++)
+		{
+			int v = indices[best * 3 + j];
+			int *vadj = &adj[adjofs[v]];
+
+			for (k = 0; k < remaining[v]; k++)
+			{
+				if (vadj[k] == best)
+				{
+					vadj[k] = vadj[--remaining[v]];
+					break;
+				}
+			}
+
+			newcache[newsize++] = v;
+		}
+
+		for (j = 0; j < cachesize; j++)
+		{
+			int v = cache[j];
+
+			if ((v != newcache[0]) && (v != newcache[1]) && (v != newcache[2]))
+			{
+				newcache[newsize++] = v;
+			}
+		}
+
+		/* update the scores of everything in
+		   the cache and of what fell out */
+		for (j = 0; j < newsize; j++)
+		{
+			int v = newcache[j];
+
+			cachepos[v] = (j < BAKE_CACHE_SIZE) ? j : -1;
+			vertscore[v] = Mod_BakeVertexScore(cachepos[v], remaining[v]);
+		}
+
+		best = -1;
+		bestscore = -1.0f;
+
+		for (j = 0; j < newsize; j++)
+		{
+			int v = newcache[j];
+
+			for (k = 0; k < remaining[v]; k++)
+			{
+				int tri = adj[adjofs[v] + k];
+
+				triscore[tri] = vertscore[indices[tri * 3]] +
+					vertscore[indices[tri * 3 + 1]] +
+					vertscore[indices[tri * 3 + 2]];
+
+				if (triscore[tri] > bestscore)
+				{
+					bestscore = triscore[tri];
+					best = tri;
+				}
+			}
+		}
+
+		cachesize = (newsize > BAKE_CACHE_SIZE) ? BAKE_CACHE_SIZE : newsize;
+		memcpy(cache, newcache, cachesize * sizeof(int));
+	}
+
+	memcpy(indices, order, numtris * 3 * sizeof(int));
+
+out:
+	free(remaining);
+	free(adj);
+	free(order);
+	free(vertscore);
+	free(triscore);
+	free(added);
+}
+
+/*
+ * Adds a glcmd vertex to the baked vertices,
+ * returns its index. Vertices are hashed by
+ * xyz index and texture coordinates.
+ */
+static int
+Mod_BakeAddVert(bakevert_t *verts, int *numverts, int *hash, int *chain,
+	int hashsize, int xyz, int s, int t)
+{
+	unsigned h;
+	int i;
+
+	h = ((unsigned)xyz * 73856093u ^ (unsigned)s * 19349663u ^
+		(unsigned)t * 83492791u) & (hashsize - 1);
+
+	for (i = hash[h]; i >= 0; i = chain[i])
+	{
+		if ((verts[i].xyz == xyz) && (verts[i].s == s) && (verts[i].t == t))
+		{
+			return i;
+		}
+	}
+
+	i = (*numverts)++;
+	verts[i].xyz = xyz;
+	verts[i].s = s;
+	verts[i].t = t;
+	chain[i] = hash[h];
+	hash[h] = i;
+
+	return i;
+}
+
+/*
+ * Bakes an MD2 file. header is the already byte swapped
+ * header of buffer. Returns a malloc()ed dmdlbaked_t
+ * or NULL if the model can't be baked.
+ */
+static dmdlbaked_t *
+Mod_BakeMD2(const char *mod_name, const dmdl_t *header, const byte *buffer,
+	int modfilelen, unsigned checksum)
+{
+	int maxverts, numverts, numindices, hashsize, i, j;
+	int *hash, *chain, *indices, *remap;
+	bakevert_t *verts;
+	const int *cmds, *cmdsend;
+	dmdlbaked_t *baked = NULL;
+
+	if ((header->ofs_glcmds < 0) || (header->num_glcmds <= 0) ||
+		(header->ofs_glcmds + header->num_glcmds * (int)sizeof(int) > header->ofs_end) ||
+		(header->framesize < (int)sizeof(daliasframe_t) - (int)sizeof(dtrivertx_t) +
+			header->num_xyz * (int)sizeof(dtrivertx_t)) ||
+		(header->ofs_frames < 0) ||
+		(header->ofs_frames + header->num_frames * header->framesize > header->ofs_end))
+	{
+		return NULL;
+	}
+
+	/* each vertex takes 3 dwords */
+	maxverts = header->num_glcmds / 3;
+
+	for (hashsize = 256; hashsize < maxverts; hashsize <<= 1)
+	{
+	}
+
+	verts = malloc(maxverts * sizeof(*verts));
+	indices = malloc(maxverts * 3 * sizeof(int));
+	hash = malloc((hashsize + maxverts * 2) * sizeof(int));
+
+	if (!verts || !indices || !hash)
+	{
+		goto out;
+	}
+
+	chain = hash + hashsize;
+	remap = chain + maxverts;
+	memset(hash, -1, hashsize * sizeof(int));
+
+	/* convert the strips and fans to triangles,
+	   like the GL renderers do it */
+	cmds = (const int *)(buffer + header->ofs_glcmds);
+	cmdsend = cmds + header->num_glcmds;
+	numverts = 0;
+	numindices = 0;
+
+	while (cmds < cmdsend)
+	{
+		int count = LittleLong(*cmds++);
+		qboolean fan = false;
+
+		if (!count)
+		{
+			break;
+		}
+
+		if (count < 0)
+		{
+			count = -count;
+			fan = true;
+		}
+
+		if (cmds + count * 3 > cmdsend)
+		{
+			goto out;
+		}
+
+		for (i = 0; i < count; i++, cmds += 3)
+		{
+			int xyz = LittleLong(cmds[2]);
+
+			if ((xyz < 0) || (xyz >= header->num_xyz))
+			{
+				goto out;
+			}
+
+			remap[i] = Mod_BakeAddVert(verts, &numverts, hash, chain,
+				hashsize, xyz, LittleLong(cmds[0]), LittleLong(cmds[1]));
+		}
+
+		for (i = 1; i < count - 1; i++)
+		{
+			int *tri = &indices[numindices];
+
+			if (fan)
+			{
+				tri[0] = remap[0];
+				tri[1] = remap[i];
+				tri[2] = remap[i + 1];
+			}
+			else if (i & 1)
+			{
+				tri[0] = remap[i - 1];
+				tri[1] = remap[i];
+				tri[2] = remap[i + 1];
+			}
+			else
+			{
+				/* every other strip triangle is flipped */
+				tri[0] = remap[i - 1];
+				tri[1] = remap[i + 1];
+				tri[2] = remap[i];
+			}
+
+			numindices += 3;
+		}
+	}
+
+	if (!numindices || (numverts > 0xffff))
+	{
+		goto out;
+	}
+
+	Mod_BakeOptimizeTris(indices, numindices / 3, numverts);
+
+	/* number the vertices in order of their first use */
+	memset(remap, -1, numverts * sizeof(int));
+
+	for (i = 0, j = 0; i < numindices; i++)
+	{
+		if (remap[indices[i]] < 0)
+		{
+			remap[indices[i]] = j++;
+		}
+
+		indices[i] = remap[indices[i]];
+	}
+
+	{
+		int ofs_st = sizeof(dmdlbaked_t);
+		int ofs_indices = ofs_st + numverts * 2 * sizeof(float);
+		int ofs_frames = (ofs_indices + numindices * sizeof(unsigned short) + 3) & ~3;
+		int ofs_end = ofs_frames + header->num_frames * numverts * sizeof(dtrivertx_t);
+		unsigned short *outindices;
+		dtrivertx_t *outverts;
+		int *outst;
+
+		baked = malloc(ofs_end);
+
+		if (!baked)
+		{
+			goto out;
+		}
+
+		baked->ident = BAKEDMD2_IDENT;
+		baked->version = BAKEDMD2_VERSION;
+		baked->checksum = checksum;
+		baked->filelen = modfilelen;
+		baked->num_verts = numverts;
+		baked->num_indices = numindices;
+		baked->num_frames = header->num_frames;
+		baked->ofs_st = ofs_st;
+		baked->ofs_indices = ofs_indices;
+		baked->ofs_frames = ofs_frames;
+		baked->ofs_end = ofs_end;
+
+		/* the float bits are already swapped */
+		outst = (int *)((byte *)baked + ofs_st);
+		outindices = (unsigned short *)((byte *)baked + ofs_indices);
+		outverts = (dtrivertx_t *)((byte *)baked + ofs_frames);
+
+		for (i = 0; i < numverts; i++)
+		{
+			outst[remap[i] * 2] = verts[i].s;
+			outst[remap[i] * 2 + 1] = verts[i].t;
+		}
+
+		for (i = 0; i < numindices; i++)
+		{
+			outindices[i] = indices[i];
+		}
+
+		for (i = 0; i < header->num_frames; i++, outverts += numverts)
+		{
+			const daliasframe_t *frame = (const daliasframe_t *)(buffer +
+				header->ofs_frames + i * header->framesize);
+
+			for (j = 0; j < numverts; j++)
+			{
+				outverts[remap[j]] = frame->verts[verts[j].xyz];
+			}
+		}
+	}
+
+out:
+	if (!baked)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: Couldn't bake %s\n", __func__, mod_name);
+	}
+
+	free(verts);
+	free(indices);
+	free(hash);
+
+	return baked;
+}
+
+/*
+ * Checks a baked model read from the
+ * cache, it may be broken or outdated.
+ */
+static qboolean
+Mod_CheckBakedMD2(const dmdlbaked_t *baked, int len, const dmdl_t *header,
+	int modfilelen, unsigned checksum)
+{
+	const unsigned short *indices;
+	int i;
+
+	if ((len < (int)sizeof(dmdlbaked_t)) ||
+		(baked->ident != BAKEDMD2_IDENT) ||
+		(baked->version != BAKEDMD2_VERSION) ||
+		(baked->checksum != checksum) ||
+		(baked->filelen != modfilelen) ||
+		(baked->ofs_end != len) ||
+		(baked->num_verts <= 0) || (baked->num_verts > 0xffff) ||
+		(baked->num_indices <= 0) ||
+		(baked->num_frames != header->num_frames) ||
+		(baked->ofs_st != sizeof(dmdlbaked_t)) ||
+		(baked->ofs_indices != baked->ofs_st + baked->num_verts * 2 * (int)sizeof(float)) ||
+		(baked->ofs_frames < baked->ofs_indices + baked->num_indices * (int)sizeof(unsigned short)) ||
+		(baked->ofs_end != baked->ofs_frames +
+			baked->num_frames * baked->num_verts * (int)sizeof(dtrivertx_t)))
+	{
+		return false;
+	}
+
+	indices = (const unsigned short *)((const byte *)baked + baked->ofs_indices);
+
+	for (i = 0; i < baked->num_indices; i++)
+	{
+		if (indices[i] >= baked->num_verts)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Returns the baked model for an MD2 file, either
+ * from the cache in the game dir or baked now.
+ * The result must be free()d.
+ */
+static dmdlbaked_t *
+Mod_LoadBakedMD2(const char *mod_name, const dmdl_t *header, const byte *buffer,
+	int modfilelen)
+{
+	static cvar_t *r_modelcache;
+	char path[MAX_OSPATH];
+	dmdlbaked_t *baked;
+	unsigned checksum;
+	FILE *f;
+
+	if (!r_modelcache)
+	{
+		r_modelcache = ri.Cvar_Get("r_modelcache", "0", CVAR_ARCHIVE);
+	}
+
+	checksum = Com_BlockChecksum((void *)buffer, modfilelen);
+
+	if (!r_modelcache->value)
+	{
+		return Mod_BakeMD2(mod_name, header, buffer, modfilelen, checksum);
+	}
+
+	Com_sprintf(path, sizeof(path), "%s/modelcache/%08x.ybm",
+		ri.FS_Gamedir(), checksum);
+
+	f = fopen(path, "rb");
+
+	if (f)
+	{
+		long len;
+
+		baked = NULL;
+
+		if (!fseek(f, 0, SEEK_END) && ((len = ftell(f)) > 0) &&
+			!fseek(f, 0, SEEK_SET) && (baked = malloc(len)))
+		{
+			if ((fread(baked, 1, len, f) == (size_t)len) &&
+				Mod_CheckBakedMD2(baked, len, header, modfilelen, checksum))
+			{
+				fclose(f);
+
+				return baked;
+			}
+
+			free(baked);
+		}
+
+		fclose(f);
+	}
+
+	baked = Mod_BakeMD2(mod_name, header, buffer, modfilelen, checksum);
+
+	if (baked)
+	{
+		char dir[MAX_OSPATH];
+
+		Com_sprintf(dir, sizeof(dir), "%s/modelcache", ri.FS_Gamedir());
+		Mod_Mkdir(dir);
+
+		f = fopen(path, "wb");
+
+		if (f)
+		{
+			if (fwrite(baked, 1, baked->ofs_end, f) != (size_t)baked->ofs_end)
+			{
+				R_Printf(PRINT_DEVELOPER, "%s: Couldn't write %s\n",
+					__func__, path);
+			}
+
+			fclose(f);
+		}
+	}
+
+	return baked;
+}
+
 /*
 =================
 Mod_LoadAliasModel/Mod_LoadMD2
@@ -46,9 +638,10 @@ Mod_LoadAliasModel/Mod_LoadMD2
 void *
 Mod_LoadMD2 (const char *mod_name, const void *buffer, int modfilelen,
 	vec3_t mins, vec3_t maxs, struct image_s **skins, findimage_t find_image,
-	modtype_t *type)
+	modtype_t *type, qboolean bake)
 {
-	dmdl_t		*pinmodel, *pheader;
+	dmdl_t		*pinmodel, *pheader, header;
+	dmdlbaked_t	*baked;
 	dtriangle_t	*pintri, *pouttri;
 	dstvert_t	*pinst, *poutst;
 	int		*pincmd, *poutcmd;
@@ -75,10 +668,9 @@ Mod_LoadMD2 (const char *mod_name, const void *buffer, int modfilelen,
 		return NULL;
 	}
 
-	extradata = Hunk_Begin(modfilelen);
-	pheader = Hunk_Alloc(ofs_end);
-
 	// byte swap the header fields and sanity check
+	pheader = &header;
+
 	for (i=0 ; i<sizeof(dmdl_t)/sizeof(int) ; i++)
 		((int *)pheader)[i] = LittleLong (((int *)buffer)[i]);
 
@@ -132,6 +724,38 @@ Mod_LoadMD2 (const char *mod_name, const void *buffer, int modfilelen,
 		pheader->num_skins = MAX_MD2SKINS;
 	}
 
+	if (!bake)
+	{
+		extradata = Hunk_Begin(modfilelen);
+		pheader = Hunk_Alloc(ofs_end);
+		memcpy(pheader, &header, sizeof(dmdl_t));
+	}
+	else
+	{
+		// the renderer draws the baked triangles,
+		// the MD2 data is kept for everything else
+		int bakedsize, hunksize;
+
+		baked = Mod_LoadBakedMD2(mod_name, pheader, buffer, modfilelen);
+
+		bakedsize = baked ? baked->ofs_end : sizeof(dmdlbaked_t);
+		hunksize = BAKED_OFS(ofs_end) + bakedsize;
+
+		extradata = Hunk_Begin(hunksize > modfilelen ? hunksize : modfilelen);
+		pheader = Hunk_Alloc(hunksize);
+		memcpy(pheader, &header, sizeof(dmdl_t));
+
+		if (baked)
+		{
+			memcpy((byte *)pheader + BAKED_OFS(ofs_end), baked, bakedsize);
+			free(baked);
+		}
+		else
+		{
+			memset((byte *)pheader + BAKED_OFS(ofs_end), 0, bakedsize);
+		}
+	}
+
 	//
 	// load base s and t vertices (not used in gl version)
 	//
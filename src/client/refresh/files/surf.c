@@ -183,4 +183,6 @@ R_SetFrustum(vec3_t vup, vec3_t vpn, vec3_t vright, vec3_t r_origin,
 		frustum[i].dist = DotProduct(r_origin, frustum[i].normal);
 		frustum[i].signbits = R_SignbitsForPlane(&frustum[i]);
 	}
+
+	R_SetCullFrustum(frustum, r_origin);
 }
@@ -54,6 +54,10 @@ glbuffer_t gl_buf;
 
 GLuint vt, tx, cl;	// indices for arrays in gl_buf
 
+// 2D batches and quads drawn, for r_speeds
+static int r_2d_draws, r_2d_quads;
+int c_2d_draws, c_2d_quads;
+
 extern void R_MYgluPerspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar);
 
 void
@@ -80,6 +84,12 @@ R_ApplyGLBuffer(void)
 		case buf_2d:
 			vtx_size = 2;
 			break;
+		case buf_2dfill:
+			vtx_size = 2;
+			texture = false;
+			color = true;
+			glDisable(GL_TEXTURE_2D);
+			break;
 		case buf_mtex:
 			mtex = true;
 			break;
@@ -227,6 +237,23 @@ R_ApplyGLBuffer(void)
 	glDrawElements(GL_TRIANGLES, gl_buf.idx_ptr, GL_UNSIGNED_SHORT, gl_buf.idx);
 	// ... and now, turn back everything as it was
 
+	if (mtex)
+	{
+		c_lightmapped_draws++;
+	}
+
+	if (gl_buf.type == buf_2d || gl_buf.type == buf_2dfill)
+	{
+		r_2d_draws++;
+		r_2d_quads += gl_buf.vtx_ptr / 4;
+	}
+
+	if (gl_buf.type == buf_2dfill)
+	{
+		glColor4f(1, 1, 1, 1);
+		glEnable(GL_TEXTURE_2D);
+	}
+
 	if (color)
 	{
 		glDisableClientState(GL_COLOR_ARRAY);
@@ -298,9 +325,12 @@ R_UpdateGLBuffer(buffered_draw_t type, int colortex, int lighttex, int flags, fl
 	}
 }
 
-void
-R_Buffer2DQuad(GLfloat ul_vx, GLfloat ul_vy, GLfloat dr_vx, GLfloat dr_vy,
-	GLfloat ul_tx, GLfloat ul_ty, GLfloat dr_tx, GLfloat dr_ty)
+/*
+ * Sets up indices and vertexes for a 2D quad,
+ * returns its index in the 2D vertex arrays
+ */
+static unsigned int
+R_Buffer2DVertices(GLfloat ul_vx, GLfloat ul_vy, GLfloat dr_vx, GLfloat dr_vy)
 {
 	static const GLushort idx_max = MAX_INDICES - 7;
 	static const GLushort vtx_max = MAX_VERTICES - 5;
@@ -334,6 +364,17 @@ R_Buffer2DQuad(GLfloat ul_vx, GLfloat ul_vy, GLfloat dr_vx, GLfloat dr_vy,
 	gl_buf.vtx[i+6] = ul_vx;
 	gl_buf.vtx[i+7] = dr_vy;
 
+	gl_buf.vtx_ptr += 4;
+
+	return i;
+}
+
+void
+R_Buffer2DQuad(GLfloat ul_vx, GLfloat ul_vy, GLfloat dr_vx, GLfloat dr_vy,
+	GLfloat ul_tx, GLfloat ul_ty, GLfloat dr_tx, GLfloat dr_ty)
+{
+	unsigned int i = R_Buffer2DVertices(ul_vx, ul_vy, dr_vx, dr_vy);
+
 	gl_buf.tex[0][i]   = ul_tx;
 	gl_buf.tex[0][i+1] = ul_ty;
 	gl_buf.tex[0][i+2] = dr_tx;
@@ -342,8 +383,34 @@ R_Buffer2DQuad(GLfloat ul_vx, GLfloat ul_vy, GLfloat dr_vx, GLfloat dr_vy,
 	gl_buf.tex[0][i+5] = dr_ty;
 	gl_buf.tex[0][i+6] = ul_tx;
 	gl_buf.tex[0][i+7] = dr_ty;
+}
 
-	gl_buf.vtx_ptr += 4;
+/*
+ * Adds an untextured 2D quad, for buf_2dfill
+ */
+void
+R_Buffer2DFill(GLfloat ul_vx, GLfloat ul_vy, GLfloat dr_vx, GLfloat dr_vy,
+	const byte color[4])
+{
+	unsigned int i = R_Buffer2DVertices(ul_vx, ul_vy, dr_vx, dr_vy) * 2;
+	int j;
+
+	for (j = 0; j < 16; j++)
+	{
+		gl_buf.clr[i + j] = color[j & 3] / 255.0f;
+	}
+}
+
+/*
+ * Called once per frame, after the last
+ * flush. Only updates the 2D counters.
+ */
+void
+R_EndFrameGLBuffer(void)
+{
+	c_2d_draws = r_2d_draws;
+	c_2d_quads = r_2d_quads;
+	r_2d_draws = r_2d_quads = 0;
 }
 
 /*
@@ -124,31 +124,8 @@ RDraw_StretchPic(int x, int y, int w, int h, char *pic)
 		Scrap_Upload();
 	}
 
-	R_Bind(gl->texnum);
-
-	GLfloat vtx[] = {
-		x, y,
-		x + w, y,
-		x + w, y + h,
-		x, y + h
-	};
-
-	GLfloat tex[] = {
-		gl->sl, gl->tl,
-		gl->sh, gl->tl,
-		gl->sh, gl->th,
-		gl->sl, gl->th
-	};
-
-	glEnableClientState( GL_VERTEX_ARRAY );
-	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-
-	glVertexPointer( 2, GL_FLOAT, 0, vtx );
-	glTexCoordPointer( 2, GL_FLOAT, 0, tex );
-	glDrawArrays( GL_TRIANGLE_FAN, 0, 4 );
-
-	glDisableClientState( GL_VERTEX_ARRAY );
-	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	R_UpdateGLBuffer(buf_2d, gl->texnum, 0, 0, 1);
+	R_Buffer2DQuad(x, y, x + w, y + h, gl->sl, gl->tl, gl->sh, gl->th);
 }
 
 void
@@ -169,39 +146,9 @@ RDraw_PicScaled(int x, int y, char *pic, float factor)
 		Scrap_Upload();
 	}
 
-	if (gl->texnum == TEXNUM_SCRAPS)
-	{
-		R_UpdateGLBuffer(buf_2d, TEXNUM_SCRAPS, 0, 0, 1);
-		R_Buffer2DQuad(x, y, x + gl->width * factor, y + gl->height * factor,
-			gl->sl, gl->tl, gl->sh, gl->th);
-		return;
-	}
-
-	R_Bind(gl->texnum);
-
-	GLfloat vtx[] = {
-		x, y,
-		x + gl->width * factor, y,
-		x + gl->width * factor, y + gl->height * factor,
-		x, y + gl->height * factor
-	};
-
-	GLfloat tex[] = {
-		gl->sl, gl->tl,
-		gl->sh, gl->tl,
-		gl->sh, gl->th,
-		gl->sl, gl->th
-	};
-
-	glEnableClientState( GL_VERTEX_ARRAY );
-	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-
-	glVertexPointer( 2, GL_FLOAT, 0, vtx );
-	glTexCoordPointer( 2, GL_FLOAT, 0, tex );
-	glDrawArrays( GL_TRIANGLE_FAN, 0, 4 );
-
-	glDisableClientState( GL_VERTEX_ARRAY );
-	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	R_UpdateGLBuffer(buf_2d, gl->texnum, 0, 0, 1);
+	R_Buffer2DQuad(x, y, x + gl->width * factor, y + gl->height * factor,
+		gl->sl, gl->tl, gl->sh, gl->th);
 }
 
 /*
@@ -245,28 +192,11 @@ RDraw_Fill(int x, int y, int w, int h, int c)
 		ri.Sys_Error(ERR_FATAL, "Draw_Fill: bad color");
 	}
 
-	glDisable(GL_TEXTURE_2D);
-
 	color.c = d_8to24table[c];
-	glColor4f(color.v [ 0 ] / 255.0, color.v [ 1 ] / 255.0,
-			   color.v [ 2 ] / 255.0, 1);
+	color.v[3] = 255;
 
-	GLfloat vtx[] = {
-		x, y,
-		x + w, y,
-		x + w, y + h,
-		x, y + h
-	};
-
-	glEnableClientState( GL_VERTEX_ARRAY );
-
-	glVertexPointer( 2, GL_FLOAT, 0, vtx );
-	glDrawArrays( GL_TRIANGLE_FAN, 0, 4 );
-
-	glDisableClientState( GL_VERTEX_ARRAY );
-
-	glColor4f( 1, 1, 1, 1 );
-	glEnable(GL_TEXTURE_2D);
+	R_UpdateGLBuffer(buf_2dfill, 0, 0, 0, 1);
+	R_Buffer2DFill(x, y, x + w, y + h, color.v);
 }
 
 void
@@ -305,6 +235,7 @@ RDraw_StretchRaw(int x, int y, int w, int h, int cols, int rows, const byte *dat
 	int i, j, trows;
 	int row;
 
+	R_ApplyGLBuffer();	// draw what's below first
 	R_Bind(0);
 
 	if(gl_config.npottextures || rows <= 256 || bits == 32)
@@ -27,7 +27,6 @@
 #include "header/local.h"
 
 int r_dlightframecount;
-vec3_t pointcolor;
 cplane_t *lightplane; /* used as shadow plane */
 vec3_t lightspot;
 static float s_blocklights[34 * 34 * 3];
@@ -165,7 +164,7 @@ R_PushDlights(void)
 }
 
 int
-R_RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
+R_RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end, lightsample_t *sample)
 {
 	float front, back, frac;
 	int side;
@@ -192,7 +191,7 @@ R_RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
 
 	if ((back < 0) == side)
 	{
-		return R_RecursiveLightPoint(node->children[side], start, end);
+		return R_RecursiveLightPoint(node->children[side], start, end, sample);
 	}
 
 	frac = front / (front - back);
@@ -201,7 +200,7 @@ R_RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
 	mid[2] = start[2] + (end[2] - start[2]) * frac;
 
 	/* go down front side */
-	r = R_RecursiveLightPoint(node->children[side], start, mid);
+	r = R_RecursiveLightPoint(node->children[side], start, mid, sample);
 
 	if (r >= 0)
 	{
@@ -254,26 +253,13 @@ R_RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
 		dt >>= 4;
 
 		lightmap = surf->samples;
-		VectorCopy(vec3_origin, pointcolor);
-
 		lightmap += 3 * (dt * ((surf->extents[0] >> 4) + 1) + ds);
 
 		for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255;
 			 maps++)
 		{
-			const float *rgb;
-			int j;
-
-			rgb = r_newrefdef.lightstyles[surf->styles[maps]].rgb;
-
-			/* Apply light level to models */
-			for (j = 0; j < 3; j++)
-			{
-				float	scale;
-
-				scale = rgb[j] * r_modulate->value;
-				pointcolor[j] += lightmap[j] * scale * (1.0 / 255);
-			}
+			sample->styles[maps] = surf->styles[maps];
+			VectorCopy(lightmap, sample->rgb[maps]);
 
 			lightmap += 3 * ((surf->extents[0] >> 4) + 1) *
 						((surf->extents[1] >> 4) + 1);
@@ -283,14 +269,30 @@ R_RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
 	}
 
 	/* go down back side */
-	return R_RecursiveLightPoint(node->children[!side], mid, end);
+	return R_RecursiveLightPoint(node->children[!side], mid, end, sample);
+}
+
+/*
+ * Traces down from p and returns the lightmap
+ * samples of the first surface that's hit.
+ */
+void
+R_SampleLight(const vec3_t p, lightsample_t *sample)
+{
+	vec3_t start, end;
+
+	memset(sample->styles, 255, sizeof(sample->styles));
+
+	VectorCopy(p, start);
+	VectorCopy(p, end);
+	end[2] -= 2048;
+
+	R_RecursiveLightPoint(r_worldmodel->nodes, start, end, sample);
 }
 
 void
 R_LightPoint(entity_t *currententity, vec3_t p, vec3_t color)
 {
-	vec3_t end;
-	float r;
 	int lnum;
 	dlight_t *dl;
 	vec3_t dist;
@@ -302,19 +304,14 @@ R_LightPoint(entity_t *currententity, vec3_t p, vec3_t color)
 		return;
 	}
 
-	end[0] = p[0];
-	end[1] = p[1];
-	end[2] = p[2] - 2048;
-
-	r = R_RecursiveLightPoint(r_worldmodel->nodes, p, end);
-
-	if (r == -1)
+	/* shadows need the lightspot from the trace */
+	if (gl_shadows->value ||
+		!R_LightGridPoint(p, r_newrefdef.lightstyles, r_modulate->value, color))
 	{
-		VectorCopy(vec3_origin, color);
-	}
-	else
-	{
-		VectorCopy(pointcolor, color);
+		lightsample_t sample;
+
+		R_SampleLight(p, &sample);
+		R_LightSampleColor(&sample, r_newrefdef.lightstyles, r_modulate->value, color);
 	}
 
 	/* add dynamic lights */
@@ -336,62 +333,150 @@ R_LightPoint(entity_t *currententity, vec3_t p, vec3_t color)
 	VectorScale(color, r_modulate->value, color);
 }
 
+/*
+ * Finds where dl hits the plane of surf, returns false if it's too
+ * weak to light surf at all. rect gets the texels it can reach, as
+ * s and t mins and maxs (exclusive).
+ */
+static qboolean
+R_DynamicLightImpact(const msurface_t *surf, const dlight_t *dl, float *frad,
+	float *fminlight, vec3_t local, int *rect)
+{
+	float fdist, reach;
+	vec3_t impact;
+	mtexinfo_t *tex;
+	int smax, tmax;
+	int i;
+
+	smax = (surf->extents[0] >> 4) + 1;
+	tmax = (surf->extents[1] >> 4) + 1;
+	tex = surf->texinfo;
+
+	*frad = dl->intensity;
+	fdist = DotProduct(dl->origin, surf->plane->normal) -
+			surf->plane->dist;
+	*frad -= fabs(fdist);
+
+	/* rad is now the highest intensity on the plane */
+	*fminlight = DLIGHT_CUTOFF;
+
+	if (*frad < *fminlight)
+	{
+		return false;
+	}
+
+	*fminlight = *frad - *fminlight;
+
+	for (i = 0; i < 3; i++)
+	{
+		impact[i] = dl->origin[i] -
+					surf->plane->normal[i] * fdist;
+	}
+
+	local[0] = DotProduct(impact,
+			   tex->vecs[0]) + tex->vecs[0][3] - surf->texturemins[0];
+	local[1] = DotProduct(impact,
+			   tex->vecs[1]) + tex->vecs[1][3] - surf->texturemins[1];
+
+	/* texels further away than fminlight on one axis
+	   aren't lit, plus one for the rounding */
+	reach = *fminlight + 1;
+
+	rect[0] = Q_max(0, (int)floor((local[0] - reach) / 16));
+	rect[1] = Q_max(0, (int)floor((local[1] - reach) / 16));
+	rect[2] = Q_min(smax, (int)floor((local[0] + reach) / 16) + 1);
+	rect[3] = Q_min(tmax, (int)floor((local[1] + reach) / 16) + 1);
+
+	return (rect[0] < rect[2]) && (rect[1] < rect[3]);
+}
+
+/*
+ * Returns the texels of surf lit by dlights
+ * in this frame, an empty rect if there are none.
+ */
 void
-R_AddDynamicLights(msurface_t *surf)
+R_DynamicLightRect(msurface_t *surf, int *rect)
+{
+	float frad, fminlight;
+	vec3_t local;
+	int lnum;
+
+	rect[0] = rect[1] = rect[2] = rect[3] = 0;
+
+	if (surf->dlightframe != r_framecount)
+	{
+		return;
+	}
+
+	for (lnum = 0; lnum < r_newrefdef.num_dlights; lnum++)
+	{
+		int lrect[4];
+
+		if (!(surf->dlightbits & (1 << lnum)))
+		{
+			continue; /* not lit by this light */
+		}
+
+		if (!R_DynamicLightImpact(surf, &r_newrefdef.dlights[lnum], &frad,
+				&fminlight, local, lrect))
+		{
+			continue;
+		}
+
+		if (rect[0] >= rect[2])
+		{
+			memcpy(rect, lrect, sizeof(lrect));
+			continue;
+		}
+
+		rect[0] = Q_min(rect[0], lrect[0]);
+		rect[1] = Q_min(rect[1], lrect[1]);
+		rect[2] = Q_max(rect[2], lrect[2]);
+		rect[3] = Q_max(rect[3], lrect[3]);
+	}
+}
+
+/*
+ * Adds the dlights to the texels of surf
+ * in rect, which are in s_blocklights.
+ */
+static void
+R_AddDynamicLights(msurface_t *surf, const int *rect)
 {
 	int lnum;
 	int sd, td;
 	float fdist, frad, fminlight;
-	vec3_t impact, local;
+	vec3_t local;
 	int s, t;
-	int i;
-	int smax, tmax;
-	mtexinfo_t *tex;
+	int smax;
 	dlight_t *dl;
 	float *pfBL;
 	float fsacc, ftacc;
 
 	smax = (surf->extents[0] >> 4) + 1;
-	tmax = (surf->extents[1] >> 4) + 1;
-	tex = surf->texinfo;
 
 	for (lnum = 0; lnum < r_newrefdef.num_dlights; lnum++)
 	{
+		int lrect[4];
+
 		if (!(surf->dlightbits & (1 << lnum)))
 		{
 			continue; /* not lit by this light */
 		}
 
 		dl = &r_newrefdef.dlights[lnum];
-		frad = dl->intensity;
-		fdist = DotProduct(dl->origin, surf->plane->normal) -
-				surf->plane->dist;
-		frad -= fabs(fdist);
-
-		/* rad is now the highest intensity on the plane */
-		fminlight = DLIGHT_CUTOFF;
 
-		if (frad < fminlight)
+		if (!R_DynamicLightImpact(surf, dl, &frad, &fminlight, local, lrect))
 		{
 			continue;
 		}
 
-		fminlight = frad - fminlight;
+		lrect[0] = Q_max(lrect[0], rect[0]);
+		lrect[1] = Q_max(lrect[1], rect[1]);
+		lrect[2] = Q_min(lrect[2], rect[2]);
+		lrect[3] = Q_min(lrect[3], rect[3]);
 
-		for (i = 0; i < 3; i++)
-		{
-			impact[i] = dl->origin[i] -
-						surf->plane->normal[i] * fdist;
-		}
-
-		local[0] = DotProduct(impact,
-				   tex->vecs[0]) + tex->vecs[0][3] - surf->texturemins[0];
-		local[1] = DotProduct(impact,
-				   tex->vecs[1]) + tex->vecs[1][3] - surf->texturemins[1];
-
-		pfBL = s_blocklights;
-
-		for (t = 0, ftacc = 0; t < tmax; t++, ftacc += 16)
+		for (t = lrect[1], ftacc = t * 16; t < lrect[3]; t++, ftacc += 16)
 		{
 			td = local[1] - ftacc;
 
@@ -400,7 +485,9 @@ R_AddDynamicLights(msurface_t *surf)
 				td = -td;
 			}
 
-			for (s = 0, fsacc = 0; s < smax; s++, fsacc += 16, pfBL += 3)
+			pfBL = s_blocklights + (t * smax + lrect[0]) * 3;
+
+			for (s = lrect[0], fsacc = s * 16; s < lrect[2]; s++, fsacc += 16, pfBL += 3)
 			{
 				sd = Q_ftol(local[0] - fsacc);
 
@@ -443,17 +530,19 @@ R_SetCacheState(msurface_t *surf)
 }
 
 /*
- * Combine and scale multiple lightmaps into the floating format in blocklights
+ * Combine and scale multiple lightmaps into the floating format in
+ * blocklights, for the texels of surf in rect. dest is where the
+ * whole lightmap of surf goes, only the texels in rect are written.
  */
 void
-R_BuildLightMap(msurface_t *surf, byte *dest, int stride)
+R_BuildLightMapRect(msurface_t *surf, byte *dest, int stride, const int *rect)
 {
 	int smax, tmax;
 	int r, g, b, a, max;
-	int i, j, size;
+	int i, j, n, size;
 	byte *lightmap;
 	float scale[4];
-	int nummaps;
+	int maps;
 	float *bl;
 
 	if (surf->texinfo->flags &
@@ -471,119 +560,90 @@ R_BuildLightMap(msurface_t *surf, byte *dest, int stride)
 		ri.Sys_Error(ERR_DROP, "Bad s_blocklights size");
 	}
 
+	n = (rect[2] - rect[0]) * 3;
+
 	/* set to full bright if no light data */
 	if (!surf->samples)
 	{
-		for (i = 0; i < size * 3; i++)
+		for (i = rect[1]; i < rect[3]; i++)
 		{
-			s_blocklights[i] = 255;
+			bl = s_blocklights + (i * smax + rect[0]) * 3;
+
+			for (j = 0; j < n; j++)
+			{
+				bl[j] = 255;
+			}
 		}
 
 		goto store;
 	}
 
-	/* count the # of maps */
-	for (nummaps = 0; nummaps < MAXLIGHTMAPS && surf->styles[nummaps] != 255;
-		 nummaps++)
-	{
-	}
-
 	lightmap = surf->samples;
 
-	/* add all the lightmaps */
-	if (nummaps == 1)
+	/* add all the lightmaps, the first one sets the blocklights */
+	for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++)
 	{
-		int maps;
+		for (i = 0; i < 3; i++)
+		{
+			scale[i] = r_modulate->value *
+					   r_newrefdef.lightstyles[surf->styles[maps]].rgb[i];
+		}
 
-		for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++)
+		for (i = rect[1]; i < rect[3]; i++)
 		{
-			bl = s_blocklights;
+			const byte *src = lightmap + (i * smax + rect[0]) * 3;
 
-			for (i = 0; i < 3; i++)
-			{
-				scale[i] = r_modulate->value *
-						   r_newrefdef.lightstyles[surf->styles[maps]].rgb[i];
-			}
+			bl = s_blocklights + (i * smax + rect[0]) * 3;
 
-			if ((scale[0] == 1.0F) &&
-				(scale[1] == 1.0F) &&
-				(scale[2] == 1.0F))
+			if (maps == 0)
 			{
-				for (i = 0; i < size; i++, bl += 3)
+				for (j = 0; j < n; j += 3)
 				{
-					bl[0] = lightmap[i * 3 + 0];
-					bl[1] = lightmap[i * 3 + 1];
-					bl[2] = lightmap[i * 3 + 2];
+					bl[j + 0] = src[j + 0] * scale[0];
+					bl[j + 1] = src[j + 1] * scale[1];
+					bl[j + 2] = src[j + 2] * scale[2];
 				}
 			}
 			else
 			{
-				for (i = 0; i < size; i++, bl += 3)
+				for (j = 0; j < n; j += 3)
 				{
-					bl[0] = lightmap[i * 3 + 0] * scale[0];
-					bl[1] = lightmap[i * 3 + 1] * scale[1];
-					bl[2] = lightmap[i * 3 + 2] * scale[2];
+					bl[j + 0] += src[j + 0] * scale[0];
+					bl[j + 1] += src[j + 1] * scale[1];
+					bl[j + 2] += src[j + 2] * scale[2];
 				}
 			}
-
-			lightmap += size * 3; /* skip to next lightmap */
 		}
-	}
-	else
-	{
-		int maps;
 
-		memset(s_blocklights, 0, sizeof(s_blocklights[0]) * size * 3);
+		lightmap += size * 3; /* skip to next lightmap */
+	}
 
-		for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++)
+	if (!maps)
+	{
+		for (i = rect[1]; i < rect[3]; i++)
 		{
-			bl = s_blocklights;
-
-			for (i = 0; i < 3; i++)
-			{
-				scale[i] = r_modulate->value *
-						   r_newrefdef.lightstyles[surf->styles[maps]].rgb[i];
-			}
-
-			if ((scale[0] == 1.0F) &&
-				(scale[1] == 1.0F) &&
-				(scale[2] == 1.0F))
-			{
-				for (i = 0; i < size; i++, bl += 3)
-				{
-					bl[0] += lightmap[i * 3 + 0];
-					bl[1] += lightmap[i * 3 + 1];
-					bl[2] += lightmap[i * 3 + 2];
-				}
-			}
-			else
-			{
-				for (i = 0; i < size; i++, bl += 3)
-				{
-					bl[0] += lightmap[i * 3 + 0] * scale[0];
-					bl[1] += lightmap[i * 3 + 1] * scale[1];
-					bl[2] += lightmap[i * 3 + 2] * scale[2];
-				}
-			}
-
-			lightmap += size * 3; /* skip to next lightmap */
+			memset(s_blocklights + (i * smax + rect[0]) * 3, 0,
+				n * sizeof(s_blocklights[0]));
 		}
 	}
 
 	/* add all the dynamic lights */
 	if (surf->dlightframe == r_framecount)
 	{
-		R_AddDynamicLights(surf);
+		R_AddDynamicLights(surf, rect);
 	}
 
 store:
 
-	stride -= (smax << 2);
-	bl = s_blocklights;
+	dest += rect[1] * stride + rect[0] * LIGHTMAP_BYTES;
 
-	for (i = 0; i < tmax; i++, dest += stride)
+	for (i = rect[1]; i < rect[3]; i++, dest += stride)
 	{
-		for (j = 0; j < smax; j++)
+		byte *out = dest;
+
+		bl = s_blocklights + (i * smax + rect[0]) * 3;
+
+		for (j = rect[0]; j < rect[2]; j++)
 		{
 			r = Q_ftol(bl[0]);
 			g = Q_ftol(bl[1]);
@@ -638,14 +698,25 @@ store:
 				a = a * t;
 			}
 
-			dest[0] = r;
-			dest[1] = g;
-			dest[2] = b;
-			dest[3] = a;
+			out[0] = r;
+			out[1] = g;
+			out[2] = b;
+			out[3] = a;
 
 			bl += 3;
-			dest += 4;
+			out += 4;
 		}
 	}
 }
 
+void
+R_BuildLightMap(msurface_t *surf, byte *dest, int stride)
+{
+	int rect[4];
+
+	rect[0] = rect[1] = 0;
+	rect[2] = (surf->extents[0] >> 4) + 1;
+	rect[3] = (surf->extents[1] >> 4) + 1;
+
+	R_BuildLightMapRect(surf, dest, stride, rect);
+}
@@ -26,8 +26,21 @@
 
 #include "header/local.h"
 
+#define MAX_LIGHTMAP_UPLOADS 256
+
+typedef struct
+{
+	int texture;
+	int x, y, w, h;
+} lmupload_t;
+
 extern gllightmapstate_t gl_lms;
 
+/* parts of the lightmap textures changed by dynamic lights */
+static lmupload_t lm_uploads[MAX_LIGHTMAP_UPLOADS];
+static int lm_numuploads;
+static GLuint lm_pbo;
+
 void R_SetCacheState(msurface_t *surf);
 void R_BuildLightMap(msurface_t *surf, byte *dest, int stride);
 
@@ -48,6 +61,14 @@ LM_FreeLightmapBuffers(void)
 		free(gl_lms.allocated);
 		gl_lms.allocated = NULL;
 	}
+
+	if (lm_pbo)
+	{
+		qglDeleteBuffers(1, &lm_pbo);
+		lm_pbo = 0;
+	}
+
+	lm_numuploads = 0;
 }
 
 static void
@@ -125,6 +146,169 @@ LM_UploadBlock(qboolean dynamic)
 	}
 }
 
+/*
+ * Packs the queued parts of the lightmap buffers into
+ * the PBO and uploads them from there. Returns false
+ * if the PBO couldn't be used.
+ */
+static qboolean
+LM_FlushUploadsPBO(void)
+{
+	const int stride = gl_state.block_width * LIGHTMAP_BYTES;
+	ptrdiff_t size, offset;
+	byte *data;
+	int i, y;
+
+	size = 0;
+
+	for (i = 0; i < lm_numuploads; i++)
+	{
+		size += lm_uploads[i].w * lm_uploads[i].h * LIGHTMAP_BYTES;
+	}
+
+	if (!lm_pbo)
+	{
+		qglGenBuffers(1, &lm_pbo);
+	}
+
+	qglBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, lm_pbo);
+
+	/* orphan the old storage, the GPU may still read it */
+	qglBufferData(GL_PIXEL_UNPACK_BUFFER_ARB, size, NULL, GL_STREAM_DRAW_ARB);
+	data = qglMapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+
+	if (!data)
+	{
+		qglBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+		return false;
+	}
+
+	offset = 0;
+
+	for (i = 0; i < lm_numuploads; i++)
+	{
+		const lmupload_t *up = &lm_uploads[i];
+		const int rowsize = up->w * LIGHTMAP_BYTES;
+		const byte *src;
+
+		src = gl_lms.lightmap_buffer[up->texture] +
+			up->y * stride + up->x * LIGHTMAP_BYTES;
+
+		for (y = 0; y < up->h; y++, src += stride, offset += rowsize)
+		{
+			memcpy(data + offset, src, rowsize);
+		}
+	}
+
+	/* the contents are lost if this fails */
+	if (!qglUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB))
+	{
+		qglBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+		return false;
+	}
+
+	offset = 0;
+
+	for (i = 0; i < lm_numuploads; i++)
+	{
+		const lmupload_t *up = &lm_uploads[i];
+
+		R_Bind(gl_state.lightmap_textures + up->texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, up->x, up->y, up->w, up->h,
+				GL_LIGHTMAP_FORMAT, GL_UNSIGNED_BYTE, (const GLvoid *)offset);
+
+		offset += up->w * up->h * LIGHTMAP_BYTES;
+	}
+
+	qglBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+
+	c_lightmap_bytes += size;
+
+	return true;
+}
+
+/*
+ * Uploads the queued parts of the lightmap textures. Without
+ * a PBO, the bounding box of each texture's parts is uploaded
+ * straight from its buffer.
+ */
+void
+LM_FlushUploads(void)
+{
+	int i;
+
+	if (!lm_numuploads)
+	{
+		return;
+	}
+
+	if (gl_config.pbo && LM_FlushUploadsPBO())
+	{
+		lm_numuploads = 0;
+		return;
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, gl_state.block_width);
+
+	for (i = 0; i < lm_numuploads; )
+	{
+		const int texture = lm_uploads[i].texture;
+		int left, right, top, bottom;
+		byte *base;
+
+		left = gl_state.block_width;
+		top = gl_state.block_height;
+		right = bottom = 0;
+
+		/* the queue is ordered by texture */
+		for ( ; i < lm_numuploads && lm_uploads[i].texture == texture; i++)
+		{
+			const lmupload_t *up = &lm_uploads[i];
+
+			left = Q_min(left, up->x);
+			top = Q_min(top, up->y);
+			right = Q_max(right, up->x + up->w);
+			bottom = Q_max(bottom, up->y + up->h);
+		}
+
+		base = gl_lms.lightmap_buffer[texture];
+		base += (top * gl_state.block_width + left) * LIGHTMAP_BYTES;
+
+		R_Bind(gl_state.lightmap_textures + texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, left, top, right - left, bottom - top,
+				GL_LIGHTMAP_FORMAT, GL_UNSIGNED_BYTE, base);
+
+		c_lightmap_bytes += (right - left) * (bottom - top) * LIGHTMAP_BYTES;
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	lm_numuploads = 0;
+}
+
+/*
+ * Queues a part of a lightmap texture for uploading
+ * from its buffer with LM_FlushUploads().
+ */
+void
+LM_QueueUpload(int texture, int x, int y, int w, int h)
+{
+	lmupload_t *up;
+
+	if (lm_numuploads == MAX_LIGHTMAP_UPLOADS)
+	{
+		LM_FlushUploads();
+	}
+
+	up = &lm_uploads[lm_numuploads++];
+
+	up->texture = texture;
+	up->x = x;
+	up->y = y;
+	up->w = w;
+	up->h = h;
+}
+
 /*
  * returns a texture number and the position inside it
  */
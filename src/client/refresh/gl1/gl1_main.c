@@ -91,6 +91,8 @@ cvar_t *gl1_particle_square;
 cvar_t *gl1_palettedtexture;
 cvar_t *gl1_pointparameters;
 cvar_t *gl1_multitexture;
+cvar_t *gl1_pbo;
+cvar_t *gl1_staticworld;
 
 cvar_t *gl_drawbuffer;
 cvar_t *gl_lightmap;
@@ -1048,8 +1050,13 @@ R_RenderView(refdef_t *fd)
 	{
 		c_brush_polys = 0;
 		c_alias_polys = 0;
+		c_lightmap_texels = 0;
+		c_lightmap_bytes = 0;
+		c_lightmapped_draws = 0;
 	}
 
+	ri.Vid_MarkPhase(PHASE_WORLD);
+
 	R_PushDlights();
 
 	if (gl_finish->value)
@@ -1068,10 +1075,14 @@ R_RenderView(refdef_t *fd)
 
 	R_DrawWorld();
 
+	ri.Vid_MarkPhase(PHASE_ENTITIES);
+
 	R_DrawEntitiesOnList();
 
 	R_RenderDlights();
 
+	ri.Vid_MarkPhase(PHASE_PARTICLES);
+
 	R_DrawParticles();
 
 	R_DrawAlphaSurfaces();
@@ -1080,9 +1091,11 @@ R_RenderView(refdef_t *fd)
 
 	if (r_speeds->value)
 	{
-		R_Printf(PRINT_ALL, "%4i wpoly %4i epoly %i tex %i lmaps\n",
+		R_Printf(PRINT_ALL, "%4i wpoly %4i epoly %i tex %i lmaps %i lm texels %i lm bytes %i lm draws %i 2D draws %i quads\n",
 				c_brush_polys, c_alias_polys, c_visible_textures,
-				c_visible_lightmaps);
+				c_visible_lightmaps, c_lightmap_texels, c_lightmap_bytes,
+				c_lightmapped_draws,
+				c_2d_draws, c_2d_quads);
 	}
 
 	switch (gl_state.stereo_mode) {
@@ -1221,6 +1234,8 @@ R_Register(void)
 	gl1_palettedtexture = ri.Cvar_Get("r_palettedtextures", "0", CVAR_ARCHIVE);
 	gl1_pointparameters = ri.Cvar_Get("gl1_pointparameters", "1", CVAR_ARCHIVE);
 	gl1_multitexture = ri.Cvar_Get("gl1_multitexture", "1", CVAR_ARCHIVE);
+	gl1_pbo = ri.Cvar_Get("gl1_pbo", "1", CVAR_ARCHIVE);
+	gl1_staticworld = ri.Cvar_Get("gl1_staticworld", "1", CVAR_ARCHIVE);
 
 	gl_drawbuffer = ri.Cvar_Get("gl_drawbuffer", "GL_BACK", 0);
 	r_vsync = ri.Cvar_Get("r_vsync", "1", CVAR_ARCHIVE);
@@ -1256,6 +1271,7 @@ R_Register(void)
 	ri.Cmd_AddCommand("screenshot", R_ScreenShot);
 	ri.Cmd_AddCommand("modellist", Mod_Modellist_f);
 	ri.Cmd_AddCommand("gl_strings", R_Strings);
+	ri.Cmd_AddCommand("r_cullbench", R_CullBench_f);
 }
 
 /*
@@ -1620,6 +1636,41 @@ RI_Init(void)
 
 	// ----
 
+	/* Pixel buffer objects, for uploading the dynamic lightmaps */
+	gl_config.pbo = false;
+
+	R_Printf(PRINT_ALL, " - Pixel buffer objects: ");
+
+	if (strstr(gl_config.extensions_string, "GL_ARB_pixel_buffer_object"))
+	{
+		qglGenBuffers = (void (APIENTRY *)(GLsizei, GLuint *))RI_GetProcAddress ("glGenBuffersARB");
+		qglDeleteBuffers = (void (APIENTRY *)(GLsizei, const GLuint *))RI_GetProcAddress ("glDeleteBuffersARB");
+		qglBindBuffer = (void (APIENTRY *)(GLenum, GLuint))RI_GetProcAddress ("glBindBufferARB");
+		qglBufferData = (void (APIENTRY *)(GLenum, ptrdiff_t, const GLvoid *, GLenum))RI_GetProcAddress ("glBufferDataARB");
+		qglMapBuffer = (GLvoid * (APIENTRY *)(GLenum, GLenum))RI_GetProcAddress ("glMapBufferARB");
+		qglUnmapBuffer = (GLboolean (APIENTRY *)(GLenum))RI_GetProcAddress ("glUnmapBufferARB");
+	}
+
+	if (gl1_pbo->value)
+	{
+		if (gl_config.multitexture && qglGenBuffers && qglDeleteBuffers &&
+			qglBindBuffer && qglBufferData && qglMapBuffer && qglUnmapBuffer)
+		{
+			gl_config.pbo = true;
+			R_Printf(PRINT_ALL, "Okay\n");
+		}
+		else
+		{
+			R_Printf(PRINT_ALL, "Failed\n");
+		}
+	}
+	else
+	{
+		R_Printf(PRINT_ALL, "Disabled\n");
+	}
+
+	// ----
+
 	/* Big lightmaps: this used to be fast, but after the implementation of the "GL Buffer", it
 	 * became too evident that the bigger the texture, the slower the call to glTexSubImage2D() is.
 	 * Original logic remains, but it's preferable not to make it visible to the user.
@@ -1652,9 +1703,12 @@ RI_Shutdown(void)
 	ri.Cmd_RemoveCommand("screenshot");
 	ri.Cmd_RemoveCommand("imagelist");
 	ri.Cmd_RemoveCommand("gl_strings");
+	ri.Cmd_RemoveCommand("r_cullbench");
 
 	LM_FreeLightmapBuffers();
 	Scrap_Free();
+	R_FreeWorldArrays();
+	R_FreeVisCache();
 	Mod_FreeAll();
 
 	R_ShutdownImages();
@@ -1993,6 +2047,7 @@ GetRefAPI(refimport_t imp)
 
 	re.api_version = API_VERSION;
 	re.framework_version = RI_GetSDLVersion();
+	re.max_particles = MAX_PARTICLES;
 
 	re.Init = RI_Init;
 	re.Shutdown = RI_Shutdown;
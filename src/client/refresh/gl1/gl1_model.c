@@ -214,7 +214,7 @@ Mod_ForName (char *name, model_t *parent_model, qboolean crash)
 				mod->extradata = Mod_LoadMD2(mod->name, buf, modfilelen,
 					mod->mins, mod->maxs,
 					(struct image_s **)mod->skins, (findimage_t)R_FindImage,
-					&(mod->type));
+					&(mod->type), false);
 				if (!mod->extradata)
 				{
 					ri.Sys_Error(ERR_DROP, "%s: Failed to load %s",
@@ -666,6 +666,8 @@ Mod_LoadBrushModel(model_t *mod, void *buffer, int modfilelen)
 				__func__, mod->name, i, BSPVERSION);
 	}
 
+	mod->checksum = Com_BlockChecksum(buffer, modfilelen);
+
 	/* swap all the lumps */
 	mod_base = (byte *)header;
 
@@ -737,6 +739,8 @@ Mod_FreeAll(void)
 			Mod_Free(&mod_known[i]);
 		}
 	}
+
+	Mod_FreeLightGrid();
 }
 
 /*
@@ -750,6 +754,7 @@ RI_BeginRegistration(char *model)
 
 	registration_sequence++;
 	r_oldviewcluster = -1; /* force markleafs */
+	R_FreeVisCache();
 
 	Com_sprintf(fullname, sizeof(fullname), "maps/%s.bsp", model);
 
@@ -765,6 +770,12 @@ RI_BeginRegistration(char *model)
 
 	r_worldmodel = Mod_ForName(fullname, NULL, true);
 
+	Mod_LoadLightGrid(r_worldmodel->name, r_worldmodel->checksum,
+		r_worldmodel->nodes, r_worldmodel->submodels[0].mins,
+		r_worldmodel->submodels[0].maxs, R_SampleLight);
+
+	R_BuildWorldArrays();
+
 	r_viewcluster = -1;
 }
 
@@ -48,6 +48,8 @@ RI_EndFrame(void)
 {
 	R_ApplyGLBuffer();	// to draw buffered 2D text
 	SDL_GL_SwapWindow(window);
+
+	R_EndFrameGLBuffer();
 }
 
 /*
@@ -30,17 +30,28 @@
 
 int c_visible_lightmaps;
 int c_visible_textures;
+int c_lightmap_texels, c_lightmap_bytes;
+int c_lightmapped_draws;
 static vec3_t modelorg; /* relative to viewpoint */
 msurface_t *r_alpha_surfaces;
 
 gllightmapstate_t gl_lms;
 
+/* static world vertex array, see R_BuildWorldArrays() */
+static GLfloat *r_worldverts;
+static GLuint *r_worldindices;
+static msurface_t **r_worldsurfs;
+
 void LM_InitBlock(void);
 void LM_UploadBlock(qboolean dynamic);
 qboolean LM_AllocBlock(int w, int h, int *x, int *y);
+void LM_QueueUpload(int texture, int x, int y, int w, int h);
+void LM_FlushUploads(void);
 
 void R_SetCacheState(msurface_t *surf);
 void R_BuildLightMap(msurface_t *surf, byte *dest, int stride);
+void R_BuildLightMapRect(msurface_t *surf, byte *dest, int stride, const int *rect);
+void R_DynamicLightRect(msurface_t *surf, int *rect);
 
 static void
 R_DrawGLPoly(msurface_t *fa)
@@ -519,11 +530,17 @@ R_DrawAlphaSurfaces(void)
 	r_alpha_surfaces = NULL;
 }
 
+/*
+ * Finds the texels of the lightmap of surf that must be rebuilt: all
+ * of them if a lightstyle changed, else the ones lit by dlights now or
+ * when it was built the last time. lit gets the ones lit now. Returns
+ * false if nothing changed.
+ */
 static qboolean
-R_HasDynamicLights(msurface_t *surf, int *mapNum)
+R_LightmapDirtyRect(msurface_t *surf, int *rect, int *lit)
 {
+	const short *old = surf->dlight_rect;
 	int map;
-	qboolean is_dynamic = false;
 
 	if ( r_fullbright->value || !gl1_dynamic->value ||
 		(surf->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP)) )
@@ -531,38 +548,41 @@ R_HasDynamicLights(msurface_t *surf, int *mapNum)
 		return false;
 	}
 
-	// Any dynamic lights on this surface?
+	R_DynamicLightRect(surf, lit);
+
 	for (map = 0; map < MAXLIGHTMAPS && surf->styles[map] != 255; map++)
 	{
 		if (r_newrefdef.lightstyles[surf->styles[map]].white != surf->cached_light[map])
 		{
-			is_dynamic = true;
-			break;
+			rect[0] = rect[1] = 0;
+			rect[2] = (surf->extents[0] >> 4) + 1;
+			rect[3] = (surf->extents[1] >> 4) + 1;
+
+			return true;
 		}
 	}
 
-	// No matter if it is this frame or was in the previous one: has dynamic lights
-	if ( !is_dynamic && (surf->dlightframe == r_framecount || surf->dirty_lightmap) )
+	/* the union of the old and new dlight footprints */
+	if (old[0] >= old[2])
 	{
-		is_dynamic = true;
+		memcpy(rect, lit, sizeof(int) * 4);
 	}
-
-	if (mapNum)
+	else if (lit[0] >= lit[2])
 	{
-		*mapNum = map;
+		rect[0] = old[0];
+		rect[1] = old[1];
+		rect[2] = old[2];
+		rect[3] = old[3];
 	}
-	return is_dynamic;
-}
-
-static void
-R_UpdateSurfCache(msurface_t *surf, int map)
-{
-	if ( ((surf->styles[map] >= 32) || (surf->styles[map] == 0))
-		&& (surf->dlightframe != r_framecount) )
+	else
 	{
-		R_SetCacheState(surf);
+		rect[0] = Q_min(old[0], lit[0]);
+		rect[1] = Q_min(old[1], lit[1]);
+		rect[2] = Q_max(old[2], lit[2]);
+		rect[3] = Q_max(old[3], lit[3]);
 	}
-	surf->dirty_lightmap = (surf->dlightframe == r_framecount);
+
+	return rect[0] < rect[2];
 }
 
 static void
@@ -599,12 +619,194 @@ R_RenderLightmappedPoly(entity_t *currententity, msurface_t *surf)
 	}
 }
 
+/*
+ * Copies the polygons of all lightmapped world surfaces into one
+ * vertex array at map load, so they can be drawn from there with
+ * index lists instead of being copied into gl_buf each frame.
+ */
+void
+R_BuildWorldArrays(void)
+{
+	int i, numverts, numindices;
+	msurface_t *surf;
+	GLfloat *v;
+
+	R_FreeWorldArrays();
+
+	if (!gl_config.multitexture || !r_worldmodel)
+	{
+		return;
+	}
+
+	numverts = numindices = 0;
+
+	for (i = 0, surf = r_worldmodel->surfaces; i < r_worldmodel->numsurfaces; i++, surf++)
+	{
+		surf->firstvertex = -1;
+
+		if ((surf->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP)) ||
+			!surf->polys || (surf->polys->numverts < 3))
+		{
+			continue;
+		}
+
+		surf->firstvertex = numverts;
+		numverts += surf->polys->numverts;
+		numindices += (surf->polys->numverts - 2) * 3;
+	}
+
+	if (!numverts)
+	{
+		return;
+	}
+
+	r_worldverts = malloc(numverts * VERTEXSIZE * sizeof(GLfloat));
+	r_worldindices = malloc(numindices * sizeof(GLuint));
+	r_worldsurfs = malloc(r_worldmodel->numsurfaces * sizeof(msurface_t *));
+
+	if (!r_worldverts || !r_worldindices || !r_worldsurfs)
+	{
+		R_Printf(PRINT_ALL, "%s: Couldn't allocate %d vertices\n", __func__, numverts);
+		R_FreeWorldArrays();
+
+		return;
+	}
+
+	for (i = 0, surf = r_worldmodel->surfaces; i < r_worldmodel->numsurfaces; i++, surf++)
+	{
+		if (surf->firstvertex < 0)
+		{
+			continue;
+		}
+
+		v = r_worldverts + surf->firstvertex * VERTEXSIZE;
+		memcpy(v, surf->polys->verts, surf->polys->numverts * VERTEXSIZE * sizeof(GLfloat));
+	}
+
+	R_Printf(PRINT_DEVELOPER, "%s: %d vertices, %d indices\n", __func__, numverts, numindices);
+}
+
+void
+R_FreeWorldArrays(void)
+{
+	free(r_worldverts);
+	free(r_worldindices);
+	free(r_worldsurfs);
+
+	r_worldverts = NULL;
+	r_worldindices = NULL;
+	r_worldsurfs = NULL;
+}
+
+/*
+ * Flowing surfaces scroll, so they still go through gl_buf.
+ */
+static qboolean
+R_IsStaticSurface(const msurface_t *surf)
+{
+	return (surf->firstvertex >= 0) && !(surf->texinfo->flags & SURF_FLOWING);
+}
+
+static int
+R_LightmapCompare(const void *a, const void *b)
+{
+	const msurface_t *sa = *(msurface_t * const *)a;
+	const msurface_t *sb = *(msurface_t * const *)b;
+
+	return sa->lightmaptexturenum - sb->lightmaptexturenum;
+}
+
+/*
+ * Draws the static surfaces of one texture, sorted by
+ * lightmap, with one glDrawElements() per lightmap.
+ * R_BeginWorldArrays() must have been called before.
+ */
+static void
+R_DrawStaticSurfaces(int texnum, msurface_t **surfs, int numsurfs)
+{
+	int first, i, j;
+	GLuint *idx;
+
+	qsort(surfs, numsurfs, sizeof(msurface_t *), R_LightmapCompare);
+
+	for (first = 0; first < numsurfs; first = i)
+	{
+		const int lightmap = surfs[first]->lightmaptexturenum;
+
+		idx = r_worldindices;
+
+		for (i = first; i < numsurfs && surfs[i]->lightmaptexturenum == lightmap; i++)
+		{
+			const GLuint v = surfs[i]->firstvertex;
+			const int nv = surfs[i]->polys->numverts;
+
+			c_brush_polys++;
+
+			for (j = 2; j < nv; j++)
+			{
+				*idx++ = v;
+				*idx++ = v + j - 1;
+				*idx++ = v + j;
+			}
+		}
+
+		R_MBind(GL_TEXTURE1, gl_state.lightmap_textures + lightmap);
+		R_MBind(GL_TEXTURE0, texnum);
+
+		glDrawElements(GL_TRIANGLES, idx - r_worldindices, GL_UNSIGNED_INT, r_worldindices);
+		c_lightmapped_draws++;
+	}
+}
+
+/*
+ * Same state as buf_mtex in R_ApplyGLBuffer(),
+ * but with the arrays pointing to r_worldverts.
+ */
+static void
+R_BeginWorldArrays(void)
+{
+	const GLsizei stride = VERTEXSIZE * sizeof(GLfloat);
+
+	R_EnableMultitexture(true);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, stride, r_worldverts);
+
+	// TMU 1: Lightmap texture
+	R_SelectTexture(GL_TEXTURE1);
+
+	if (gl1_overbrightbits->value)
+	{
+		R_TexEnv(GL_COMBINE);
+		glTexEnvi(GL_TEXTURE_ENV, GL_RGB_SCALE, gl1_overbrightbits->value);
+	}
+
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, stride, r_worldverts + 5);
+
+	// TMU 0: Color texture
+	R_SelectTexture(GL_TEXTURE0);
+
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, stride, r_worldverts + 3);
+}
+
+static void
+R_EndWorldArrays(void)
+{
+	R_SelectTexture(GL_TEXTURE1);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	R_SelectTexture(GL_TEXTURE0);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 /* Upload dynamic lights to each lightmap texture (multitexture path only) */
 static void
 R_RegenAllLightmaps()
 {
-	int i, map, smax, tmax, top, bottom, left, right, bt, bb, bl, br;
-	qboolean affected_lightmap, pixelstore_set = false;
+	int i, j, rect[4], lit[4];
 	msurface_t *surf;
 	byte *base;
 
@@ -620,77 +822,34 @@ R_RegenAllLightmaps()
 			continue;
 		}
 
-		affected_lightmap = false;
-		bt = gl_state.block_height;
-		bl = gl_state.block_width;
-		bb = br = 0;
-
 		for (surf = gl_lms.lightmap_surfaces[i];
 			 surf != 0;
 			 surf = surf->lightmapchain)
 		{
-			if ( !R_HasDynamicLights(surf, &map) )
+			if ( !R_LightmapDirtyRect(surf, rect, lit) )
 			{
 				continue;
 			}
 
-			affected_lightmap = true;
-			smax = (surf->extents[0] >> 4) + 1;
-			tmax = (surf->extents[1] >> 4) + 1;
-
-			left = surf->light_s;
-			right = surf->light_s + smax;
-			top = surf->light_t;
-			bottom = surf->light_t + tmax;
-
 			base = gl_lms.lightmap_buffer[i];
-			base += (top * gl_state.block_width + left) * LIGHTMAP_BYTES;
+			base += (surf->light_t * gl_state.block_width + surf->light_s) * LIGHTMAP_BYTES;
 
-			R_BuildLightMap(surf, base, gl_state.block_width * LIGHTMAP_BYTES);
-			R_UpdateSurfCache(surf, map);
+			R_BuildLightMapRect(surf, base, gl_state.block_width * LIGHTMAP_BYTES, rect);
+			R_SetCacheState(surf);
 
-			if (left < bl)
+			for (j = 0; j < 4; j++)
 			{
-				bl = left;
+				surf->dlight_rect[j] = lit[j];
 			}
-			if (right > br)
-			{
-				br = right;
-			}
-			if (top < bt)
-			{
-				bt = top;
-			}
-			if (bottom > bb)
-			{
-				bb = bottom;
-			}
-		}
 
-		if (!affected_lightmap)
-		{
-			continue;
-		}
+			c_lightmap_texels += (rect[2] - rect[0]) * (rect[3] - rect[1]);
 
-		if (!pixelstore_set)
-		{
-			glPixelStorei(GL_UNPACK_ROW_LENGTH, gl_state.block_width);
-			pixelstore_set = true;
+			LM_QueueUpload(i, surf->light_s + rect[0], surf->light_t + rect[1],
+				rect[2] - rect[0], rect[3] - rect[1]);
 		}
-
-		base = gl_lms.lightmap_buffer[i];
-		base += (bt * gl_state.block_width + bl) * LIGHTMAP_BYTES;
-
-		// upload changes
-		R_Bind(gl_state.lightmap_textures + i);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, bl, bt, br - bl, bb - bt,
-						GL_LIGHTMAP_FORMAT, GL_UNSIGNED_BYTE, base);
 	}
 
-	if (pixelstore_set)
-	{
-		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-	}
+	LM_FlushUploads();
 }
 
 static void
@@ -732,6 +891,8 @@ R_DrawTextureChains(entity_t *currententity)
 	}
 	else	// multitexture
 	{
+		const qboolean usestatic = r_worldverts && gl1_staticworld->value;
+
 		for (i = 0, image = gltextures; i < numgltextures; i++, image++)
 		{
 			if (!image->registration_sequence || !image->texturechain)
@@ -743,7 +904,7 @@ R_DrawTextureChains(entity_t *currententity)
 
 			for (s = image->texturechain; s; s = s->texturechain)
 			{
-				if (!(s->flags & SURF_DRAWTURB))
+				if (!(s->flags & SURF_DRAWTURB) && !(usestatic && R_IsStaticSurface(s)))
 				{
 					R_UpdateGLBuffer(buf_mtex, image->texnum, s->lightmaptexturenum, 0, 1);
 					R_RenderLightmappedPoly(currententity, s);
@@ -752,6 +913,36 @@ R_DrawTextureChains(entity_t *currententity)
 		}
 		R_ApplyGLBuffer();
 
+		if (usestatic)
+		{
+			R_BeginWorldArrays();
+
+			for (i = 0, image = gltextures; i < numgltextures; i++, image++)
+			{
+				int numstatic = 0;
+
+				if (!image->registration_sequence || !image->texturechain)
+				{
+					continue;
+				}
+
+				for (s = image->texturechain; s; s = s->texturechain)
+				{
+					if (!(s->flags & SURF_DRAWTURB) && R_IsStaticSurface(s))
+					{
+						r_worldsurfs[numstatic++] = s;
+					}
+				}
+
+				if (numstatic)
+				{
+					R_DrawStaticSurfaces(image->texnum, r_worldsurfs, numstatic);
+				}
+			}
+
+			R_EndWorldArrays();
+		}
+
 		R_EnableMultitexture(false);	// force disabling, SURF_DRAWTURB surfaces may not exist
 
 		for (i = 0, image = gltextures; i < numgltextures; i++, image++)
@@ -943,7 +1134,7 @@ R_DrawBrushModel(entity_t *currententity, const model_t *currentmodel)
 }
 
 static void
-R_RecursiveWorldNode(entity_t *currententity, mnode_t *node)
+R_RecursiveWorldNode(entity_t *currententity, mnode_t *node, int clipflags)
 {
 	int c, side, sidebit;
 	cplane_t *plane;
@@ -962,9 +1153,15 @@ R_RecursiveWorldNode(entity_t *currententity, mnode_t *node)
 		return;
 	}
 
-	if (r_cull->value && R_CullBox(node->minmaxs, node->minmaxs + 3, frustum))
+	/* planes the parent is completely in front of aren't tested */
+	if (clipflags)
 	{
-		return;
+		clipflags = R_CullNodeBox(node->minmaxs, clipflags);
+
+		if (clipflags < 0)
+		{
+			return;
+		}
 	}
 
 	/* if a leaf node, draw stuff */
@@ -1024,7 +1221,7 @@ R_RecursiveWorldNode(entity_t *currententity, mnode_t *node)
 	}
 
 	/* recurse down the children, front side first */
-	R_RecursiveWorldNode(currententity, node->children[side]);
+	R_RecursiveWorldNode(currententity, node->children[side], clipflags);
 
 	/* draw stuff */
 	for (c = node->numsurfaces,
@@ -1069,7 +1266,7 @@ R_RecursiveWorldNode(entity_t *currententity, mnode_t *node)
 	}
 
 	/* recurse down the back side */
-	R_RecursiveWorldNode(currententity, node->children[!side]);
+	R_RecursiveWorldNode(currententity, node->children[!side], clipflags);
 }
 
 /*
@@ -1190,7 +1387,8 @@ R_DrawWorld(void)
 	memset(gl_lms.lightmap_surfaces, 0, sizeof(gl_lms.lightmap_surfaces));
 
 	R_ClearSkyBox();
-	R_RecursiveWorldNode(&ent, r_worldmodel->nodes);
+	R_RecursiveWorldNode(&ent, r_worldmodel->nodes,
+		r_cull->value ? FRUSTUM_ALLPLANES : 0);
 	R_GetBrushesLighting();
 	R_RegenAllLightmaps();
 	R_DrawTextureChains(&ent);
@@ -1208,10 +1406,7 @@ R_MarkLeaves(void)
 {
 	const byte *vis;
 	YQ2_ALIGNAS_TYPE(int) byte fatvis[MAX_MAP_LEAFS / 8];
-	mnode_t *node;
 	int i, c;
-	mleaf_t *leaf;
-	int cluster;
 
 	if ((r_oldviewcluster == r_viewcluster) &&
 		(r_oldviewcluster2 == r_viewcluster2) &&
@@ -1248,6 +1443,12 @@ R_MarkLeaves(void)
 		return;
 	}
 
+	if (R_MarkCachedLeaves(r_worldmodel->leafs, r_viewcluster, r_viewcluster2,
+		r_visframecount))
+	{
+		return;
+	}
+
 	vis = Mod_ClusterPVS(r_viewcluster, r_worldmodel);
 
 	/* may have to combine two clusters because of solid water boundaries */
@@ -1265,32 +1466,28 @@ R_MarkLeaves(void)
 		vis = fatvis;
 	}
 
-	for (i = 0, leaf = r_worldmodel->leafs;
-		 i < r_worldmodel->numleafs;
-		 i++, leaf++)
-	{
-		cluster = leaf->cluster;
+	R_MarkVisibleLeaves(r_worldmodel->leafs, r_worldmodel->numleafs,
+		r_worldmodel->numnodes, vis, r_viewcluster, r_viewcluster2,
+		r_visframecount);
+}
 
-		if (cluster == -1)
-		{
-			continue;
-		}
+static const byte *
+R_WorldClusterPVS(int cluster)
+{
+	return Mod_ClusterPVS(cluster, r_worldmodel);
+}
 
-		if (vis[cluster >> 3] & (1 << (cluster & 7)))
-		{
-			node = (mnode_t *)leaf;
+void
+R_CullBench_f(void)
+{
+	if (!r_worldmodel)
+	{
+		R_Printf(PRINT_ALL, "r_cullbench needs a map.\n");
+		return;
+	}
 
-			do
-			{
-				if (node->visframe == r_visframecount)
-				{
-					break;
-				}
+	R_CullBench(r_worldmodel->nodes, r_worldmodel->leafs, r_worldmodel->numleafs,
+		r_worldmodel->numnodes, R_WorldClusterPVS);
 
-				node->visframe = r_visframecount;
-				node = node->parent;
-			}
-			while (node);
-		}
-	}
+	r_oldviewcluster = -1; /* force markleafs */
 }
@@ -110,6 +110,7 @@ typedef enum
 typedef enum
 {
 	buf_2d,
+	buf_2dfill,
 	buf_singletex,
 	buf_mtex,
 	buf_alpha,
@@ -133,6 +134,7 @@ extern int r_visframecount;
 extern int r_framecount;
 extern cplane_t frustum[4];
 extern int c_brush_polys, c_alias_polys;
+extern int c_2d_draws, c_2d_quads; /* of the last frame */
 extern int gl_filter_min, gl_filter_max;
 
 /* view origin */
@@ -165,6 +167,8 @@ extern cvar_t *gl1_overbrightbits;
 extern cvar_t *gl1_palettedtexture;
 extern cvar_t *gl1_pointparameters;
 extern cvar_t *gl1_multitexture;
+extern cvar_t *gl1_pbo;
+extern cvar_t *gl1_staticworld;
 
 extern cvar_t *gl1_particle_min_size;
 extern cvar_t *gl1_particle_max_size;
@@ -225,6 +229,8 @@ extern int gl_tex_solid_format;
 extern int gl_tex_alpha_format;
 
 extern int c_visible_lightmaps;
+extern int c_lightmap_texels, c_lightmap_bytes;
+extern int c_lightmapped_draws;
 extern int c_visible_textures;
 
 extern float r_world_matrix[16];
@@ -238,6 +244,7 @@ void R_MBind(GLenum target, int texnum);
 void R_EnableMultitexture(qboolean enable);
 
 void R_LightPoint(entity_t *currententity, vec3_t p, vec3_t color);
+void R_SampleLight(const vec3_t p, lightsample_t *sample);
 void R_PushDlights(void);
 
 extern model_t *r_worldmodel;
@@ -252,6 +259,8 @@ void R_DrawBrushModel(entity_t *currententity, const model_t *currentmodel);
 void R_DrawSpriteModel(entity_t *currententity, const model_t *currentmodel);
 void R_DrawBeam(entity_t *e);
 void R_DrawWorld(void);
+void R_BuildWorldArrays(void);
+void R_FreeWorldArrays(void);
 void R_RenderDlights(void);
 void R_DrawAlphaSurfaces(void);
 void R_InitParticleTexture(void);
@@ -259,6 +268,7 @@ void Draw_InitLocal(void);
 void R_SubdivideSurface(model_t *loadmodel, msurface_t *fa);
 void R_RotateForEntity(entity_t *e);
 void R_MarkLeaves(void);
+void R_CullBench_f(void);
 
 extern int r_dlightframecount;
 glpoly_t *WaterWarpPolyVerts(glpoly_t *p);
@@ -295,6 +305,9 @@ void R_ApplyGLBuffer(void);
 void R_UpdateGLBuffer(buffered_draw_t type, int colortex, int lighttex, int flags, float alpha);
 void R_Buffer2DQuad(GLfloat ul_vx, GLfloat ul_vy, GLfloat dr_vx, GLfloat dr_vy,
 	GLfloat ul_tx, GLfloat ul_ty, GLfloat dr_tx, GLfloat dr_ty);
+void R_Buffer2DFill(GLfloat ul_vx, GLfloat ul_vy, GLfloat dr_vx, GLfloat dr_vy,
+	const byte color[4]);
+void R_EndFrameGLBuffer(void);
 void R_SetBufferIndices(GLenum type, GLuint vertices_num);
 void R_BufferVertex(GLfloat x, GLfloat y, GLfloat z);
 void R_BufferSingleTex(GLfloat s, GLfloat t);
@@ -377,6 +390,7 @@ typedef struct
 	qboolean palettedtexture;
 	qboolean pointparameters;
 	qboolean multitexture;
+	qboolean pbo;
 
 	// ----
 
@@ -66,9 +66,10 @@ typedef struct msurface_s
 	/* lighting info */
 	int dlightframe;
 	int dlightbits;
-	qboolean dirty_lightmap;	// lightmap has dynamic lights from previous frame (mtex only)
+	short dlight_rect[4];	// texels lit by dlights when the lightmap was built, s/t mins and maxs (mtex only)
 
 	int lightmaptexturenum;
+	int firstvertex;	// in the static world vertex array, -1 if not in there
 	byte styles[MAXLIGHTMAPS];
 	float cached_light[MAXLIGHTMAPS];       /* values currently used in lightmap */
 	byte *samples;                          /* [numstyles*surfsize] */
@@ -133,6 +134,7 @@ typedef struct model_s
 	dvis_t *vis;
 
 	byte *lightdata;
+	unsigned checksum; /* of the BSP, for the light grid */
 
 	/* for alias models and skins */
 	image_t *skins[MAX_MD2SKINS];
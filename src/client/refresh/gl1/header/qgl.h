@@ -29,6 +29,8 @@
 #ifndef REF_QGL_H
 #define REF_QGL_H
 
+#include <stddef.h>
+
 #ifdef _WIN32
 #include <windows.h>
 #endif
@@ -73,6 +75,15 @@
 #define GL_MULTISAMPLE_FILTER_HINT_NV     0x8534
 #endif
 
+#ifndef GL_ARB_pixel_buffer_object
+#define GL_PIXEL_UNPACK_BUFFER_ARB        0x88EC
+#endif
+
+#ifndef GL_ARB_vertex_buffer_object
+#define GL_STREAM_DRAW_ARB                0x88E0
+#define GL_WRITE_ONLY_ARB                 0x88B9
+#endif
+
 // =======================================================================
 
 /*
@@ -93,5 +104,12 @@ extern void ( APIENTRY *qglColorTableEXT ) ( GLenum, GLenum, GLsizei, GLenum,
 		GLenum, const GLvoid * );
 extern void ( APIENTRY *qglActiveTexture ) ( GLenum texture );
 extern void ( APIENTRY *qglClientActiveTexture ) ( GLenum texture );
+extern void ( APIENTRY *qglGenBuffers ) ( GLsizei n, GLuint *buffers );
+extern void ( APIENTRY *qglDeleteBuffers ) ( GLsizei n, const GLuint *buffers );
+extern void ( APIENTRY *qglBindBuffer ) ( GLenum target, GLuint buffer );
+extern void ( APIENTRY *qglBufferData ) ( GLenum target, ptrdiff_t size,
+		const GLvoid *data, GLenum usage );
+extern GLvoid * ( APIENTRY *qglMapBuffer ) ( GLenum target, GLenum access );
+extern GLboolean ( APIENTRY *qglUnmapBuffer ) ( GLenum target );
 
 #endif
@@ -44,6 +44,13 @@ void (APIENTRY *qglColorTableEXT)(GLenum, GLenum, GLsizei, GLenum, GLenum,
 		const GLvoid *);
 void (APIENTRY *qglActiveTexture) (GLenum texture);
 void (APIENTRY *qglClientActiveTexture) (GLenum texture);
+void (APIENTRY *qglGenBuffers) (GLsizei n, GLuint *buffers);
+void (APIENTRY *qglDeleteBuffers) (GLsizei n, const GLuint *buffers);
+void (APIENTRY *qglBindBuffer) (GLenum target, GLuint buffer);
+void (APIENTRY *qglBufferData) (GLenum target, ptrdiff_t size,
+		const GLvoid *data, GLenum usage);
+GLvoid * (APIENTRY *qglMapBuffer) (GLenum target, GLenum access);
+GLboolean (APIENTRY *qglUnmapBuffer) (GLenum target);
 
 /* ========================================================================= */
 
@@ -54,6 +61,12 @@ void QGL_EXT_Reset ( void )
 	qglColorTableEXT       = NULL;
 	qglActiveTexture       = NULL;
 	qglClientActiveTexture = NULL;
+	qglGenBuffers          = NULL;
+	qglDeleteBuffers       = NULL;
+	qglBindBuffer          = NULL;
+	qglBufferData          = NULL;
+	qglMapBuffer           = NULL;
+	qglUnmapBuffer         = NULL;
 }
 
 /* ========================================================================= */
@@ -25,13 +25,36 @@
  * =======================================================================
  */
 
+#include <stddef.h> // offsetof()
+
 #include "header/local.h"
 
 unsigned d_8to24table[256];
 
 gl3image_t *draw_chars;
 
-static GLuint vbo2D = 0, vao2D = 0, vao2Dcolor = 0; // vao2D is for textured rendering, vao2Dcolor for color-only
+static GLuint vao2D = 0, vao2Dcolor = 0; // vao2D is for textured rendering, vao2Dcolor for color-only
+
+typedef struct
+{
+	GLfloat pos[2];
+	GLfloat texCoord[2];
+} draw2D_vtx_t;
+
+typedef struct
+{
+	GLfloat pos[2];
+	byte color[4];
+} draw2Dcolor_vtx_t;
+
+// 2D quads are collected here and drawn with one draw call
+// when the texture changes or something else must be drawn
+#define MAX_BATCH_QUADS 1024
+
+static GLuint batchTexnum; // 0 for color-only quads
+static int batchNumQuads;
+static draw2D_vtx_t batchVerts[MAX_BATCH_QUADS*6];
+static draw2Dcolor_vtx_t batchColorVerts[MAX_BATCH_QUADS*6];
 
 void
 GL3_Draw_InitLocal(void)
@@ -48,46 +71,169 @@ GL3_Draw_InitLocal(void)
 	glGenVertexArrays(1, &vao2D);
 	glBindVertexArray(vao2D);
 
-	glGenBuffers(1, &vbo2D);
-	GL3_BindVBO(vbo2D);
+	// the vertices are streamed, see GL3_Draw_Flush()
+	GL3_BindVBO(gl3state.vtxStream.buffer);
 
 	GL3_UseProgram(gl3state.si2D.shaderProgram);
 
 	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
 	// Note: the glVertexAttribPointer() configuration is stored in the VAO, not the shader or sth
 	//       (that's why I use one VAO per 2D shader)
-	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), 0);
+	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(draw2D_vtx_t), 0);
 
 	glEnableVertexAttribArray(GL3_ATTRIB_TEXCOORD);
-	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 4*sizeof(float), 2*sizeof(float));
+	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(draw2D_vtx_t), offsetof(draw2D_vtx_t, texCoord));
 
 	// set up attribute layout for 2D flat color rendering
 
 	glGenVertexArrays(1, &vao2Dcolor);
 	glBindVertexArray(vao2Dcolor);
 
-	GL3_BindVBO(vbo2D); // yes, both VAOs share the same VBO
+	GL3_BindVBO(gl3state.vtxStream.buffer); // yes, both VAOs share the same VBO
 
 	GL3_UseProgram(gl3state.si2Dcolor.shaderProgram);
 
 	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
-	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), 0);
+	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(draw2Dcolor_vtx_t), 0);
+
+	glEnableVertexAttribArray(GL3_ATTRIB_COLOR);
+	qglVertexAttribPointer(GL3_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(draw2Dcolor_vtx_t), offsetof(draw2Dcolor_vtx_t, color));
 
 	GL3_BindVAO(0);
+
+	batchNumQuads = 0;
 }
 
 void
 GL3_Draw_ShutdownLocal(void)
 {
-	glDeleteBuffers(1, &vbo2D);
-	vbo2D = 0;
+	batchNumQuads = 0;
+
 	glDeleteVertexArrays(1, &vao2D);
 	vao2D = 0;
 	glDeleteVertexArrays(1, &vao2Dcolor);
 	vao2Dcolor = 0;
 }
 
-// bind the texture before calling this
+/*
+ * Draws the batched 2D quads. Must be called before
+ * anything else is drawn or the 2D state is changed.
+ */
+void
+GL3_Draw_Flush(void)
+{
+	GLintptr offset;
+	int numVerts = batchNumQuads*6;
+
+	if (batchNumQuads == 0)
+	{
+		return;
+	}
+
+	if (batchTexnum != 0)
+	{
+		GL3_UseProgram(gl3state.si2D.shaderProgram);
+		GL3_Bind(batchTexnum);
+		GL3_BindVAO(vao2D);
+
+		offset = GL3_StreamData(&gl3state.vtxStream, batchVerts,
+			numVerts*sizeof(draw2D_vtx_t), sizeof(draw2D_vtx_t));
+		if (offset >= 0)
+		{
+			glDrawArrays(GL_TRIANGLES, offset/sizeof(draw2D_vtx_t), numVerts);
+		}
+	}
+	else
+	{
+		GL3_UseProgram(gl3state.si2Dcolor.shaderProgram);
+		GL3_BindVAO(vao2Dcolor);
+
+		offset = GL3_StreamData(&gl3state.vtxStream, batchColorVerts,
+			numVerts*sizeof(draw2Dcolor_vtx_t), sizeof(draw2Dcolor_vtx_t));
+		if (offset >= 0)
+		{
+			glDrawArrays(GL_TRIANGLES, offset/sizeof(draw2Dcolor_vtx_t), numVerts);
+		}
+	}
+
+	gl3state.num2DDraws++;
+	gl3state.num2DQuads += batchNumQuads;
+
+	batchNumQuads = 0;
+}
+
+/*
+ * Called once per frame, after swapping
+ * buffers. Only updates the counters.
+ */
+void
+GL3_Draw_EndFrame(void)
+{
+	gl3state.lastNum2DDraws = gl3state.num2DDraws;
+	gl3state.lastNum2DQuads = gl3state.num2DQuads;
+	gl3state.num2DDraws = gl3state.num2DQuads = 0;
+}
+
+// flushes if the quad can't be added to the current batch
+static void
+batchBegin(GLuint texnum)
+{
+	if (batchNumQuads > 0 &&
+		(batchTexnum != texnum || batchNumQuads == MAX_BATCH_QUADS))
+	{
+		GL3_Draw_Flush();
+	}
+
+	batchTexnum = texnum;
+}
+
+static void
+batchTexturedRectangle(GLuint texnum, float x, float y, float w, float h,
+                       float sl, float tl, float sh, float th)
+{
+	draw2D_vtx_t* v;
+
+	batchBegin(texnum);
+
+	v = &batchVerts[batchNumQuads*6];
+	batchNumQuads++;
+
+	// two triangles: (x,y) (x+w,y) (x,y+h) and (x,y+h) (x+w,y) (x+w,y+h)
+	v[0] = (draw2D_vtx_t){ { x,   y   }, { sl, tl } };
+	v[1] = (draw2D_vtx_t){ { x+w, y   }, { sh, tl } };
+	v[2] = (draw2D_vtx_t){ { x,   y+h }, { sl, th } };
+	v[3] = v[2];
+	v[4] = v[1];
+	v[5] = (draw2D_vtx_t){ { x+w, y+h }, { sh, th } };
+}
+
+static void
+batchColorRectangle(float x, float y, float w, float h, const byte color[4])
+{
+	draw2Dcolor_vtx_t* v;
+	int i;
+
+	batchBegin(0);
+
+	v = &batchColorVerts[batchNumQuads*6];
+	batchNumQuads++;
+
+	v[0].pos[0] = x;   v[0].pos[1] = y;
+	v[1].pos[0] = x+w; v[1].pos[1] = y;
+	v[2].pos[0] = x;   v[2].pos[1] = y+h;
+	v[5].pos[0] = x+w; v[5].pos[1] = y+h;
+
+	for (i = 0; i < 4; ++i)
+	{
+		v[0].color[i] = v[1].color[i] = v[2].color[i] = v[5].color[i] = color[i];
+	}
+
+	v[3] = v[2];
+	v[4] = v[1];
+}
+
+// bind the texture before calling this.
+// draws right away, use batchTexturedRectangle() for pics
 static void
 drawTexturedRectangle(float x, float y, float w, float h,
                       float sl, float tl, float sh, float th)
@@ -112,14 +258,11 @@ drawTexturedRectangle(float x, float y, float w, float h,
 
 	GL3_BindVAO(vao2D);
 
-	// Note: while vao2D "remembers" its vbo for drawing, binding the vao does *not*
-	//       implicitly bind the vbo, so I need to explicitly bind it before glBufferData()
-	GL3_BindVBO(vbo2D);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vBuf), vBuf, GL_STREAM_DRAW);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	//glMultiDrawArrays(mode, first, count, drawcount) ??
+	GLintptr offset = GL3_StreamData(&gl3state.vtxStream, vBuf, sizeof(vBuf), 4*sizeof(GLfloat));
+	if(offset >= 0)
+	{
+		glDrawArrays(GL_TRIANGLE_STRIP, offset/(4*sizeof(GLfloat)), 4);
+	}
 }
 
 /*
@@ -132,6 +275,7 @@ GL3_Draw_CharScaled(int x, int y, int num, float scale)
 {
 	int row, col;
 	float frow, fcol, size, scaledSize;
+	float sw, tw;
 	num &= 255;
 
 	if ((num & 127) == 32)
@@ -153,11 +297,14 @@ GL3_Draw_CharScaled(int x, int y, int num, float scale)
 
 	scaledSize = 8*scale;
 
-	// TODO: batchen?
+	// draw_chars can be part of the scrap, so map
+	// the coordinates to its part of the texture
+	sw = draw_chars->sh - draw_chars->sl;
+	tw = draw_chars->th - draw_chars->tl;
 
-	GL3_UseProgram(gl3state.si2D.shaderProgram);
-	GL3_Bind(draw_chars->texnum);
-	drawTexturedRectangle(x, y, scaledSize, scaledSize, fcol, frow, fcol+size, frow+size);
+	batchTexturedRectangle(draw_chars->texnum, x, y, scaledSize, scaledSize,
+		draw_chars->sl + fcol*sw, draw_chars->tl + frow*tw,
+		draw_chars->sl + (fcol+size)*sw, draw_chars->tl + (frow+size)*tw);
 }
 
 gl3image_t *
@@ -194,10 +341,7 @@ GL3_Draw_StretchPic(int x, int y, int w, int h, char *pic)
 		return;
 	}
 
-	GL3_UseProgram(gl3state.si2D.shaderProgram);
-	GL3_Bind(gl->texnum);
-
-	drawTexturedRectangle(x, y, w, h, gl->sl, gl->tl, gl->sh, gl->th);
+	batchTexturedRectangle(gl->texnum, x, y, w, h, gl->sl, gl->tl, gl->sh, gl->th);
 }
 
 void
@@ -210,10 +354,7 @@ GL3_Draw_PicScaled(int x, int y, char *pic, float factor)
 		return;
 	}
 
-	GL3_UseProgram(gl3state.si2D.shaderProgram);
-	GL3_Bind(gl->texnum);
-
-	drawTexturedRectangle(x, y, gl->width*factor, gl->height*factor, gl->sl, gl->tl, gl->sh, gl->th);
+	batchTexturedRectangle(gl->texnum, x, y, gl->width*factor, gl->height*factor, gl->sl, gl->tl, gl->sh, gl->th);
 }
 
 /*
@@ -231,10 +372,35 @@ GL3_Draw_TileClear(int x, int y, int w, int h, char *pic)
 		return;
 	}
 
-	GL3_UseProgram(gl3state.si2D.shaderProgram);
-	GL3_Bind(image->texnum);
+	if (!image->scrap)
+	{
+		batchTexturedRectangle(image->texnum, x, y, w, h, x/64.0f, y/64.0f, (x+w)/64.0f, (y+h)/64.0f);
+		return;
+	}
+
+	// texture repeat would wrap over the whole scrap,
+	// so small pics are tiled one 64*64 cell at a time
+	{
+		float ds = (image->sh - image->sl) / 64.0f;
+		float dt = (image->th - image->tl) / 64.0f;
+		int cx, cy;
 
-	drawTexturedRectangle(x, y, w, h, x/64.0f, y/64.0f, (x+w)/64.0f, (y+h)/64.0f);
+		for (cy = y & ~63; cy < y + h; cy += 64)
+		{
+			int y0 = (cy > y) ? cy : y;
+			int y1 = (cy + 64 < y + h) ? cy + 64 : y + h;
+
+			for (cx = x & ~63; cx < x + w; cx += 64)
+			{
+				int x0 = (cx > x) ? cx : x;
+				int x1 = (cx + 64 < x + w) ? cx + 64 : x + w;
+
+				batchTexturedRectangle(image->texnum, x0, y0, x1 - x0, y1 - y0,
+					image->sl + (x0 - cx) * ds, image->tl + (y0 - cy) * dt,
+					image->sl + (x1 - cx) * ds, image->tl + (y1 - cy) * dt);
+			}
+		}
+	}
 }
 
 void
@@ -243,6 +409,9 @@ GL3_DrawFrameBufferObject(int x, int y, int w, int h, GLuint fboTexture, const f
 	qboolean underwater = (gl3_newrefdef.rdflags & RDF_UNDERWATER) != 0;
 	gl3ShaderInfo_t* shader = underwater ? &gl3state.si2DpostProcessWater
 	                                     : &gl3state.si2DpostProcess;
+
+	GL3_Draw_Flush();
+
 	GL3_UseProgram(shader->shaderProgram);
 	GL3_Bind(fboTexture);
 
@@ -269,7 +438,6 @@ GL3_Draw_Fill(int x, int y, int w, int h, int c)
 		unsigned c;
 		byte v[4];
 	} color;
-	int i;
 
 	if ((unsigned)c > 255)
 	{
@@ -277,30 +445,9 @@ GL3_Draw_Fill(int x, int y, int w, int h, int c)
 	}
 
 	color.c = d_8to24table[c];
+	color.v[3] = 255;
 
-	GLfloat vBuf[8] = {
-	//  X,   Y
-		x,   y+h,
-		x,   y,
-		x+w, y+h,
-		x+w, y
-	};
-
-	for(i=0; i<3; ++i)
-	{
-		gl3state.uniCommonData.color.Elements[i] = color.v[i] * (1.0f/255.0f);
-	}
-	gl3state.uniCommonData.color.A = 1.0f;
-
-	GL3_UpdateUBOCommon();
-
-	GL3_UseProgram(gl3state.si2Dcolor.shaderProgram);
-	GL3_BindVAO(vao2Dcolor);
-
-	GL3_BindVBO(vbo2D);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vBuf), vBuf, GL_STREAM_DRAW);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	batchColorRectangle(x, y, w, h, color.v);
 }
 
 // in GL1 this is called R_Flash() (which just calls R_PolyBlend())
@@ -315,29 +462,20 @@ GL3_Draw_Flash(const float color[4], float x, float y, float w, float h)
 	}
 
 	int i=0;
+	byte bColor[4];
 
-	GLfloat vBuf[8] = {
-	//  X,   Y
-		x,   y+h,
-		x,   y,
-		x+w, y+h,
-		x+w, y
-	};
-
-	glEnable(GL_BLEND);
-
-	for(i=0; i<4; ++i)  gl3state.uniCommonData.color.Elements[i] = color[i];
-
-	GL3_UpdateUBOCommon();
-
-	GL3_UseProgram(gl3state.si2Dcolor.shaderProgram);
+	for(i=0; i<4; ++i)
+	{
+		bColor[i] = (byte)(Q_max(0.0f, Q_min(color[i], 1.0f))*255.0f + 0.5f);
+	}
 
-	GL3_BindVAO(vao2Dcolor);
+	// this one is blended, so it gets a batch of its own
+	GL3_Draw_Flush();
 
-	GL3_BindVBO(vbo2D);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vBuf), vBuf, GL_STREAM_DRAW);
+	glEnable(GL_BLEND);
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	batchColorRectangle(x, y, w, h, bColor);
+	GL3_Draw_Flush();
 
 	glDisable(GL_BLEND);
 }
@@ -354,6 +492,8 @@ GL3_Draw_StretchRaw(int x, int y, int w, int h, int cols, int rows, const byte *
 {
 	int i, j;
 
+	GL3_Draw_Flush();
+
 	GL3_Bind(0);
 
 	unsigned image32[320*240]; /* was 256 * 256, but we want a bit more space */
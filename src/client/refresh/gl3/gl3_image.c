@@ -49,6 +49,18 @@ gl3image_t gl3textures[MAX_GL3TEXTURES];
 int numgl3textures = 0;
 static int image_max = 0;
 
+/*
+ * Small 8 bit pics and conchars are packed into the scrap, so 2D
+ * drawing can batch them without switching textures. There's one
+ * scrap for filtered and one for unfiltered (gl_nolerp_list) pics.
+ */
+#define SCRAP_SIZE 512
+
+enum {SCRAP_FILTERED, SCRAP_NEAREST, NUM_SCRAPS};
+
+static GLuint scrap_texnum[NUM_SCRAPS];
+static int scrap_allocated[NUM_SCRAPS][SCRAP_SIZE];
+
 void
 GL3_TextureMode(char *string)
 {
@@ -106,6 +118,11 @@ GL3_TextureMode(char *string)
 			nolerp = true;
 		}
 
+		if (glt->scrap)
+		{
+			continue; /* the scrap is set below */
+		}
+
 		GL3_SelectTMU(GL_TEXTURE0);
 		GL3_Bind(glt->texnum);
 		if ((glt->type != it_pic) && (glt->type != it_sky)) /* mipmapped texture */
@@ -136,6 +153,15 @@ GL3_TextureMode(char *string)
 			}
 		}
 	}
+
+	/* pics stay in the scrap they were loaded into until vid_restart */
+	if (scrap_texnum[SCRAP_FILTERED])
+	{
+		GL3_SelectTMU(GL_TEXTURE0);
+		GL3_Bind(scrap_texnum[SCRAP_FILTERED]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_filter_max);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter_max);
+	}
 }
 
 void
@@ -237,11 +263,13 @@ GL3_Upload32(unsigned *data, int width, int height, qboolean mipmap)
 /*
  * Returns has_alpha
  */
-qboolean
-GL3_Upload8(byte *data, int width, int height, qboolean mipmap, qboolean is_sky)
+/*
+ * Converts paletted data to RGBA into trans
+ */
+static void
+Convert8to32(const byte *data, int width, int height, unsigned *trans)
 {
 	int s = width * height;
-	unsigned *trans = malloc(s * sizeof(unsigned));
 
 	for (int i = 0; i < s; i++)
 	{
@@ -279,12 +307,148 @@ GL3_Upload8(byte *data, int width, int height, qboolean mipmap, qboolean is_sky)
 			((byte *)&trans[i])[2] = ((byte *)&d_8to24table[p])[2];
 		}
 	}
+}
+
+qboolean
+GL3_Upload8(byte *data, int width, int height, qboolean mipmap, qboolean is_sky)
+{
+	unsigned *trans = malloc(width * height * sizeof(unsigned));
+
+	Convert8to32(data, width, height, trans);
 
 	qboolean ret = GL3_Upload32(trans, width, height, mipmap);
 	free(trans);
 	return ret;
 }
 
+/*
+ * Finds the lowest place for a w*h block in the scrap,
+ * returns false if it's full
+ */
+static qboolean
+Scrap_AllocBlock(int scrap, int w, int h, int *x, int *y)
+{
+	int *allocated = scrap_allocated[scrap];
+	int i, j;
+	int best, best2;
+
+	best = SCRAP_SIZE;
+
+	for (i = 0; i <= SCRAP_SIZE - w; i++)
+	{
+		best2 = 0;
+
+		for (j = 0; j < w; j++)
+		{
+			if (allocated[i + j] >= best)
+			{
+				break;
+			}
+
+			if (allocated[i + j] > best2)
+			{
+				best2 = allocated[i + j];
+			}
+		}
+
+		if (j == w)
+		{
+			/* this is a valid spot */
+			*x = i;
+			*y = best = best2;
+		}
+	}
+
+	if (best + h > SCRAP_SIZE)
+	{
+		return false;
+	}
+
+	for (i = 0; i < w; i++)
+	{
+		allocated[*x + i] = best + h;
+	}
+
+	return true;
+}
+
+/*
+ * Copies an 8 bit pic into the scrap, with a border of
+ * repeated edge pixels so filtering doesn't pick up the
+ * neighbours. Returns false if it doesn't fit.
+ */
+static qboolean
+Scrap_Upload(gl3image_t *image, byte *pic, int width, int height, qboolean nolerp)
+{
+	int scrap = nolerp ? SCRAP_NEAREST : SCRAP_FILTERED;
+	int bw = width + 2;
+	int bh = height + 2;
+	unsigned *trans, *block;
+	int x = 0, y = 0;
+	int i, j;
+
+	trans = malloc(width * height * sizeof(unsigned));
+	block = malloc(bw * bh * sizeof(unsigned));
+
+	if (!trans || !block || !Scrap_AllocBlock(scrap, bw, bh, &x, &y))
+	{
+		free(trans);
+		free(block);
+
+		return false;
+	}
+
+	Convert8to32(pic, width, height, trans);
+
+	for (i = 0; i < bh; i++)
+	{
+		int sy = Q_min(Q_max(i - 1, 0), height - 1);
+
+		for (j = 0; j < bw; j++)
+		{
+			int sx = Q_min(Q_max(j - 1, 0), width - 1);
+
+			block[i * bw + j] = trans[sy * width + sx];
+		}
+	}
+
+	GL3_SelectTMU(GL_TEXTURE0);
+
+	if (!scrap_texnum[scrap])
+	{
+		GLint filter = nolerp ? GL_NEAREST : gl_filter_max;
+
+		glGenTextures(1, &scrap_texnum[scrap]);
+		GL3_Bind(scrap_texnum[scrap]);
+
+		glTexImage2D(GL_TEXTURE_2D, 0, gl3_tex_alpha_format, SCRAP_SIZE, SCRAP_SIZE,
+		             0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	else
+	{
+		GL3_Bind(scrap_texnum[scrap]);
+	}
+
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, bw, bh, GL_RGBA, GL_UNSIGNED_BYTE, block);
+
+	free(trans);
+	free(block);
+
+	image->texnum = scrap_texnum[scrap];
+	image->scrap = true;
+	image->has_alpha = true;
+	image->sl = (x + 1) / (float)SCRAP_SIZE;
+	image->sh = (x + 1 + width) / (float)SCRAP_SIZE;
+	image->tl = (y + 1) / (float)SCRAP_SIZE;
+	image->th = (y + 1 + height) / (float)SCRAP_SIZE;
+
+	return true;
+}
+
 typedef struct
 {
 	short x, y;
@@ -434,54 +598,64 @@ GL3_LoadPic(char *name, byte *pic, int width, int realwidth,
 
 	image->is_lava = (strstr(name, "lava") != NULL);
 
-	// image->scrap = false; // TODO: reintroduce scrap? would allow optimizations in 2D rendering..
-
-	glGenTextures(1, &texNum);
-
-	image->texnum = texNum;
+	image->scrap = false;
 
-	GL3_SelectTMU(GL_TEXTURE0);
-	GL3_Bind(texNum);
+	/* load little pics and the console font into the scrap */
+	if ((type == it_pic) && (bits == 8) && !r_scale8bittextures->value &&
+		(((width < 64) && (height < 64)) || !strcmp(name, "pics/conchars.pcx")))
+	{
+		image->scrap = Scrap_Upload(image, pic, width, height, nolerp);
+	}
 
-	if (bits == 8)
+	if (!image->scrap)
 	{
-		// resize 8bit images only when we forced such logic
-		if (r_scale8bittextures->value)
-		{
-			byte *image_converted;
-			int scale = 2;
+		glGenTextures(1, &texNum);
 
-			// scale 3 times if lerp image
-			if (!nolerp && (vid.height >= 240 * 3))
-				scale = 3;
+		image->texnum = texNum;
 
-			image_converted = malloc(width * height * scale * scale);
-			if (!image_converted)
-				return NULL;
+		GL3_SelectTMU(GL_TEXTURE0);
+		GL3_Bind(texNum);
 
-			if (scale == 3) {
-				scale3x(pic, image_converted, width, height);
-			} else {
-				scale2x(pic, image_converted, width, height);
+		if (bits == 8)
+		{
+			// resize 8bit images only when we forced such logic
+			if (r_scale8bittextures->value)
+			{
+				byte *image_converted;
+				int scale = 2;
+
+				// scale 3 times if lerp image
+				if (!nolerp && (vid.height >= 240 * 3))
+					scale = 3;
+
+				image_converted = malloc(width * height * scale * scale);
+				if (!image_converted)
+					return NULL;
+
+				if (scale == 3) {
+					scale3x(pic, image_converted, width, height);
+				} else {
+					scale2x(pic, image_converted, width, height);
+				}
+
+				image->has_alpha = GL3_Upload8(image_converted, width * scale, height * scale,
+							(image->type != it_pic && image->type != it_sky),
+							image->type == it_sky);
+				free(image_converted);
+			}
+			else
+			{
+				image->has_alpha = GL3_Upload8(pic, width, height,
+							(image->type != it_pic && image->type != it_sky),
+							image->type == it_sky);
 			}
-
-			image->has_alpha = GL3_Upload8(image_converted, width * scale, height * scale,
-						(image->type != it_pic && image->type != it_sky),
-						image->type == it_sky);
-			free(image_converted);
 		}
 		else
 		{
-			image->has_alpha = GL3_Upload8(pic, width, height,
-						(image->type != it_pic && image->type != it_sky),
-						image->type == it_sky);
+			image->has_alpha = GL3_Upload32((unsigned *)pic, width, height,
+						(image->type != it_pic && image->type != it_sky));
 		}
 	}
-	else
-	{
-		image->has_alpha = GL3_Upload32((unsigned *)pic, width, height,
-					(image->type != it_pic && image->type != it_sky));
-	}
 
 	if (realwidth && realheight)
 	{
@@ -498,91 +672,8 @@ GL3_LoadPic(char *name, byte *pic, int width, int realwidth,
 		}
 	}
 
-	image->sl = 0;
-	image->sh = 1;
-	image->tl = 0;
-	image->th = 1;
-
-	if (nolerp)
+	if (!image->scrap)
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	}
-#if 0 // TODO: the scrap could allow batch rendering 2D stuff? not sure it's worth the hassle..
-	/* load little pics into the scrap */
-	if (!nolerp && (image->type == it_pic) && (bits == 8) &&
-		(image->width < 64) && (image->height < 64))
-	{
-		int x, y;
-		int i, j, k;
-		int texnum;
-
-		texnum = Scrap_AllocBlock(image->width, image->height, &x, &y);
-
-		if (texnum == -1)
-		{
-			goto nonscrap;
-		}
-
-		scrap_dirty = true;
-
-		/* copy the texels into the scrap block */
-		k = 0;
-
-		for (i = 0; i < image->height; i++)
-		{
-			for (j = 0; j < image->width; j++, k++)
-			{
-				scrap_texels[texnum][(y + i) * BLOCK_WIDTH + x + j] = pic[k];
-			}
-		}
-
-		image->texnum = TEXNUM_SCRAPS + texnum;
-		image->scrap = true;
-		image->has_alpha = true;
-		image->sl = (x + 0.01) / (float)BLOCK_WIDTH;
-		image->sh = (x + image->width - 0.01) / (float)BLOCK_WIDTH;
-		image->tl = (y + 0.01) / (float)BLOCK_WIDTH;
-		image->th = (y + image->height - 0.01) / (float)BLOCK_WIDTH;
-	}
-	else
-	{
-	nonscrap:
-		image->scrap = false;
-		image->texnum = TEXNUM_IMAGES + (image - gltextures);
-		R_Bind(image->texnum);
-
-		if (bits == 8)
-		{
-			image->has_alpha = R_Upload8(pic, width, height,
-						(image->type != it_pic && image->type != it_sky),
-						image->type == it_sky);
-		}
-		else
-		{
-			image->has_alpha = R_Upload32((unsigned *)pic, width, height,
-						(image->type != it_pic && image->type != it_sky));
-		}
-
-		image->upload_width = upload_width; /* after power of 2 and scales */
-		image->upload_height = upload_height;
-		image->paletted = uploaded_paletted;
-
-		if (realwidth && realheight)
-		{
-			if ((realwidth <= image->width) && (realheight <= image->height))
-			{
-				image->width = realwidth;
-				image->height = realheight;
-			}
-			else
-			{
-				R_Printf(PRINT_DEVELOPER,
-						"Warning, image '%s' has hi-res replacement smaller than the original! (%d x %d) < (%d x %d)\n",
-						name, image->width, image->height, realwidth, realheight);
-			}
-		}
-
 		image->sl = 0;
 		image->sh = 1;
 		image->tl = 0;
@@ -594,7 +685,7 @@ GL3_LoadPic(char *name, byte *pic, int width, int realwidth,
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		}
 	}
-#endif // 0
+
 	return image;
 }
 
@@ -747,10 +838,25 @@ GL3_ShutdownImages(void)
 			continue; /* free image_t slot */
 		}
 
-		/* free it */
-		glDeleteTextures(1, &image->texnum);
+		/* free it, unless it's in the scrap */
+		if (!image->scrap)
+		{
+			glDeleteTextures(1, &image->texnum);
+		}
+
 		memset(image, 0, sizeof(*image));
 	}
+
+	for (i = 0; i < NUM_SCRAPS; i++)
+	{
+		if (scrap_texnum[i])
+		{
+			glDeleteTextures(1, &scrap_texnum[i]);
+			scrap_texnum[i] = 0;
+		}
+	}
+
+	memset(scrap_allocated, 0, sizeof(scrap_allocated));
 }
 
 static qboolean IsNPOT(int v)
@@ -30,7 +30,6 @@
 extern gl3lightmapstate_t gl3_lms;
 
 int r_dlightframecount;
-static vec3_t pointcolor;
 static cplane_t *lightplane; /* used as shadow plane */
 vec3_t lightspot;
 
@@ -108,7 +107,7 @@ GL3_PushDlights(void)
 }
 
 static int
-RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
+RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end, lightsample_t *sample)
 {
 	float front, back, frac;
 	int side;
@@ -135,7 +134,7 @@ RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
 
 	if ((back < 0) == side)
 	{
-		return RecursiveLightPoint(node->children[side], start, end);
+		return RecursiveLightPoint(node->children[side], start, end, sample);
 	}
 
 	frac = front / (front - back);
@@ -144,7 +143,7 @@ RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
 	mid[2] = start[2] + (end[2] - start[2]) * frac;
 
 	/* go down front side */
-	r = RecursiveLightPoint(node->children[side], start, mid);
+	r = RecursiveLightPoint(node->children[side], start, mid, sample);
 
 	if (r >= 0)
 	{
@@ -197,26 +196,13 @@ RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
 		dt >>= 4;
 
 		lightmap = surf->samples;
-		VectorCopy(vec3_origin, pointcolor);
-
 		lightmap += 3 * (dt * ((surf->extents[0] >> 4) + 1) + ds);
 
 		for (maps = 0; maps < MAX_LIGHTMAPS_PER_SURFACE && surf->styles[maps] != 255;
 			 maps++)
 		{
-			const float *rgb;
-			int j;
-
-			rgb = gl3_newrefdef.lightstyles[surf->styles[maps]].rgb;
-
-			/* Apply light level to models */
-			for (j = 0; j < 3; j++)
-			{
-				float	scale;
-
-				scale = rgb[j] * r_modulate->value;
-				pointcolor[j] += lightmap[j] * scale * (1.0 / 255);
-			}
+			sample->styles[maps] = surf->styles[maps];
+			VectorCopy(lightmap, sample->rgb[maps]);
 
 			lightmap += 3 * ((surf->extents[0] >> 4) + 1) *
 						((surf->extents[1] >> 4) + 1);
@@ -226,14 +212,30 @@ RecursiveLightPoint(mnode_t *node, vec3_t start, vec3_t end)
 	}
 
 	/* go down back side */
-	return RecursiveLightPoint(node->children[!side], mid, end);
+	return RecursiveLightPoint(node->children[!side], mid, end, sample);
+}
+
+/*
+ * Traces down from p and returns the lightmap
+ * samples of the first surface that's hit.
+ */
+void
+GL3_SampleLight(const vec3_t p, lightsample_t *sample)
+{
+	vec3_t start, end;
+
+	memset(sample->styles, 255, sizeof(sample->styles));
+
+	VectorCopy(p, start);
+	VectorCopy(p, end);
+	end[2] -= 2048;
+
+	RecursiveLightPoint(gl3_worldmodel->nodes, start, end, sample);
 }
 
 void
 GL3_LightPoint(entity_t *currententity, vec3_t p, vec3_t color)
 {
-	vec3_t end;
-	float r;
 	int lnum;
 	dlight_t *dl;
 	vec3_t dist;
@@ -245,22 +247,14 @@ GL3_LightPoint(entity_t *currententity, vec3_t p, vec3_t color)
 		return;
 	}
 
-	end[0] = p[0];
-	end[1] = p[1];
-	end[2] = p[2] - 2048;
-
-	// TODO: don't just aggregate the color, but also save position of brightest+nearest light
-	//       for shadow position and maybe lighting on model?
-
-	r = RecursiveLightPoint(gl3_worldmodel->nodes, p, end);
-
-	if (r == -1)
+	/* shadows need the lightspot from the trace */
+	if (gl_shadows->value ||
+		!R_LightGridPoint(p, gl3_newrefdef.lightstyles, r_modulate->value, color))
 	{
-		VectorCopy(vec3_origin, color);
-	}
-	else
-	{
-		VectorCopy(pointcolor, color);
+		lightsample_t sample;
+
+		GL3_SampleLight(p, &sample);
+		R_LightSampleColor(&sample, gl3_newrefdef.lightstyles, r_modulate->value, color);
 	}
 
 	/* add dynamic lights */
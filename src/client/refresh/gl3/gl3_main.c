@@ -128,7 +128,8 @@ cvar_t *r_modulate;
 cvar_t *gl_lightmap;
 cvar_t *gl_shadows;
 cvar_t *gl3_debugcontext;
-cvar_t *gl3_usebigvbo;
+cvar_t *gl3_bufferstorage;
+cvar_t *gl3_shadercache;
 cvar_t *r_fixsurfsky;
 cvar_t *r_palettedtexture;
 cvar_t *r_validation;
@@ -222,10 +223,13 @@ GL3_Register(void)
 	gl3_colorlight = ri.Cvar_Get("gl3_colorlight", "1", CVAR_ARCHIVE);
 	gl_polyblend = ri.Cvar_Get("gl_polyblend", "1", CVAR_ARCHIVE);
 
-	//  0: use lots of calls to glBufferData()
-	//  1: reduce calls to glBufferData() with one big VBO (see GL3_BufferAndDraw3D())
-	// -1: auto (let yq2 choose to enable/disable this based on detected driver)
-	gl3_usebigvbo = ri.Cvar_Get("gl3_usebigvbo", "-1", CVAR_ARCHIVE);
+	// if set to 0, dynamic geometry isn't streamed through persistently mapped buffers
+	// even if GL_ARB_buffer_storage is supported (see gl3_stream.c)
+	gl3_bufferstorage = ri.Cvar_Get("gl3_bufferstorage", "1", CVAR_ARCHIVE);
+
+	// if set to 0, shader programs are always compiled instead of
+	// being loaded from the cache in the game dir (see gl3_shadercache.c)
+	gl3_shadercache = ri.Cvar_Get("gl3_shadercache", "1", CVAR_ARCHIVE);
 
 	r_norefresh = ri.Cvar_Get("r_norefresh", "0", 0);
 	r_drawentities = ri.Cvar_Get("r_drawentities", "1", 0);
@@ -337,6 +341,7 @@ GL3_Register(void)
 	ri.Cmd_AddCommand("screenshot", GL3_ScreenShot);
 	ri.Cmd_AddCommand("modellist", GL3_Mod_Modellist_f);
 	ri.Cmd_AddCommand("gl_strings", GL3_Strings);
+	ri.Cmd_AddCommand("r_cullbench", GL3_CullBench_f);
 }
 
 /*
@@ -591,45 +596,21 @@ GL3_Init(void)
 		R_Printf(PRINT_ALL, " - OpenGL Debug Output: Not Supported\n");
 	}
 
-	gl3config.useBigVBO = false;
-	if(gl3_usebigvbo->value == 1.0f)
-	{
-		R_Printf(PRINT_ALL, "Enabling useBigVBO workaround because gl3_usebigvbo = 1\n");
-		gl3config.useBigVBO = true;
-	}
-	else if(gl3_usebigvbo->value == -1.0f)
+	if(gl3config.buffer_storage)
 	{
-		// enable for AMDs proprietary Windows and Linux drivers
-#ifdef _WIN32
-		if(gl3config.version_string != NULL && gl3config.vendor_string != NULL
-		   && strstr(gl3config.vendor_string, "ATI Technologies Inc") != NULL)
+		R_Printf(PRINT_ALL, " - Buffer Storage: Supported ");
+		if(gl3_bufferstorage->value == 0.0f)
 		{
-			int a, b, ver;
-			if(sscanf(gl3config.version_string, " %d.%d.%d ", &a, &b, &ver) >= 3 && ver >= 13431)
-			{
-				// turns out the legacy driver is a lot faster *without* the workaround :-/
-				// GL_VERSION for legacy 16.2.1 Beta driver: 3.2.13399 Core Profile Forward-Compatible Context 15.200.1062.1004
-				//            (this is the last version that supports the Radeon HD 6950)
-				// GL_VERSION for (non-legacy) 16.3.1 driver on Radeon R9 200: 4.5.13431 Compatibility Profile Context 16.150.2111.0
-				// GL_VERSION for non-legacy 17.7.2 WHQL driver: 4.5.13491 Compatibility Profile/Debug Context 22.19.662.4
-				// GL_VERSION for 18.10.1 driver: 4.6.13541 Compatibility Profile/Debug Context 25.20.14003.1010
-				// GL_VERSION for (current) 19.3.2 driver: 4.6.13547 Compatibility Profile/Debug Context 25.20.15027.5007
-				// (the 3.2/4.5/4.6 can probably be ignored, might depend on the card and what kind of context was requested
-				//  but AFAIK the number behind that can be used to roughly match the driver version)
-				// => let's try matching for x.y.z with z >= 13431
-				// (no, I don't feel like testing which release since 16.2.1 has introduced the slowdown.)
-				R_Printf(PRINT_ALL, "Detected AMD Windows GPU driver, enabling useBigVBO workaround\n");
-				gl3config.useBigVBO = true;
-			}
+			R_Printf(PRINT_ALL, "(but disabled with gl3_bufferstorage = 0)\n");
 		}
-#elif defined(__linux__)
-		if(gl3config.vendor_string != NULL && strstr(gl3config.vendor_string, "Advanced Micro Devices, Inc.") != NULL)
+		else
 		{
-			R_Printf(PRINT_ALL, "Detected proprietary AMD GPU driver, enabling useBigVBO workaround\n");
-			R_Printf(PRINT_ALL, "(consider using the open source RadeonSI drivers, they tend to work better overall)\n");
-			gl3config.useBigVBO = true;
+			R_Printf(PRINT_ALL, "and enabled\n");
 		}
-#endif
+	}
+	else
+	{
+		R_Printf(PRINT_ALL, " - Buffer Storage: Not Supported\n");
 	}
 
 	// generate texture handles for all possible lightmaps
@@ -651,8 +632,12 @@ GL3_Init(void)
 
 	GL3_Mod_Init();
 
+	GL3_InitMeshes();
+
 	GL3_InitParticleTexture();
 
+	GL3_StreamInit();
+
 	GL3_Draw_InitLocal();
 
 	GL3_SurfInit();
@@ -673,16 +658,19 @@ GL3_Shutdown(void)
 	ri.Cmd_RemoveCommand("screenshot");
 	ri.Cmd_RemoveCommand("imagelist");
 	ri.Cmd_RemoveCommand("gl_strings");
+	ri.Cmd_RemoveCommand("r_cullbench");
 
 	// only call all these if we have an OpenGL context and the gl function pointers
 	// randomly chose one function that should always be there to test..
 	if(glDeleteBuffers != NULL)
 	{
 		GL3_Mod_FreeAll();
+		R_FreeVisCache();
 		GL3_ShutdownMeshes();
 		GL3_ShutdownImages();
 		GL3_SurfShutdown();
 		GL3_Draw_ShutdownLocal();
+		GL3_StreamShutdown();
 		GL3_ShutdownShaders();
 
 		// free the postprocessing FBO and its renderbuffer and texture
@@ -701,78 +689,27 @@ GL3_Shutdown(void)
 	GL3_ShutdownContext();
 }
 
-// assumes gl3state.v[ab]o3D are bound
+// assumes gl3state.vao3D is bound
 // buffers and draws gl3_3D_vtx_t vertices
 // drawMode is something like GL_TRIANGLE_STRIP or GL_TRIANGLE_FAN or whatever
 void
 GL3_BufferAndDraw3D(const gl3_3D_vtx_t* verts, int numVerts, GLenum drawMode)
 {
-	if(!gl3config.useBigVBO)
-	{
-		glBufferData( GL_ARRAY_BUFFER, sizeof(gl3_3D_vtx_t)*numVerts, verts, GL_STREAM_DRAW );
-		glDrawArrays( drawMode, 0, numVerts );
-	}
-	else // gl3config.useBigVBO == true
-	{
-		/*
-		 * For some reason, AMD's Windows driver doesn't seem to like lots of
-		 * calls to glBufferData() (some of them seem to take very long then).
-		 * GL3_BufferAndDraw3D() is called a lot when drawing world geometry
-		 * (once for each visible face I think?).
-		 * The simple code above caused noticeable slowdowns - even a fast
-		 * quadcore CPU and a Radeon RX580 weren't able to maintain 60fps..
-		 * The workaround is to not call glBufferData() with small data all the time,
-		 * but to allocate a big buffer and on each call to GL3_BufferAndDraw3D()
-		 * to use a different region of that buffer, resulting in a lot less calls
-		 * to glBufferData() (=> a lot less buffer allocations in the driver).
-		 * Only when the buffer is full and at the end of a frame (=> GL3_EndFrame())
-		 * we get a fresh buffer.
-		 *
-		 * BTW, we couldn't observe this kind of problem with any other driver:
-		 * Neither nvidias driver, nor AMDs or Intels Open Source Linux drivers,
-		 * not even Intels Windows driver seem to care that much about the
-		 * glBufferData() calls.. However, at least nvidias driver doesn't like
-		 * this workaround (with glMapBufferRange()), the framerate dropped
-		 * significantly - that's why both methods are available and
-		 * selectable at runtime.
-		 */
-#if 0
-		// I /think/ doing it with glBufferSubData() didn't really help
-		const int bufSize = gl3state.vbo3Dsize;
-		int neededSize = numVerts*sizeof(gl3_3D_vtx_t);
-		int curOffset = gl3state.vbo3DcurOffset;
-		if(curOffset + neededSize > gl3state.vbo3Dsize)
-			curOffset = 0;
-		int curIdx = curOffset / sizeof(gl3_3D_vtx_t);
-
-		gl3state.vbo3DcurOffset = curOffset + neededSize;
-
-		glBufferSubData( GL_ARRAY_BUFFER, curOffset, neededSize, verts );
-		glDrawArrays( drawMode, curIdx, numVerts );
-#else
-		int curOffset = gl3state.vbo3DcurOffset;
-		int neededSize = numVerts*sizeof(gl3_3D_vtx_t);
-		if(curOffset+neededSize > gl3state.vbo3Dsize)
-		{
-			// buffer is full, need to start again from the beginning
-			// => need to sync or get fresh buffer
-			// (getting fresh buffer seems easier)
-			glBufferData(GL_ARRAY_BUFFER, gl3state.vbo3Dsize, NULL, GL_STREAM_DRAW);
-			curOffset = 0;
-		}
-
-		// as we make sure to use a previously unused part of the buffer,
-		// doing it unsynchronized should be safe..
-		GLbitfield accessBits = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
-		void* data = glMapBufferRange(GL_ARRAY_BUFFER, curOffset, neededSize, accessBits);
-		memcpy(data, verts, neededSize);
-		glUnmapBuffer(GL_ARRAY_BUFFER);
-
-		glDrawArrays(drawMode, curOffset/sizeof(gl3_3D_vtx_t), numVerts);
+	/*
+	 * This used to call glBufferData() for each call, which some drivers
+	 * (esp. AMDs Windows driver) didn't like at all, because it's called for
+	 * every water, sky or translucent polygon. Now the vertices are appended
+	 * to the stream buffer, see gl3_stream.c.
+	 */
+	GLintptr offset = GL3_StreamData(&gl3state.vtxStream, verts,
+		sizeof(gl3_3D_vtx_t)*numVerts, sizeof(gl3_3D_vtx_t));
 
-		gl3state.vbo3DcurOffset = curOffset + neededSize; // TODO: padding or sth needed?
-#endif
+	if(offset < 0)
+	{
+		return;
 	}
+
+	glDrawArrays(drawMode, offset/sizeof(gl3_3D_vtx_t), numVerts);
 }
 
 static void
@@ -848,7 +785,6 @@ GL3_DrawBeam(entity_t *e)
 	}
 
 	GL3_BindVAO(gl3state.vao3D);
-	GL3_BindVBO(gl3state.vbo3D);
 
 	GL3_BufferAndDraw3D(verts, NUM_BEAM_SEGS*4, GL_TRIANGLE_STRIP);
 
@@ -930,7 +866,6 @@ GL3_DrawSpriteModel(entity_t *e, gl3model_t *currentmodel)
 	VectorMA( verts[3].pos, frame->width - frame->origin_x, right, verts[3].pos );
 
 	GL3_BindVAO(gl3state.vao3D);
-	GL3_BindVBO(gl3state.vbo3D);
 
 	GL3_BufferAndDraw3D(verts, 4, GL_TRIANGLE_FAN);
 
@@ -965,7 +900,6 @@ GL3_DrawNullModel(entity_t *currententity)
 	GL3_UseProgram(gl3state.si3DcolorOnly.shaderProgram);
 
 	GL3_BindVAO(gl3state.vao3D);
-	GL3_BindVBO(gl3state.vbo3D);
 
 	gl3_3D_vtx_t vtxA[6] = {
 		{{0, 0, -16}, {0,0}, {0,0}},
@@ -1000,18 +934,13 @@ GL3_DrawParticles(void)
 	{
 		int i;
 		int numParticles = gl3_newrefdef.num_particles;
-		YQ2_ALIGNAS_TYPE(unsigned) byte color[4];
 		const particle_t *p;
+		gl3_particle_vtx_t *buf;
+		GLintptr offset;
 		// assume the size looks good with window height 480px and scale according to real resolution
 		float pointSize = gl3_particle_size->value * (float)gl3_newrefdef.height/480.0f;
 
-		typedef struct part_vtx {
-			GLfloat pos[3];
-			GLfloat size;
-			GLfloat dist;
-			GLfloat color[4];
-		} part_vtx;
-		YQ2_STATIC_ASSERT(sizeof(part_vtx)==9*sizeof(float), "invalid part_vtx size"); // remember to update GL3_SurfInit() if this changes!
+		YQ2_STATIC_ASSERT(sizeof(gl3_particle_vtx_t)==4*sizeof(float), "invalid gl3_particle_vtx_t size"); // remember to update GL3_SurfInit() if this changes!
 
 		// Don't try to draw particles if there aren't any.
 		if (numParticles == 0)
@@ -1019,11 +948,34 @@ GL3_DrawParticles(void)
 			return;
 		}
 
-		YQ2_VLA(part_vtx, buf, numParticles);
+		// the particles are written straight into the stream,
+		// only origin and color, the vertex shader does the rest
+		buf = GL3_StreamBegin(&gl3state.vtxStream,
+			sizeof(gl3_particle_vtx_t)*numParticles, sizeof(gl3_particle_vtx_t));
+		if (buf == NULL)
+		{
+			return;
+		}
 
-		// TODO: viewOrg could be in UBO
-		vec3_t viewOrg;
-		VectorCopy(gl3_newrefdef.vieworg, viewOrg);
+		for ( i = 0, p = gl3_newrefdef.particles; i < numParticles; i++, p++ )
+		{
+			gl3_particle_vtx_t* cur = &buf[i];
+			float alpha = p->alpha;
+
+			VectorCopy(p->origin, cur->pos);
+			memcpy(cur->color, &d_8to24table[ p->color & 0xFF ], sizeof(cur->color));
+
+			alpha = Q_max(0.0f, Q_min(alpha, 1.0f));
+			cur->color[3] = (byte)(alpha*255.0f + 0.5f);
+		}
+
+		offset = GL3_StreamEnd(&gl3state.vtxStream);
+
+		if (gl3state.uni3DData.particleSize != pointSize)
+		{
+			gl3state.uni3DData.particleSize = pointSize;
+			GL3_UpdateUBO3D();
+		}
 
 		glDepthMask(GL_FALSE);
 		glEnable(GL_BLEND);
@@ -1040,26 +992,8 @@ GL3_DrawParticles(void)
 
 		GL3_UseProgram(gl3state.siParticle.shaderProgram);
 
-		for ( i = 0, p = gl3_newrefdef.particles; i < numParticles; i++, p++ )
-		{
-			*(int *) color = d_8to24table [ p->color & 0xFF ];
-			part_vtx* cur = &buf[i];
-			vec3_t offset; // between viewOrg and particle position
-			VectorSubtract(viewOrg, p->origin, offset);
-
-			VectorCopy(p->origin, cur->pos);
-			cur->size = pointSize;
-			cur->dist = VectorLength(offset);
-
-			for(int j=0; j<3; ++j)  cur->color[j] = color[j]*(1.0f/255.0f);
-
-			cur->color[3] = p->alpha;
-		}
-
 		GL3_BindVAO(gl3state.vaoParticle);
-		GL3_BindVBO(gl3state.vboParticle);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(part_vtx)*numParticles, buf, GL_STREAM_DRAW);
-		glDrawArrays(GL_POINTS, 0, numParticles);
+		glDrawArrays(GL_POINTS, offset/sizeof(gl3_particle_vtx_t), numParticles);
 
 		glDisable(GL_BLEND);
 		glDepthMask(GL_TRUE);
@@ -1069,8 +1003,6 @@ GL3_DrawParticles(void)
 #else
 		glDisable(GL_PROGRAM_POINT_SIZE);
 #endif
-
-		YQ2_VLAFREE(buf);
 	}
 }
 
@@ -1287,6 +1219,8 @@ GL3_SetGL2D(void)
 	}
 #endif // 0
 
+	GL3_Draw_Flush();
+
 	glViewport(x, y, w, h);
 
 	hmm_mat4 transMatr = HMM_Orthographic(0, vid.width, vid.height, 0, -99999, 99999);
@@ -1646,6 +1580,8 @@ GL3_RenderView(refdef_t *fd)
 		c_alias_polys = 0;
 	}
 
+	ri.Vid_MarkPhase(PHASE_WORLD);
+
 	GL3_PushDlights();
 
 	if (gl_finish->value)
@@ -1662,13 +1598,19 @@ GL3_RenderView(refdef_t *fd)
 
 	GL3_MarkLeaves(); /* done here so we know if we're in water */
 
+	GL3_UpdateLightstyles();
+
 	GL3_DrawWorld();
 
+	ri.Vid_MarkPhase(PHASE_ENTITIES);
+
 	GL3_DrawEntitiesOnList();
 
 	// kick the silly gl1_flashblend poly lights
 	// GL3_RenderDlights();
 
+	ri.Vid_MarkPhase(PHASE_PARTICLES);
+
 	GL3_DrawParticles();
 
 	GL3_DrawAlphaSurfaces();
@@ -1677,9 +1619,11 @@ GL3_RenderView(refdef_t *fd)
 
 	if (r_speeds->value)
 	{
-		R_Printf(PRINT_ALL, "%4i wpoly %4i epoly %i tex %i lmaps\n",
+		R_Printf(PRINT_ALL, "%4i wpoly %4i epoly %i tex %i lmaps %i kb streamed %i waits %i 2D draws %i quads\n",
 				c_brush_polys, c_alias_polys, c_visible_textures,
-				c_visible_lightmaps);
+				c_visible_lightmaps, gl3state.lastStreamBytes / 1024,
+				gl3state.lastStreamWaits, gl3state.lastNum2DDraws,
+				gl3state.lastNum2DQuads);
 	}
 
 #if 0 // TODO: stereo stuff
@@ -1762,6 +1706,8 @@ GL3_SetLightLevel(entity_t *currententity)
 static void
 GL3_RenderFrame(refdef_t *fd)
 {
+	GL3_Draw_Flush(); // 2D stuff drawn before this frame's view
+
 	GL3_RenderView(fd);
 	GL3_SetLightLevel(NULL);
 	qboolean usedFBO = gl3state.ppFBObound; // if it was/is used this frame
@@ -1853,6 +1799,8 @@ GL3_BeginFrame(float camera_separation)
 	}
 #endif // 0
 
+	GL3_Draw_Flush();
+
 	if (vid_gamma->modified || gl3_intensity->modified || gl3_intensity_2D->modified)
 	{
 		vid_gamma->modified = false;
@@ -1998,6 +1946,8 @@ GetRefAPI(refimport_t imp)
 
 	re.api_version = API_VERSION;
 	re.framework_version = GL3_GetSDLVersion();
+	// particles are expanded on the GPU, so it can handle more
+	re.max_particles = MAX_PARTICLES_LIMIT;
 
 	re.Init = GL3_Init;
 	re.Shutdown = GL3_Shutdown;
@@ -29,9 +29,6 @@
 
 #include "header/DG_dynarr.h"
 
-#define NUMVERTEXNORMALS 162
-#define SHADEDOT_QUANT 16
-
 static float r_avertexnormals[NUMVERTEXNORMALS][3] = {
 #include "../constants/anorms.h"
 };
@@ -63,6 +60,42 @@ DA_TYPEDEF(GLushort, UShortArray_t);
 static AliasVtxArray_t vtxBuf = {0};
 static UShortArray_t idxBuf = {0};
 
+/*
+ * Uploads the tables models are lit with and sets up
+ * the VAO for models lerped in the vertex shader.
+ */
+void
+GL3_InitMeshes(void)
+{
+	gl3UniAliasTables_t *tables = &gl3state.uniAliasTablesData;
+	float *dots = (float *)tables->shadedots;
+	int i, j;
+
+	for (i = 0; i < NUMVERTEXNORMALS; i++)
+	{
+		VectorCopy(r_avertexnormals[i], tables->normals[i].Elements);
+		tables->normals[i].W = 0.0f;
+	}
+
+	for (i = 0; i < SHADEDOT_QUANT; i++)
+	{
+		for (j = 0; j < NUMVERTEXNORMALS; j++)
+		{
+			dots[i * NUMVERTEXNORMALS + j] = r_avertexnormal_dots[i][j];
+		}
+	}
+
+	GL3_UpdateUBOAliasTables();
+
+	// the pointers are set for each model, as each one has its own VBO
+	glGenVertexArrays(1, &gl3state.vaoAliasLerp);
+	GL3_BindVAO(gl3state.vaoAliasLerp);
+
+	glEnableVertexAttribArray(GL3_ATTRIB_TEXCOORD);
+	glEnableVertexAttribArray(GL3_ATTRIB_FRAMEVERT);
+	glEnableVertexAttribArray(GL3_ATTRIB_OLDFRAMEVERT);
+}
+
 void
 GL3_ShutdownMeshes(void)
 {
@@ -70,6 +103,86 @@ GL3_ShutdownMeshes(void)
 	da_free(idxBuf);
 
 	da_free(shadowModels);
+
+	glDeleteVertexArrays(1, &gl3state.vaoAliasLerp);
+	gl3state.vaoAliasLerp = 0;
+}
+
+/*
+ * Uploads the baked data of a model: the texture
+ * coordinates followed by all frames into vboAlias,
+ * the indices into eboAlias. Models that couldn't
+ * be baked are lerped on the CPU instead.
+ */
+void
+GL3_UploadAliasModel(gl3model_t *mod)
+{
+	const dmdlbaked_t *baked = Mod_GetBakedMD2((const dmdl_t *)mod->extradata);
+	GLsizeiptr stSize, framesSize;
+
+	if (!baked->num_verts)
+	{
+		return;
+	}
+
+	stSize = baked->num_verts * 2 * sizeof(float);
+	framesSize = baked->num_frames * baked->num_verts * sizeof(dtrivertx_t);
+
+	// GL_COPY_WRITE_BUFFER doesn't change the VAO or VBO bindings
+	glGenBuffers(1, &mod->vboAlias);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mod->vboAlias);
+	glBufferData(GL_COPY_WRITE_BUFFER, stSize + framesSize, NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, 0, stSize,
+		(const byte *)baked + baked->ofs_st);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, stSize, framesSize,
+		(const byte *)baked + baked->ofs_frames);
+
+	glGenBuffers(1, &mod->eboAlias);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mod->eboAlias);
+	glBufferData(GL_COPY_WRITE_BUFFER, baked->num_indices * sizeof(GLushort),
+		(const byte *)baked + baked->ofs_indices, GL_STATIC_DRAW);
+}
+
+/*
+ * Streams the vertices and indices of a model and draws them.
+ * The indices are rebased to where the vertices ended up in
+ * the stream, so they're uploaded as GLuint.
+ */
+static void
+DrawAliasElements(const gl3_alias_vtx_t *verts, int numVerts,
+		const GLushort *indices, int numIndices)
+{
+	GLintptr vtxOffset, idxOffset;
+	GLuint *dst, base;
+	int i;
+
+	vtxOffset = GL3_StreamData(&gl3state.vtxStream, verts,
+		numVerts * sizeof(gl3_alias_vtx_t), sizeof(gl3_alias_vtx_t));
+
+	if (vtxOffset < 0)
+	{
+		return;
+	}
+
+	dst = GL3_StreamBegin(&gl3state.idxStream, numIndices * sizeof(GLuint),
+		sizeof(GLuint));
+
+	if (!dst)
+	{
+		return;
+	}
+
+	base = vtxOffset / sizeof(gl3_alias_vtx_t);
+
+	for (i = 0; i < numIndices; i++)
+	{
+		dst[i] = base + indices[i];
+	}
+
+	idxOffset = GL3_StreamEnd(&gl3state.idxStream);
+
+	GL3_BindVAO(gl3state.vaoAlias);
+	glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, (const void *)idxOffset);
 }
 
 static void
@@ -104,6 +217,62 @@ LerpVerts(qboolean powerUpEffect, int nverts, dtrivertx_t *v, dtrivertx_t *ov,
 	}
 }
 
+/*
+ * Draws the baked triangle list of a model, see
+ * dmdlbaked_t. All frames are in the models VBO,
+ * the vertex shader lerps between them. Only
+ * uniAlias is updated for each model.
+ */
+static void
+DrawBakedFrameLerp(const gl3model_t *model, const dmdlbaked_t *baked,
+		entity_t* entity, vec3_t shadelight, int shadedotsRow, float alpha,
+		qboolean colorOnly, float move[3], float frontv[3], float backv[3])
+{
+	gl3UniAlias_t *uni = &gl3state.uniAliasData;
+	GLintptr ofsFrames = baked->num_verts * 2 * sizeof(float);
+	GLsizeiptr frameSize = baked->num_verts * sizeof(dtrivertx_t);
+	int i;
+
+	if (colorOnly)
+	{
+		GL3_UseProgram(gl3state.si3DaliasLerpColor.shaderProgram);
+	}
+	else
+	{
+		GL3_UseProgram(gl3state.si3DaliasLerp.shaderProgram);
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		uni->move.Elements[i] = move[i];
+		uni->frontv.Elements[i] = frontv[i];
+		uni->backv.Elements[i] = backv[i];
+		uni->shadelight.Elements[i] = shadelight[i];
+	}
+
+	uni->shadelight.A = alpha;
+	uni->shadedotsRow = shadedotsRow;
+	// shells are flat colored and expanded along the normals
+	uni->shellScale = colorOnly ? POWERSUIT_SCALE : 0.0f;
+
+	GL3_UpdateUBOAlias();
+
+	GL3_BindVAO(gl3state.vaoAliasLerp);
+	GL3_BindVBO(model->vboAlias);
+
+	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 2*sizeof(float), 0);
+	qglVertexAttribIPointer(GL3_ATTRIB_FRAMEVERT, 4, GL_UNSIGNED_BYTE, sizeof(dtrivertx_t),
+		ofsFrames + entity->frame * frameSize);
+	qglVertexAttribIPointer(GL3_ATTRIB_OLDFRAMEVERT, 4, GL_UNSIGNED_BYTE, sizeof(dtrivertx_t),
+		ofsFrames + entity->oldframe * frameSize);
+
+	// the element buffer binding is part of the VAO
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model->eboAlias);
+	gl3state.currentEBO = model->eboAlias;
+
+	glDrawElements(GL_TRIANGLES, baked->num_indices, GL_UNSIGNED_SHORT, NULL);
+}
+
 /*
  * Interpolates between two frames and origins
  */
@@ -129,9 +298,10 @@ DrawAliasFrameLerp(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight)
 			(RF_SHELL_RED | RF_SHELL_GREEN | RF_SHELL_BLUE | RF_SHELL_DOUBLE |
 			 RF_SHELL_HALF_DAM));
 
-	// TODO: maybe we could somehow store the non-rotated normal and do the dot in shader?
-	float* shadedots = r_avertexnormal_dots[((int)(entity->angles[1] *
-				(SHADEDOT_QUANT / 360.0))) & (SHADEDOT_QUANT - 1)];
+	int shadedotsRow = ((int)(entity->angles[1] * (SHADEDOT_QUANT / 360.0))) &
+		(SHADEDOT_QUANT - 1);
+	float* shadedots = r_avertexnormal_dots[shadedotsRow];
+	gl3model_t *model = entity->model;
 
 	frame = (daliasframe_t *)((byte *)paliashdr + paliashdr->ofs_frames
 							  + entity->frame * paliashdr->framesize);
@@ -152,15 +322,6 @@ DrawAliasFrameLerp(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight)
 		alpha = 1.0;
 	}
 
-	if (colorOnly)
-	{
-		GL3_UseProgram(gl3state.si3DaliasColor.shaderProgram);
-	}
-	else
-	{
-		GL3_UseProgram(gl3state.si3Dalias.shaderProgram);
-	}
-
 	if(gl3_colorlight->value == 0.0f)
 	{
 		float avg = 0.333333f * (shadelight[0]+shadelight[1]+shadelight[2]);
@@ -185,6 +346,22 @@ DrawAliasFrameLerp(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight)
 		backv[i] = backlerp * oldframe->scale[i];
 	}
 
+	if (model->vboAlias)
+	{
+		DrawBakedFrameLerp(model, Mod_GetBakedMD2(paliashdr), entity, shadelight,
+				shadedotsRow, alpha, colorOnly, move, frontv, backv);
+		return;
+	}
+
+	if (colorOnly)
+	{
+		GL3_UseProgram(gl3state.si3DaliasColor.shaderProgram);
+	}
+	else
+	{
+		GL3_UseProgram(gl3state.si3Dalias.shaderProgram);
+	}
+
 	lerp = s_lerped[0];
 
 	LerpVerts(colorOnly, paliashdr->num_xyz, v, ov, verts, lerp, move, frontv, backv);
@@ -194,7 +371,7 @@ DrawAliasFrameLerp(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight)
 	// all the triangle fans and triangle strips of this model will be converted to
 	// just triangles: the vertices stay the same and are batched in vtxBuf,
 	// but idxBuf will contain indices to draw them all as GL_TRIANGLE
-	// this way there's only one draw call (and two glBufferData() calls)
+	// this way there's only one draw call for the whole model
 	// instead of (at least) dozens. *greatly* improves performance.
 
 	// so first clear out the data from last call to this function
@@ -316,13 +493,7 @@ DrawAliasFrameLerp(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight)
 		}
 	}
 
-	GL3_BindVAO(gl3state.vaoAlias);
-	GL3_BindVBO(gl3state.vboAlias);
-
-	glBufferData(GL_ARRAY_BUFFER, da_count(vtxBuf)*sizeof(gl3_alias_vtx_t), vtxBuf.p, GL_STREAM_DRAW);
-	GL3_BindEBO(gl3state.eboAlias);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, da_count(idxBuf)*sizeof(GLushort), idxBuf.p, GL_STREAM_DRAW);
-	glDrawElements(GL_TRIANGLES, da_count(idxBuf), GL_UNSIGNED_SHORT, NULL);
+	DrawAliasElements(vtxBuf.p, da_count(vtxBuf), idxBuf.p, da_count(idxBuf));
 }
 
 static void
@@ -477,13 +648,7 @@ DrawAliasShadow(gl3_shadowinfo_t* shadowInfo)
 		}
 	}
 
-	GL3_BindVAO(gl3state.vaoAlias);
-	GL3_BindVBO(gl3state.vboAlias);
-
-	glBufferData(GL_ARRAY_BUFFER, da_count(vtxBuf)*sizeof(gl3_alias_vtx_t), vtxBuf.p, GL_STREAM_DRAW);
-	GL3_BindEBO(gl3state.eboAlias);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, da_count(idxBuf)*sizeof(GLushort), idxBuf.p, GL_STREAM_DRAW);
-	glDrawElements(GL_TRIANGLES, da_count(idxBuf), GL_UNSIGNED_SHORT, NULL);
+	DrawAliasElements(vtxBuf.p, da_count(vtxBuf), idxBuf.p, da_count(idxBuf));
 }
 
 static qboolean
@@ -536,6 +536,8 @@ Mod_LoadBrushModel(gl3model_t *mod, void *buffer, int modfilelen)
 				__func__, mod->name, i, BSPVERSION);
 	}
 
+	mod->checksum = Com_BlockChecksum(buffer, modfilelen);
+
 	/* swap all the lumps */
 	mod_base = (byte *)header;
 
@@ -586,11 +588,19 @@ Mod_LoadBrushModel(gl3model_t *mod, void *buffer, int modfilelen)
 		&header->lumps[LUMP_NODES]);
 	Mod_LoadSubmodels (mod, mod_base, &header->lumps[LUMP_MODELS]);
 	mod->numframes = 2; /* regular and alternate animation */
+
+	GL3_SurfBuildWorldVBO(mod);
 }
 
 static void
 Mod_Free(gl3model_t *mod)
 {
+	if (mod->vboAlias)
+	{
+		glDeleteBuffers(1, &mod->vboAlias);
+		glDeleteBuffers(1, &mod->eboAlias);
+	}
+
 	Hunk_Free(mod->extradata);
 	memset(mod, 0, sizeof(*mod));
 }
@@ -607,6 +617,8 @@ GL3_Mod_FreeAll(void)
 			Mod_Free(&mod_known[i]);
 		}
 	}
+
+	Mod_FreeLightGrid();
 }
 
 /*
@@ -696,12 +708,14 @@ Mod_ForName (char *name, gl3model_t *parent_model, qboolean crash)
 				mod->extradata = Mod_LoadMD2(mod->name, buf, modfilelen,
 					mod->mins, mod->maxs,
 					(struct image_s **)mod->skins, (findimage_t)GL3_FindImage,
-					&(mod->type));
+					&(mod->type), true);
 				if (!mod->extradata)
 				{
 					ri.Sys_Error(ERR_DROP, "%s: Failed to load %s",
 						__func__, mod->name);
 				}
+
+				GL3_UploadAliasModel(mod);
 			};
 			break;
 
@@ -746,6 +760,7 @@ GL3_BeginRegistration(char *model)
 
 	registration_sequence++;
 	gl3_oldviewcluster = -1; /* force markleafs */
+	R_FreeVisCache();
 
 	gl3state.currentlightmap = -1;
 
@@ -763,6 +778,10 @@ GL3_BeginRegistration(char *model)
 
 	gl3_worldmodel = Mod_ForName(fullname, NULL, true);
 
+	Mod_LoadLightGrid(gl3_worldmodel->name, gl3_worldmodel->checksum,
+		gl3_worldmodel->nodes, gl3_worldmodel->submodels[0].mins,
+		gl3_worldmodel->submodels[0].maxs, GL3_SampleLight);
+
 	gl3_viewcluster = -1;
 }
 
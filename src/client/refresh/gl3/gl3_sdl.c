@@ -117,16 +117,12 @@ DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei le
  */
 void GL3_EndFrame(void)
 {
-	if(gl3config.useBigVBO)
-	{
-		// I think this is a good point to orphan the VBO and get a fresh one
-		GL3_BindVAO(gl3state.vao3D);
-		GL3_BindVBO(gl3state.vbo3D);
-		glBufferData(GL_ARRAY_BUFFER, gl3state.vbo3Dsize, NULL, GL_STREAM_DRAW);
-		gl3state.vbo3DcurOffset = 0;
-	}
+	GL3_Draw_Flush();
 
 	SDL_GL_SwapWindow(window);
+
+	GL3_StreamEndFrame();
+	GL3_Draw_EndFrame();
 }
 
 /*
@@ -392,6 +388,16 @@ int GL3_InitContext(void* win)
 	gl3config.debug_output = GLAD_GL_ARB_debug_output != 0;
 #endif
 	gl3config.anisotropic = GLAD_GL_EXT_texture_filter_anisotropic != 0;
+#ifdef YQ2_GL3_GLES
+	gl3config.buffer_storage = false;
+#else
+	gl3config.buffer_storage = GLAD_GL_ARB_buffer_storage != 0;
+#endif
+#ifdef YQ2_GL3_GLES
+	gl3config.program_binary = true; // core in GLES3
+#else
+	gl3config.program_binary = GLAD_GL_ARB_get_program_binary != 0;
+#endif
 
 	gl3config.major_version = GLVersion.major;
 	gl3config.minor_version = GLVersion.minor;
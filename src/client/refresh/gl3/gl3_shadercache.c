@@ -0,0 +1,460 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Shader program binary cache. Linked programs are saved with
+ * glGetProgramBinary() to a file in the game dir and loaded with
+ * glProgramBinary() the next time, instead of compiling them again.
+ * Each program is keyed by a checksum of its sources. The whole file
+ * is keyed by GL vendor, renderer and version, so a driver update
+ * throws it away. Programs the driver rejects are just compiled again
+ * and replace the stale binary.
+ *
+ * =======================================================================
+ */
+
+#include "header/local.h"
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#define SHADERCACHE_IDENT (('C' << 24) + ('S' << 16) + ('3' << 8) + 'Y')
+#define SHADERCACHE_VERSION 1 // bump when the attribute locations change
+
+// more than all variants of all programs
+#define MAX_CACHED_PROGRAMS 64
+
+#ifdef YQ2_GL3_GLES
+#define SHADERCACHE_NAME "gles3shaders.cache"
+#else
+#define SHADERCACHE_NAME "gl3shaders.cache"
+#endif
+
+typedef struct
+{
+	int ident;
+	int version;
+	unsigned gpukey; // checksum of GL vendor, renderer and version
+	int numprograms;
+} shadercacheheader_t;
+
+// in the file, each is followed by length bytes of binary
+typedef struct
+{
+	unsigned key; // checksum of the sources
+	GLenum format;
+	int length;
+	int msec; // how long compiling and linking took
+} shadercacheprogram_t;
+
+typedef struct
+{
+	shadercacheprogram_t info;
+	byte *binary;
+} cachedprogram_t;
+
+static qboolean active;
+static qboolean dirty;
+static unsigned gpukey;
+static cachedprogram_t programs[MAX_CACHED_PROGRAMS];
+static int numprograms;
+
+// for the log
+static int numhits, numlookups;
+static int savedmsec, loadmsec;
+static int compilestart;
+
+static void
+GetCachePath(char *path, size_t size)
+{
+	Com_sprintf(path, size, "%s/%s", ri.FS_Gamedir(), SHADERCACHE_NAME);
+}
+
+static void
+FreePrograms(void)
+{
+	int i;
+
+	for (i = 0; i < numprograms; i++)
+	{
+		free(programs[i].binary);
+	}
+
+	memset(programs, 0, sizeof(programs));
+	numprograms = 0;
+}
+
+static void
+RemoveProgram(int i)
+{
+	free(programs[i].binary);
+
+	numprograms--;
+	memmove(&programs[i], &programs[i + 1], (numprograms - i) * sizeof(cachedprogram_t));
+	memset(&programs[numprograms], 0, sizeof(cachedprogram_t));
+
+	dirty = true;
+}
+
+static unsigned
+GetGPUKey(void)
+{
+	char buf[1024];
+
+	Com_sprintf(buf, sizeof(buf), "%s\n%s\n%s", gl3config.vendor_string,
+		gl3config.renderer_string, gl3config.version_string);
+
+	return Com_BlockChecksum(buf, strlen(buf));
+}
+
+/*
+ * Reads the cache file, anything
+ * that doesn't look right is dropped.
+ */
+static void
+ReadCache(void)
+{
+	char path[MAX_OSPATH];
+	shadercacheheader_t header;
+	FILE *f;
+	int i;
+
+	GetCachePath(path, sizeof(path));
+
+	f = fopen(path, "rb");
+
+	if (!f)
+	{
+		return;
+	}
+
+	if ((fread(&header, sizeof(header), 1, f) != 1) ||
+		(header.ident != SHADERCACHE_IDENT) ||
+		(header.version != SHADERCACHE_VERSION) ||
+		(header.gpukey != gpukey) ||
+		(header.numprograms < 0) ||
+		(header.numprograms > MAX_CACHED_PROGRAMS))
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: %s is outdated, ignoring it\n", __func__, path);
+
+		fclose(f);
+		dirty = true;
+
+		return;
+	}
+
+	for (i = 0; i < header.numprograms; i++)
+	{
+		cachedprogram_t *prog = &programs[numprograms];
+
+		if ((fread(&prog->info, sizeof(prog->info), 1, f) != 1) ||
+			(prog->info.length <= 0) || (prog->info.length > 16 * 1024 * 1024))
+		{
+			break;
+		}
+
+		prog->binary = malloc(prog->info.length);
+
+		if (!prog->binary ||
+			(fread(prog->binary, 1, prog->info.length, f) != (size_t)prog->info.length))
+		{
+			free(prog->binary);
+			prog->binary = NULL;
+
+			break;
+		}
+
+		numprograms++;
+	}
+
+	if (numprograms != header.numprograms)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: %s is truncated\n", __func__, path);
+		dirty = true;
+	}
+
+	fclose(f);
+}
+
+static void
+WriteCache(void)
+{
+	char path[MAX_OSPATH];
+	shadercacheheader_t header;
+	qboolean ok;
+	FILE *f;
+	int i;
+
+	GetCachePath(path, sizeof(path));
+
+	f = fopen(path, "wb");
+
+	if (!f)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: Couldn't open %s for writing\n", __func__, path);
+		return;
+	}
+
+	header.ident = SHADERCACHE_IDENT;
+	header.version = SHADERCACHE_VERSION;
+	header.gpukey = gpukey;
+	header.numprograms = numprograms;
+
+	ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+
+	for (i = 0; ok && i < numprograms; i++)
+	{
+		ok = (fwrite(&programs[i].info, sizeof(programs[i].info), 1, f) == 1) &&
+			(fwrite(programs[i].binary, 1, programs[i].info.length, f) ==
+				(size_t)programs[i].info.length);
+	}
+
+	fclose(f);
+
+	if (!ok)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: Couldn't write %s\n", __func__, path);
+		remove(path);
+	}
+}
+
+/*
+ * Called before creating the shader programs.
+ */
+void
+GL3_ShaderCacheBegin(void)
+{
+	GLint numformats = 0;
+
+	active = dirty = false;
+	numhits = numlookups = 0;
+	savedmsec = loadmsec = 0;
+
+	FreePrograms();
+
+	if (!gl3config.program_binary || !gl3_shadercache->value)
+	{
+		return;
+	}
+
+	// some drivers support the extension but no format
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numformats);
+
+	if (numformats <= 0)
+	{
+		return;
+	}
+
+	active = true;
+	gpukey = GetGPUKey();
+
+	ReadCache();
+}
+
+/*
+ * Called after creating the shader programs. Writes
+ * the cache if anything changed and logs the savings.
+ */
+void
+GL3_ShaderCacheEnd(void)
+{
+	if (!active)
+	{
+		return;
+	}
+
+	if (dirty)
+	{
+		WriteCache();
+	}
+
+	if (numhits > 0)
+	{
+		R_Printf(PRINT_ALL, "Loaded %i of %i shader programs from cache in %i ms, saved %i ms.\n",
+			numhits, numlookups, loadmsec, savedmsec - loadmsec);
+	}
+
+	FreePrograms();
+
+	active = dirty = false;
+}
+
+/*
+ * Returns a checksum over all sources of a program.
+ */
+unsigned
+GL3_ShaderCacheKey(const char **sources, int numsources)
+{
+	size_t len = 0;
+	unsigned key;
+	char *buf;
+	int i;
+
+	for (i = 0; i < numsources; i++)
+	{
+		len += strlen(sources[i]) + 1;
+	}
+
+	buf = malloc(len);
+
+	if (!buf)
+	{
+		return 0;
+	}
+
+	len = 0;
+
+	for (i = 0; i < numsources; i++)
+	{
+		size_t srclen = strlen(sources[i]) + 1;
+
+		memcpy(buf + len, sources[i], srclen);
+		len += srclen;
+	}
+
+	key = Com_BlockChecksum(buf, len);
+	free(buf);
+
+	return key;
+}
+
+/*
+ * Returns the linked program for key from the cache, 0 if
+ * there is none or the driver rejected it. In that case the
+ * program must be compiled and passed to GL3_ShaderCacheStore().
+ */
+GLuint
+GL3_ShaderCacheLoad(unsigned key)
+{
+	GLuint prog;
+	GLint status;
+	int start, i;
+
+	if (!active)
+	{
+		return 0;
+	}
+
+	start = SDL_GetTicks();
+	numlookups++;
+
+	for (i = 0; i < numprograms; i++)
+	{
+		if (programs[i].info.key == key)
+		{
+			break;
+		}
+	}
+
+	if (i == numprograms)
+	{
+		compilestart = start;
+
+		return 0;
+	}
+
+	prog = glCreateProgram();
+
+	if (prog == 0)
+	{
+		compilestart = start;
+
+		return 0;
+	}
+
+	glProgramBinary(prog, programs[i].info.format, programs[i].binary,
+		programs[i].info.length);
+	glGetProgramiv(prog, GL_LINK_STATUS, &status);
+
+	if (status != GL_TRUE)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: Cached shader program %08x was rejected\n",
+			__func__, key);
+
+		glDeleteProgram(prog);
+		RemoveProgram(i);
+
+		compilestart = SDL_GetTicks();
+
+		return 0;
+	}
+
+	numhits++;
+	loadmsec += SDL_GetTicks() - start;
+	savedmsec += programs[i].info.msec;
+
+	return prog;
+}
+
+/*
+ * Saves a freshly linked program, the time since the
+ * GL3_ShaderCacheLoad() miss is taken as its compile time.
+ */
+void
+GL3_ShaderCacheStore(GLuint prog, unsigned key)
+{
+	cachedprogram_t *cached;
+	GLint length = 0;
+	GLsizei written = 0;
+
+	if (!active)
+	{
+		return;
+	}
+
+	glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+	{
+		return;
+	}
+
+	// make room by dropping the oldest one
+	if (numprograms == MAX_CACHED_PROGRAMS)
+	{
+		RemoveProgram(0);
+	}
+
+	cached = &programs[numprograms];
+	cached->binary = malloc(length);
+
+	if (!cached->binary)
+	{
+		return;
+	}
+
+	glGetProgramBinary(prog, length, &written, &cached->info.format, cached->binary);
+
+	if (written <= 0)
+	{
+		free(cached->binary);
+		cached->binary = NULL;
+
+		return;
+	}
+
+	cached->info.key = key;
+	cached->info.length = written;
+	cached->info.msec = SDL_GetTicks() - compilestart;
+
+	numprograms++;
+	dirty = true;
+}
@@ -30,18 +30,18 @@
 // TODO: remove eprintf() usage
 #define eprintf(...)  R_Printf(PRINT_ALL, __VA_ARGS__)
 
+#ifdef YQ2_GL3_GLES3
+static const char* shaderVersion = "#version 300 es\nprecision mediump float;\n";
+#else // Desktop GL
+static const char* shaderVersion = "#version 150\n";
+#endif
 
 static GLuint
 CompileShader(GLenum shaderType, const char* shaderSrc, const char* shaderSrc2)
 {
 	GLuint shader = glCreateShader(shaderType);
 
-#ifdef YQ2_GL3_GLES3
-	const char* version = "#version 300 es\nprecision mediump float;\n";
-#else // Desktop GL
-	const char* version = "#version 150\n";
-#endif
-	const char* sources[3] = { version, shaderSrc, shaderSrc2 };
+	const char* sources[3] = { shaderVersion, shaderSrc, shaderSrc2 };
 	int numSources = shaderSrc2 != NULL ? 3 : 2;
 
 	glShaderSource(shader, numSources, sources, NULL);
@@ -117,10 +117,19 @@ CreateShaderProgram(int numShaders, const GLuint* shaders)
 	glBindAttribLocation(shaderProgram, GL3_ATTRIB_COLOR, "vertColor");
 	glBindAttribLocation(shaderProgram, GL3_ATTRIB_NORMAL, "normal");
 	glBindAttribLocation(shaderProgram, GL3_ATTRIB_LIGHTFLAGS, "lightFlags");
+	glBindAttribLocation(shaderProgram, GL3_ATTRIB_LMSTYLES, "lmStyles");
+	glBindAttribLocation(shaderProgram, GL3_ATTRIB_FRAMEVERT, "frameVert");
+	glBindAttribLocation(shaderProgram, GL3_ATTRIB_OLDFRAMEVERT, "oldFrameVert");
 
 	// the following line is not necessary/implicit (as there's only one output)
 	// glBindFragDataLocation(shaderProgram, 0, "outColor"); XXX would this even be here?
 
+	if(gl3config.program_binary)
+	{
+		// so it can be put into the shader cache
+		glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
 	glLinkProgram(shaderProgram);
 
 	GLint status;
@@ -165,6 +174,48 @@ CreateShaderProgram(int numShaders, const GLuint* shaders)
 	return shaderProgram;
 }
 
+/*
+ * Loads the program made of the given vertex and fragment shader sources
+ * (vertSrc2 and fragSrc2 may be NULL) from the shader cache, or compiles
+ * and links it and puts it into the cache.
+ */
+static GLuint
+CreateProgram(const char* vertSrc, const char* vertSrc2, const char* fragSrc, const char* fragSrc2)
+{
+	GLuint shaders[2] = {0};
+	GLuint prog = 0;
+
+	const char* sources[5] = { shaderVersion, vertSrc, vertSrc2 ? vertSrc2 : "",
+	                           fragSrc, fragSrc2 ? fragSrc2 : "" };
+	unsigned key = GL3_ShaderCacheKey(sources, 5);
+
+	prog = GL3_ShaderCacheLoad(key);
+	if(prog != 0)  return prog;
+
+	shaders[0] = CompileShader(GL_VERTEX_SHADER, vertSrc, vertSrc2);
+	if(shaders[0] == 0)  return 0;
+
+	shaders[1] = CompileShader(GL_FRAGMENT_SHADER, fragSrc, fragSrc2);
+	if(shaders[1] == 0)
+	{
+		glDeleteShader(shaders[0]);
+		return 0;
+	}
+
+	prog = CreateShaderProgram(2, shaders);
+
+	// I think the shaders aren't needed anymore once they're linked into the program
+	glDeleteShader(shaders[0]);
+	glDeleteShader(shaders[1]);
+
+	if(prog != 0)
+	{
+		GL3_ShaderCacheStore(prog, key);
+	}
+
+	return prog;
+}
+
 #define MULTILINE_STRING(...) #__VA_ARGS__
 
 // ############## shaders for 2D rendering (HUD, menus, console, videos, ..) #####################
@@ -308,6 +359,7 @@ static const char* fragmentSrc2DpostprocessWater = MULTILINE_STRING(
 static const char* vertexSrc2Dcolor = MULTILINE_STRING(
 
 		in vec2 position; // GL3_ATTRIB_POSITION
+		in vec4 vertColor; // GL3_ATTRIB_COLOR
 
 		// for UBO shared between 2D shaders
 		layout (std140) uniform uni2D
@@ -315,9 +367,12 @@ static const char* vertexSrc2Dcolor = MULTILINE_STRING(
 			mat4 trans;
 		};
 
+		out vec4 passColor;
+
 		void main()
 		{
 			gl_Position = trans * vec4(position, 0.0, 1.0);
+			passColor = vertColor;
 		}
 );
 
@@ -333,13 +388,15 @@ static const char* fragmentSrc2Dcolor = MULTILINE_STRING(
 			vec4 color;
 		};
 
+		in vec4 passColor;
+
 		out vec4 outColor;
 
 		void main()
 		{
-			vec3 col = color.rgb * intensity2D;
+			vec3 col = passColor.rgb * intensity2D;
 			outColor.rgb = pow(col, vec3(gamma));
-			outColor.a = color.a;
+			outColor.a = passColor.a;
 		}
 );
 
@@ -368,8 +425,8 @@ static const char* vertexCommon3D = MULTILINE_STRING(
 			float overbrightbits;
 			float particleFadeFactor;
 			float lightScaleForTurb; // surfaces with SURF_DRAWTURB (water, lava) don't have lightmaps, use this instead
+			float particleSize;
 			float _pad_1; // AMDs legacy windows driver needs this, otherwise uni3D has wrong size
-			float _pad_2;
 		};
 );
 
@@ -400,8 +457,8 @@ static const char* fragmentCommon3D = MULTILINE_STRING(
 			float overbrightbits;
 			float particleFadeFactor;
 			float lightScaleForTurb; // surfaces with SURF_DRAWTURB (water, lava) don't have lightmaps, use this instead
+			float particleSize;
 			float _pad_1; // AMDs legacy windows driver needs this, otherwise uni3D has wrong size
-			float _pad_2;
 		};
 );
 
@@ -431,15 +488,30 @@ static const char* vertexSrc3Dlm = MULTILINE_STRING(
 
 		// it gets attributes and uniforms from vertexCommon3D
 
+		in uvec4 lmStyles; // GL3_ATTRIB_LMSTYLES
+
+		layout (std140) uniform uniLightstyles
+		{
+			vec4 lightstyles[256];
+		};
+
 		out vec2 passLMcoord;
 		out vec3 passWorldCoord;
 		out vec3 passNormal;
 		flat out uint passLightFlags;
+		flat out vec4 passLMscales[4];
 
 		void main()
 		{
 			passTexCoord = texCoord;
 			passLMcoord = lmTexCoord;
+
+			// the first lightmap is used even without a style
+			passLMscales[0] = (lmStyles.x == 255u) ? vec4(1.0) : lightstyles[lmStyles.x];
+			passLMscales[1] = lightstyles[lmStyles.y];
+			passLMscales[2] = lightstyles[lmStyles.z];
+			passLMscales[3] = lightstyles[lmStyles.w];
+
 			vec4 worldCoord = transModel * vec4(position, 1.0);
 			passWorldCoord = worldCoord.xyz;
 			vec4 worldNormal = transModel * vec4(normal, 0.0f);
@@ -454,15 +526,30 @@ static const char* vertexSrc3DlmFlow = MULTILINE_STRING(
 
 		// it gets attributes and uniforms from vertexCommon3D
 
+		in uvec4 lmStyles; // GL3_ATTRIB_LMSTYLES
+
+		layout (std140) uniform uniLightstyles
+		{
+			vec4 lightstyles[256];
+		};
+
 		out vec2 passLMcoord;
 		out vec3 passWorldCoord;
 		out vec3 passNormal;
 		flat out uint passLightFlags;
+		flat out vec4 passLMscales[4];
 
 		void main()
 		{
 			passTexCoord = texCoord + vec2(scroll, 0.0);
 			passLMcoord = lmTexCoord;
+
+			// the first lightmap is used even without a style
+			passLMscales[0] = (lmStyles.x == 255u) ? vec4(1.0) : lightstyles[lmStyles.x];
+			passLMscales[1] = lightstyles[lmStyles.y];
+			passLMscales[2] = lightstyles[lmStyles.z];
+			passLMscales[3] = lightstyles[lmStyles.w];
+
 			vec4 worldCoord = transModel * vec4(position, 1.0);
 			passWorldCoord = worldCoord.xyz;
 			vec4 worldNormal = transModel * vec4(normal, 0.0f);
@@ -540,7 +627,7 @@ static const char* fragmentSrc3Dlm = MULTILINE_STRING(
 		uniform sampler2D lightmap2;
 		uniform sampler2D lightmap3;
 
-		uniform vec4 lmScales[4];
+		flat in vec4 passLMscales[4];
 
 		in vec2 passLMcoord;
 		in vec3 passWorldCoord;
@@ -555,10 +642,10 @@ static const char* fragmentSrc3Dlm = MULTILINE_STRING(
 			texel.rgb *= intensity;
 
 			// apply lightmap
-			vec4 lmTex = texture(lightmap0, passLMcoord) * lmScales[0];
-			lmTex     += texture(lightmap1, passLMcoord) * lmScales[1];
-			lmTex     += texture(lightmap2, passLMcoord) * lmScales[2];
-			lmTex     += texture(lightmap3, passLMcoord) * lmScales[3];
+			vec4 lmTex = texture(lightmap0, passLMcoord) * passLMscales[0];
+			lmTex     += texture(lightmap1, passLMcoord) * passLMscales[1];
+			lmTex     += texture(lightmap2, passLMcoord) * passLMscales[2];
+			lmTex     += texture(lightmap3, passLMcoord) * passLMscales[3];
 
 			if(passLightFlags != 0u)
 			{
@@ -627,7 +714,7 @@ static const char* fragmentSrc3DlmNoColor = MULTILINE_STRING(
 		uniform sampler2D lightmap2;
 		uniform sampler2D lightmap3;
 
-		uniform vec4 lmScales[4];
+		flat in vec4 passLMscales[4];
 
 		in vec2 passLMcoord;
 		in vec3 passWorldCoord;
@@ -642,10 +729,10 @@ static const char* fragmentSrc3DlmNoColor = MULTILINE_STRING(
 			texel.rgb *= intensity;
 
 			// apply lightmap
-			vec4 lmTex = texture(lightmap0, passLMcoord) * lmScales[0];
-			lmTex     += texture(lightmap1, passLMcoord) * lmScales[1];
-			lmTex     += texture(lightmap2, passLMcoord) * lmScales[2];
-			lmTex     += texture(lightmap3, passLMcoord) * lmScales[3];
+			vec4 lmTex = texture(lightmap0, passLMcoord) * passLMscales[0];
+			lmTex     += texture(lightmap1, passLMcoord) * passLMscales[1];
+			lmTex     += texture(lightmap2, passLMcoord) * passLMscales[2];
+			lmTex     += texture(lightmap3, passLMcoord) * passLMscales[3];
 
 			if(passLightFlags != 0u)
 			{
@@ -786,6 +873,56 @@ static const char* vertexSrcAlias = MULTILINE_STRING(
 		}
 );
 
+static const char* vertexSrcAliasLerp = MULTILINE_STRING(
+
+		// it gets attributes and uniforms from vertexCommon3D,
+		// but position and vertColor are calculated from the frames
+
+		in uvec4 frameVert;    // GL3_ATTRIB_FRAMEVERT
+		in uvec4 oldFrameVert; // GL3_ATTRIB_OLDFRAMEVERT
+
+		layout (std140) uniform uniAlias
+		{
+			vec4 move;
+			vec4 frontv;
+			vec4 backv;
+			vec4 shadelight; // a is alpha
+			int shadedotsRow;
+			float shellScale;
+			float _pad_a1;
+			float _pad_a2;
+		};
+
+		layout (std140) uniform uniAliasTables
+		{
+			vec4 normals[162];
+			vec4 shadedots[648]; // 16 rows of 162, 4 per vec4
+		};
+
+		out vec4 passColor;
+
+		void main()
+		{
+			int normalIndex = min(int(frameVert.w), 161);
+
+			vec3 pos = move.xyz + vec3(oldFrameVert.xyz) * backv.xyz
+			           + vec3(frameVert.xyz) * frontv.xyz
+			           + normals[normalIndex].xyz * shellScale;
+
+			// shells are flat colored
+			float l = 1.0;
+			if(shellScale == 0.0)
+			{
+				int i = shadedotsRow * 162 + normalIndex;
+				l = shadedots[i / 4][i % 4];
+			}
+
+			passColor = vec4(shadelight.rgb * l, shadelight.a) * overbrightbits;
+			passTexCoord = texCoord;
+			gl_Position = transProjView * transModel * vec4(pos, 1.0);
+		}
+);
+
 static const char* fragmentSrcAlias = MULTILINE_STRING(
 
 		// it gets attributes and uniforms from fragmentCommon3D
@@ -837,10 +974,10 @@ static const char* vertexSrcParticles = MULTILINE_STRING(
 			passColor = vertColor;
 			gl_Position = transProjView * transModel * vec4(position, 1.0);
 
-			// abusing texCoord for pointSize, pointDist for particles
-			float pointDist = texCoord.y*0.1; // with factor 0.1 it looks good.
+			// w is the distance from the camera along the view direction
+			float pointDist = max(gl_Position.w, 1.0)*0.1; // with factor 0.1 it looks good.
 
-			gl_PointSize = texCoord.x/pointDist;
+			gl_PointSize = particleSize/pointDist;
 		}
 );
 
@@ -894,13 +1031,15 @@ enum {
 	GL3_BINDINGPOINT_UNICOMMON,
 	GL3_BINDINGPOINT_UNI2D,
 	GL3_BINDINGPOINT_UNI3D,
-	GL3_BINDINGPOINT_UNILIGHTS
+	GL3_BINDINGPOINT_UNILIGHTS,
+	GL3_BINDINGPOINT_UNILIGHTSTYLES,
+	GL3_BINDINGPOINT_UNIALIAS,
+	GL3_BINDINGPOINT_UNIALIASTABLES
 };
 
 static qboolean
 initShader2D(gl3ShaderInfo_t* shaderInfo, const char* vertSrc, const char* fragSrc)
 {
-	GLuint shaders2D[2] = {0};
 	GLuint prog = 0;
 
 	if(shaderInfo->shaderProgram != 0)
@@ -914,21 +1053,7 @@ initShader2D(gl3ShaderInfo_t* shaderInfo, const char* vertSrc, const char* fragS
 	shaderInfo->uniLmScalesOrTime = -1;
 	shaderInfo->uniVblend = -1;
 
-	shaders2D[0] = CompileShader(GL_VERTEX_SHADER, vertSrc, NULL);
-	if(shaders2D[0] == 0)  return false;
-
-	shaders2D[1] = CompileShader(GL_FRAGMENT_SHADER, fragSrc, NULL);
-	if(shaders2D[1] == 0)
-	{
-		glDeleteShader(shaders2D[0]);
-		return false;
-	}
-
-	prog = CreateShaderProgram(2, shaders2D);
-
-	// I think the shaders aren't needed anymore once they're linked into the program
-	glDeleteShader(shaders2D[0]);
-	glDeleteShader(shaders2D[1]);
+	prog = CreateProgram(vertSrc, NULL, fragSrc, NULL);
 
 	if(prog == 0)
 	{
@@ -1003,7 +1128,6 @@ err_cleanup:
 static qboolean
 initShader3D(gl3ShaderInfo_t* shaderInfo, const char* vertSrc, const char* fragSrc)
 {
-	GLuint shaders3D[2] = {0};
 	GLuint prog = 0;
 	int i=0;
 
@@ -1017,21 +1141,11 @@ initShader3D(gl3ShaderInfo_t* shaderInfo, const char* vertSrc, const char* fragS
 	shaderInfo->uniLmScalesOrTime = -1;
 	shaderInfo->uniVblend = -1;
 
-	shaders3D[0] = CompileShader(GL_VERTEX_SHADER, vertexCommon3D, vertSrc);
-	if(shaders3D[0] == 0)  return false;
-
-	shaders3D[1] = CompileShader(GL_FRAGMENT_SHADER, fragmentCommon3D, fragSrc);
-	if(shaders3D[1] == 0)
-	{
-		glDeleteShader(shaders3D[0]);
-		return false;
-	}
-
-	prog = CreateShaderProgram(2, shaders3D);
+	prog = CreateProgram(vertexCommon3D, vertSrc, fragmentCommon3D, fragSrc);
 
 	if(prog == 0)
 	{
-		goto err_cleanup;
+		return false;
 	}
 
 	GL3_UseProgram(prog);
@@ -1094,6 +1208,53 @@ initShader3D(gl3ShaderInfo_t* shaderInfo, const char* vertSrc, const char* fragS
 		glUniformBlockBinding(prog, blockIndex, GL3_BINDINGPOINT_UNILIGHTS);
 	}
 	// else: as uniLights is only used in the LM shaders, it's ok if it's missing
+	blockIndex = glGetUniformBlockIndex(prog, "uniLightstyles");
+	if(blockIndex != GL_INVALID_INDEX)
+	{
+		GLint blockSize;
+		glGetActiveUniformBlockiv(prog, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+		if(blockSize != sizeof(gl3state.uniLightstylesData))
+		{
+			R_Printf(PRINT_ALL, "WARNING: OpenGL driver disagrees with us about UBO size of 'uniLightstyles'\n");
+			R_Printf(PRINT_ALL, "         OpenGL says %d, we say %d\n", blockSize, (int)sizeof(gl3state.uniLightstylesData));
+
+			goto err_cleanup;
+		}
+
+		glUniformBlockBinding(prog, blockIndex, GL3_BINDINGPOINT_UNILIGHTSTYLES);
+	}
+	// same for uniLightstyles
+	blockIndex = glGetUniformBlockIndex(prog, "uniAlias");
+	if(blockIndex != GL_INVALID_INDEX)
+	{
+		GLint blockSize;
+		glGetActiveUniformBlockiv(prog, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+		if(blockSize != sizeof(gl3state.uniAliasData))
+		{
+			R_Printf(PRINT_ALL, "WARNING: OpenGL driver disagrees with us about UBO size of 'uniAlias'\n");
+			R_Printf(PRINT_ALL, "         OpenGL says %d, we say %d\n", blockSize, (int)sizeof(gl3state.uniAliasData));
+
+			goto err_cleanup;
+		}
+
+		glUniformBlockBinding(prog, blockIndex, GL3_BINDINGPOINT_UNIALIAS);
+	}
+	blockIndex = glGetUniformBlockIndex(prog, "uniAliasTables");
+	if(blockIndex != GL_INVALID_INDEX)
+	{
+		GLint blockSize;
+		glGetActiveUniformBlockiv(prog, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+		if(blockSize != sizeof(gl3state.uniAliasTablesData))
+		{
+			R_Printf(PRINT_ALL, "WARNING: OpenGL driver disagrees with us about UBO size of 'uniAliasTables'\n");
+			R_Printf(PRINT_ALL, "         OpenGL says %d, we say %d\n", blockSize, (int)sizeof(gl3state.uniAliasTablesData));
+
+			goto err_cleanup;
+		}
+
+		glUniformBlockBinding(prog, blockIndex, GL3_BINDINGPOINT_UNIALIASTABLES);
+	}
+	// and for uniAlias and uniAliasTables, only used by the model shaders
 
 	// make sure texture is GL_TEXTURE0
 	GLint texLoc = glGetUniformLocation(prog, "tex");
@@ -1114,31 +1275,13 @@ initShader3D(gl3ShaderInfo_t* shaderInfo, const char* vertSrc, const char* fragS
 		}
 	}
 
-	GLint lmScalesLoc = glGetUniformLocation(prog, "lmScales");
-	shaderInfo->uniLmScalesOrTime = lmScalesLoc;
-	if(lmScalesLoc != -1)
-	{
-		shaderInfo->lmScales[0] = HMM_Vec4(1.0f, 1.0f, 1.0f, 1.0f);
-
-		for(i=1; i<4; ++i)  shaderInfo->lmScales[i] = HMM_Vec4(0.0f, 0.0f, 0.0f, 0.0f);
-
-		glUniform4fv(lmScalesLoc, 4, shaderInfo->lmScales[0].Elements);
-	}
-
 	shaderInfo->shaderProgram = prog;
 
-	// I think the shaders aren't needed anymore once they're linked into the program
-	glDeleteShader(shaders3D[0]);
-	glDeleteShader(shaders3D[1]);
-
 	return true;
 
 err_cleanup:
 
-	glDeleteShader(shaders3D[0]);
-	glDeleteShader(shaders3D[1]);
-
-	if(prog != 0)  glDeleteProgram(prog);
+	glDeleteProgram(prog);
 
 	return false;
 }
@@ -1184,10 +1327,26 @@ static void initUBOs(void)
 	glBindBufferBase(GL_UNIFORM_BUFFER, GL3_BINDINGPOINT_UNILIGHTS, gl3state.uniLightsUBO);
 	glBufferData(GL_UNIFORM_BUFFER, sizeof(gl3state.uniLightsData), &gl3state.uniLightsData, GL_DYNAMIC_DRAW);
 
-	gl3state.currentUBO = gl3state.uniLightsUBO;
+	glGenBuffers(1, &gl3state.uniLightstylesUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, gl3state.uniLightstylesUBO);
+	glBindBufferBase(GL_UNIFORM_BUFFER, GL3_BINDINGPOINT_UNILIGHTSTYLES, gl3state.uniLightstylesUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(gl3state.uniLightstylesData), &gl3state.uniLightstylesData, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &gl3state.uniAliasUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, gl3state.uniAliasUBO);
+	glBindBufferBase(GL_UNIFORM_BUFFER, GL3_BINDINGPOINT_UNIALIAS, gl3state.uniAliasUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(gl3state.uniAliasData), &gl3state.uniAliasData, GL_DYNAMIC_DRAW);
+
+	// the tables are filled in GL3_InitMeshes()
+	glGenBuffers(1, &gl3state.uniAliasTablesUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, gl3state.uniAliasTablesUBO);
+	glBindBufferBase(GL_UNIFORM_BUFFER, GL3_BINDINGPOINT_UNIALIASTABLES, gl3state.uniAliasTablesUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(gl3state.uniAliasTablesData), &gl3state.uniAliasTablesData, GL_STATIC_DRAW);
+
+	gl3state.currentUBO = gl3state.uniAliasTablesUBO;
 }
 
-static qboolean createShaders(void)
+static qboolean createShaderPrograms(void)
 {
 	if(!initShader2D(&gl3state.si2D, vertexSrc2D, fragmentSrc2D))
 	{
@@ -1276,6 +1435,16 @@ static qboolean createShaders(void)
 		R_Printf(PRINT_ALL, "WARNING: Failed to create shader program for rendering flat-colored models!\n");
 		return false;
 	}
+	if(!initShader3D(&gl3state.si3DaliasLerp, vertexSrcAliasLerp, fragmentSrcAlias))
+	{
+		R_Printf(PRINT_ALL, "WARNING: Failed to create shader program for rendering textured lerped models!\n");
+		return false;
+	}
+	if(!initShader3D(&gl3state.si3DaliasLerpColor, vertexSrcAliasLerp, fragmentSrcAliasColor))
+	{
+		R_Printf(PRINT_ALL, "WARNING: Failed to create shader program for rendering flat-colored lerped models!\n");
+		return false;
+	}
 
 	const char* particleFrag = fragmentSrcParticles;
 	if(gl3_particle_square->value != 0.0f)
@@ -1294,6 +1463,17 @@ static qboolean createShaders(void)
 	return true;
 }
 
+static qboolean createShaders(void)
+{
+	qboolean ret;
+
+	GL3_ShaderCacheBegin();
+	ret = createShaderPrograms();
+	GL3_ShaderCacheEnd();
+
+	return ret;
+}
+
 qboolean GL3_InitShaders(void)
 {
 	initUBOs();
@@ -1315,10 +1495,11 @@ void GL3_ShutdownShaders(void)
 {
 	deleteShaders();
 
-	// let's (ab)use the fact that all 4 UBO handles are consecutive fields
+	// let's (ab)use the fact that all 7 UBO handles are consecutive fields
 	// of the gl3state struct
-	glDeleteBuffers(4, &gl3state.uniCommonUBO);
+	glDeleteBuffers(7, &gl3state.uniCommonUBO);
 	gl3state.uniCommonUBO = gl3state.uni2DUBO = gl3state.uni3DUBO = gl3state.uniLightsUBO = 0;
+	gl3state.uniLightstylesUBO = gl3state.uniAliasUBO = gl3state.uniAliasTablesUBO = 0;
 }
 
 qboolean GL3_RecreateShaders(void)
@@ -1394,3 +1575,18 @@ void GL3_UpdateUBOLights(void)
 {
 	updateUBO(gl3state.uniLightsUBO, sizeof(gl3state.uniLightsData), &gl3state.uniLightsData);
 }
+
+void GL3_UpdateUBOLightstyles(void)
+{
+	updateUBO(gl3state.uniLightstylesUBO, sizeof(gl3state.uniLightstylesData), &gl3state.uniLightstylesData);
+}
+
+void GL3_UpdateUBOAlias(void)
+{
+	updateUBO(gl3state.uniAliasUBO, sizeof(gl3state.uniAliasData), &gl3state.uniAliasData);
+}
+
+void GL3_UpdateUBOAliasTables(void)
+{
+	updateUBO(gl3state.uniAliasTablesUBO, sizeof(gl3state.uniAliasTablesData), &gl3state.uniAliasTablesData);
+}
@@ -0,0 +1,272 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Streaming of dynamic geometry. Everything that's generated on the CPU
+ * each frame (2D quads, particles, alias models, warped and flowing
+ * surfaces, ...) is written into one of two ring buffers instead of
+ * calling glBufferData() for each draw. Each ring is split into
+ * GL3_STREAM_SECTIONS sections. When writing moves on to the next
+ * section, a fence is set for the one just finished, and the fence of
+ * the next section is waited on. This way, data the GPU still reads
+ * is never overwritten.
+ *
+ * With GL_ARB_buffer_storage, the rings are mapped once, persistently
+ * and coherently, and written to directly. Without it (or with
+ * gl3_bufferstorage 0, and always on GLES3), each range is mapped
+ * unsynchronized. The fences make that safe, too.
+ *
+ * =======================================================================
+ */
+
+#include "header/local.h"
+
+// big enough for the biggest alias model or all particles of a frame
+#define VTX_STREAM_SIZE (8*1024*1024)
+#define IDX_STREAM_SIZE (1024*1024)
+
+static void
+CreateStream(gl3stream_t *stream, GLsizeiptr size, qboolean persistent)
+{
+	memset(stream, 0, sizeof(*stream));
+
+	stream->size = size;
+	stream->sectionSize = size / GL3_STREAM_SECTIONS;
+
+	glGenBuffers(1, &stream->buffer);
+	// GL_COPY_WRITE_BUFFER doesn't affect the VAOs or the bound VBO
+	glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+
+#ifndef YQ2_GL3_GLES
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+		stream->mapped = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+
+		if (stream->mapped)
+		{
+			return;
+		}
+
+		// buffer storage is immutable, start over with a fresh one
+		R_Printf(PRINT_ALL, "%s: Couldn't map stream buffer persistently\n", __func__);
+
+		glDeleteBuffers(1, &stream->buffer);
+		glGenBuffers(1, &stream->buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+	}
+#endif
+
+	glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+}
+
+static void
+DestroyStream(gl3stream_t *stream)
+{
+	int i;
+
+	for (i = 0; i < GL3_STREAM_SECTIONS; i++)
+	{
+		if (stream->fences[i])
+		{
+			glDeleteSync(stream->fences[i]);
+		}
+	}
+
+	if (stream->mapped)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+
+	glDeleteBuffers(1, &stream->buffer);
+
+	memset(stream, 0, sizeof(*stream));
+}
+
+void
+GL3_StreamInit(void)
+{
+	qboolean persistent;
+
+	persistent = gl3config.buffer_storage && gl3_bufferstorage->value;
+
+	CreateStream(&gl3state.vtxStream, VTX_STREAM_SIZE, persistent);
+	CreateStream(&gl3state.idxStream, IDX_STREAM_SIZE, persistent);
+
+	gl3state.streamBytes = gl3state.streamWaits = 0;
+	gl3state.lastStreamBytes = gl3state.lastStreamWaits = 0;
+
+	R_Printf(PRINT_ALL, "Streaming dynamic geometry with %s buffers\n",
+		gl3state.vtxStream.mapped ? "persistently mapped" : "unsynchronized mapped");
+}
+
+void
+GL3_StreamShutdown(void)
+{
+	DestroyStream(&gl3state.vtxStream);
+	DestroyStream(&gl3state.idxStream);
+}
+
+/*
+ * Called once per frame, after swapping
+ * buffers. Only updates the counters.
+ */
+void
+GL3_StreamEndFrame(void)
+{
+	gl3state.lastStreamBytes = gl3state.streamBytes;
+	gl3state.lastStreamWaits = gl3state.streamWaits;
+	gl3state.streamBytes = gl3state.streamWaits = 0;
+}
+
+/*
+ * Fences the section that was written until now
+ * and waits until the GPU is done with the next one.
+ */
+static void
+EnterSection(gl3stream_t *stream, int section)
+{
+	GLsync fence;
+
+	if (stream->fences[stream->section])
+	{
+		glDeleteSync(stream->fences[stream->section]);
+	}
+
+	stream->fences[stream->section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stream->section = section;
+
+	fence = stream->fences[section];
+
+	if (!fence)
+	{
+		return;
+	}
+
+	if (glClientWaitSync(fence, 0, 0) != GL_ALREADY_SIGNALED)
+	{
+		GLenum ret;
+
+		gl3state.streamWaits++;
+
+		do
+		{
+			// 1ms, flushing so the fence can signal at all
+			ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		while (ret == GL_TIMEOUT_EXPIRED);
+	}
+
+	glDeleteSync(fence);
+	stream->fences[section] = 0;
+}
+
+/*
+ * Reserves size bytes in the stream, starting at a multiple of align
+ * (usually the vertex size, so the data can be drawn with glDrawArrays()
+ * starting at offset/align). Returns where to write the data, which
+ * must be followed by GL3_StreamEnd() before any other GL call.
+ * Returns NULL if the data doesn't fit.
+ */
+void *
+GL3_StreamBegin(gl3stream_t *stream, GLsizeiptr size, GLsizeiptr align)
+{
+	GLsizeiptr offset;
+	int section;
+
+	if (size <= 0 || size + align > stream->sectionSize)
+	{
+		if (size > 0)
+		{
+			R_Printf(PRINT_DEVELOPER, "%s: %d bytes don't fit into the stream\n",
+				__func__, (int)size);
+		}
+
+		return NULL;
+	}
+
+	offset = ((stream->offset + align - 1) / align) * align;
+	section = stream->section;
+
+	// data doesn't go across sections, skip to the next one
+	if (offset + size > (section + 1) * stream->sectionSize)
+	{
+		section = (section + 1) % GL3_STREAM_SECTIONS;
+		offset = section * stream->sectionSize;
+		offset = ((offset + align - 1) / align) * align;
+	}
+
+	if (section != stream->section)
+	{
+		EnterSection(stream, section);
+	}
+
+	stream->pendingOffset = offset;
+	stream->pendingSize = size;
+	stream->offset = offset + size;
+
+	gl3state.streamBytes += size;
+
+	if (stream->mapped)
+	{
+		return stream->mapped + offset;
+	}
+
+	// the fences make sure the GPU isn't using this range
+	glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+
+	return glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+/*
+ * Finishes writing the data reserved by GL3_StreamBegin(),
+ * returns its offset in bytes in the stream buffer.
+ */
+GLintptr
+GL3_StreamEnd(gl3stream_t *stream)
+{
+	if (!stream->mapped)
+	{
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+
+	return stream->pendingOffset;
+}
+
+/*
+ * Copies data into the stream, returns its offset
+ * in bytes or -1 if it couldn't be streamed.
+ */
+GLintptr
+GL3_StreamData(gl3stream_t *stream, const void *data, GLsizeiptr size, GLsizeiptr align)
+{
+	void *dst = GL3_StreamBegin(stream, size, align);
+
+	if (!dst)
+	{
+		return -1;
+	}
+
+	memcpy(dst, data, size);
+
+	return GL3_StreamEnd(stream);
+}
@@ -29,6 +29,7 @@
 #include <stddef.h> // ofsetof()
 
 #include "header/local.h"
+#include "header/DG_dynarr.h"
 
 int c_visible_lightmaps;
 int c_visible_textures;
@@ -42,6 +43,29 @@ gl3lightmapstate_t gl3_lms;
 extern gl3image_t gl3textures[MAX_GL3TEXTURES];
 extern int numgl3textures;
 
+typedef struct
+{
+	GLuint texnum;
+	int lightmap;
+	qboolean flowing; // si3DlmFlow instead of si3Dlm
+	int firstIndex;
+	int numIndexes;
+} gl3worldbatch_t;
+
+DA_TYPEDEF(gl3worldbatch_t, WorldBatchArray_t);
+DA_TYPEDEF(GLuint, UIntArray_t);
+
+// visible lightmapped surfaces are gathered into batches with the same
+// texture, lightmap and shader. the indices of all batches go into one
+// buffer and each batch is drawn with a single glDrawElements()
+static WorldBatchArray_t worldBatches = {0};
+static UIntArray_t worldIndexes = {0};
+
+// copy of gl3state.vboWorldFlags and the range of it that changed
+static GLuint *worldLightFlags;
+static int numWorldVerts;
+static int worldFlagsMin, worldFlagsMax;
+
 void GL3_SurfInit(void)
 {
 	// init the VAO and VBO for the standard vertexdata: 10 floats and 1 uint
@@ -50,15 +74,8 @@ void GL3_SurfInit(void)
 	glGenVertexArrays(1, &gl3state.vao3D);
 	GL3_BindVAO(gl3state.vao3D);
 
-	glGenBuffers(1, &gl3state.vbo3D);
-	GL3_BindVBO(gl3state.vbo3D);
-
-	if(gl3config.useBigVBO)
-	{
-		gl3state.vbo3Dsize = 5*1024*1024; // a 5MB buffer seems to work well?
-		gl3state.vbo3DcurOffset = 0;
-		glBufferData(GL_ARRAY_BUFFER, gl3state.vbo3Dsize, NULL, GL_STREAM_DRAW); // allocate/reserve that data
-	}
+	// the vertices are streamed, see GL3_BufferAndDraw3D()
+	GL3_BindVBO(gl3state.vtxStream.buffer);
 
 	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
 	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), 0);
@@ -83,8 +100,7 @@ void GL3_SurfInit(void)
 	glGenVertexArrays(1, &gl3state.vaoAlias);
 	GL3_BindVAO(gl3state.vaoAlias);
 
-	glGenBuffers(1, &gl3state.vboAlias);
-	GL3_BindVBO(gl3state.vboAlias);
+	GL3_BindVBO(gl3state.vtxStream.buffer);
 
 	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
 	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 9*sizeof(GLfloat), 0);
@@ -95,7 +111,9 @@ void GL3_SurfInit(void)
 	glEnableVertexAttribArray(GL3_ATTRIB_COLOR);
 	qglVertexAttribPointer(GL3_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, 9*sizeof(GLfloat), 5*sizeof(GLfloat));
 
-	glGenBuffers(1, &gl3state.eboAlias);
+	// the element buffer binding is part of the VAO
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl3state.idxStream.buffer);
+	gl3state.currentEBO = gl3state.idxStream.buffer;
 
 	// init VAO and VBO for particle vertexdata: 9 floats
 	// (X,Y,Z), (point_size,distace_to_camera), (R,G,B,A)
@@ -103,64 +121,352 @@ void GL3_SurfInit(void)
 	glGenVertexArrays(1, &gl3state.vaoParticle);
 	GL3_BindVAO(gl3state.vaoParticle);
 
-	glGenBuffers(1, &gl3state.vboParticle);
-	GL3_BindVBO(gl3state.vboParticle);
+	GL3_BindVBO(gl3state.vtxStream.buffer);
 
+	// one gl3_particle_vtx_t per particle, the size is calculated in the vertex shader
 	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
-	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 9*sizeof(GLfloat), 0);
-
-	// TODO: maybe move point size and camera origin to UBO and calculate distance in vertex shader
-	glEnableVertexAttribArray(GL3_ATTRIB_TEXCOORD); // it's abused for (point_size, distance) here..
-	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 9*sizeof(GLfloat), 3*sizeof(GLfloat));
+	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_particle_vtx_t), 0);
 
 	glEnableVertexAttribArray(GL3_ATTRIB_COLOR);
-	qglVertexAttribPointer(GL3_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, 9*sizeof(GLfloat), 5*sizeof(GLfloat));
+	qglVertexAttribPointer(GL3_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(gl3_particle_vtx_t), offsetof(gl3_particle_vtx_t, color));
+
+	// init VAO and VBOs for the static world geometry, see gl3_world_vtx_t.
+	// the light flags come from their own VBO, as they change every frame
+
+	glGenVertexArrays(1, &gl3state.vaoWorld);
+	GL3_BindVAO(gl3state.vaoWorld);
+
+	glGenBuffers(1, &gl3state.vboWorld);
+	GL3_BindVBO(gl3state.vboWorld);
+
+	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
+	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_world_vtx_t), 0);
+
+	glEnableVertexAttribArray(GL3_ATTRIB_TEXCOORD);
+	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(gl3_world_vtx_t), offsetof(gl3_world_vtx_t, texCoord));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_LMTEXCOORD);
+	qglVertexAttribPointer(GL3_ATTRIB_LMTEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(gl3_world_vtx_t), offsetof(gl3_world_vtx_t, lmTexCoord));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_NORMAL);
+	qglVertexAttribPointer(GL3_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_world_vtx_t), offsetof(gl3_world_vtx_t, normal));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_LMSTYLES);
+	qglVertexAttribIPointer(GL3_ATTRIB_LMSTYLES, 4, GL_UNSIGNED_BYTE, sizeof(gl3_world_vtx_t), offsetof(gl3_world_vtx_t, lmStyles));
+
+	glGenBuffers(1, &gl3state.vboWorldFlags);
+	GL3_BindVBO(gl3state.vboWorldFlags);
+
+	glEnableVertexAttribArray(GL3_ATTRIB_LIGHTFLAGS);
+	qglVertexAttribIPointer(GL3_ATTRIB_LIGHTFLAGS, 1, GL_UNSIGNED_INT, sizeof(GLuint), 0);
+
+	// the element buffer binding is part of the VAO
+	glGenBuffers(1, &gl3state.eboWorld);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl3state.eboWorld);
+	gl3state.currentEBO = gl3state.eboWorld;
 }
 
 void GL3_SurfShutdown(void)
 {
-	glDeleteBuffers(1, &gl3state.vbo3D);
-	gl3state.vbo3D = 0;
 	glDeleteVertexArrays(1, &gl3state.vao3D);
 	gl3state.vao3D = 0;
 
-	glDeleteBuffers(1, &gl3state.eboAlias);
-	gl3state.eboAlias = 0;
-	glDeleteBuffers(1, &gl3state.vboAlias);
-	gl3state.vboAlias = 0;
 	glDeleteVertexArrays(1, &gl3state.vaoAlias);
 	gl3state.vaoAlias = 0;
+	glDeleteVertexArrays(1, &gl3state.vaoParticle);
+	gl3state.vaoParticle = 0;
+
+	glDeleteBuffers(1, &gl3state.eboWorld);
+	gl3state.eboWorld = 0;
+	glDeleteBuffers(1, &gl3state.vboWorldFlags);
+	gl3state.vboWorldFlags = 0;
+	glDeleteBuffers(1, &gl3state.vboWorld);
+	gl3state.vboWorld = 0;
+	glDeleteVertexArrays(1, &gl3state.vaoWorld);
+	gl3state.vaoWorld = 0;
+	gl3state.currentEBO = 0;
+
+	da_free(worldBatches);
+	da_free(worldIndexes);
+
+	free(worldLightFlags);
+	worldLightFlags = NULL;
+	numWorldVerts = 0;
 }
 
+static qboolean
+IsWorldVBOSurface(const msurface_t *surf)
+{
+	// the same surfaces that get a lightmap in Mod_LoadFaces()
+	return surf->polys && !(surf->texinfo->flags &
+		(SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP));
+}
+
+/*
+ * Uploads the polygons of all lightmapped surfaces of
+ * the world and its inline models into the static world
+ * VBO. Called once after the map was loaded.
+ */
+void
+GL3_SurfBuildWorldVBO(gl3model_t *mod)
+{
+	gl3_world_vtx_t *verts, *v;
+	msurface_t *surf;
+	int i, j, numverts;
+
+	numverts = 0;
+
+	for (i = 0, surf = mod->surfaces; i < mod->numsurfaces; i++, surf++)
+	{
+		surf->firstworldvert = -1;
+		surf->worldlightflags = 0;
+		surf->lightmapchain = NULL;
+
+		if (IsWorldVBOSurface(surf))
+		{
+			numverts += surf->polys->numverts;
+		}
+	}
+
+	verts = malloc(Q_max(numverts, 1) * sizeof(gl3_world_vtx_t));
+	free(worldLightFlags);
+	worldLightFlags = calloc(Q_max(numverts, 1), sizeof(GLuint));
+
+	if (!verts || !worldLightFlags)
+	{
+		ri.Sys_Error(ERR_FATAL, "%s: Couldn't allocate %d vertices", __func__, numverts);
+	}
+
+	v = verts;
+
+	for (i = 0, surf = mod->surfaces; i < mod->numsurfaces; i++, surf++)
+	{
+		byte styles[MAX_LIGHTMAPS_PER_SURFACE];
+		const gl3_3D_vtx_t *pv;
+
+		if (!IsWorldVBOSurface(surf))
+		{
+			continue;
+		}
+
+		// the styles after the first unused one are ignored
+		for (j = 0; j < MAX_LIGHTMAPS_PER_SURFACE; j++)
+		{
+			styles[j] = (j > 0 && styles[j - 1] == 255) ? 255 : surf->styles[j];
+		}
+
+		surf->firstworldvert = v - verts;
+
+		for (j = 0, pv = surf->polys->vertices; j < surf->polys->numverts; j++, pv++, v++)
+		{
+			VectorCopy(pv->pos, v->pos);
+			v->texCoord[0] = pv->texCoord[0];
+			v->texCoord[1] = pv->texCoord[1];
+			v->lmTexCoord[0] = pv->lmTexCoord[0];
+			v->lmTexCoord[1] = pv->lmTexCoord[1];
+			VectorCopy(pv->normal, v->normal);
+			memcpy(v->lmStyles, styles, sizeof(v->lmStyles));
+		}
+	}
+
+	GL3_BindVBO(gl3state.vboWorld);
+	glBufferData(GL_ARRAY_BUFFER, numverts * sizeof(gl3_world_vtx_t), verts, GL_STATIC_DRAW);
+
+	GL3_BindVBO(gl3state.vboWorldFlags);
+	glBufferData(GL_ARRAY_BUFFER, numverts * sizeof(GLuint), worldLightFlags, GL_DYNAMIC_DRAW);
+
+	free(verts);
+
+	numWorldVerts = numverts;
+	worldFlagsMin = numverts;
+	worldFlagsMax = 0;
+
+	da_clear(worldBatches);
+	da_clear(worldIndexes);
+}
+
+/*
+ * Adds a surface from the static world VBO to
+ * the batches, a new batch is started when the
+ * texture, lightmap or shader changes.
+ */
 static void
-SetLightFlags(msurface_t *surf)
+AddWorldSurface(msurface_t *surf, GLuint texnum, GLuint lightFlags)
 {
-	unsigned int lightFlags = 0;
-	if (surf->dlightframe == gl3_framecount)
+	gl3worldbatch_t *batch;
+	qboolean flowing;
+	GLuint *idx;
+	GLuint first;
+	int i, numverts, numindexes;
+
+	if (surf->firstworldvert < 0)
 	{
-		lightFlags = surf->dlightbits;
+		return; // sky on an inline model
 	}
 
-	gl3_3D_vtx_t* verts = surf->polys->vertices;
+	c_brush_polys++;
+
+	first = surf->firstworldvert;
+	numverts = surf->polys->numverts;
 
-	int numVerts = surf->polys->numverts;
-	for(int i=0; i<numVerts; ++i)
+	if (lightFlags != surf->worldlightflags)
 	{
-		verts[i].lightFlags = lightFlags;
+		surf->worldlightflags = lightFlags;
+
+		for (i = 0; i < numverts; i++)
+		{
+			worldLightFlags[first + i] = lightFlags;
+		}
+
+		worldFlagsMin = Q_min(worldFlagsMin, first);
+		worldFlagsMax = Q_max(worldFlagsMax, first + numverts);
 	}
+
+	flowing = (surf->texinfo->flags & SURF_FLOWING) != 0;
+	batch = da_lastptr(worldBatches);
+
+	if (!batch || batch->texnum != texnum || batch->flowing != flowing
+		|| batch->lightmap != surf->lightmaptexturenum)
+	{
+		batch = da_addn_zeroed(worldBatches, 1);
+		batch->texnum = texnum;
+		batch->lightmap = surf->lightmaptexturenum;
+		batch->flowing = flowing;
+		batch->firstIndex = da_count(worldIndexes);
+	}
+
+	// the polygons are fans
+	numindexes = (numverts - 2) * 3;
+	idx = da_addn_uninit(worldIndexes, numindexes);
+
+	for (i = 2; i < numverts; i++)
+	{
+		*idx++ = first;
+		*idx++ = first + i - 1;
+		*idx++ = first + i;
+	}
+
+	batch->numIndexes += numindexes;
 }
 
+/*
+ * Draws and clears the batches. All batches of si3Dlm
+ * are drawn first, then those of si3DlmFlow, so the
+ * program changes at most once.
+ */
 static void
-SetAllLightFlags(msurface_t *surf)
+DrawWorldBatches(void)
 {
-	unsigned int lightFlags = 0xffffffff;
+	gl3worldbatch_t *batch;
+	int i, numbatches = da_count(worldBatches);
+	int pass;
+
+	if (!numbatches)
+	{
+		return;
+	}
 
-	gl3_3D_vtx_t* verts = surf->polys->vertices;
+	GL3_BindVAO(gl3state.vaoWorld);
 
-	int numVerts = surf->polys->numverts;
-	for(int i=0; i<numVerts; ++i)
+	if (worldFlagsMin < worldFlagsMax)
 	{
-		verts[i].lightFlags = lightFlags;
+		GL3_BindVBO(gl3state.vboWorldFlags);
+		glBufferSubData(GL_ARRAY_BUFFER, worldFlagsMin * sizeof(GLuint),
+			(worldFlagsMax - worldFlagsMin) * sizeof(GLuint), worldLightFlags + worldFlagsMin);
+
+		worldFlagsMin = numWorldVerts;
+		worldFlagsMax = 0;
+	}
+
+	GL3_BindEBO(gl3state.eboWorld);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, da_count(worldIndexes) * sizeof(GLuint),
+		worldIndexes.p, GL_STREAM_DRAW);
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		const qboolean flowing = (pass == 1);
+		qboolean programSet = false;
+
+		for (i = 0; i < numbatches; i++)
+		{
+			batch = da_getptr(worldBatches, i);
+
+			if (batch->flowing != flowing)
+			{
+				continue;
+			}
+
+			if (!programSet && flowing)
+			{
+				float scroll = -64.0f * ((gl3_newrefdef.time / 40.0f) - (int)(gl3_newrefdef.time / 40.0f));
+
+				if (scroll == 0.0f)
+				{
+					scroll = -64.0f;
+				}
+
+				if (gl3state.uni3DData.scroll != scroll)
+				{
+					gl3state.uni3DData.scroll = scroll;
+					GL3_UpdateUBO3D();
+				}
+
+				GL3_UseProgram(gl3state.si3DlmFlow.shaderProgram);
+			}
+			else if (!programSet)
+			{
+				GL3_UseProgram(gl3state.si3Dlm.shaderProgram);
+			}
+
+			programSet = true;
+
+			GL3_Bind(batch->texnum);
+			GL3_BindLightmap(batch->lightmap);
+
+			glDrawElements(GL_TRIANGLES, batch->numIndexes, GL_UNSIGNED_INT,
+				(void *)(batch->firstIndex * sizeof(GLuint)));
+		}
+	}
+
+	da_clear(worldBatches);
+	da_clear(worldIndexes);
+}
+
+/*
+ * Sets the scales of all lightstyles for the lightmap
+ * shaders. Style 255 means "no lightmap" and stays 0.
+ * Most styles don't change for many frames, so the UBO
+ * is only updated when one of them did.
+ */
+void
+GL3_UpdateLightstyles(void)
+{
+	hmm_vec4 *scale = gl3state.uniLightstylesData.lightstyles;
+	qboolean changed = false;
+	int i;
+
+	// no world, e.g. the player model in the menu
+	if (!gl3_newrefdef.lightstyles)
+	{
+		return;
+	}
+
+	for (i = 0; i < MAX_LIGHTSTYLES - 1; i++)
+	{
+		const float *rgb = gl3_newrefdef.lightstyles[i].rgb;
+
+		if (scale[i].R != rgb[0] || scale[i].G != rgb[1] ||
+			scale[i].B != rgb[2] || scale[i].A != 1.0f)
+		{
+			scale[i] = HMM_Vec4(rgb[0], rgb[1], rgb[2], 1.0f);
+			changed = true;
+		}
+	}
+
+	// the last one was set to 0 when the UBO was created
+	if (changed)
+	{
+		GL3_UpdateUBOLightstyles();
 	}
 }
 
@@ -170,7 +476,6 @@ GL3_DrawGLPoly(msurface_t *fa)
 	glpoly_t *p = fa->polys;
 
 	GL3_BindVAO(gl3state.vao3D);
-	GL3_BindVBO(gl3state.vbo3D);
 
 	GL3_BufferAndDraw3D(p->vertices, p->numverts, GL_TRIANGLE_FAN);
 }
@@ -197,7 +502,6 @@ GL3_DrawGLFlowingPoly(msurface_t *fa)
 	}
 
 	GL3_BindVAO(gl3state.vao3D);
-	GL3_BindVBO(gl3state.vbo3D);
 
 	GL3_BufferAndDraw3D(p->vertices, p->numverts, GL_TRIANGLE_FAN);
 }
@@ -260,85 +564,26 @@ DrawTriangleOutlines(void)
 #endif // 0
 }
 
-static void
-UpdateLMscales(const hmm_vec4 lmScales[MAX_LIGHTMAPS_PER_SURFACE], gl3ShaderInfo_t* si)
-{
-	int i;
-	qboolean hasChanged = false;
-
-	for(i=0; i<MAX_LIGHTMAPS_PER_SURFACE; ++i)
-	{
-		if(hasChanged)
-		{
-			si->lmScales[i] = lmScales[i];
-		}
-		else if(   si->lmScales[i].R != lmScales[i].R
-		        || si->lmScales[i].G != lmScales[i].G
-		        || si->lmScales[i].B != lmScales[i].B
-		        || si->lmScales[i].A != lmScales[i].A )
-		{
-			si->lmScales[i] = lmScales[i];
-			hasChanged = true;
-		}
-	}
-
-	if(hasChanged)
-	{
-		glUniform4fv(si->uniLmScalesOrTime, MAX_LIGHTMAPS_PER_SURFACE, si->lmScales[0].Elements);
-	}
-}
-
 static void
 RenderBrushPoly(entity_t *currententity, msurface_t *fa)
 {
-	int map;
 	gl3image_t *image;
 
-	c_brush_polys++;
-
 	image = R_TextureAnimation(currententity, fa->texinfo);
 
 	if (fa->flags & SURF_DRAWTURB)
 	{
+		c_brush_polys++;
+
 		GL3_Bind(image->texnum);
 
 		GL3_EmitWaterPolys(fa);
 
 		return;
 	}
-	else
-	{
-		GL3_Bind(image->texnum);
-	}
-
-	hmm_vec4 lmScales[MAX_LIGHTMAPS_PER_SURFACE] = {0};
-	lmScales[0] = HMM_Vec4(1.0f, 1.0f, 1.0f, 1.0f);
-
-	GL3_BindLightmap(fa->lightmaptexturenum);
 
-	// Any dynamic lights on this surface?
-	for (map = 0; map < MAX_LIGHTMAPS_PER_SURFACE && fa->styles[map] != 255; map++)
-	{
-		lmScales[map].R = gl3_newrefdef.lightstyles[fa->styles[map]].rgb[0];
-		lmScales[map].G = gl3_newrefdef.lightstyles[fa->styles[map]].rgb[1];
-		lmScales[map].B = gl3_newrefdef.lightstyles[fa->styles[map]].rgb[2];
-		lmScales[map].A = 1.0f;
-	}
-
-	if (fa->texinfo->flags & SURF_FLOWING)
-	{
-		GL3_UseProgram(gl3state.si3DlmFlow.shaderProgram);
-		UpdateLMscales(lmScales, &gl3state.si3DlmFlow);
-		GL3_DrawGLFlowingPoly(fa);
-	}
-	else
-	{
-		GL3_UseProgram(gl3state.si3Dlm.shaderProgram);
-		UpdateLMscales(lmScales, &gl3state.si3Dlm);
-		GL3_DrawGLPoly(fa);
-	}
-
-	// Note: lightmap chains are gone, lightmaps are rendered together with normal texture in one pass
+	// lightmaps are rendered together with normal texture in one pass
+	AddWorldSurface(fa, image->texnum, (fa->dlightframe == gl3_framecount) ? fa->dlightbits : 0);
 }
 
 /*
@@ -403,12 +648,15 @@ GL3_DrawAlphaSurfaces(void)
 static void
 DrawTextureChains(entity_t *currententity)
 {
-	int i;
-	msurface_t *s;
+	msurface_t *lmchains[2][MAX_LIGHTMAPS];
+	int i, j, k;
+	msurface_t *s, *next;
 	gl3image_t *image;
 
 	c_visible_textures = 0;
 
+	memset(lmchains, 0, sizeof(lmchains));
+
 	for (i = 0, image = gl3textures; i < numgl3textures; i++, image++)
 	{
 		if (!image->registration_sequence)
@@ -425,56 +673,41 @@ DrawTextureChains(entity_t *currententity)
 
 		c_visible_textures++;
 
-		for ( ; s; s = s->texturechain)
+		// water is drawn right away, the rest
+		// is sorted by shader and lightmap
+		for ( ; s; s = next)
 		{
-			SetLightFlags(s);
-			RenderBrushPoly(currententity, s);
-		}
-
-		image->texturechain = NULL;
-	}
-
-	// TODO: maybe one loop for normal faces and one for SURF_DRAWTURB ???
-}
+			next = s->texturechain;
 
-static void
-RenderLightmappedPoly(entity_t *currententity, msurface_t *surf)
-{
-	int map;
-	gl3image_t *image = R_TextureAnimation(currententity, surf->texinfo);
+			if (s->flags & SURF_DRAWTURB)
+			{
+				RenderBrushPoly(currententity, s);
+			}
+			else
+			{
+				k = (s->texinfo->flags & SURF_FLOWING) ? 1 : 0;
+				s->lightmapchain = lmchains[k][s->lightmaptexturenum];
+				lmchains[k][s->lightmaptexturenum] = s;
+			}
+		}
 
-	hmm_vec4 lmScales[MAX_LIGHTMAPS_PER_SURFACE] = {0};
-	lmScales[0] = HMM_Vec4(1.0f, 1.0f, 1.0f, 1.0f);
+		for (k = 0; k < 2; k++)
+		{
+			for (j = 0; j < MAX_LIGHTMAPS; j++)
+			{
+				for (s = lmchains[k][j]; s; s = s->lightmapchain)
+				{
+					RenderBrushPoly(currententity, s);
+				}
 
-	assert((surf->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP)) == 0
-			&& "RenderLightMappedPoly mustn't be called with transparent, sky or warping surfaces!");
+				lmchains[k][j] = NULL;
+			}
+		}
 
-	// Any dynamic lights on this surface?
-	for (map = 0; map < MAX_LIGHTMAPS_PER_SURFACE && surf->styles[map] != 255; map++)
-	{
-		lmScales[map].R = gl3_newrefdef.lightstyles[surf->styles[map]].rgb[0];
-		lmScales[map].G = gl3_newrefdef.lightstyles[surf->styles[map]].rgb[1];
-		lmScales[map].B = gl3_newrefdef.lightstyles[surf->styles[map]].rgb[2];
-		lmScales[map].A = 1.0f;
+		image->texturechain = NULL;
 	}
 
-	c_brush_polys++;
-
-	GL3_Bind(image->texnum);
-	GL3_BindLightmap(surf->lightmaptexturenum);
-
-	if (surf->texinfo->flags & SURF_FLOWING)
-	{
-		GL3_UseProgram(gl3state.si3DlmFlow.shaderProgram);
-		UpdateLMscales(lmScales, &gl3state.si3DlmFlow);
-		GL3_DrawGLFlowingPoly(surf);
-	}
-	else
-	{
-		GL3_UseProgram(gl3state.si3Dlm.shaderProgram);
-		UpdateLMscales(lmScales, &gl3state.si3Dlm);
-		GL3_DrawGLPoly(surf);
-	}
+	DrawWorldBatches();
 }
 
 static void
@@ -526,8 +759,9 @@ DrawInlineBModel(entity_t *currententity, gl3model_t *currentmodel)
 			}
 			else if(!(psurf->flags & SURF_DRAWTURB))
 			{
-				SetAllLightFlags(psurf);
-				RenderLightmappedPoly(currententity, psurf);
+				gl3image_t *image = R_TextureAnimation(currententity, psurf->texinfo);
+
+				AddWorldSurface(psurf, image->texnum, 0xffffffff);
 			}
 			else
 			{
@@ -536,6 +770,8 @@ DrawInlineBModel(entity_t *currententity, gl3model_t *currentmodel)
 		}
 	}
 
+	DrawWorldBatches();
+
 	if (currententity->flags & RF_TRANSLUCENT)
 	{
 		glDisable(GL_BLEND);
@@ -621,7 +857,7 @@ GL3_DrawBrushModel(entity_t *e, gl3model_t *currentmodel)
 }
 
 static void
-RecursiveWorldNode(entity_t *currententity, mnode_t *node)
+RecursiveWorldNode(entity_t *currententity, mnode_t *node, int clipflags)
 {
 	int c, side, sidebit;
 	cplane_t *plane;
@@ -640,9 +876,15 @@ RecursiveWorldNode(entity_t *currententity, mnode_t *node)
 		return;
 	}
 
-	if (r_cull->value && R_CullBox(node->minmaxs, node->minmaxs + 3, frustum))
+	/* planes the parent is completely in front of aren't tested */
+	if (clipflags)
 	{
-		return;
+		clipflags = R_CullNodeBox(node->minmaxs, clipflags);
+
+		if (clipflags < 0)
+		{
+			return;
+		}
 	}
 
 	/* if a leaf node, draw stuff */
@@ -703,7 +945,7 @@ RecursiveWorldNode(entity_t *currententity, mnode_t *node)
 	}
 
 	/* recurse down the children, front side first */
-	RecursiveWorldNode(currententity, node->children[side]);
+	RecursiveWorldNode(currententity, node->children[side], clipflags);
 
 	/* draw stuff */
 	for (c = node->numsurfaces,
@@ -754,7 +996,7 @@ RecursiveWorldNode(entity_t *currententity, mnode_t *node)
 	}
 
 	/* recurse down the back side */
-	RecursiveWorldNode(currententity, node->children[!side]);
+	RecursiveWorldNode(currententity, node->children[!side], clipflags);
 }
 
 void
@@ -781,7 +1023,8 @@ GL3_DrawWorld(void)
 	gl3state.currenttexture = -1;
 
 	GL3_ClearSkyBox();
-	RecursiveWorldNode(&ent, gl3_worldmodel->nodes);
+	RecursiveWorldNode(&ent, gl3_worldmodel->nodes,
+		r_cull->value ? FRUSTUM_ALLPLANES : 0);
 	DrawTextureChains(&ent);
 	GL3_DrawSkyBox();
 	DrawTriangleOutlines();
@@ -796,10 +1039,7 @@ GL3_MarkLeaves(void)
 {
 	const byte *vis;
 	YQ2_ALIGNAS_TYPE(int) byte fatvis[MAX_MAP_LEAFS / 8];
-	mnode_t *node;
 	int i, c;
-	mleaf_t *leaf;
-	int cluster;
 
 	if ((gl3_oldviewcluster == gl3_viewcluster) &&
 		(gl3_oldviewcluster2 == gl3_viewcluster2) &&
@@ -836,6 +1076,12 @@ GL3_MarkLeaves(void)
 		return;
 	}
 
+	if (R_MarkCachedLeaves(gl3_worldmodel->leafs, gl3_viewcluster, gl3_viewcluster2,
+		gl3_visframecount))
+	{
+		return;
+	}
+
 	vis = GL3_Mod_ClusterPVS(gl3_viewcluster, gl3_worldmodel);
 
 	/* may have to combine two clusters because of solid water boundaries */
@@ -853,33 +1099,29 @@ GL3_MarkLeaves(void)
 		vis = fatvis;
 	}
 
-	for (i = 0, leaf = gl3_worldmodel->leafs;
-		 i < gl3_worldmodel->numleafs;
-		 i++, leaf++)
-	{
-		cluster = leaf->cluster;
+	R_MarkVisibleLeaves(gl3_worldmodel->leafs, gl3_worldmodel->numleafs,
+		gl3_worldmodel->numnodes, vis, gl3_viewcluster, gl3_viewcluster2,
+		gl3_visframecount);
+}
 
-		if (cluster == -1)
-		{
-			continue;
-		}
+static const byte *
+WorldClusterPVS(int cluster)
+{
+	return GL3_Mod_ClusterPVS(cluster, gl3_worldmodel);
+}
 
-		if (vis[cluster >> 3] & (1 << (cluster & 7)))
-		{
-			node = (mnode_t *)leaf;
+void
+GL3_CullBench_f(void)
+{
+	if (!gl3_worldmodel)
+	{
+		R_Printf(PRINT_ALL, "r_cullbench needs a map.\n");
+		return;
+	}
 
-			do
-			{
-				if (node->visframe == gl3_visframecount)
-				{
-					break;
-				}
+	R_CullBench(gl3_worldmodel->nodes, gl3_worldmodel->leafs, gl3_worldmodel->numleafs,
+		gl3_worldmodel->numnodes, WorldClusterPVS);
 
-				node->visframe = gl3_visframecount;
-				node = node->parent;
-			}
-			while (node);
-		}
-	}
+	gl3_oldviewcluster = -1; /* force markleafs */
 }
 
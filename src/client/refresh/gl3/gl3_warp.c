@@ -267,7 +267,6 @@ GL3_EmitWaterPolys(msurface_t *fa)
 	GL3_UseProgram(gl3state.si3Dturb.shaderProgram);
 
 	GL3_BindVAO(gl3state.vao3D);
-	GL3_BindVBO(gl3state.vbo3D);
 
 	for (bp = fa->polys; bp != NULL; bp = bp->next)
 	{
@@ -713,7 +712,6 @@ GL3_DrawSkyBox(void)
 
 	GL3_UseProgram(gl3state.si3Dsky.shaderProgram);
 	GL3_BindVAO(gl3state.vao3D);
-	GL3_BindVBO(gl3state.vbo3D);
 
 	// TODO: this could all be done in one drawcall.. but.. whatever, it's <= 6 drawcalls/frame
 
@@ -91,7 +91,10 @@ enum {
 	GL3_ATTRIB_LMTEXCOORD = 2, // for lightmap
 	GL3_ATTRIB_COLOR      = 3, // per-vertex color
 	GL3_ATTRIB_NORMAL     = 4, // vertex normal
-	GL3_ATTRIB_LIGHTFLAGS = 5  // uint, each set bit means "dyn light i affects this surface"
+	GL3_ATTRIB_LIGHTFLAGS = 5, // uint, each set bit means "dyn light i affects this surface"
+	GL3_ATTRIB_LMSTYLES   = 6, // uvec4, the lightstyles of a world surface
+	GL3_ATTRIB_FRAMEVERT  = 7, // uvec4, a dtrivertx_t of the current frame of a model
+	GL3_ATTRIB_OLDFRAMEVERT = 8 // uvec4, the same for the frame lerped from
 };
 
 // always using RGBA now, GLES3 on RPi4 doesn't work otherwise
@@ -119,8 +122,8 @@ typedef struct
 	qboolean anisotropic; // is GL_EXT_texture_filter_anisotropic supported?
 	qboolean debug_output; // is GL_ARB_debug_output supported?
 	qboolean stencil; // Do we have a stencil buffer?
-
-	qboolean useBigVBO; // workaround for AMDs windows driver for fewer calls to glBufferData()
+	qboolean buffer_storage; // is GL_ARB_buffer_storage supported?
+	qboolean program_binary; // is GL_ARB_get_program_binary supported?
 
 	// ----
 
@@ -131,10 +134,25 @@ typedef struct
 {
 	GLuint shaderProgram;
 	GLint uniVblend;
-	GLint uniLmScalesOrTime; // for 3D it's lmScales, for 2D underwater PP it's time
-	hmm_vec4 lmScales[4];
+	GLint uniLmScalesOrTime; // for 2D underwater PP it's time
 } gl3ShaderInfo_t;
 
+// number of sections a gl3stream_t is split into, each gets a fence
+#define GL3_STREAM_SECTIONS 4
+
+// a ring buffer for dynamic vertex or index data, see gl3_stream.c
+typedef struct
+{
+	GLuint buffer;
+	GLsizeiptr size;
+	GLsizeiptr sectionSize;
+	GLsizeiptr offset; // where the next data goes
+	GLsizeiptr pendingOffset, pendingSize; // between GL3_StreamBegin() and GL3_StreamEnd()
+	int section; // the section offset is in
+	byte *mapped; // persistent mapping, NULL when mapping each range unsynchronized
+	GLsync fences[GL3_STREAM_SECTIONS];
+} gl3stream_t;
+
 typedef struct
 {
 	GLfloat gamma;
@@ -165,7 +183,8 @@ typedef struct
 	GLfloat particleFadeFactor; // gl3_particle_fade_factor, higher => less fading out towards edges
 
 	GLfloat lightScaleForTurb; // surfaces with SURF_DRAWTURB (water, lava) don't have lightmaps, use this instead
-		GLfloat _padding[2]; // again, some padding to ensure this has right size
+	GLfloat particleSize; // gl3_particle_size, scaled to the window height
+		GLfloat _padding; // again, some padding to ensure this has right size
 } gl3Uni3D_t;
 
 extern const hmm_mat4 gl3_identityMat4;
@@ -185,6 +204,32 @@ typedef struct
 	GLfloat _padding[3];
 } gl3UniLights_t;
 
+typedef struct
+{
+	hmm_vec4 lightstyles[MAX_LIGHTSTYLES]; // rgb scale of each lightstyle, 255 is always 0
+} gl3UniLightstyles_t;
+
+// for models lerped in the vertex shader, set for each model
+typedef struct
+{
+	hmm_vec4 move; // translation, already lerped
+	hmm_vec4 frontv; // scale of the current frame * frontlerp
+	hmm_vec4 backv; // scale of the old frame * backlerp
+	hmm_vec4 shadelight; // rgb: light, a: alpha
+	GLint shadedotsRow; // row in shadedots, depends on the yaw
+	GLfloat shellScale; // POWERSUIT_SCALE for shells, 0 otherwise
+		GLfloat _padding[2];
+} gl3UniAlias_t;
+
+#define SHADEDOT_QUANT 16
+
+// the tables models are lit with, uploaded once
+typedef struct
+{
+	hmm_vec4 normals[NUMVERTEXNORMALS]; // w is unused
+	hmm_vec4 shadedots[SHADEDOT_QUANT * NUMVERTEXNORMALS / 4]; // 4 per vec4
+} gl3UniAliasTables_t;
+
 enum {
 	// width and height used to be 128, so now we should be able to get the same lightmap data
 	// that used 32 lightmaps before into one, so 4 lightmaps should be enough
@@ -246,28 +291,46 @@ typedef struct
 
 	gl3ShaderInfo_t si3Dalias;      // for models
 	gl3ShaderInfo_t si3DaliasColor; // for models w/ flat colors
+	gl3ShaderInfo_t si3DaliasLerp;      // for models lerped in the vertex shader
+	gl3ShaderInfo_t si3DaliasLerpColor; // the same w/ flat colors
 
 	// NOTE: make sure siParticle is always the last shaderInfo (or adapt GL3_ShutdownShaders())
 	gl3ShaderInfo_t siParticle; // for particles. surprising, right?
 
-	GLuint vao3D, vbo3D; // for brushes etc, using 10 floats and one uint as vertex input (x,y,z, s,t, lms,lmt, normX,normY,normZ ; lightFlags)
+	// all dynamic geometry is streamed through these. the VAOs below
+	// (and the 2D ones) take their vertices from vtxStream
+	gl3stream_t vtxStream, idxStream;
+	int streamBytes, streamWaits; // this frame
+	int lastStreamBytes, lastStreamWaits; // last frame, for r_speeds
+
+	// batched 2D draw calls and quads, see GL3_Draw_Flush()
+	int num2DDraws, num2DQuads;
+	int lastNum2DDraws, lastNum2DQuads; // last frame, for r_speeds
 
-	// the next two are for gl3config.useBigVBO == true
-	int vbo3Dsize;
-	int vbo3DcurOffset;
+	GLuint vao3D; // for brushes etc, using 10 floats and one uint as vertex input (x,y,z, s,t, lms,lmt, normX,normY,normZ ; lightFlags)
+	GLuint vaoAlias; // for models, using 9 floats as (x,y,z, s,t, r,g,b,a) and GLuint indices from idxStream
+	GLuint vaoParticle; // for particles, using 9 floats (x,y,z, size,distance, r,g,b,a)
+	GLuint vaoAliasLerp; // for models lerped in the vertex shader, the VBOs are per model
 
-	GLuint vaoAlias, vboAlias, eboAlias; // for models, using 9 floats as (x,y,z, s,t, r,g,b,a)
-	GLuint vaoParticle, vboParticle; // for particles, using 9 floats (x,y,z, size,distance, r,g,b,a)
+	// static world geometry with lightmaps, see gl3_world_vtx_t. vboWorldFlags has
+	// the dynamic light flags, one uint per vertex. eboWorld is streamed each frame
+	GLuint vaoWorld, vboWorld, vboWorldFlags, eboWorld;
 
 	// UBOs and their data
 	gl3UniCommon_t uniCommonData;
 	gl3Uni2D_t uni2DData;
 	gl3Uni3D_t uni3DData;
 	gl3UniLights_t uniLightsData;
+	gl3UniLightstyles_t uniLightstylesData;
+	gl3UniAlias_t uniAliasData;
+	gl3UniAliasTables_t uniAliasTablesData;
 	GLuint uniCommonUBO;
 	GLuint uni2DUBO;
 	GLuint uni3DUBO;
 	GLuint uniLightsUBO;
+	GLuint uniLightstylesUBO;
+	GLuint uniAliasUBO;
+	GLuint uniAliasTablesUBO;
 
 	hmm_mat4 projMat3D;
 	hmm_mat4 viewMat3D;
@@ -304,7 +367,7 @@ typedef struct image_s
 	struct msurface_s *texturechain;    /* for sort-by-texture world drawing */
 	GLuint texnum;                      /* gl texture binding */
 	float sl, tl, sh, th;               /* 0,0 - 1,1 unless part of the scrap */
-	// qboolean scrap; // currently unused
+	qboolean scrap;                     /* texnum is one of the scraps */
 	qboolean has_alpha;
 	qboolean is_lava; // DG: added for lava brightness hack
 
@@ -383,6 +446,21 @@ GL3_BindEBO(GLuint ebo)
 	}
 }
 
+// gl3_stream.c
+extern void GL3_StreamInit(void);
+extern void GL3_StreamShutdown(void);
+extern void GL3_StreamEndFrame(void);
+extern void *GL3_StreamBegin(gl3stream_t *stream, GLsizeiptr size, GLsizeiptr align);
+extern GLintptr GL3_StreamEnd(gl3stream_t *stream);
+extern GLintptr GL3_StreamData(gl3stream_t *stream, const void *data, GLsizeiptr size, GLsizeiptr align);
+
+// gl3_shadercache.c
+extern void GL3_ShaderCacheBegin(void);
+extern void GL3_ShaderCacheEnd(void);
+extern unsigned GL3_ShaderCacheKey(const char **sources, int numsources);
+extern GLuint GL3_ShaderCacheLoad(unsigned key);
+extern void GL3_ShaderCacheStore(GLuint prog, unsigned key);
+
 extern void GL3_BufferAndDraw3D(const gl3_3D_vtx_t* verts, int numVerts, GLenum drawMode);
 
 extern void GL3_RotateForEntity(entity_t *e);
@@ -415,6 +493,8 @@ extern const byte* GL3_Mod_ClusterPVS(int cluster, const gl3model_t *model);
 // gl3_draw.c
 extern void GL3_Draw_InitLocal(void);
 extern void GL3_Draw_ShutdownLocal(void);
+extern void GL3_Draw_Flush(void);
+extern void GL3_Draw_EndFrame(void);
 extern gl3image_t * GL3_Draw_FindPic(char *name);
 extern void GL3_Draw_GetPicSize(int *w, int *h, char *pic);
 
@@ -459,6 +539,7 @@ extern void GL3_MarkSurfaceLights(dlight_t *light, int bit, mnode_t *node,
 	int r_dlightframecount);
 extern void GL3_PushDlights(void);
 extern void GL3_LightPoint(entity_t *currententity, vec3_t p, vec3_t color);
+extern void GL3_SampleLight(const vec3_t p, lightsample_t *sample);
 extern void GL3_BuildLightMap(msurface_t *surf, int offsetInLMbuf, int stride);
 
 // gl3_lightmap.c
@@ -485,6 +566,8 @@ extern void GL3_AddSkySurface(msurface_t *fa);
 // gl3_surf.c
 extern void GL3_SurfInit(void);
 extern void GL3_SurfShutdown(void);
+extern void GL3_SurfBuildWorldVBO(gl3model_t *mod);
+extern void GL3_UpdateLightstyles(void);
 extern void GL3_DrawGLPoly(msurface_t *fa);
 extern void GL3_DrawGLFlowingPoly(msurface_t *fa);
 extern void GL3_DrawTriangleOutlines(void);
@@ -492,12 +575,15 @@ extern void GL3_DrawAlphaSurfaces(void);
 extern void GL3_DrawBrushModel(entity_t *e, gl3model_t *currentmodel);
 extern void GL3_DrawWorld(void);
 extern void GL3_MarkLeaves(void);
+extern void GL3_CullBench_f(void);
 
 // gl3_mesh.c
 extern void GL3_DrawAliasModel(entity_t *e);
 extern void GL3_ResetShadowAliasModels(void);
 extern void GL3_DrawAliasShadows(void);
+extern void GL3_InitMeshes(void);
 extern void GL3_ShutdownMeshes(void);
+extern void GL3_UploadAliasModel(gl3model_t *mod);
 
 // gl3_shaders.c
 
@@ -508,6 +594,9 @@ extern void GL3_UpdateUBOCommon(void);
 extern void GL3_UpdateUBO2D(void);
 extern void GL3_UpdateUBO3D(void);
 extern void GL3_UpdateUBOLights(void);
+extern void GL3_UpdateUBOLightstyles(void);
+extern void GL3_UpdateUBOAlias(void);
+extern void GL3_UpdateUBOAliasTables(void);
 
 // ############ Cvars ###########
 
@@ -559,5 +648,7 @@ extern cvar_t *r_palettedtexture;
 extern cvar_t *r_validation;
 
 extern cvar_t *gl3_debugcontext;
+extern cvar_t *gl3_bufferstorage;
+extern cvar_t *gl3_shadercache;
 
 #endif /* SRC_CLIENT_REFRESH_GL3_HEADER_LOCAL_H_ */
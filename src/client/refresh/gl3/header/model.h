@@ -37,6 +37,16 @@ typedef struct gl3_3D_vtx_s {
 	GLuint lightFlags; // bit i set means: dynlight i affects surface
 } gl3_3D_vtx_t;
 
+// used for the static world vertex buffer, built once when the map is
+// loaded. the dynamic light flags live in a separate buffer, see gl3_surf.c
+typedef struct gl3_world_vtx_s {
+	vec3_t pos;
+	float texCoord[2];
+	float lmTexCoord[2];
+	vec3_t normal;
+	byte lmStyles[4]; // lightstyles of the surface, 255 for none
+} gl3_world_vtx_t;
+
 // used for vertex array elements when drawing models
 typedef struct gl3_alias_vtx_s {
 	GLfloat pos[3];
@@ -44,6 +54,12 @@ typedef struct gl3_alias_vtx_s {
 	GLfloat color[4];
 } gl3_alias_vtx_t;
 
+// one per particle, the point size is calculated in the vertex shader
+typedef struct gl3_particle_vtx_s {
+	vec3_t pos;
+	byte color[4]; // RGB from the palette, A is the particle's alpha
+} gl3_particle_vtx_t;
+
 /* in memory representation */
 
 typedef struct glpoly_s
@@ -73,7 +89,10 @@ typedef struct msurface_s
 
 	glpoly_t *polys;                /* multiple if warped */
 	struct  msurface_s *texturechain;
-	// struct  msurface_s *lightmapchain; not used/needed anymore
+	struct  msurface_s *lightmapchain; /* for batching by lightmap */
+
+	int firstworldvert;             /* in the static world VBO, -1 if not in it */
+	GLuint worldlightflags;         /* dynamic light flags last uploaded for it */
 
 	mtexinfo_t *texinfo;
 
@@ -149,6 +168,7 @@ typedef struct model_s
 	dvis_t *vis;
 
 	byte *lightdata;
+	unsigned checksum; /* of the BSP, for the light grid */
 
 	/* for alias models and skins */
 	gl3image_t *skins[MAX_MD2SKINS];
@@ -156,6 +176,9 @@ typedef struct model_s
 	int extradatasize;
 	void *extradata;
 
+	/* baked alias models, see GL3_UploadAliasModel() */
+	GLuint vboAlias, eboAlias;
+
 	// submodules
 	vec3_t		origin;	// for sounds or lights
 } gl3model_t;
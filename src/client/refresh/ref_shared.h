@@ -46,6 +46,14 @@
 
 #endif
 
+#ifdef _WIN32
+  #include <direct.h>
+  #define Mod_Mkdir(path) _mkdir(path)
+#else
+  #include <sys/stat.h>
+  #define Mod_Mkdir(path) mkdir(path, 0755)
+#endif
+
 /*
  * skins will be outline flood filled and mip mapped
  * pics and sprites with alpha will be outline flood filled
@@ -175,11 +183,44 @@ typedef struct mleaf_s
 	int		key;	/* BSP sequence number for leaf's contents */
 } mleaf_t;
 
+/*
+ * Alias models baked at load time into an indexed triangle
+ * list. Each vertex is an unique xyz/st pair, the triangles
+ * are ordered for the post transform vertex cache and the
+ * vertices in order of their first use. Every frame has its
+ * own stream of num_verts dtrivertx_t in vertex order, so
+ * two frames can be lerped by walking both linearly. Scale
+ * and translation are still taken from the MD2 frames.
+ * Only models loaded by Mod_LoadMD2() with bake set have it,
+ * stored in the hunk behind the dmdl_t, see Mod_GetBakedMD2().
+ * num_verts is 0 if the model couldn't be baked.
+ */
+#define BAKEDMD2_IDENT (('K' << 24) + ('A' << 16) + ('B' << 8) + 'Y')
+#define BAKEDMD2_VERSION 1
+
+typedef struct
+{
+	int ident;
+	int version;
+	unsigned checksum; /* of the .md2 file */
+	int filelen;       /* length of the .md2 file */
+
+	int num_verts;
+	int num_indices;
+	int num_frames;
+
+	int ofs_st;        /* float[num_verts][2] */
+	int ofs_indices;   /* unsigned short[num_indices] */
+	int ofs_frames;    /* dtrivertx_t[num_frames][num_verts] */
+	int ofs_end;
+} dmdlbaked_t;
+
 /* Shared models func */
 typedef struct image_s* (*findimage_t)(const char *name, imagetype_t type);
+extern const dmdlbaked_t *Mod_GetBakedMD2(const dmdl_t *pheader);
 extern void *Mod_LoadMD2 (const char *mod_name, const void *buffer, int modfilelen,
 	vec3_t mins, vec3_t maxs, struct image_s **skins,
-	findimage_t find_image, modtype_t *type);
+	findimage_t find_image, modtype_t *type, qboolean bake);
 extern void *Mod_LoadSP2 (const char *mod_name, const void *buffer, int modfilelen,
 	struct image_s **skins, findimage_t find_image, modtype_t *type);
 extern int Mod_ReLoadSkins(struct image_s **skins, findimage_t find_image,
@@ -223,4 +264,35 @@ extern qboolean R_CullBox(vec3_t mins, vec3_t maxs, cplane_t *frustum);
 extern void R_SetFrustum(vec3_t vup, vec3_t vpn, vec3_t vright, vec3_t r_origin,
 	float fov_x, float fov_y, cplane_t *frustum);
 
+/* World culling */
+#define FRUSTUM_ALLPLANES 15 /* clipflags of R_CullNodeBox() */
+
+typedef const byte *(*clusterpvs_t)(int cluster);
+extern void R_SetCullFrustum(const cplane_t *frustum, const vec3_t origin);
+extern int R_CullNodeBox(const float *minmaxs, int clipflags);
+extern void R_FreeVisCache(void);
+extern qboolean R_MarkCachedLeaves(const mleaf_t *leafs, int cluster1, int cluster2,
+	int visframe);
+extern void R_MarkVisibleLeaves(mleaf_t *leafs, int numleafs, int numnodes,
+	const byte *vis, int cluster1, int cluster2, int visframe);
+extern void R_CullBench(mnode_t *nodes, mleaf_t *leafs, int numleafs, int numnodes,
+	clusterpvs_t cluster_pvs);
+
+/* Light grid */
+typedef struct
+{
+	byte styles[MAXLIGHTMAPS]; /* 255 if unused */
+	byte rgb[MAXLIGHTMAPS][3]; /* lightmap samples of the styles */
+} lightsample_t;
+
+/* traces from p down into the world, like R_LightPoint() */
+typedef void (*samplelight_t)(const vec3_t p, lightsample_t *sample);
+extern void R_LightSampleColor(const lightsample_t *sample,
+	const lightstyle_t *lightstyles, float scale, vec3_t color);
+extern void Mod_LoadLightGrid(const char *name, unsigned checksum, mnode_t *nodes,
+	const vec3_t mins, const vec3_t maxs, samplelight_t sample_light);
+extern void Mod_FreeLightGrid(void);
+extern qboolean R_LightGridPoint(const vec3_t p, const lightstyle_t *lightstyles,
+	float scale, vec3_t color);
+
 #endif /* SRC_CLIENT_REFRESH_REF_SHARED_H_ */
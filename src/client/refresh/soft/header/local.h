@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "../../ref_shared.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
@@ -265,6 +266,9 @@ typedef struct surfcache_s
 	unsigned		height; // DEBUG only needed for debug
 	float			mipscale;
 	image_t			*image;
+	int			spanseq; // == d_spanseq while queued spans read it
+	qboolean		referenced; // used since the rover passed, see D_SCAlloc()
+	int			lastframe; // r_framecount when it was last used
 	byte			data[4]; // width*height elements
 } surfcache_t;
 
@@ -272,6 +276,7 @@ typedef struct espan_s
 {
 	int		u, v, count;
 	struct espan_s	*pnext;
+	qboolean	skipz; // z buffer is still valid, see D_DamageZSpans()
 } espan_t;
 extern espan_t	*vid_polygon_spans; // space for spans in r_poly
 
@@ -360,12 +365,64 @@ extern float	d_sdivzstepu, d_tdivzstepu;
 extern float	d_sdivzstepv, d_tdivzstepv;
 extern float	d_sdivzorigin, d_tdivzorigin;
 
-void D_DrawSpansPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
-void D_DrawZSpans(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
-void TurbulentPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
-void NonTurbulentPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
+// everything needed to draw the spans of a surface, captured
+// when the surface is set up so the spans can be drawn later
+typedef struct spanstate_s
+{
+	espan_t	*spans;
+	void	(*drawspans)(const struct spanstate_s *state, int vstart, int vend);
+	pixel_t	*cacheblock;
+	int	cachewidth;
+	int	color; // for D_FlatFillSpans
+	float	d_sdivzstepu, d_tdivzstepu;
+	float	d_sdivzstepv, d_tdivzstepv;
+	float	d_sdivzorigin, d_tdivzorigin;
+	float	d_ziorigin, d_zistepu, d_zistepv;
+	float	z_ziorigin, z_zistepu, z_zistepv; // for the z buffer
+	int	sadjust, tadjust;
+	int	bbextents, bbextentt;
+} spanstate_t;
+
+extern int	d_spanseq;
+
+void D_DrawSpansPow2(const spanstate_t *state, int vstart, int vend);
+void D_DrawZSpans(const spanstate_t *state, int vstart, int vend);
+void D_DamageZSpans(espan_t *pspan);
+void D_FlatFillSpans(const spanstate_t *state, int vstart, int vend);
+void TurbulentPow2(const spanstate_t *state, int vstart, int vend);
+void NonTurbulentPow2(const spanstate_t *state, int vstart, int vend);
+void D_FlushSpans(void);
+void D_ShutdownSpans(void);
+
+// band parallel rendering, see sw_threads.c
+typedef void (*bandfunc_t)(int band, int vstart, int vend, void *data);
+
+void R_InitThreads(void);
+void R_ShutdownThreads(void);
+void R_CheckThreads(void);
+int R_NumBands(void);
+int R_BandForRow(int y);
+void R_RunBands(bandfunc_t func, void *data, int ystart, int yend);
+
+// copying the frame to the texture, see sw_copy.c
+void R_InitCopy(void);
+void R_CopyFrame(uint32_t *pixels, int pitch, const pixel_t *buffer,
+		const uint32_t *palette, int vmin, int vmax);
+int R_FrameDifferenceStart(const pixel_t *back, const pixel_t *front, int vmin, int vmax);
+int R_FrameDifferenceEnd(const pixel_t *back, const pixel_t *front, int vmin, int vmax);
+void R_CopyBench_f(void);
+void R_CullBench_f(void);
 
 surfcache_t *D_CacheSurface(const entity_t *currententity, msurface_t *surface, int miplevel);
+void D_BuildSurfaces(void);
+void D_CheckCacheSize(void);
+void D_SurfCacheStats_f(void);
+void D_ShutdownSurfaces(void);
+qboolean R_BuildLightMap(drawsurf_t *drawsurf, light_t *lights, const light_t *lights_max);
+
+// surface cache builds for r_dspeeds
+extern int	d_surfsbuilt, d_texelsbuilt;
+extern float	d_surfbuildms;
 
 extern int	d_vrectx, d_vrecty, d_vrectright_particle, d_vrectbottom_particle;
 
@@ -558,6 +615,7 @@ void R_PrintAliasStats (void);
 void R_PrintTimes (void);
 void R_PrintDSpeeds (void);
 void R_LightPoint (const entity_t *currententity, vec3_t p, vec3_t color);
+void R_SampleLight (const vec3_t p, lightsample_t *sample);
 void R_SetupFrame (void);
 
 extern  refdef_t		r_newrefdef;
@@ -137,6 +137,7 @@ typedef struct model_s
 	dvis_t		*vis;
 
 	byte		*lightdata;
+	unsigned	checksum;	// of the BSP, for the light grid
 
 	// for alias models and sprites
 	image_t		*skins[MAX_MD2SKINS];
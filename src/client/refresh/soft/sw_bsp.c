@@ -434,7 +434,7 @@ R_RecursiveWorldNode
 */
 static void
 R_RecursiveWorldNode (entity_t *currententity, const model_t *currentmodel, mnode_t *node,
-	int clipflags, qboolean insubmodel)
+	int clipflags, int cullflags, qboolean insubmodel)
 {
 	int c;
 	vec3_t acceptpt, rejectpt;
@@ -450,9 +450,13 @@ R_RecursiveWorldNode (entity_t *currententity, const model_t *currentmodel, mnod
 		return;
 	}
 
-	if (r_cull->value && R_CullBox(node->minmaxs, node->minmaxs + 3, frustum))
+	// frustum planes the parent is completely in front of aren't tested
+	if (cullflags)
 	{
-		return;
+		cullflags = R_CullNodeBox(node->minmaxs, cullflags);
+
+		if (cullflags < 0)
+			return;
 	}
 
 	// cull the clipping planes if not trivial accept
@@ -550,7 +554,7 @@ R_RecursiveWorldNode (entity_t *currententity, const model_t *currentmodel, mnod
 			side = 1;
 
 		// recurse down the children, front side first
-		R_RecursiveWorldNode (currententity, currentmodel, node->children[side], clipflags, insubmodel);
+		R_RecursiveWorldNode (currententity, currentmodel, node->children[side], clipflags, cullflags, insubmodel);
 
 		// draw stuff
 		c = node->numsurfaces;
@@ -593,7 +597,7 @@ R_RecursiveWorldNode (entity_t *currententity, const model_t *currentmodel, mnod
 		}
 
 		// recurse down the back side
-		R_RecursiveWorldNode (currententity, currentmodel, node->children[!side], clipflags, insubmodel);
+		R_RecursiveWorldNode (currententity, currentmodel, node->children[!side], clipflags, cullflags, insubmodel);
 	}
 }
 
@@ -618,5 +622,6 @@ R_RenderWorld (entity_t *currententity)
 	VectorCopy (r_origin, modelorg);
 	r_pcurrentvertbase = currentmodel->vertexes;
 
-	R_RecursiveWorldNode (currententity, currentmodel, currentmodel->nodes, ALIAS_XY_CLIP_MASK, false);
+	R_RecursiveWorldNode (currententity, currentmodel, currentmodel->nodes, ALIAS_XY_CLIP_MASK,
+		r_cull->value ? FRUSTUM_ALLPLANES : 0, false);
 }
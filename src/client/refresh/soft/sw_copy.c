@@ -0,0 +1,628 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ * USA.
+ *
+ * =======================================================================
+ *
+ * Copying the 8 bit frame into the 32 bit SDL texture. Expanding the
+ * palette and searching the part of the frame that changed since the
+ * last one are implemented several times: A plain C version, which is
+ * the reference, SSE2 and NEON versions of the search and an AVX2
+ * version of the expansion using gathers. The best ones are selected
+ * at runtime, all of them produce identical results. Big frames are
+ * expanded by all sw_threads, split by rows.
+ *
+ * `sw_copybench` compares their throughput.
+ *
+ * =======================================================================
+ */
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#include "header/local.h"
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define COPY_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+	(defined(__x86_64__) || defined(__i386__))
+#define COPY_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define COPY_NEON
+#include <arm_neon.h>
+#endif
+
+/* frames with less pixels are expanded on one thread */
+#define COPY_MINTHREADED (256 * 1024)
+
+typedef struct
+{
+	const char *name;
+
+	/* Writes palette[in[i]] to out[i] */
+	void (*expand)(Uint32 *out, const pixel_t *in, int count,
+			const Uint32 *palette);
+
+	/* First int between vmin and vmax that differs, or vmax */
+	int (*diffstart)(const pixel_t *back, const pixel_t *front,
+			int vmin, int vmax);
+
+	/* End of the last int between vmin and vmax that differs */
+	int (*diffend)(const pixel_t *back, const pixel_t *front,
+			int vmin, int vmax);
+} swcopy_t;
+
+static cvar_t *sw_simd;
+static const swcopy_t *sw_copy;
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * The reference implementation
+ */
+static void
+Copy_Expand_C(Uint32 *out, const pixel_t *in, int count, const Uint32 *palette)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		out[i] = palette[in[i]];
+	}
+}
+
+static int
+Copy_DiffStart_C(const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	const int *front_buffer, *back_buffer, *back_max;
+
+	back_buffer = (const int*)(back + vmin);
+	front_buffer = (const int*)(front + vmin);
+	back_max = (const int*)(back + vmax);
+
+	while (back_buffer < back_max && *back_buffer == *front_buffer) {
+		back_buffer ++;
+		front_buffer ++;
+	}
+	return (const pixel_t*)back_buffer - back;
+}
+
+static int
+Copy_DiffEnd_C(const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	const int *front_buffer, *back_buffer, *back_min;
+
+	back_buffer = (const int*)(back + vmax);
+	front_buffer = (const int*)(front + vmax);
+	back_min = (const int*)(back + vmin);
+
+	do {
+		back_buffer --;
+		front_buffer --;
+	} while (back_buffer > back_min && *back_buffer == *front_buffer);
+	// +1 for fully cover changes
+	return (const pixel_t*)back_buffer - back + sizeof(int);
+}
+
+static const swcopy_t copy_c = {
+	"C",
+	Copy_Expand_C,
+	Copy_DiffStart_C,
+	Copy_DiffEnd_C
+};
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * The vector versions of the search skip equal
+ * 16 byte blocks, stepping from vmin or vmax like
+ * the reference does. The reference finishes, so
+ * the result is the same.
+ */
+
+#ifdef COPY_SSE2
+
+static int
+Copy_DiffStart_SSE2(const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	int pos = vmin;
+
+	while (pos + 16 <= vmax)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(back + pos));
+		__m128i b = _mm_loadu_si128((const __m128i *)(front + pos));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+		{
+			break;
+		}
+
+		pos += 16;
+	}
+
+	return Copy_DiffStart_C(back, front, pos, vmax);
+}
+
+static int
+Copy_DiffEnd_SSE2(const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	int pos = vmax;
+
+	/* the reference stops at vmin, even if it's equal */
+	while (pos - 16 > vmin)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(back + pos - 16));
+		__m128i b = _mm_loadu_si128((const __m128i *)(front + pos - 16));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+		{
+			break;
+		}
+
+		pos -= 16;
+	}
+
+	return Copy_DiffEnd_C(back, front, vmin, pos);
+}
+
+static const swcopy_t copy_sse2 = {
+	"SSE2",
+	Copy_Expand_C,
+	Copy_DiffStart_SSE2,
+	Copy_DiffEnd_SSE2
+};
+
+#endif /* COPY_SSE2 */
+
+/* ------------------------------------------------------------------ */
+
+#ifdef COPY_AVX2
+
+__attribute__((target("avx2"))) static void
+Copy_Expand_AVX2(Uint32 *out, const pixel_t *in, int count, const Uint32 *palette)
+{
+	int i;
+
+	for (i = 0; i + 16 <= count; i += 16)
+	{
+		__m128i idx = _mm_loadu_si128((const __m128i *)(in + i));
+		__m256i lo = _mm256_cvtepu8_epi32(idx);
+		__m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(idx, 8));
+
+		_mm256_storeu_si256((__m256i *)(out + i),
+			_mm256_i32gather_epi32((const int *)palette, lo, 4));
+		_mm256_storeu_si256((__m256i *)(out + i + 8),
+			_mm256_i32gather_epi32((const int *)palette, hi, 4));
+	}
+
+	if (i < count)
+	{
+		Copy_Expand_C(out + i, in + i, count - i, palette);
+	}
+}
+
+static const swcopy_t copy_avx2 = {
+	"AVX2",
+	Copy_Expand_AVX2,
+#ifdef COPY_SSE2
+	Copy_DiffStart_SSE2,
+	Copy_DiffEnd_SSE2
+#else
+	Copy_DiffStart_C,
+	Copy_DiffEnd_C
+#endif
+};
+
+#endif /* COPY_AVX2 */
+
+/* ------------------------------------------------------------------ */
+
+#ifdef COPY_NEON
+
+static int
+Copy_DiffStart_NEON(const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	int pos = vmin;
+
+	while (pos + 16 <= vmax)
+	{
+		uint8x16_t eq = vceqq_u8(vld1q_u8(back + pos), vld1q_u8(front + pos));
+
+		if (vminvq_u8(eq) != 0xFF)
+		{
+			break;
+		}
+
+		pos += 16;
+	}
+
+	return Copy_DiffStart_C(back, front, pos, vmax);
+}
+
+static int
+Copy_DiffEnd_NEON(const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	int pos = vmax;
+
+	/* the reference stops at vmin, even if it's equal */
+	while (pos - 16 > vmin)
+	{
+		uint8x16_t eq = vceqq_u8(vld1q_u8(back + pos - 16), vld1q_u8(front + pos - 16));
+
+		if (vminvq_u8(eq) != 0xFF)
+		{
+			break;
+		}
+
+		pos -= 16;
+	}
+
+	return Copy_DiffEnd_C(back, front, vmin, pos);
+}
+
+static const swcopy_t copy_neon = {
+	"NEON",
+	Copy_Expand_C,
+	Copy_DiffStart_NEON,
+	Copy_DiffEnd_NEON
+};
+
+#endif /* COPY_NEON */
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * Returns all implementations usable on
+ * this CPU, the best one is returned last.
+ */
+static int
+R_CopyList(const swcopy_t **list)
+{
+	int num = 0;
+
+	list[num++] = &copy_c;
+
+#ifdef COPY_SSE2
+	if (SDL_HasSSE2())
+	{
+		list[num++] = &copy_sse2;
+	}
+#endif
+
+#ifdef COPY_AVX2
+	if (SDL_HasAVX2())
+	{
+		list[num++] = &copy_avx2;
+	}
+#endif
+
+#ifdef COPY_NEON
+	if (SDL_HasNEON())
+	{
+		list[num++] = &copy_neon;
+	}
+#endif
+
+	return num;
+}
+
+/*
+ * Selects the implementation, either
+ * the reference or the best available.
+ */
+static void
+R_CopySelect(void)
+{
+	const swcopy_t *list[4];
+	int num;
+
+	num = R_CopyList(list);
+
+	if (sw_simd->value)
+	{
+		sw_copy = list[num - 1];
+	}
+	else
+	{
+		sw_copy = list[0];
+	}
+
+	sw_simd->modified = false;
+
+	R_Printf(PRINT_ALL, "Software renderer frame copy is \"%s\".\n", sw_copy->name);
+}
+
+/*
+ * Registers sw_simd and selects
+ * the implementation.
+ */
+void
+R_InitCopy(void)
+{
+	sw_simd = ri.Cvar_Get("sw_simd", "1", CVAR_ARCHIVE);
+
+	R_CopySelect();
+}
+
+/* ------------------------------------------------------------------ */
+
+typedef struct
+{
+	const swcopy_t *copy;
+	Uint32 *pixels;
+	const pixel_t *buffer;
+	const Uint32 *palette;
+	int pitch;
+} copyjob_t;
+
+/*
+ * Expands the pixels vstart to vend - 1 of a
+ * frame without gaps between the rows.
+ */
+static void
+R_CopyLinear(int band, int vstart, int vend, void *data)
+{
+	const copyjob_t *job = (const copyjob_t *)data;
+
+	job->copy->expand(job->pixels + vstart, job->buffer + vstart,
+		vend - vstart, job->palette);
+}
+
+/*
+ * Expands the rows vstart to vend - 1 into
+ * a texture with pitch pixels per row.
+ */
+static void
+R_CopyRows(int band, int vstart, int vend, void *data)
+{
+	const copyjob_t *job = (const copyjob_t *)data;
+	int y;
+
+	for (y = vstart; y < vend; y++)
+	{
+		job->copy->expand(job->pixels + y * job->pitch,
+			job->buffer + y * vid_buffer_width, vid_buffer_width,
+			job->palette);
+	}
+}
+
+/*
+ * Copies the pixels vmin to vmax - 1 of buffer into
+ * the texture, pitch is in pixels. Rows with gaps are
+ * always copied as a whole.
+ */
+static void
+R_CopyFrameWith(const swcopy_t *copy, Uint32 *pixels, int pitch,
+		const pixel_t *buffer, const Uint32 *palette, int vmin, int vmax)
+{
+	copyjob_t job;
+	qboolean threaded;
+
+	job.copy = copy;
+	job.pixels = pixels;
+	job.buffer = buffer;
+	job.palette = palette;
+	job.pitch = pitch;
+
+	threaded = (R_NumBands() > 1) && (vmax - vmin >= COPY_MINTHREADED);
+
+	// no gaps between images rows
+	if (pitch == vid_buffer_width)
+	{
+		if (threaded)
+		{
+			R_RunBands(R_CopyLinear, &job, vmin, vmax);
+		}
+		else
+		{
+			R_CopyLinear(0, vmin, vmax, &job);
+		}
+	}
+	else
+	{
+		int ymin, ymax;
+
+		ymin = vmin / vid_buffer_width;
+		ymax = vmax / vid_buffer_width;
+
+		if (threaded)
+		{
+			R_RunBands(R_CopyRows, &job, ymin, ymax);
+		}
+		else
+		{
+			R_CopyRows(0, ymin, ymax, &job);
+		}
+	}
+}
+
+/*
+ * Copies the frame, see R_CopyFrameWith().
+ */
+void
+R_CopyFrame(uint32_t *pixels, int pitch, const pixel_t *buffer,
+		const uint32_t *palette, int vmin, int vmax)
+{
+	if (sw_simd->modified)
+	{
+		R_CopySelect();
+	}
+
+	R_CopyFrameWith(sw_copy, pixels, pitch, buffer, palette, vmin, vmax);
+}
+
+/*
+ * Returns the first int between vmin and vmax
+ * that differs in the two frames, vmax if none.
+ */
+int
+R_FrameDifferenceStart(const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	return sw_copy->diffstart(back, front, vmin, vmax);
+}
+
+/*
+ * Returns the end of the last int between
+ * vmin and vmax that differs in the two frames.
+ */
+int
+R_FrameDifferenceEnd(const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	return sw_copy->diffend(back, front, vmin, vmax);
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * Checksum of a copied frame
+ */
+static unsigned
+R_CopyChecksum(const Uint32 *pixels, int count)
+{
+	unsigned crc = 0;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		crc = (crc << 5 | crc >> 27) ^ pixels[i];
+	}
+
+	return crc;
+}
+
+/*
+ * Expands the current frame and searches a difference
+ * in it with all implementations, prints their throughput
+ * in megapixels per second and checks their results.
+ */
+void
+R_CopyBench_f(void)
+{
+	const swcopy_t *list[4];
+	Uint32 palette[256];
+	Uint32 *pixels;
+	pixel_t *front;
+	int count, iterations, num, i;
+	int refstart = 0, refend = 0;
+	unsigned refcrc = 0;
+	Uint64 reference = 0;
+
+	if (!vid_buffer)
+	{
+		return;
+	}
+
+	iterations = (ri.Cmd_Argc() > 1) ? (int)strtol(ri.Cmd_Argv(1), NULL, 10) : 100;
+
+	if (iterations < 1)
+	{
+		iterations = 1;
+	}
+
+	count = vid_buffer_width * vid_buffer_height;
+
+	pixels = malloc(count * sizeof(Uint32));
+	front = malloc(count);
+
+	if (!pixels || !front)
+	{
+		free(pixels);
+		free(front);
+		R_Printf(PRINT_ALL, "%s: Couldn't allocate %d bytes\n",
+			__func__, (int)(count * (sizeof(Uint32) + 1)));
+		return;
+	}
+
+	for (i = 0; i < 256; i++)
+	{
+		palette[i] = 0xFF000000 | (i * 0x010203);
+	}
+
+	// the frame with one changed row in the middle
+	memcpy(front, vid_buffer, count);
+	memset(front + (vid_buffer_height / 2) * vid_buffer_width,
+		vid_buffer[0] ^ 0xFF, vid_buffer_width);
+
+	R_Printf(PRINT_ALL, "Copying %dx%d pixels %d times on %d threads.\n",
+		vid_buffer_width, vid_buffer_height, iterations, R_NumBands());
+
+	num = R_CopyList(list);
+
+	for (i = 0; i < num; i++)
+	{
+		Uint64 start, expand, diff;
+		int diffstart = 0, diffend = 0;
+		unsigned crc;
+		float expandrate, diffrate;
+		int j;
+
+		memset(pixels, 0, count * sizeof(Uint32));
+
+		start = SDL_GetPerformanceCounter();
+
+		for (j = 0; j < iterations; j++)
+		{
+			R_CopyFrameWith(list[i], pixels, vid_buffer_width, vid_buffer,
+				palette, 0, count);
+		}
+
+		expand = SDL_GetPerformanceCounter() - start;
+		start = SDL_GetPerformanceCounter();
+
+		for (j = 0; j < iterations; j++)
+		{
+			diffstart = list[i]->diffstart(vid_buffer, front, 0, count);
+			diffend = list[i]->diffend(vid_buffer, front, 0, count);
+		}
+
+		diff = SDL_GetPerformanceCounter() - start;
+		crc = R_CopyChecksum(pixels, count);
+
+		expand = Q_max(expand, 1);
+		diff = Q_max(diff, 1);
+
+		expandrate = (float)count * iterations / 1000000.0f *
+			SDL_GetPerformanceFrequency() / expand;
+		diffrate = (float)count * iterations / 1000000.0f *
+			SDL_GetPerformanceFrequency() / diff;
+
+		if (i == 0)
+		{
+			reference = expand;
+			refcrc = crc;
+			refstart = diffstart;
+			refend = diffend;
+		}
+
+		R_Printf(PRINT_ALL, "%-5s %8.1f MP/s expand (%.2fx) %9.1f MP/s search%s\n",
+			list[i]->name, expandrate, (float)reference / expand, diffrate,
+			((crc != refcrc) || (diffstart != refstart) || (diffend != refend)) ?
+			" MISMATCH" : "");
+	}
+
+	free(pixels);
+	free(front);
+}
@@ -54,6 +54,11 @@ static edge_t	edge_sentinel;
 static float	fv;
 static int	miplevel;
 
+// surfaces queued for drawing, see D_FlushSpans()
+static spanstate_t	*d_spanstates;
+static int	d_numspanstates, d_maxspanstates;
+int	d_spanseq = 1;
+
 float	scale_for_mip;
 
 static void R_GenerateSpans (void);
@@ -752,25 +757,129 @@ D_MipLevelForScale (float scale)
 
 /*
 ==============
-D_FlatFillSurface
+D_QueueSpans
+
+Captures the current drawing state for the spans of a surface. The
+spans are drawn in D_FlushSpans(), the z buffer damage is tracked
+right away as it depends on the order of the surfaces.
+==============
+*/
+static spanstate_t *
+D_QueueSpans (surf_t *s, void (*drawspans)(const spanstate_t *state, int vstart, int vend),
+	float z_ziorigin, float z_zistepu, float z_zistepv)
+{
+	spanstate_t	*state;
+
+	if (d_numspanstates == d_maxspanstates)
+	{
+		spanstate_t	*states;
+		int	newmax;
+
+		newmax = d_maxspanstates ? d_maxspanstates * 2 : 256;
+		states = realloc(d_spanstates, newmax * sizeof(spanstate_t));
+		if (!states)
+		{
+			if (!d_maxspanstates)
+			{
+				ri.Sys_Error(ERR_FATAL, "%s: Couldn't realloc %d bytes",
+					__func__, (int)(newmax * sizeof(spanstate_t)));
+			}
+
+			// draw what we have and reuse the old array
+			D_FlushSpans();
+		}
+		else
+		{
+			d_spanstates = states;
+			d_maxspanstates = newmax;
+		}
+	}
+
+	state = &d_spanstates[d_numspanstates++];
+
+	state->spans = s->spans;
+	state->drawspans = drawspans;
+	state->cacheblock = cacheblock;
+	state->cachewidth = cachewidth;
+	state->color = 0;
+	state->d_sdivzstepu = d_sdivzstepu;
+	state->d_tdivzstepu = d_tdivzstepu;
+	state->d_sdivzstepv = d_sdivzstepv;
+	state->d_tdivzstepv = d_tdivzstepv;
+	state->d_sdivzorigin = d_sdivzorigin;
+	state->d_tdivzorigin = d_tdivzorigin;
+	state->d_ziorigin = s->d_ziorigin;
+	state->d_zistepu = s->d_zistepu;
+	state->d_zistepv = s->d_zistepv;
+	state->z_ziorigin = z_ziorigin;
+	state->z_zistepu = z_zistepu;
+	state->z_zistepv = z_zistepv;
+	state->sadjust = sadjust;
+	state->tadjust = tadjust;
+	state->bbextents = bbextents;
+	state->bbextentt = bbextentt;
+
+	D_DamageZSpans (s->spans);
+
+	return state;
+}
+
+/*
+==============
+D_DrawSpanStates
 
-Simple single color fill with no texture mapping
+Draws the queued surfaces clipped to the rows of a band
 ==============
 */
 static void
-D_FlatFillSurface (surf_t *surf, pixel_t color)
+D_DrawSpanStates (int band, int vstart, int vend, void *data)
 {
-	espan_t	*span;
+	int	i;
 
-	for (span=surf->spans ; span ; span=span->pnext)
+	for (i = 0; i < d_numspanstates; i++)
 	{
-		pixel_t   *pdest;
+		const spanstate_t	*state = &d_spanstates[i];
+
+		state->drawspans (state, vstart, vend);
+		D_DrawZSpans (state, vstart, vend);
+	}
+}
+
+/*
+==============
+D_FlushSpans
+
+Draws all queued surfaces. Needs to be called before the spans
+or a surface cache block one of them reads from are reused.
+==============
+*/
+void
+D_FlushSpans (void)
+{
+	// the cache blocks of the spans
+	D_BuildSurfaces ();
 
-		pdest = d_viewbuffer + vid_buffer_width*span->v + span->u;
-		memset(pdest,  color&0xFF, span->count * sizeof(pixel_t));
+	if (d_numspanstates)
+	{
+		R_RunBands (D_DrawSpanStates, NULL, r_refdef.vrect.y, r_refdef.vrectbottom);
+		d_numspanstates = 0;
 	}
+
+	d_spanseq++;
 }
 
+/*
+==============
+D_ShutdownSpans
+==============
+*/
+void
+D_ShutdownSpans (void)
+{
+	free(d_spanstates);
+	d_spanstates = NULL;
+	d_numspanstates = d_maxspanstates = 0;
+}
 
 /*
 ==============
@@ -840,10 +949,12 @@ The grey background filler seen when there is a hole in the map
 static void
 D_BackgroundSurf (surf_t *s)
 {
-	D_FlatFillSurface (s, (int)sw_clearcolor->value & 0xFF);
+	spanstate_t	*state;
+
 	// set up a gradient for the background surface that places it
 	// effectively at infinity distance from the viewpoint
-	D_DrawZSpans (s->spans, -0.9, 0, 0);
+	state = D_QueueSpans (s, D_FlatFillSpans, -0.9, 0, 0);
+	state->color = (int)sw_clearcolor->value & 0xFF;
 }
 
 /*
@@ -880,13 +991,11 @@ D_TurbulentSurf(surf_t *s)
 	//============
 	// textures that aren't warping are just flowing. Use NonTurbulentPow2 instead
 	if(!(pface->texinfo->flags & SURF_WARP))
-		NonTurbulentPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		D_QueueSpans (s, NonTurbulentPow2, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 	else
-		TurbulentPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		D_QueueSpans (s, TurbulentPow2, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 	//============
 
-	D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
-
 	if (s->insubmodel)
 	{
 		//
@@ -920,11 +1029,9 @@ D_SkySurf (surf_t *s)
 
 	D_CalcGradients (pface, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
-	D_DrawSpansPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
-
 	// set up a gradient for the background surface that places it
 	// effectively at infinity distance from the viewpoint
-	D_DrawZSpans (s->spans, -0.9, 0, 0);
+	D_QueueSpans (s, D_DrawSpansPow2, -0.9, 0, 0);
 }
 
 /*
@@ -969,12 +1076,12 @@ D_SolidSurf (entity_t *currententity, surf_t *s)
 
 	cacheblock = (pixel_t *)pcurrentcache->data;
 	cachewidth = pcurrentcache->width;
+	// the block must not be reused until the spans are drawn
+	pcurrentcache->spanseq = d_spanseq;
 
 	D_CalcGradients (pface, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
-	D_DrawSpansPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
-
-	D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	D_QueueSpans (s, D_DrawSpansPow2, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
 	if (s->insubmodel)
 	{
@@ -1007,13 +1114,15 @@ D_DrawflatSurfaces (const surf_t *surface)
 
 	for (s = &surfaces[1] ; s<surface ; s++)
 	{
+		spanstate_t	*state;
+
 		if (!s->spans)
 			continue;
 
 		// make a stable color for each surface by taking the low
 		// bits of the msurface pointer
-		D_FlatFillSurface (s, color & 0xFF);
-		D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		state = D_QueueSpans (s, D_FlatFillSpans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		state->color = color & 0xFF;
 
 		color ++;
 	}
@@ -1058,6 +1167,8 @@ D_DrawSurfaces (entity_t *currententity, surf_t *surface)
 	else
 		D_DrawflatSurfaces (surface);
 
+	D_FlushSpans ();
+
 	VectorSubtract (r_origin, vec3_origin, modelorg);
 	R_TransformFrustum ();
 }
@@ -76,7 +76,7 @@ LIGHT SAMPLING
 =============================================================================
 */
 static int
-RecursiveLightPoint (mnode_t *node, vec3_t start, vec3_t end, vec3_t pointcolor)
+RecursiveLightPoint (mnode_t *node, vec3_t start, vec3_t end, lightsample_t *sample)
 {
 	float		front, back, frac;
 	qboolean	side;
@@ -101,7 +101,7 @@ RecursiveLightPoint (mnode_t *node, vec3_t start, vec3_t end, vec3_t pointcolor)
 	side = front < 0;
 
 	if ( (back < 0) == side)
-		return RecursiveLightPoint (node->children[side], start, end, pointcolor);
+		return RecursiveLightPoint (node->children[side], start, end, sample);
 
 	frac = front / (front-back);
 	mid[0] = start[0] + (end[0] - start[0])*frac;
@@ -111,7 +111,7 @@ RecursiveLightPoint (mnode_t *node, vec3_t start, vec3_t end, vec3_t pointcolor)
 		mid[plane->type] = plane->dist;
 
 	// go down front side
-	r = RecursiveLightPoint (node->children[side], start, mid, pointcolor);
+	r = RecursiveLightPoint (node->children[side], start, mid, sample);
 	if (r >= 0)
 		return r;	// hit something
 
@@ -145,26 +145,13 @@ RecursiveLightPoint (mnode_t *node, vec3_t start, vec3_t end, vec3_t pointcolor)
 		dt >>= 4;
 
 		lightmap = surf->samples;
-		VectorCopy (vec3_origin, pointcolor);
-
 		lightmap += 3 * (dt * ((surf->extents[0] >> 4) + 1) + ds);
 
 		for (maps = 0 ; maps < MAXLIGHTMAPS && surf->styles[maps] != 255 ;
 				maps++)
 		{
-			const float *rgb;
-			int j;
-
-			rgb = r_newrefdef.lightstyles[surf->styles[maps]].rgb;
-
-			/* Apply light level to models */
-			for (j = 0; j < 3; j++)
-			{
-				float	scale;
-
-				scale = rgb[j] * r_modulate->value;
-				pointcolor[j] += lightmap[j] * scale * (1.0 / 255);
-			}
+			sample->styles[maps] = surf->styles[maps];
+			VectorCopy (lightmap, sample->rgb[maps]);
 
 			lightmap += 3 * ((surf->extents[0] >> 4) + 1) *
 						((surf->extents[1] >> 4) + 1);
@@ -174,7 +161,29 @@ RecursiveLightPoint (mnode_t *node, vec3_t start, vec3_t end, vec3_t pointcolor)
 	}
 
 	// go down back side
-	return RecursiveLightPoint (node->children[!side], mid, end, pointcolor);
+	return RecursiveLightPoint (node->children[!side], mid, end, sample);
+}
+
+/*
+===============
+R_SampleLight
+
+Traces down from p and returns the lightmap
+samples of the first surface that's hit
+===============
+*/
+void
+R_SampleLight (const vec3_t p, lightsample_t *sample)
+{
+	vec3_t		start, end;
+
+	memset (sample->styles, 255, sizeof(sample->styles));
+
+	VectorCopy (p, start);
+	VectorCopy (p, end);
+	end[2] -= 2048;
+
+	RecursiveLightPoint (r_worldmodel->nodes, start, end, sample);
 }
 
 /*
@@ -185,12 +194,9 @@ R_LightPoint
 void
 R_LightPoint (const entity_t *currententity, vec3_t p, vec3_t color)
 {
-	vec3_t		end;
-	float		r;
 	int			lnum;
 	dlight_t	*dl;
 	vec3_t		dist;
-	vec3_t		pointcolor;
 
 	if (!r_worldmodel->lightdata)
 	{
@@ -198,19 +204,13 @@ R_LightPoint (const entity_t *currententity, vec3_t p, vec3_t color)
 		return;
 	}
 
-	end[0] = p[0];
-	end[1] = p[1];
-	end[2] = p[2] - 2048;
-
-	r = RecursiveLightPoint (r_worldmodel->nodes, p, end, pointcolor);
-
-	if (r == -1)
+	if (!R_LightGridPoint (p, r_newrefdef.lightstyles, r_modulate->value, color))
 	{
-		VectorCopy (vec3_origin, color);
-	}
-	else
-	{
-		VectorCopy (pointcolor, color);
+		lightsample_t	sample;
+
+		R_SampleLight (p, &sample);
+		R_LightSampleColor (&sample, r_newrefdef.lightstyles,
+			r_modulate->value, color);
 	}
 
 	//
@@ -244,7 +244,7 @@ R_AddDynamicLights
 ===============
 */
 static void
-R_AddDynamicLights (drawsurf_t* drawsurf)
+R_AddDynamicLights (drawsurf_t* drawsurf, light_t *lights)
 {
 	msurface_t 	*surf;
 	int		lnum;
@@ -256,12 +256,6 @@ R_AddDynamicLights (drawsurf_t* drawsurf)
 	tmax = (surf->extents[1]>>4)+1;
 	tex = surf->texinfo;
 
-	if (blocklight_max <= blocklights + smax*tmax*3)
-	{
-		r_outoflights = true;
-		return;
-	}
-
 	for (lnum=0; lnum < r_newrefdef.num_dlights; lnum++)
 	{
 		vec3_t impact, local, color;
@@ -270,7 +264,7 @@ R_AddDynamicLights (drawsurf_t* drawsurf)
 		int		i;
 		dlight_t	*dl;
 		int		negativeLight;
-		light_t *plightdest = blocklights;
+		light_t *plightdest = lights;
 
 		if (!(surf->dlightbits & (1<<lnum)))
 			continue;	// not lit by this light
@@ -365,11 +359,12 @@ R_AddDynamicLights (drawsurf_t* drawsurf)
 ===============
 R_BuildLightMap
 
-Combine and scale multiple lightmaps into the 8.8 format in blocklights
+Combine and scale multiple lightmaps into the 8.8 format in lights.
+Returns false if they don't fit, called from several threads at once.
 ===============
 */
-void
-R_BuildLightMap (drawsurf_t* drawsurf)
+qboolean
+R_BuildLightMap (drawsurf_t* drawsurf, light_t *lights, const light_t *lights_max)
 {
 	int			smax, tmax;
 	int			size;
@@ -382,18 +377,17 @@ R_BuildLightMap (drawsurf_t* drawsurf)
 	tmax = (surf->extents[1]>>4)+1;
 	size = smax*tmax*3;
 
-	if (blocklight_max <= blocklights + size)
+	if (lights_max <= lights + size)
 	{
-		r_outoflights = true;
-		return;
+		return false;
 	}
 
 	// clear to no light
-	memset(blocklights, 0, size * sizeof(light_t));
+	memset(lights, 0, size * sizeof(light_t));
 
 	if (r_fullbright->value || !r_worldmodel->lightdata)
 	{
-		return;
+		return true;
 	}
 
 	// add all the lightmaps
@@ -408,8 +402,8 @@ R_BuildLightMap (drawsurf_t* drawsurf)
 			unsigned scale;
 			light_t  *curr_light, *max_light;
 
-			curr_light = blocklights;
-			max_light = blocklights + size;
+			curr_light = lights;
+			max_light = lights + size;
 
 			scale = drawsurf->lightadj[maps];	// 8.8 fraction
 
@@ -453,14 +447,14 @@ R_BuildLightMap (drawsurf_t* drawsurf)
 
 	// add all the dynamic lights
 	if (surf->dlightframe == r_framecount)
-		R_AddDynamicLights (drawsurf);
+		R_AddDynamicLights (drawsurf, lights);
 
 	// bound, invert, and shift
 	{
 		light_t  *curr_light, *max_light;
 
-		curr_light = blocklights;
-		max_light = blocklights + size;
+		curr_light = lights;
+		max_light = lights + size;
 
 		do
 		{
@@ -480,4 +474,6 @@ R_BuildLightMap (drawsurf_t* drawsurf)
 		}
 		while(curr_light < max_light);
 	}
+
+	return true;
 }
@@ -427,6 +427,9 @@ R_RegisterVariables (void)
 	ri.Cmd_AddCommand("modellist", Mod_Modellist_f);
 	ri.Cmd_AddCommand("screenshot", R_ScreenShot_f);
 	ri.Cmd_AddCommand("imagelist", R_ImageList_f);
+	ri.Cmd_AddCommand("sw_surfcache_stats", D_SurfCacheStats_f);
+	ri.Cmd_AddCommand("sw_copybench", R_CopyBench_f);
+	ri.Cmd_AddCommand("r_cullbench", R_CullBench_f);
 
 	r_mode->modified = true; // force us to do mode specific stuff later
 	vid_gamma->modified = true; // force us to rebuild the gamma table later
@@ -441,6 +444,9 @@ R_UnRegister (void)
 	ri.Cmd_RemoveCommand( "screenshot" );
 	ri.Cmd_RemoveCommand( "modellist" );
 	ri.Cmd_RemoveCommand( "imagelist" );
+	ri.Cmd_RemoveCommand( "sw_surfcache_stats" );
+	ri.Cmd_RemoveCommand( "sw_copybench" );
+	ri.Cmd_RemoveCommand( "r_cullbench" );
 }
 
 static void RE_ShutdownContext(void);
@@ -461,6 +467,8 @@ RE_Init(void)
 	R_InitImages ();
 	Mod_Init ();
 	Draw_InitLocal ();
+	R_InitThreads ();
+	R_InitCopy ();
 
 	view_clipplanes[0].leftedge = true;
 	view_clipplanes[1].rightedge = true;
@@ -524,8 +532,13 @@ RE_Shutdown (void)
 		vid_colormap = NULL;
 	}
 
+	R_ShutdownThreads ();
+	D_ShutdownSpans ();
+	D_ShutdownSurfaces ();
+
 	R_UnRegister ();
 	Mod_FreeAll ();
+	R_FreeVisCache ();
 	R_ShutdownImages ();
 
 	RE_ShutdownContext();
@@ -756,9 +769,7 @@ static void
 R_MarkLeaves (void)
 {
 	const byte	*vis;
-	mnode_t	*node;
 	int		i;
-	mleaf_t	*leaf;
 
 	if (r_oldviewcluster == r_viewcluster && !r_novis->value && r_viewcluster != -1)
 		return;
@@ -781,27 +792,36 @@ R_MarkLeaves (void)
 		return;
 	}
 
+	if (R_MarkCachedLeaves(r_worldmodel->leafs, r_viewcluster, r_viewcluster,
+		r_visframecount))
+		return;
+
 	vis = Mod_ClusterPVS (r_viewcluster, r_worldmodel);
 
-	for (i=0,leaf=r_worldmodel->leafs ; i<r_worldmodel->numleafs ; i++, leaf++)
-	{
-		int cluster;
+	R_MarkVisibleLeaves(r_worldmodel->leafs, r_worldmodel->numleafs,
+		r_worldmodel->numnodes, vis, r_viewcluster, r_viewcluster,
+		r_visframecount);
+}
 
-		cluster = leaf->cluster;
-		if (cluster == -1)
-			continue;
-		if (vis[cluster>>3] & (1<<(cluster&7)))
-		{
-			node = (mnode_t *)leaf;
-			do
-			{
-				if (node->visframe == r_visframecount)
-					break;
-				node->visframe = r_visframecount;
-				node = node->parent;
-			} while (node);
-		}
+static const byte *
+R_WorldClusterPVS(int cluster)
+{
+	return Mod_ClusterPVS(cluster, r_worldmodel);
+}
+
+void
+R_CullBench_f(void)
+{
+	if (!r_worldmodel)
+	{
+		R_Printf(PRINT_ALL, "r_cullbench needs a map.\n");
+		return;
 	}
+
+	R_CullBench(r_worldmodel->nodes, r_worldmodel->leafs, r_worldmodel->numleafs,
+		r_worldmodel->numnodes, R_WorldClusterPVS);
+
+	r_oldviewcluster = -1;	// force markleafs
 }
 
 /*
@@ -1321,6 +1341,12 @@ RE_RenderFrame (refdef_t *fd)
 		ri.Sys_Error(ERR_FATAL, "%s: NULL worldmodel", __func__);
 	}
 
+	// sw_threads changed
+	R_CheckThreads ();
+
+	// grow the surface cache if it's thrashing
+	D_CheckCacheSize ();
+
 	// Need to rerender whole frame
 	VID_WholeDamageBuffer();
 
@@ -1346,6 +1372,11 @@ RE_RenderFrame (refdef_t *fd)
 	if (r_speeds->value || r_dspeeds->value)
 		r_time1 = SDL_GetTicks();
 
+	d_surfsbuilt = d_texelsbuilt = 0;
+	d_surfbuildms = 0;
+
+	ri.Vid_MarkPhase(PHASE_WORLD);
+
 	R_SetupFrame ();
 
 	R_SetFrustum(vup, vpn, vright, r_origin, r_newrefdef.fov_x, r_newrefdef.fov_y,
@@ -1385,6 +1416,7 @@ RE_RenderFrame (refdef_t *fd)
 	}
 	// Draw enemies, barrel etc...
 	// Use Z-Buffer mostly in read mode only.
+	ri.Vid_MarkPhase(PHASE_ENTITIES);
 	R_DrawEntitiesOnList ();
 
 	if (r_dspeeds->value)
@@ -1394,6 +1426,7 @@ RE_RenderFrame (refdef_t *fd)
 	}
 
 	// Duh !
+	ri.Vid_MarkPhase(PHASE_PARTICLES);
 	R_DrawParticles ();
 
 	if (r_dspeeds->value)
@@ -1826,6 +1859,7 @@ GetRefAPI(refimport_t imp)
 
 	refexport.api_version = API_VERSION;
 	refexport.framework_version = ver.major;
+	refexport.max_particles = MAX_PARTICLES;
 
 	refexport.BeginRegistration = RE_BeginRegistration;
 	refexport.RegisterModel = RE_RegisterModel;
@@ -2109,79 +2143,20 @@ char shift_size;
 static void
 RE_CopyFrame (Uint32 * pixels, int pitch, int vmin, int vmax)
 {
-	Uint32 *sdl_palette = (Uint32 *)sw_state.currentpalette;
-
-	// no gaps between images rows
-	if (pitch == vid_buffer_width)
-	{
-		const Uint32	*max_pixels;
-		Uint32	*pixels_pos;
-		pixel_t	*buffer_pos;
-
-		max_pixels = pixels + vmax;
-		buffer_pos = vid_buffer + vmin;
-
-		pixels_pos = pixels + vmin;
-
-		while ( pixels_pos < max_pixels)
-		{
-			*pixels_pos = sdl_palette[*buffer_pos];
-			buffer_pos++;
-			pixels_pos++;
-		}
-	}
-	else
-	{
-		int y,x, buffer_pos, ymin, ymax;
-
-		ymin = vmin / vid_buffer_width;
-		ymax = vmax / vid_buffer_width;
-
-		buffer_pos = ymin * vid_buffer_width;
-		pixels += ymin * pitch;
-		for (y=ymin; y < ymax;  y++)
-		{
-			for (x=0; x < vid_buffer_width; x ++)
-			{
-				pixels[x] = sdl_palette[vid_buffer[buffer_pos + x]];
-			}
-			pixels += pitch;
-			buffer_pos += vid_buffer_width;
-		}
-	}
+	R_CopyFrame (pixels, pitch, vid_buffer,
+		(const Uint32 *)sw_state.currentpalette, vmin, vmax);
 }
 
 static int
 RE_BufferDifferenceStart(int vmin, int vmax)
 {
-	int *front_buffer, *back_buffer, *back_max;
-
-	back_buffer = (int*)(swap_frames[0] + vmin);
-	front_buffer = (int*)(swap_frames[1] + vmin);
-	back_max = (int*)(swap_frames[0] + vmax);
-
-	while (back_buffer < back_max && *back_buffer == *front_buffer) {
-		back_buffer ++;
-		front_buffer ++;
-	}
-	return (pixel_t*)back_buffer - swap_frames[0];
+	return R_FrameDifferenceStart(swap_frames[0], swap_frames[1], vmin, vmax);
 }
 
 static int
 RE_BufferDifferenceEnd(int vmin, int vmax)
 {
-	int *front_buffer, *back_buffer, *back_min;
-
-	back_buffer = (int*)(swap_frames[0] + vmax);
-	front_buffer = (int*)(swap_frames[1] + vmax);
-	back_min = (int*)(swap_frames[0] + vmin);
-
-	do {
-		back_buffer --;
-		front_buffer --;
-	} while (back_buffer > back_min && *back_buffer == *front_buffer);
-	// +1 for fully cover changes
-	return (pixel_t*)back_buffer - swap_frames[0] + sizeof(int);
+	return R_FrameDifferenceEnd(swap_frames[0], swap_frames[1], vmin, vmax);
 }
 
 static void
@@ -119,6 +119,8 @@ R_PrintDSpeeds (void)
 
 	R_Printf(PRINT_ALL,"%3i %2ip %2iw %2ib %2is %2ie %2ia\n",
 				ms, dp_time, rw_time, db_time, se_time, de_time, da_time);
+	R_Printf(PRINT_ALL,"%4i surfs rebuilt %7i texels %5.2f ms\n",
+				d_surfsbuilt, d_texelsbuilt, d_surfbuildms);
 }
 
 
@@ -201,7 +201,7 @@ Mod_ForName (char *name, model_t *parent_model, qboolean crash)
 			mod->extradata = Mod_LoadMD2(mod->name, buf, modfilelen,
 				mod->mins, mod->maxs,
 				(struct image_s **)mod->skins, (findimage_t)R_FindImage,
-				&(mod->type));
+				&(mod->type), false);
 			if (!mod->extradata)
 			{
 				ri.Sys_Error(ERR_DROP, "%s: Failed to load %s",
@@ -624,6 +624,8 @@ Mod_LoadBrushModel(model_t *mod, void *buffer, int modfilelen)
 				__func__, mod->name, i, BSPVERSION);
 	}
 
+	mod->checksum = Com_BlockChecksum(buffer, modfilelen);
+
 	// swap all the lumps
 	mod_base = (byte *)header;
 
@@ -704,6 +706,7 @@ RE_BeginRegistration (char *model)
 
 	registration_sequence++;
 	r_oldviewcluster = -1;		// force markleafs
+	R_FreeVisCache ();
 	Com_sprintf (fullname, sizeof(fullname), "maps/%s.bsp", model);
 
 	D_FlushCaches ();
@@ -713,6 +716,9 @@ RE_BeginRegistration (char *model)
 	if ( strcmp(mod_known[0].name, fullname) || flushmap->value)
 		Mod_Free (&mod_known[0]);
 	r_worldmodel = RE_RegisterModel (fullname);
+	Mod_LoadLightGrid (r_worldmodel->name, r_worldmodel->checksum,
+		r_worldmodel->nodes, r_worldmodel->submodels[0].mins,
+		r_worldmodel->submodels[0].maxs, R_SampleLight);
 	R_NewMap ();
 }
 
@@ -813,4 +819,6 @@ Mod_FreeAll (void)
 		if (mod_known[i].extradatasize)
 			Mod_Free (&mod_known[i]);
 	}
+
+	Mod_FreeLightGrid ();
 }
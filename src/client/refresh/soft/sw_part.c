@@ -18,6 +18,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 */
 #include "header/local.h"
+#include "../../header/threads.h"
 
 static vec3_t r_pright, r_pup, r_ppn;
 extern cvar_t	*sw_custom_particles;
@@ -26,6 +27,156 @@ extern cvar_t	*sw_custom_particles;
 #define PARTICLE_66     1
 #define PARTICLE_OPAQUE 2
 
+/* r_partstate, set by the band owning the row of the z test */
+#define PARTICLE_PENDING 0
+#define PARTICLE_DRAW    1
+#define PARTICLE_SKIP    2
+
+/* a projected particle, pix is 0 for culled ones */
+typedef struct
+{
+	int		u, v, pix, zofs;
+	int		level, color;
+	zvalue_t	izi;
+} partproj_t;
+
+static partproj_t	r_partproj[MAX_PARTICLES];
+static yq2_atomic_t	r_partstate[MAX_PARTICLES];
+static int		r_numpartproj;
+
+/*
+** R_ProjectParticles
+**
+** Transforms and projects the particles first to last - 1,
+** called in parallel for ranges of the particle list.
+*/
+static void
+R_ProjectParticles(int band, int first, int last, void *data)
+{
+	int	k;
+
+	for (k = first; k < last; k++)
+	{
+		const particle_t *pparticle = &r_newrefdef.particles[k];
+		partproj_t *proj = &r_partproj[k];
+		vec3_t		local, transformed;
+		float		zi;
+		int		u, v, pix;
+		zvalue_t	izi;
+
+		proj->pix = 0;
+		YQ2_AtomicSet(&r_partstate[k], PARTICLE_PENDING);
+
+		if ( pparticle->alpha > 0.66 )
+			proj->level = PARTICLE_OPAQUE;
+		else if ( pparticle->alpha > 0.33 )
+			proj->level = PARTICLE_66;
+		else
+			proj->level = PARTICLE_33;
+
+		/*
+		** transform the particle
+		*/
+		VectorSubtract (pparticle->origin, r_origin, local);
+
+		transformed[0] = DotProduct(local, r_pright);
+		transformed[1] = DotProduct(local, r_pup);
+		transformed[2] = DotProduct(local, r_ppn);
+
+		if (transformed[2] < PARTICLE_Z_CLIP)
+			continue;
+
+		/*
+		** project the point
+		*/
+		// FIXME: preadjust xcenter and ycenter
+		zi = 1.0 / transformed[2];
+		u = (int)(xcenter + zi * transformed[0] + 0.5);
+		v = (int)(ycenter - zi * transformed[1] + 0.5);
+
+		if ((v > d_vrectbottom_particle) ||
+			(u > d_vrectright_particle) ||
+			(v < d_vrecty) ||
+			(u < d_vrectx))
+		{
+			continue;
+		}
+
+		izi = (int)(zi * 0x8000);
+
+		/*
+		** determine the screen area covered by the particle,
+		** which also means clamping to a min and max
+		*/
+		pix = (izi * d_pix_mul) >> 7;
+		if (pix < d_pix_min)
+			pix = d_pix_min;
+		else if (pix > d_pix_max)
+			pix = d_pix_max;
+
+		proj->u = u;
+		proj->v = v;
+		proj->izi = izi;
+		proj->pix = pix;
+		proj->color = pparticle->color;
+		// the z buffer value deciding if it's visible
+		proj->zofs = (vid_buffer_width * v) + u +
+			(vid_buffer_width * pix / 2) + (pix / 2);
+	}
+}
+
+/*
+** R_ParticleOwner
+**
+** The band drawing the row of the z test of a particle
+*/
+static int
+R_ParticleOwner(const partproj_t *proj)
+{
+	int owner;
+
+	owner = R_BandForRow(proj->zofs / vid_buffer_width);
+	if (owner < 0)
+	{
+		// no band writes that row, any one can decide
+		owner = 0;
+	}
+
+	return owner;
+}
+
+/*
+** R_ParticleVisible
+**
+** The particle is drawn if it's not behind the z buffer at its
+** center. The band owning that row decides, the others wait for
+** it. The owner has drawn all earlier particles into that row.
+*/
+static qboolean
+R_ParticleVisible(int k, int band)
+{
+	const partproj_t *proj = &r_partproj[k];
+	int state, spins;
+
+	if (R_ParticleOwner(proj) == band)
+	{
+		state = (d_pzbuffer[proj->zofs] > proj->izi) ? PARTICLE_SKIP : PARTICLE_DRAW;
+		YQ2_AtomicSet(&r_partstate[k], state);
+
+		return state == PARTICLE_DRAW;
+	}
+
+	for (spins = 0; (state = YQ2_AtomicGet(&r_partstate[k])) == PARTICLE_PENDING; spins++)
+	{
+		if ((spins & 1023) == 1023)
+		{
+			SDL_Delay(0);
+		}
+	}
+
+	return state == PARTICLE_DRAW;
+}
+
 /*
 ** R_DrawParticle
 **
@@ -38,84 +189,55 @@ extern cvar_t	*sw_custom_particles;
 ** To minimize error and improve readability I went the
 ** function pointer route.  This exacts some overhead, but
 ** it pays off in clean and easy to understand code.
+**
+** Only the rows vstart to vend - 1 are drawn.
 */
 static void
-R_DrawParticle(particle_t *pparticle, int level)
+R_DrawParticle(const partproj_t *proj, int vstart, int vend, int custom_particle)
 {
-	vec3_t		local, transformed;
-	float		zi;
 	byte		*pdest;
 	zvalue_t	*pz;
-	int		color = pparticle->color;
-	int		i, pix, count, u, v;
-	zvalue_t	izi;
-	int 		custom_particle = (int)sw_custom_particles->value;
+	int		color = proj->color;
+	int		level = proj->level;
+	int		i, pix, count, last, u, v;
+	zvalue_t	izi = proj->izi;
+
+	u = proj->u;
+	v = proj->v;
+	pix = proj->pix;
 
 	/*
-	** transform the particle
+	** clip the rows to the band, count goes
+	** from pix down to 1 over all rows
 	*/
-	VectorSubtract (pparticle->origin, r_origin, local);
-
-	transformed[0] = DotProduct(local, r_pright);
-	transformed[1] = DotProduct(local, r_pup);
-	transformed[2] = DotProduct(local, r_ppn);
+	count = pix;
+	last = 0;
 
-	if (transformed[2] < PARTICLE_Z_CLIP)
-		return;
+	if (v < vstart)
+	{
+		count -= vstart - v;
+		v = vstart;
+	}
 
-	/*
-	** project the point
-	*/
-	// FIXME: preadjust xcenter and ycenter
-	zi = 1.0 / transformed[2];
-	u = (int)(xcenter + zi * transformed[0] + 0.5);
-	v = (int)(ycenter - zi * transformed[1] + 0.5);
-
-	if ((v > d_vrectbottom_particle) ||
-		(u > d_vrectright_particle) ||
-		(v < d_vrecty) ||
-		(u < d_vrectx))
+	if (v + count > vend)
 	{
-		return;
+		last = v + count - vend;
 	}
 
 	/*
-	** compute addresses of zbuffer, framebuffer, and
-	** compute the Z-buffer reference value.
+	** compute addresses of zbuffer, framebuffer
 	*/
 	pz = d_pzbuffer + (vid_buffer_width * v) + u;
 	pdest = d_viewbuffer + vid_buffer_width * v + u;
-	izi = (int)(zi * 0x8000);
-
-	/*
-	** determine the screen area covered by the particle,
-	** which also means clamping to a min and max
-	*/
-	pix = (izi * d_pix_mul) >> 7;
-	if (pix < d_pix_min)
-		pix = d_pix_min;
-	else if (pix > d_pix_max)
-		pix = d_pix_max;
 
 	/*
 	** render the appropriate pixels
 	*/
-	count = pix;
-	if ((pz[(vid_buffer_width * count / 2) + (count / 2)]) > izi)
-	{
-		// looks like under some object
-		return;
-	}
-
-	// zbuffer particles damage
-	VID_DamageZBuffer(u, v);
-	VID_DamageZBuffer(u + count, v + count);
-
 	if (custom_particle == 0)
 	{
 		switch (level) {
 		case PARTICLE_33 :
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > last ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				//FIXME--do it in blocks of 8?
 				for (i=0 ; i<pix ; i++)
@@ -132,7 +254,7 @@ R_DrawParticle(particle_t *pparticle, int level)
 		case PARTICLE_66 :
 		{
 			int color_part = (color<<8);
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > last ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				for (i=0 ; i<pix ; i++)
 				{
@@ -147,7 +269,7 @@ R_DrawParticle(particle_t *pparticle, int level)
 		}
 
 		default:  //100
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > last ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				for (i=0 ; i<pix ; i++)
 				{
@@ -169,7 +291,7 @@ R_DrawParticle(particle_t *pparticle, int level)
 
 		switch (level) {
 		case PARTICLE_33 :
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > last ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				//FIXME--do it in blocks of 8?
 				for (i=0 ; i<pix ; i++)
@@ -187,7 +309,7 @@ R_DrawParticle(particle_t *pparticle, int level)
 		case PARTICLE_66 :
 		{
 			int color_part = (color<<8);
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > last ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				for (i=0 ; i<pix ; i++)
 				{
@@ -203,7 +325,7 @@ R_DrawParticle(particle_t *pparticle, int level)
 		}
 
 		default:  //100
-			for ( ; count ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
+			for ( ; count > last ; count--, pz += vid_buffer_width, pdest += vid_buffer_width)
 			{
 				for (i=0 ; i<pix ; i++)
 				{
@@ -220,35 +342,80 @@ R_DrawParticle(particle_t *pparticle, int level)
 	}
 }
 
+/*
+** R_DrawParticleBand
+**
+** Draws the rows vstart to vend - 1 of all particles, in order.
+*/
+static void
+R_DrawParticleBand(int band, int vstart, int vend, void *data)
+{
+	int custom_particle = (int)sw_custom_particles->value;
+	int k;
+
+	for (k = 0; k < r_numpartproj; k++)
+	{
+		const partproj_t *proj = &r_partproj[k];
+
+		if (!proj->pix)
+		{
+			continue;
+		}
+
+		// the owner of the z test row must see every particle
+		if (((proj->v >= vend) || (proj->v + proj->pix <= vstart)) &&
+			(R_ParticleOwner(proj) != band))
+		{
+			continue;
+		}
+
+		if (!R_ParticleVisible(k, band))
+		{
+			continue;
+		}
+
+		if ((proj->v < vend) && (proj->v + proj->pix > vstart))
+		{
+			R_DrawParticle(proj, vstart, vend, custom_particle);
+		}
+	}
+}
+
 /*
 ** R_DrawParticles
 **
 ** Responsible for drawing all of the particles in the particle list
-** throughout the world.  Doesn't care if we're using the C path or
-** if we're using the asm path, it simply assigns a function pointer
-** and goes.
+** throughout the world. They're projected and then drawn in bands,
+** see sw_threads.c.
 */
 void
 R_DrawParticles (void)
 {
-	particle_t *p;
-	int         i;
+	int	k;
 
 	VectorScale( vright, xscaleshrink, r_pright );
 	VectorScale( vup, yscaleshrink, r_pup );
 	VectorCopy( vpn, r_ppn );
 
-	for (p=r_newrefdef.particles, i=0 ; i<r_newrefdef.num_particles ; i++,p++)
+	if (r_newrefdef.num_particles <= 0)
 	{
-		int level;
+		return;
+	}
 
-		if ( p->alpha > 0.66 )
-			level = PARTICLE_OPAQUE;
-		else if ( p->alpha > 0.33 )
-			level = PARTICLE_66;
-		else
-			level = PARTICLE_33;
+	r_numpartproj = Q_min(r_newrefdef.num_particles, MAX_PARTICLES);
 
-		R_DrawParticle(p, level);
+	R_RunBands(R_ProjectParticles, NULL, 0, r_numpartproj);
+	R_RunBands(R_DrawParticleBand, NULL, 0, vid_buffer_height);
+
+	// zbuffer particles damage
+	for (k = 0; k < r_numpartproj; k++)
+	{
+		const partproj_t *proj = &r_partproj[k];
+
+		if (YQ2_AtomicGet(&r_partstate[k]) == PARTICLE_DRAW)
+		{
+			VID_DamageZBuffer(proj->u, proj->v);
+			VID_DamageZBuffer(proj->u + proj->pix, proj->v + proj->pix);
+		}
 	}
 }
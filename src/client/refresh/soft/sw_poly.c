@@ -1090,6 +1090,7 @@ R_BuildPolygonFromSurface(const entity_t *currententity, const model_t *currentm
 		surfcache_t *scache;
 
 		scache = D_CacheSurface(currententity, fa, 0);
+		D_BuildSurfaces();
 
 		r_polydesc.pixels       = scache->data;
 		r_polydesc.pixel_width  = scache->width;
@@ -29,6 +29,38 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 byte	**warp_rowptr;
 int	*warp_column;
 
+/*
+=============
+D_WarpRows
+
+Warps the rows vstart to vend - 1 of the view, a band of D_WarpScreen
+=============
+*/
+static void
+D_WarpRows (int band, int vstart, int vend, void *data)
+{
+	int	*turb = (int *)data;
+	int	w = r_newrefdef.width;
+	pixel_t	*dest;
+	int	v;
+
+	dest = vid_buffer + (r_newrefdef.y + vstart) * vid_buffer_width + r_newrefdef.x;
+
+	for (v=vstart ; v<vend ; v++, dest += vid_buffer_width)
+	{
+		int	*col;
+		byte	**row;
+		int	u;
+
+		col = warp_column + turb[v];
+		row = warp_rowptr + v;
+		for (u=0 ; u<w ; u++)
+		{
+			dest[u] = row[turb[u]][col[u]];
+		}
+	}
+}
+
 /*
 =============
 D_WarpScreen
@@ -42,9 +74,7 @@ D_WarpScreen (void)
 {
 	int	w, h;
 	int	u,v;
-	pixel_t	*dest;
 	int	*turb;
-	byte	**row;
 
 	static int	cached_width, cached_height;
 
@@ -75,19 +105,8 @@ D_WarpScreen (void)
 	}
 
 	turb = intsintable + ((int)(r_newrefdef.time*SPEED)&(CYCLE-1));
-	dest = vid_buffer + r_newrefdef.y * vid_buffer_width + r_newrefdef.x;
 
-	for (v=0 ; v<h ; v++, dest += vid_buffer_width)
-	{
-		int *col;
-
-		col = warp_column + turb[v];
-		row = warp_rowptr + v;
-		for (u=0 ; u<w ; u++)
-		{
-			dest[u] = row[turb[u]][col[u]];
-		}
-	}
+	R_RunBands(D_WarpRows, turb, 0, h);
 }
 
 
@@ -184,8 +203,17 @@ TurbulentPow2
 =============
 */
 void
-TurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv)
+TurbulentPow2 (const spanstate_t *state, int vstart, int vend)
 {
+	// the surface's gradients, see spanstate_t
+	float	d_sdivzstepu = state->d_sdivzstepu, d_tdivzstepu = state->d_tdivzstepu;
+	float	d_sdivzstepv = state->d_sdivzstepv, d_tdivzstepv = state->d_tdivzstepv;
+	float	d_sdivzorigin = state->d_sdivzorigin, d_tdivzorigin = state->d_tdivzorigin;
+	float	d_ziorigin = state->d_ziorigin;
+	float	d_zistepu = state->d_zistepu, d_zistepv = state->d_zistepv;
+	int	sadjust = state->sadjust, tadjust = state->tadjust;
+	int	bbextents = state->bbextents, bbextentt = state->bbextentt;
+	espan_t	*pspan = state->spans;
 	float	spancountminus1;
 	float	sdivzpow2stepu, tdivzpow2stepu, zipow2stepu;
 	pixel_t	*r_turb_pbase;
@@ -197,7 +225,7 @@ TurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistep
 
 	r_turb_turb = sintable + ((int)(r_newrefdef.time*SPEED)&(CYCLE-1));
 
-	r_turb_pbase = (unsigned char *)cacheblock;
+	r_turb_pbase = (unsigned char *)state->cacheblock;
 
 	sdivzpow2stepu = d_sdivzstepu * spanstep_value;
 	tdivzpow2stepu = d_tdivzstepu * spanstep_value;
@@ -209,6 +237,11 @@ TurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistep
 		float sdivz, tdivz, zi, z, du, dv;
 		pixel_t	*r_turb_pdest;
 
+		if ((pspan->v < vstart) || (pspan->v >= vend))
+		{
+			continue;
+		}
+
 		r_turb_pdest = d_viewbuffer + (vid_buffer_width * pspan->v) + pspan->u;
 
 		count = pspan->count;
@@ -338,8 +371,17 @@ NonTurbulentPow2 - this is for drawing scrolling textures. they're warping water
 =============
 */
 void
-NonTurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv)
+NonTurbulentPow2 (const spanstate_t *state, int vstart, int vend)
 {
+	// the surface's gradients, see spanstate_t
+	float	d_sdivzstepu = state->d_sdivzstepu, d_tdivzstepu = state->d_tdivzstepu;
+	float	d_sdivzstepv = state->d_sdivzstepv, d_tdivzstepv = state->d_tdivzstepv;
+	float	d_sdivzorigin = state->d_sdivzorigin, d_tdivzorigin = state->d_tdivzorigin;
+	float	d_ziorigin = state->d_ziorigin;
+	float	d_zistepu = state->d_zistepu, d_zistepv = state->d_zistepv;
+	int	sadjust = state->sadjust, tadjust = state->tadjust;
+	int	bbextents = state->bbextents, bbextentt = state->bbextentt;
+	espan_t	*pspan = state->spans;
 	float spancountminus1;
 	float sdivzpow2stepu, tdivzpow2stepu, zipow2stepu;
 	pixel_t	*r_turb_pbase;
@@ -351,7 +393,7 @@ NonTurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zis
 
 	r_turb_turb = blanktable;
 
-	r_turb_pbase = (unsigned char *)cacheblock;
+	r_turb_pbase = (unsigned char *)state->cacheblock;
 
 	sdivzpow2stepu = d_sdivzstepu * spanstep_value;
 	tdivzpow2stepu = d_tdivzstepu * spanstep_value;
@@ -363,6 +405,11 @@ NonTurbulentPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zis
 		float sdivz, tdivz, zi, z, dv, du;
 		pixel_t	*r_turb_pdest;
 
+		if ((pspan->v < vstart) || (pspan->v >= vend))
+		{
+			continue;
+		}
+
 		r_turb_pdest = d_viewbuffer + (vid_buffer_width * pspan->v) + pspan->u;
 
 		count = pspan->count;
@@ -505,7 +552,8 @@ D_DrawSpan
 =============
 */
 static pixel_t *
-D_DrawSpan(pixel_t *pdest, const pixel_t *pbase, int s, int t, int sstep, int tstep, int spancount)
+D_DrawSpan(pixel_t *pdest, const pixel_t *pbase, int cachewidth, int s, int t,
+	int sstep, int tstep, int spancount)
 {
 	const pixel_t *tdest_max = pdest + spancount;
 
@@ -553,8 +601,8 @@ D_DrawSpanFiltered
 =============
 */
 static pixel_t *
-D_DrawSpanFiltered(pixel_t *pdest, pixel_t *pbase, int s, int t, int sstep, int tstep, int spancount,
-	   const espan_t *pspan)
+D_DrawSpanFiltered(pixel_t *pdest, pixel_t *pbase, int cachewidth, int s, int t,
+	int sstep, int tstep, int spancount, const espan_t *pspan)
 {
 	do
 	{
@@ -590,8 +638,18 @@ D_DrawSpansPow2
 =============
 */
 void
-D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv)
+D_DrawSpansPow2 (const spanstate_t *state, int vstart, int vend)
 {
+	// the surface's gradients, see spanstate_t
+	float	d_sdivzstepu = state->d_sdivzstepu, d_tdivzstepu = state->d_tdivzstepu;
+	float	d_sdivzstepv = state->d_sdivzstepv, d_tdivzstepv = state->d_tdivzstepv;
+	float	d_sdivzorigin = state->d_sdivzorigin, d_tdivzorigin = state->d_tdivzorigin;
+	float	d_ziorigin = state->d_ziorigin;
+	float	d_zistepu = state->d_zistepu, d_zistepv = state->d_zistepv;
+	int	sadjust = state->sadjust, tadjust = state->tadjust;
+	int	bbextents = state->bbextents, bbextentt = state->bbextentt;
+	espan_t	*pspan = state->spans;
+	int	cachewidth = state->cachewidth;
 	int 	spancount;
 	pixel_t	*pbase;
 	int	snext, tnext;
@@ -603,7 +661,7 @@ D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zist
 	spanstep_shift = D_DrawSpanGetStep(d_zistepu, d_zistepv);
 	spanstep_value = (1 << spanstep_shift);
 
-	pbase = (unsigned char *)cacheblock;
+	pbase = (unsigned char *)state->cacheblock;
 
 	texture_filtering = (int)sw_texture_filtering->value;
 	sdivzpow2stepu = d_sdivzstepu * spanstep_value;
@@ -616,6 +674,11 @@ D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zist
 		int	count, s, t;
 		float	sdivz, tdivz, zi, z, du, dv;
 
+		if ((pspan->v < vstart) || (pspan->v >= vend))
+		{
+			continue;
+		}
+
 		pdest = d_viewbuffer + (vid_buffer_width * pspan->v) + pspan->u;
 
 		count = pspan->count;
@@ -721,12 +784,12 @@ D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zist
 			// Drawing phrase
 			if ((texture_filtering == 0) || fastmoving)
 			{
-				pdest = D_DrawSpan(pdest, pbase, s, t, sstep, tstep,
+				pdest = D_DrawSpan(pdest, pbase, cachewidth, s, t, sstep, tstep,
 						   spancount);
 			}
 			else
 			{
-				pdest = D_DrawSpanFiltered(pdest, pbase, s, t, sstep, tstep,
+				pdest = D_DrawSpanFiltered(pdest, pbase, cachewidth, s, t, sstep, tstep,
 						   spancount, pspan);
 			}
 			s = snext;
@@ -736,16 +799,72 @@ D_DrawSpansPow2 (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zist
 	} while ((pspan = pspan->pnext) != NULL);
 }
 
+/*
+=============
+D_DamageZSpans
+
+Decides which spans need their z values written, the z buffer may
+still be valid from the last frame. Must be called in drawing order,
+as the damaged area grows with every span.
+=============
+*/
+void
+D_DamageZSpans (espan_t *pspan)
+{
+	do
+	{
+		pspan->skipz = !VID_CheckDamageZBuffer(pspan->u, pspan->v, pspan->count, 0);
+
+		if (pspan->skipz)
+		{
+			continue;
+		}
+
+		// solid map walls damage
+		VID_DamageZBuffer(pspan->u, pspan->v);
+		VID_DamageZBuffer(pspan->u + pspan->count, pspan->v);
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_FlatFillSpans
+
+Simple single color fill with no texture mapping
+=============
+*/
+void
+D_FlatFillSpans (const spanstate_t *state, int vstart, int vend)
+{
+	espan_t	*span;
+
+	for (span = state->spans; span; span = span->pnext)
+	{
+		pixel_t   *pdest;
+
+		if ((span->v < vstart) || (span->v >= vend))
+		{
+			continue;
+		}
+
+		pdest = d_viewbuffer + vid_buffer_width*span->v + span->u;
+		memset(pdest, state->color & 0xFF, span->count * sizeof(pixel_t));
+	}
+}
+
 /*
 =============
 D_DrawZSpans
 =============
 */
 void
-D_DrawZSpans (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv)
+D_DrawZSpans (const spanstate_t *state, int vstart, int vend)
 {
 	zvalue_t	izistep;
 	int		safe_step;
+	float		d_ziorigin = state->z_ziorigin;
+	float		d_zistepu = state->z_zistepu, d_zistepv = state->z_zistepv;
+	espan_t		*pspan = state->spans;
 
 	// FIXME: check for clamping/range problems
 	// we count on FP exceptions being turned off to avoid range problems
@@ -760,15 +879,11 @@ D_DrawZSpans (espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv
 		float		zi;
 		float		du, dv;
 
-		if (!VID_CheckDamageZBuffer(pspan->u, pspan->v, pspan->count, 0))
+		if (pspan->skipz || (pspan->v < vstart) || (pspan->v >= vend))
 		{
 			continue;
 		}
 
-		// solid map walls damage
-		VID_DamageZBuffer(pspan->u, pspan->v);
-		VID_DamageZBuffer(pspan->u + pspan->count, pspan->v);
-
 		pdest = d_pzbuffer + (vid_buffer_width * pspan->v) + pspan->u;
 
 		count = pspan->count;
@@ -20,22 +20,73 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // sw_surf.c: surface-related refresh code
 
 #include "header/local.h"
+#include "../../header/threads.h"
 
-static int		sourcetstep;
-static void		*prowdestbase;
-static unsigned char	*pbasesource;
-static int		r_stepback;
-static int		r_lightwidth;
-static int		r_numvblocks;
-static unsigned char	*r_source, *r_sourcemax;
-static unsigned		*r_lightptr;
+// state of one surface being rasterized into the cache
+typedef struct
+{
+	int		sourcetstep;
+	pixel_t		*prowdestbase;
+	pixel_t		*pbasesource;
+	int		stepback;
+	int		lightwidth;
+	int		numvblocks;
+	pixel_t		*source, *sourcemax;
+	light_t		*lightptr;
+} surfblock_t;
+
+// a cache block waiting to be built, see D_BuildSurfaces()
+typedef struct
+{
+	drawsurf_t	drawsurf;
+	qboolean	outoflights;
+} surfbuild_t;
+
+/*
+ * The surface cache is split into an arena per mip level, so the
+ * small distant surfaces don't push out the big near ones. Each is
+ * a ring of blocks, allocated at a rover. Blocks used since the rover
+ * passed them last get a second chance (clock), so the working set of
+ * a frame stays. The arenas are resized from the bytes they needed in
+ * a frame once they start evicting recently used surfaces.
+ */
+typedef struct
+{
+	surfcache_t	*base;
+	surfcache_t	*rover;
+	int		size;
+
+	// sw_surfcache_stats, since its last call
+	int		hits, misses;
+	int		evictions, churn; // churn: used in the last frame
+
+	// for resizing, over SURFCACHE_WINDOW frames
+	int		framebytes, maxframebytes;
+	int		churnbytes;
+} surfarena_t;
+
+#define SURFCACHE_WINDOW	32
+#define SURFCACHE_MINARENA	(128 * 1024)
+#define SURFCACHE_MAXSCALE	8
 
-void R_BuildLightMap (drawsurf_t *drawsurf);
+static const int	sc_shares[NUM_MIPS] = {40, 30, 20, 10}; // percent
 
-static int	sc_size;
-static surfcache_t	*sc_rover;
+static int	sc_size, sc_basesize;
+static int	sc_windowframes, sc_resizes;
+static surfarena_t	sc_arenas[NUM_MIPS];
 surfcache_t	*sc_base;
 
+static surfbuild_t	*d_surfbuilds;
+static int	d_numsurfbuilds, d_maxsurfbuilds;
+static yq2_atomic_t	d_nextsurfbuild;
+
+// blocklights for the other bands than 0
+static light_t	*d_bandlights;
+static int	d_bandlightsize, d_bandlightbands;
+
+int	d_surfsbuilt, d_texelsbuilt;
+float	d_surfbuildms;
+
 /*
  * Color light apply is not required
  */
@@ -86,6 +137,30 @@ R_DrawSurfaceBlock_Light (pixel_t *prowdest, pixel_t *psource, size_t size,
 		return;
 	}
 
+	// grey light shades, as with sw_colorlight 0. The light of all
+	// pixels is calculated first in a loop the compiler can vectorize,
+	// the colormap lookups follow. Same result as R_ApplyLight().
+	if (lightleft[0] == lightleft[1] && lightleft[0] == lightleft[2] &&
+		lightright[0] == lightright[1] && lightright[0] == lightright[2])
+	{
+		int	lightrow[16];
+		int	b, lightstep;
+
+		lightstep = (lightleft[0] - lightright[0]) >> level;
+
+		for (b = 0; b < (int)size; b++)
+		{
+			lightrow[b] = (lightright[0] + ((int)size - 1 - b) * lightstep) & LIGHTMASK;
+		}
+
+		for (b = 0; b < (int)size; b++)
+		{
+			prowdest[b] = vid_colormap[psource[b] + lightrow[b]];
+		}
+
+		return;
+	}
+
 	// same color light shades
 	{
 		int b, j;
@@ -120,28 +195,28 @@ R_DrawSurfaceBlock8_anymip
 ================
 */
 static void
-R_DrawSurfaceBlock8_anymip (int level, int surfrowbytes)
+R_DrawSurfaceBlock8_anymip (surfblock_t *block, int level, int surfrowbytes)
 {
 	int		v, i, size;
 	pixel_t	*psource, *prowdest;
 
 	size = 1 << level;
-	psource = pbasesource;
-	prowdest = prowdestbase;
+	psource = block->pbasesource;
+	prowdest = block->prowdestbase;
 
-	for (v=0 ; v<r_numvblocks ; v++)
+	for (v=0 ; v<block->numvblocks ; v++)
 	{
 		light3_t	lightleft, lightright;
 		light3_t	lightleftstep, lightrightstep;
 
 		// FIXME: use delta rather than both right and left, like ASM?
-		memcpy(lightleft, r_lightptr, sizeof(light3_t));
-		memcpy(lightright, r_lightptr + 3, sizeof(light3_t));
-		r_lightptr += r_lightwidth * 3;
+		memcpy(lightleft, block->lightptr, sizeof(light3_t));
+		memcpy(lightright, block->lightptr + 3, sizeof(light3_t));
+		block->lightptr += block->lightwidth * 3;
 		for(i=0; i<3; i++)
 		{
-			lightleftstep[i] = (r_lightptr[i] - lightleft[i]) >> level;
-			lightrightstep[i] = (r_lightptr[i + 3] - lightright[i]) >> level;
+			lightleftstep[i] = (block->lightptr[i] - lightleft[i]) >> level;
+			lightrightstep[i] = (block->lightptr[i + 3] - lightright[i]) >> level;
 		}
 
 		for (i=0 ; i<size ; i++)
@@ -150,7 +225,7 @@ R_DrawSurfaceBlock8_anymip (int level, int surfrowbytes)
 
 			R_DrawSurfaceBlock_Light(prowdest, psource, size, level, lightleft, lightright);
 
-			psource += sourcetstep;
+			psource += block->sourcetstep;
 
 			for(j=0; j<3; j++)
 			{
@@ -161,8 +236,8 @@ R_DrawSurfaceBlock8_anymip (int level, int surfrowbytes)
 			prowdest += surfrowbytes;
 		}
 
-		if (psource >= r_sourcemax)
-			psource -= r_stepback;
+		if (psource >= block->sourcemax)
+			psource -= block->stepback;
 	}
 }
 
@@ -170,11 +245,14 @@ R_DrawSurfaceBlock8_anymip (int level, int surfrowbytes)
 /*
 ===============
 R_DrawSurface
+
+Returns false if the lights didn't fit into lights
 ===============
 */
-static void
-R_DrawSurface (drawsurf_t *drawsurf)
+static qboolean
+R_DrawSurface (drawsurf_t *drawsurf, light_t *lights, const light_t *lights_max)
 {
+	surfblock_t	block;
 	unsigned char	*basetptr;
 	int		smax, tmax, twidth;
 	int		u;
@@ -184,10 +262,11 @@ R_DrawSurface (drawsurf_t *drawsurf)
 	image_t		*mt;
 	int		blockdivshift;
 	int		r_numhblocks;
+	qboolean	fits = true;
 
 	mt = drawsurf->image;
 
-	r_source = mt->pixels[drawsurf->surfmip];
+	block.source = mt->pixels[drawsurf->surfmip];
 
 	// the fractional light values should range from 0 to (VID_GRADES - 1) << 16
 	// from a source range of 0 - 255
@@ -197,46 +276,46 @@ R_DrawSurface (drawsurf_t *drawsurf)
 	blocksize = 16 >> drawsurf->surfmip;
 	blockdivshift = NUM_MIPS - drawsurf->surfmip;
 
-	r_lightwidth = (drawsurf->surf->extents[0]>>4)+1;
+	block.lightwidth = (drawsurf->surf->extents[0]>>4)+1;
 
 	r_numhblocks = drawsurf->surfwidth >> blockdivshift;
-	r_numvblocks = drawsurf->surfheight >> blockdivshift;
+	block.numvblocks = drawsurf->surfheight >> blockdivshift;
 
 	//==============================
 
 	smax = mt->width >> drawsurf->surfmip;
 	twidth = texwidth;
 	tmax = mt->height >> drawsurf->surfmip;
-	sourcetstep = texwidth;
-	r_stepback = tmax * twidth;
+	block.sourcetstep = texwidth;
+	block.stepback = tmax * twidth;
 
-	r_sourcemax = r_source + (tmax * smax);
+	block.sourcemax = block.source + (tmax * smax);
 
 	soffset = drawsurf->surf->texturemins[0];
 	basetoffset = drawsurf->surf->texturemins[1];
 
 	// << 16 components are to guarantee positive values for %
 	soffset = ((soffset >> drawsurf->surfmip) + (smax << SHIFT16XYZ)) % smax;
-	basetptr = &r_source[((((basetoffset >> drawsurf->surfmip)
+	basetptr = &block.source[((((basetoffset >> drawsurf->surfmip)
 		+ (tmax << SHIFT16XYZ)) % tmax) * twidth)];
 
 	pcolumndest = drawsurf->surfdat;
 
 	for (u=0 ; u<r_numhblocks; u++)
 	{
-		r_lightptr = blocklights + u * 3;
+		block.lightptr = lights + u * 3;
 
-		if (r_lightptr >= blocklight_max)
+		if (block.lightptr >= lights_max)
 		{
-			r_outoflights = true;
+			fits = false;
 			continue;
 		}
 
-		prowdestbase = pcolumndest;
+		block.prowdestbase = pcolumndest;
 
-		pbasesource = basetptr + soffset;
+		block.pbasesource = basetptr + soffset;
 
-		R_DrawSurfaceBlock8_anymip(NUM_MIPS - drawsurf->surfmip, drawsurf->rowbytes);
+		R_DrawSurfaceBlock8_anymip(&block, NUM_MIPS - drawsurf->surfmip, drawsurf->rowbytes);
 
 		soffset = soffset + blocksize;
 		if (soffset >= smax)
@@ -244,11 +323,224 @@ R_DrawSurface (drawsurf_t *drawsurf)
 
 		pcolumndest += blocksize;
 	}
+
+	return fits;
+}
+
+/*
+===============
+R_BuildSurface
+
+Lights and rasterizes a surface into its cache block
+===============
+*/
+static void
+R_BuildSurface (surfbuild_t *build, light_t *lights, const light_t *lights_max)
+{
+	build->outoflights = false;
+
+	// calculate the lightings
+	if (!R_BuildLightMap (&build->drawsurf, lights, lights_max))
+	{
+		build->outoflights = true;
+	}
+
+	// rasterize the surface into the cache
+	if (!R_DrawSurface (&build->drawsurf, lights, lights_max))
+	{
+		build->outoflights = true;
+	}
+}
+
+/*
+===============
+D_BuildSurfaceBand
+
+Takes queued surfaces until all are built
+===============
+*/
+static void
+D_BuildSurfaceBand (int band, int vstart, int vend, void *data)
+{
+	light_t	*lights, *lights_max;
+
+	if (band)
+	{
+		lights = d_bandlights + (band - 1) * d_bandlightsize;
+		lights_max = lights + d_bandlightsize;
+	}
+	else
+	{
+		lights = blocklights;
+		lights_max = blocklight_max;
+	}
+
+	while (1)
+	{
+		int	i;
+
+		i = YQ2_AtomicAdd(&d_nextsurfbuild, 1);
+		if (i >= d_numsurfbuilds)
+		{
+			break;
+		}
+
+		R_BuildSurface (&d_surfbuilds[i], lights, lights_max);
+	}
+}
+
+/*
+===============
+D_BuildSurfaces
+
+Builds all surfaces queued by D_CacheSurface(). They're independent
+of each other, so with sw_threads they're built in parallel.
+===============
+*/
+void
+D_BuildSurfaces (void)
+{
+	Uint64	start;
+	int	i, numbands, lightsize;
+
+	if (!d_numsurfbuilds)
+	{
+		return;
+	}
+
+	start = SDL_GetPerformanceCounter();
+
+	numbands = Q_min(R_NumBands(), d_numsurfbuilds);
+	lightsize = blocklight_max - blocklights;
+
+	if ((numbands > 1) &&
+		((d_bandlightsize != lightsize) || (d_bandlightbands != R_NumBands())))
+	{
+		free(d_bandlights);
+		d_bandlightsize = lightsize;
+		d_bandlightbands = R_NumBands();
+		d_bandlights = malloc((d_bandlightbands - 1) * lightsize * sizeof(light_t));
+		if (!d_bandlights)
+		{
+			d_bandlightsize = d_bandlightbands = 0;
+		}
+	}
+
+	YQ2_AtomicSet(&d_nextsurfbuild, 0);
+
+	if ((numbands > 1) && d_bandlights)
+	{
+		// a band per thread, they take the surfaces one by one
+		R_RunBands (D_BuildSurfaceBand, NULL, 0, numbands);
+	}
+	else
+	{
+		D_BuildSurfaceBand (0, 0, 1, NULL);
+	}
+
+	for (i = 0; i < d_numsurfbuilds; i++)
+	{
+		const drawsurf_t *drawsurf = &d_surfbuilds[i].drawsurf;
+
+		if (d_surfbuilds[i].outoflights)
+		{
+			r_outoflights = true;
+		}
+
+		d_texelsbuilt += drawsurf->surfwidth * drawsurf->surfheight;
+	}
+
+	d_surfsbuilt += d_numsurfbuilds;
+	d_numsurfbuilds = 0;
+
+	d_surfbuildms += (SDL_GetPerformanceCounter() - start) * 1000.0 /
+		SDL_GetPerformanceFrequency();
+}
+
+/*
+===============
+D_ShutdownSurfaces
+===============
+*/
+void
+D_ShutdownSurfaces (void)
+{
+	free(d_surfbuilds);
+	d_surfbuilds = NULL;
+	d_numsurfbuilds = d_maxsurfbuilds = 0;
+
+	free(d_bandlights);
+	d_bandlights = NULL;
+	d_bandlightsize = d_bandlightbands = 0;
 }
 
 
 //=============================================================================
 
+/*
+================
+D_InitArena
+================
+*/
+static void
+D_InitArena (surfarena_t *arena)
+{
+	arena->rover = arena->base;
+
+	arena->base->next = NULL;
+	arena->base->owner = NULL;
+	arena->base->size = arena->size;
+	arena->base->spanseq = 0;
+	arena->base->referenced = false;
+	arena->base->lastframe = 0;
+}
+
+/*
+================
+D_AllocCaches
+
+Allocates the cache with the given arena sizes
+================
+*/
+static void
+D_AllocCaches (const int *sizes)
+{
+	byte	*base;
+	int	i;
+
+	if (sc_base)
+	{
+		D_FlushCaches ();
+		free (sc_base);
+		sc_base = NULL;
+	}
+
+	sc_size = 0;
+	for (i = 0; i < NUM_MIPS; i++)
+	{
+		// keep the block headers aligned
+		sc_arenas[i].size = (sizes[i] + 15) & ~15;
+		sc_size += sc_arenas[i].size;
+	}
+
+	sc_base = (surfcache_t *)malloc(sc_size);
+	if (!sc_base)
+	{
+		ri.Sys_Error(ERR_FATAL, "%s: Can't allocate cache.", __func__);
+		// code never returns after ERR_FATAL
+		return;
+	}
+
+	base = (byte *)sc_base;
+	for (i = 0; i < NUM_MIPS; i++)
+	{
+		sc_arenas[i].base = (surfcache_t *)base;
+		base += sc_arenas[i].size;
+
+		D_InitArena (&sc_arenas[i]);
+	}
+}
+
 /*
 ================
 R_InitCaches
@@ -258,7 +550,8 @@ R_InitCaches
 void
 R_InitCaches (void)
 {
-	int		size;
+	int		size, sizes[NUM_MIPS];
+	int		i;
 
 	// calculate size to allocate
 	int pix;
@@ -282,19 +575,99 @@ R_InitCaches (void)
 
 	R_Printf(PRINT_ALL,"%ik surface cache.\n", size/1024);
 
-	sc_size = size;
-	sc_base = (surfcache_t *)malloc(size);
+	sc_basesize = size;
+
+	for (i = 0; i < NUM_MIPS; i++)
+	{
+		sizes[i] = Q_max(size / 100 * sc_shares[i], SURFCACHE_MINARENA);
+	}
+
+	D_AllocCaches (sizes);
+
+	for (i = 0; i < NUM_MIPS; i++)
+	{
+		surfarena_t *arena = &sc_arenas[i];
+
+		arena->framebytes = arena->maxframebytes = arena->churnbytes = 0;
+	}
+
+	sc_windowframes = 0;
+}
+
+/*
+================
+D_CheckCacheSize
+
+Called at the start of each frame, when no cache block is in use.
+Grows the arenas that evicted surfaces needed in the last frame.
+================
+*/
+void
+D_CheckCacheSize (void)
+{
+	int	sizes[NUM_MIPS];
+	int	i, total;
+	qboolean	resize = false;
+
 	if (!sc_base)
 	{
-		ri.Sys_Error(ERR_FATAL, "%s: Can't allocate cache.", __func__);
-		// code never returns after ERR_FATAL
 		return;
 	}
-	sc_rover = sc_base;
 
-	sc_base->next = NULL;
-	sc_base->owner = NULL;
-	sc_base->size = sc_size;
+	for (i = 0; i < NUM_MIPS; i++)
+	{
+		surfarena_t *arena = &sc_arenas[i];
+
+		arena->maxframebytes = Q_max(arena->maxframebytes, arena->framebytes);
+		arena->framebytes = 0;
+	}
+
+	if (++sc_windowframes < SURFCACHE_WINDOW)
+	{
+		return;
+	}
+
+	total = 0;
+	for (i = 0; i < NUM_MIPS; i++)
+	{
+		surfarena_t *arena = &sc_arenas[i];
+
+		sizes[i] = arena->size;
+
+		// thrashing, the frames need more than fits in
+		if (arena->churnbytes > arena->size / 8)
+		{
+			// leave room for fragmentation
+			sizes[i] = Q_max(arena->maxframebytes * 2, arena->size * 3 / 2);
+			resize = true;
+		}
+
+		total += sizes[i];
+
+		arena->maxframebytes = arena->churnbytes = 0;
+	}
+
+	sc_windowframes = 0;
+
+	if (!resize || (sc_size >= sc_basesize * SURFCACHE_MAXSCALE))
+	{
+		return;
+	}
+
+	if (total > sc_basesize * SURFCACHE_MAXSCALE)
+	{
+		float scale = (float)sc_basesize * SURFCACHE_MAXSCALE / total;
+
+		for (i = 0; i < NUM_MIPS; i++)
+		{
+			sizes[i] = Q_max((int)(sizes[i] * scale), SURFCACHE_MINARENA);
+		}
+	}
+
+	D_AllocCaches (sizes);
+	sc_resizes++;
+
+	R_Printf(PRINT_DEVELOPER, "Resized surface cache to %ik.\n", sc_size / 1024);
 }
 
 
@@ -306,21 +679,123 @@ D_FlushCaches
 void
 D_FlushCaches (void)
 {
-	surfcache_t     *c;
+	int	i;
+
+	if (!sc_base)
+		return;
+
+	for (i = 0; i < NUM_MIPS; i++)
+	{
+		surfcache_t     *c;
+
+		for (c = sc_arenas[i].base ; c ; c = c->next)
+		{
+			if (c->owner)
+				*c->owner = NULL;
+		}
+
+		D_InitArena (&sc_arenas[i]);
+	}
+}
+
+/*
+==================
+D_SurfCacheStats_f
+==================
+*/
+void
+D_SurfCacheStats_f (void)
+{
+	int	i;
 
 	if (!sc_base)
+	{
 		return;
+	}
 
-	for (c = sc_base ; c ; c = c->next)
+	R_Printf(PRINT_ALL, "%ik surface cache, resized %i times\n",
+		sc_size / 1024, sc_resizes);
+
+	for (i = 0; i < NUM_MIPS; i++)
 	{
-		if (c->owner)
-			*c->owner = NULL;
+		surfarena_t	*arena = &sc_arenas[i];
+		surfcache_t	*c;
+		int	blocks = 0, freeblocks = 0, freebytes = 0;
+		int	run = 0, maxrun = 0;
+		int	lookups;
+
+		for (c = arena->base ; c ; c = c->next)
+		{
+			blocks++;
+
+			if (c->owner)
+			{
+				run = 0;
+				continue;
+			}
+
+			freeblocks++;
+			freebytes += c->size;
+			run += c->size;
+			maxrun = Q_max(maxrun, run);
+		}
+
+		lookups = arena->hits + arena->misses;
+
+		R_Printf(PRINT_ALL, "mip %i: %5ik, %5.1f%% hits of %i, %i evicted, %i of them"
+			" used last frame\n", i, arena->size / 1024,
+			lookups ? arena->hits * 100.0f / lookups : 0.0f, lookups,
+			arena->evictions, arena->churn);
+		R_Printf(PRINT_ALL, "       %i blocks, %ik free in %i blocks, largest %ik\n",
+			blocks, freebytes / 1024, freeblocks, maxrun / 1024);
+
+		arena->hits = arena->misses = 0;
+		arena->evictions = arena->churn = 0;
 	}
+}
+
+/*
+=================
+D_TouchCache
 
-	sc_rover = sc_base;
-	sc_base->next = NULL;
-	sc_base->owner = NULL;
-	sc_base->size = sc_size;
+Marks a block as used in this frame
+=================
+*/
+static void
+D_TouchCache (surfarena_t *arena, surfcache_t *cache)
+{
+	cache->referenced = true;
+
+	if (cache->lastframe != r_framecount)
+	{
+		cache->lastframe = r_framecount;
+		arena->framebytes += cache->size;
+	}
+}
+
+/*
+=================
+D_EvictCache
+=================
+*/
+static void
+D_EvictCache (surfarena_t *arena, surfcache_t *cache)
+{
+	if (!cache->owner)
+	{
+		return;
+	}
+
+	*cache->owner = NULL;
+	cache->owner = NULL;
+
+	arena->evictions++;
+
+	if (cache->lastframe >= r_framecount - 1)
+	{
+		arena->churn++;
+		arena->churnbytes += cache->size;
+	}
 }
 
 /*
@@ -329,9 +804,10 @@ D_SCAlloc
 =================
 */
 static surfcache_t *
-D_SCAlloc (int width, int size)
+D_SCAlloc (surfarena_t *arena, int width, int size)
 {
 	surfcache_t	*new;
+	int		total, skipped;
 
 	if ((width < 0) || (width > 256))
 	{
@@ -346,50 +822,95 @@ D_SCAlloc (int width, int size)
 	// Add header size
 	size += ((char*)sc_base->data - (char*)sc_base);
 	size = (size + 3) & ~3;
-	if (size > sc_size)
+	if (size > arena->size)
 	{
-		ri.Sys_Error(ERR_FATAL, "%s: %i > cache size of %i", __func__, size, sc_size);
+		ri.Sys_Error(ERR_FATAL, "%s: %i > cache size of %i", __func__, size, arena->size);
+	}
+
+	// find size bytes without recently used blocks. These get a second
+	// chance, the rover moves past them. After two rounds it takes any.
+	skipped = 0;
+	while (1)
+	{
+		surfcache_t	*used = NULL;
+
+		// if there is not size bytes after the rover, reset to the start
+		if ( !arena->rover ||
+			(byte *)arena->rover - (byte *)arena->base > arena->size - size)
+		{
+			arena->rover = arena->base;
+		}
+
+		for (new = arena->rover, total = 0; new && total < size; new = new->next)
+		{
+			if (new->owner && new->referenced && (skipped < arena->size * 2))
+			{
+				used = new;
+				break;
+			}
+
+			total += new->size;
+		}
+
+		if (!used)
+		{
+			break;
+		}
+
+		used->referenced = false;
+		skipped += total + used->size;
+		arena->rover = used->next;
 	}
 
-	// if there is not size bytes after the rover, reset to the start
-	if ( !sc_rover || (byte *)sc_rover - (byte *)sc_base > sc_size - size)
+	// the queued spans may still read from the blocks we're
+	// about to reuse, draw them before they're overwritten
+	for (new = arena->rover, total = 0; new && total < size; new = new->next)
 	{
-		sc_rover = sc_base;
+		if (new->spanseq == d_spanseq)
+		{
+			D_FlushSpans();
+			break;
+		}
+
+		total += new->size;
 	}
 
 	// colect and free surfcache_t blocks until the rover block is large enough
-	new = sc_rover;
-	if (sc_rover->owner)
-		*sc_rover->owner = NULL;
+	new = arena->rover;
+	D_EvictCache (arena, new);
 
 	while (new->size < size)
 	{
+		surfcache_t	*next;
+
 		// free another
-		sc_rover = sc_rover->next;
-		if (!sc_rover)
+		next = new->next;
+		if (!next)
 		{
 			ri.Sys_Error(ERR_FATAL, "%s: hit the end of memory", __func__);
 		}
-		if (sc_rover->owner)
-			*sc_rover->owner = NULL;
+		D_EvictCache (arena, next);
 
-		new->size += sc_rover->size;
-		new->next = sc_rover->next;
+		new->size += next->size;
+		new->next = next->next;
 	}
 
 	// create a fragment out of any leftovers
 	if (new->size - size > 256)
 	{
-		sc_rover = (surfcache_t *)( (byte *)new + size);
-		sc_rover->size = new->size - size;
-		sc_rover->next = new->next;
-		sc_rover->width = 0;
-		sc_rover->owner = NULL;
-		new->next = sc_rover;
+		arena->rover = (surfcache_t *)( (byte *)new + size);
+		arena->rover->size = new->size - size;
+		arena->rover->next = new->next;
+		arena->rover->width = 0;
+		arena->rover->owner = NULL;
+		arena->rover->spanseq = 0;
+		arena->rover->referenced = false;
+		arena->rover->lastframe = 0;
+		new->next = arena->rover;
 		new->size = size;
 	}
 	else
-		sc_rover = new->next;
+		arena->rover = new->next;
 
 	new->width = width;
 	// DEBUG
@@ -397,6 +918,9 @@ D_SCAlloc (int width, int size)
 		new->height = (size - sizeof(*new) + sizeof(new->data)) / width;
 
 	new->owner = NULL; // should be set properly after return
+	new->spanseq = 0;
+	new->referenced = false;
+	new->lastframe = 0;
 
 	return new;
 }
@@ -414,6 +938,7 @@ surfcache_t *
 D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel)
 {
 	surfcache_t	*cache;
+	surfarena_t	*arena;
 	float		surfscale;
 
 	//
@@ -429,6 +954,7 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 	// see if the cache holds apropriate data
 	//
 	cache = surface->cachespots[miplevel];
+	arena = &sc_arenas[miplevel];
 
 	if (cache && !cache->dlight && surface->dlightframe != r_framecount
 			&& cache->image == r_drawsurf.image
@@ -436,7 +962,19 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 			&& cache->lightadj[1] == r_drawsurf.lightadj[1]
 			&& cache->lightadj[2] == r_drawsurf.lightadj[2]
 			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
+	{
+		arena->hits++;
+		D_TouchCache (arena, cache);
 		return cache;
+	}
+
+	arena->misses++;
+
+	// the queued spans still read the old contents
+	if (cache && cache->spanseq == d_spanseq)
+	{
+		D_FlushSpans();
+	}
 
 	//
 	// determine shape of surface
@@ -452,13 +990,15 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 	//
 	if (!cache) // if a texture just animated, don't reallocate it
 	{
-		cache = D_SCAlloc (r_drawsurf.surfwidth,
+		cache = D_SCAlloc (arena, r_drawsurf.surfwidth,
 						   r_drawsurf.surfwidth * r_drawsurf.surfheight);
 		surface->cachespots[miplevel] = cache;
 		cache->owner = &surface->cachespots[miplevel];
 		cache->mipscale = surfscale;
 	}
 
+	D_TouchCache (arena, cache);
+
 	if (surface->dlightframe == r_framecount)
 		cache->dlight = 1;
 	else
@@ -473,17 +1013,31 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 	cache->lightadj[3] = r_drawsurf.lightadj[3];
 
 	//
-	// draw and light the surface texture
+	// queue drawing and lighting the surface texture,
+	// D_BuildSurfaces() does it before the block is read
 	//
 	r_drawsurf.surf = surface;
 
 	c_surf++;
 
-	// calculate the lightings
-	R_BuildLightMap (&r_drawsurf);
+	if (d_numsurfbuilds == d_maxsurfbuilds)
+	{
+		surfbuild_t	*builds;
+		int	newmax;
 
-	// rasterize the surface into the cache
-	R_DrawSurface (&r_drawsurf);
+		newmax = d_maxsurfbuilds ? d_maxsurfbuilds * 2 : 256;
+		builds = realloc(d_surfbuilds, newmax * sizeof(surfbuild_t));
+		if (!builds)
+		{
+			ri.Sys_Error(ERR_FATAL, "%s: Couldn't realloc %d bytes",
+				__func__, (int)(newmax * sizeof(surfbuild_t)));
+		}
+
+		d_surfbuilds = builds;
+		d_maxsurfbuilds = newmax;
+	}
+
+	d_surfbuilds[d_numsurfbuilds++].drawsurf = r_drawsurf;
 
 	return cache;
 }
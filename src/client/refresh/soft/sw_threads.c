@@ -0,0 +1,259 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ * USA.
+ *
+ * =======================================================================
+ *
+ * Band parallel rendering. The framebuffer is split into horizontal
+ * bands, one per thread. A band function is run for every band at the
+ * same time and must only write to the rows of its band, both in the
+ * framebuffer and in the z buffer. Everything else it reads must stay
+ * constant until R_RunBands() returns. With sw_threads set to 0 or 1
+ * there's just one band and no threads are started.
+ *
+ * =======================================================================
+ */
+
+#include "header/local.h"
+#include "../../header/threads.h"
+
+#define MAX_BANDS 32
+
+typedef struct
+{
+	SDL_Thread *thread;
+	yq2_sem_t *start;
+	int band;
+} bandworker_t;
+
+static cvar_t *sw_threads;
+
+static bandworker_t r_workers[MAX_BANDS];
+static yq2_sem_t *r_banddone;
+static int r_numbands = 1;
+static qboolean r_bandquit;
+
+/* the current job, constant while the workers run */
+static bandfunc_t r_bandfunc;
+static void *r_banddata;
+static int r_bandstart[MAX_BANDS + 1];
+
+/*
+ * Runs the current job for one band.
+ */
+static void
+R_RunBand(int band)
+{
+	r_bandfunc(band, r_bandstart[band], r_bandstart[band + 1], r_banddata);
+}
+
+/*
+ * Worker thread, runs a band each
+ * time its semaphore is posted.
+ */
+static int
+R_BandWorker(void *data)
+{
+	bandworker_t *worker = (bandworker_t *)data;
+
+	while (1)
+	{
+		YQ2_SemWait(worker->start);
+
+		if (r_bandquit)
+		{
+			break;
+		}
+
+		R_RunBand(worker->band);
+		YQ2_SemPost(r_banddone);
+	}
+
+	return 0;
+}
+
+/*
+ * Stops all worker threads.
+ */
+void
+R_ShutdownThreads(void)
+{
+	int i;
+
+	r_bandquit = true;
+
+	for (i = 1; i < r_numbands; i++)
+	{
+		YQ2_SemPost(r_workers[i].start);
+		SDL_WaitThread(r_workers[i].thread, NULL);
+		SDL_DestroySemaphore(r_workers[i].start);
+	}
+
+	if (r_banddone)
+	{
+		SDL_DestroySemaphore(r_banddone);
+		r_banddone = NULL;
+	}
+
+	memset(r_workers, 0, sizeof(r_workers));
+	r_numbands = 1;
+	r_bandquit = false;
+}
+
+/*
+ * Starts sw_threads - 1 worker threads,
+ * the calling thread renders band 0.
+ */
+void
+R_InitThreads(void)
+{
+	int numbands, i;
+
+	if (!sw_threads)
+	{
+		sw_threads = ri.Cvar_Get("sw_threads", "0", CVAR_ARCHIVE);
+	}
+
+	sw_threads->modified = false;
+	numbands = (int)sw_threads->value;
+
+	if (numbands < 1)
+	{
+		numbands = 1;
+	}
+	else if (numbands > MAX_BANDS)
+	{
+		numbands = MAX_BANDS;
+	}
+
+	if (numbands == 1)
+	{
+		return;
+	}
+
+	r_banddone = SDL_CreateSemaphore(0);
+
+	if (!r_banddone)
+	{
+		R_Printf(PRINT_ALL, "%s: Couldn't create semaphore: %s\n",
+			__func__, SDL_GetError());
+		return;
+	}
+
+	for (i = 1; i < numbands; i++)
+	{
+		bandworker_t *worker = &r_workers[i];
+
+		worker->band = i;
+		worker->start = SDL_CreateSemaphore(0);
+
+		if (worker->start)
+		{
+			worker->thread = SDL_CreateThread(R_BandWorker, "yq2band", worker);
+		}
+
+		if (!worker->thread)
+		{
+			R_Printf(PRINT_ALL, "%s: Couldn't start render thread: %s\n",
+				__func__, SDL_GetError());
+
+			if (worker->start)
+			{
+				SDL_DestroySemaphore(worker->start);
+				worker->start = NULL;
+			}
+
+			break;
+		}
+
+		r_numbands = i + 1;
+	}
+
+	R_Printf(PRINT_ALL, "Rendering with %d threads.\n", r_numbands);
+}
+
+/*
+ * Restarts the threads if sw_threads changed.
+ */
+void
+R_CheckThreads(void)
+{
+	if (sw_threads && sw_threads->modified)
+	{
+		R_ShutdownThreads();
+		R_InitThreads();
+	}
+}
+
+/*
+ * Number of bands R_RunBands() splits into.
+ */
+int
+R_NumBands(void)
+{
+	return r_numbands;
+}
+
+/*
+ * Returns the band row y belongs to in the
+ * current job, -1 if it's outside of all bands.
+ */
+int
+R_BandForRow(int y)
+{
+	int band;
+
+	for (band = 0; band < r_numbands; band++)
+	{
+		if ((y >= r_bandstart[band]) && (y < r_bandstart[band + 1]))
+		{
+			return band;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Splits the rows ystart to yend - 1 into bands
+ * and calls func for all of them in parallel.
+ * Returns after all bands are done.
+ */
+void
+R_RunBands(bandfunc_t func, void *data, int ystart, int yend)
+{
+	int i;
+
+	r_bandfunc = func;
+	r_banddata = data;
+
+	for (i = 0; i <= r_numbands; i++)
+	{
+		r_bandstart[i] = ystart + (yend - ystart) * i / r_numbands;
+	}
+
+	for (i = 1; i < r_numbands; i++)
+	{
+		YQ2_SemPost(r_workers[i].start);
+	}
+
+	R_RunBand(0);
+
+	for (i = 1; i < r_numbands; i++)
+	{
+		YQ2_SemWait(r_banddone);
+	}
+}
@@ -1277,6 +1277,8 @@ WiiU_RenderView(refdef_t *fd)
 
 	GX2SetPixelSampler(&gl3state.sampler3D, 0);
 
+	ri.Vid_MarkPhase(PHASE_WORLD);
+
 	WiiU_PushDlights();
 
 	SetupFrame();
@@ -1290,11 +1292,15 @@ WiiU_RenderView(refdef_t *fd)
 
 	WiiU_DrawWorld();
 
+	ri.Vid_MarkPhase(PHASE_ENTITIES);
+
 	WiiU_DrawEntitiesOnList();
 
 	// kick the silly gl1_flashblend poly lights
 	// WiiU_RenderDlights();
 
+	ri.Vid_MarkPhase(PHASE_PARTICLES);
+
 	WiiU_DrawParticles();
 
 	WiiU_DrawAlphaSurfaces();
@@ -1599,6 +1605,7 @@ GetRefAPIWiiU(refimport_t imp)
 
 	re.api_version = API_VERSION;
 	re.framework_version = WiiU_GetSDLVersion();
+	re.max_particles = MAX_PARTICLES;
 
 	re.Init = WiiU_Init;
 	re.Shutdown = WiiU_Shutdown;
@@ -713,7 +713,7 @@ Mod_ForName (char *name, gl3model_t *parent_model, qboolean crash)
 				mod->extradata = Mod_LoadMD2(mod->name, buf, modfilelen,
 					mod->mins, mod->maxs,
 					(struct image_s **)mod->skins, (findimage_t)WiiU_FindImage,
-					&(mod->type));
+					&(mod->type), false);
 				if (!mod->extradata)
 				{
 					ri.Sys_Error(ERR_DROP, "%s: Failed to load %s",
@@ -75,6 +75,8 @@ typedef struct sfx_s
 	sfxcache_t *cache;
 	char *truename;
 	qboolean is_silenced_muzzle_flash;
+	int sexedindex; /* slot in the client sound cache for '*' sounds, else -1 */
+	struct sfx_s *hashnext;
 } sfx_t;
 
 /* A playsound_t will be generated by each call
@@ -94,6 +96,17 @@ typedef struct playsound_s
 	unsigned begin;
 } playsound_t;
 
+/*
+ * Where a new playsound is sorted
+ * into the list of pending sounds
+ */
+typedef enum
+{
+	PS_APPEND,      /* no sorting, append at the end */
+	PS_SORT_AFTER,  /* after sounds with the same start time */
+	PS_SORT_BEFORE  /* before sounds with the same start time */
+} pssort_t;
+
 /*
  * Interface to pass data and metadata
  * between the frontend and the backends.
@@ -198,6 +211,13 @@ extern vec3_t listener_up;
 extern qboolean snd_is_underwater;
 extern qboolean snd_is_underwater_enabled;
 
+/* true while the SDL backend mixes in
+   its own thread. The mixer thread owns
+   the channels, the pending playsounds
+   and paintedtime. It must not print,
+   load sounds or touch client state. */
+extern qboolean snd_threaded;
+
 /*
  * Returns the header infos
  * of a wave file
@@ -211,15 +231,30 @@ wavinfo_t GetWavinfo(char *name, byte *wav, int wavlength);
 sfxcache_t *S_LoadSound(sfx_t *s);
 
 /*
- * Plays one sound sample
+ * Plays one sound sample, playerent is
+ * the entity number of the local player
  */
-void S_IssuePlaysound(playsound_t *ps);
+void S_IssuePlaysound(playsound_t *ps, int playerent);
+
+/*
+ * Copies a playsound into the
+ * list of pending playsounds
+ */
+void S_QueuePlaysound(const playsound_t *src, pssort_t sorting);
+
+/*
+ * Frees all pending playsounds
+ */
+void S_ClearPlaysounds(void);
 
 /*
  * picks a channel based on priorities,
- * empty slots, number of channels
+ * empty slots, number of channels.
+ * playerent is the entity number of the
+ * local player, the mixer thread must not
+ * take it from the client state.
  */
-channel_t *S_PickChannel(int entnum, int entchannel);
+channel_t *S_PickChannel(int entnum, int entchannel, int playerent);
 
 /*
  * Builds a list of all
@@ -256,6 +291,35 @@ int  SDL_DriftBeginofs(float);
  */
 void SDL_ClearBuffer(void);
 
+/*
+ * Returns paintedtime. While the mixer
+ * thread runs this is the last value
+ * published by it.
+ */
+int SDL_PaintedTime(void);
+
+/*
+ * Notes a playsound issued by the
+ * mixer thread for s_show, the main
+ * thread prints it
+ */
+void SDL_ShowIssue(int begin);
+
+/*
+ * Passes a new playsound or a stop
+ * request to the mixer thread
+ */
+void SDL_PostPlaysound(const playsound_t *ps, pssort_t sorting);
+void SDL_PostStopAll(void);
+
+/*
+ * Stops the mixer thread, everything
+ * it owned belongs to the caller
+ * afterwards. It's restarted by the
+ * next SDL_Update().
+ */
+void SDL_StopMixThread(void);
+
 /*
  * Caches an sample for use
  * the SDL backend
@@ -285,6 +349,92 @@ void SDL_Spatialize(channel_t *ch);
 
 /* ----------------------------------------------------------------- */
 
+/*
+ * State of the low pass filter
+ * used by the SDL backend when
+ * the player is under water.
+ */
+typedef struct
+{
+	float a;
+	float gain_hf;
+	portable_samplepair_t history[2];
+	qboolean is_history_initialized;
+} LpfContext;
+
+/*
+ * Initializes the low pass filter
+ */
+void lpf_initialize(LpfContext *lpf_context, float gain_hf,
+		int target_frequency);
+
+/*
+ * Inner loops of the SDL mixer.
+ * Several implementations exist,
+ * the fastest one usable on the
+ * current CPU is selected.
+ */
+typedef struct
+{
+	const char *name;
+
+	/* Mixes an 8 bit sample, lvol and rvol
+	   are rows in the volume scale table */
+	void (*paint8)(portable_samplepair_t *out, const byte *sfx,
+			int count, int lvol, int rvol);
+
+	/* Mixes a 16 bit sample, the volumes are
+	   the channel volume times master volume */
+	void (*paint16)(portable_samplepair_t *out, const short *sfx,
+			int count, int leftvol, int rightvol);
+
+	/* Adds raw samples (music, cinematics) */
+	void (*addraw)(portable_samplepair_t *out,
+			const portable_samplepair_t *in, int count);
+
+	/* Runs the underwater low pass filter */
+	void (*lowpass)(LpfContext *lpf, int count,
+			portable_samplepair_t *samples);
+
+	/* Clamps count values to 16 bit */
+	void (*clip16)(short *out, const int *in, int count);
+} sndmixer_t;
+
+extern const sndmixer_t *snd_mixer;
+extern qboolean snd_mixtracing;
+
+/*
+ * Selects the mixer and registers
+ * the mixer commands
+ */
+void SDL_MixerInit(void);
+
+/*
+ * Removes the mixer commands
+ */
+void SDL_MixerShutdown(void);
+
+/*
+ * Reselects the mixer if
+ * s_mixsimd was changed
+ */
+void SDL_MixerUpdate(void);
+
+/*
+ * Rebuilds the volume tables
+ */
+void SDL_MixerSetVolume(float volume);
+
+/*
+ * Records mixing operations while
+ * a mixer trace is running
+ */
+void SDL_MixerTracePaint(const char *name, int width, int lvol,
+		int rvol, int pos, int count, int offset);
+void SDL_MixerTraceOp(char op, int count);
+
+/* ----------------------------------------------------------------- */
+
 #if USE_OPENAL
 
  /* Only begin attenuating sound volumes
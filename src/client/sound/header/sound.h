@@ -48,6 +48,7 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up);
 void S_Activate(qboolean active);
 void S_BeginRegistration(void);
 struct sfx_s *S_RegisterSound(char *name);
+void S_RegisterClientSounds(int playernum);
 void S_EndRegistration(void);
 
 /* the sound code makes callbacks to the client for
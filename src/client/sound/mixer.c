@@ -0,0 +1,1046 @@
+/*
+ * Copyright (C) 1997-2001 Id Software, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ * USA.
+ *
+ * =======================================================================
+ *
+ * Mixing kernels for the SDL sound backend. The inner loops of the
+ * software mixer (painting channels into the paintbuffer, adding raw
+ * samples, the underwater low pass and the final clamp to 16 bit) are
+ * implemented several times: A plain C version, which is the reference,
+ * a version using the GCC / Clang vector extension for CPUs without
+ * dedicated support and hand written SSE2 and NEON versions. The best
+ * one is selected at runtime. All of them produce bit identical output.
+ *
+ * This file also implements the mixer trace, a recording of all mixing
+ * operations. `s_mixtrace` records it, `s_mixbench` replays it against
+ * all kernels and reports their throughput.
+ *
+ * =======================================================================
+ */
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#include "../../client/header/client.h"
+#include "../../client/sound/header/local.h"
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define MIX_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define MIX_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MIX_VECEXT
+#endif
+
+static cvar_t *s_mixsimd;
+
+static int mix_scaletable[32][256];
+static int mix_scale[32];
+
+const sndmixer_t *snd_mixer;
+
+static FILE *mix_tracefile;
+qboolean snd_mixtracing;
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * The reference implementation. This
+ * is the classic Quake II mixer.
+ */
+static void
+Mix_Paint8_C(portable_samplepair_t *out, const byte *sfx, int count, int lvol, int rvol)
+{
+	const int *lscale, *rscale;
+	int i;
+
+	lscale = mix_scaletable[lvol];
+	rscale = mix_scaletable[rvol];
+
+	for (i = 0; i < count; i++, out++)
+	{
+		int data;
+
+		data = sfx[i];
+		out->left += lscale[data];
+		out->right += rscale[data];
+	}
+}
+
+static void
+Mix_Paint16_C(portable_samplepair_t *out, const short *sfx, int count, int leftvol, int rightvol)
+{
+	int i;
+
+	for (i = 0; i < count; i++, out++)
+	{
+		int data;
+
+		data = sfx[i];
+		out->left += (data * leftvol) >> 8;
+		out->right += (data * rightvol) >> 8;
+	}
+}
+
+static void
+Mix_AddRaw_C(portable_samplepair_t *out, const portable_samplepair_t *in, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		out[i].left += in[i].left;
+		out[i].right += in[i].right;
+	}
+}
+
+static void
+Mix_Lowpass_C(LpfContext *lpf, int count, portable_samplepair_t *samples)
+{
+	int s;
+	float a;
+	portable_samplepair_t y;
+	portable_samplepair_t *history;
+
+	a = lpf->a;
+	history = lpf->history;
+
+	for (s = 0; s < count; ++s)
+	{
+		/* Update left channel */
+		y.left = samples[s].left;
+
+		y.left = (int)(y.left + a * (history[0].left - y.left));
+		history[0].left = y.left;
+
+		y.left = (int)(y.left + a * (history[1].left - y.left));
+		history[1].left = y.left;
+
+		/* Update right channel */
+		y.right = samples[s].right;
+
+		y.right = (int)(y.right + a * (history[0].right - y.right));
+		history[0].right = y.right;
+
+		y.right = (int)(y.right + a * (history[1].right - y.right));
+		history[1].right = y.right;
+
+		/* Update sample */
+		samples[s] = y;
+	}
+}
+
+static void
+Mix_Clip16_C(short *out, const int *in, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		int val;
+
+		val = in[i] >> 8;
+
+		if (val > 0x7fff)
+		{
+			out[i] = 0x7fff;
+		}
+		else if (val < -32768)
+		{
+			out[i] = -32768;
+		}
+		else
+		{
+			out[i] = val;
+		}
+	}
+}
+
+static const sndmixer_t mixer_c = {
+	"C",
+	Mix_Paint8_C,
+	Mix_Paint16_C,
+	Mix_AddRaw_C,
+	Mix_Lowpass_C,
+	Mix_Clip16_C
+};
+
+/* ------------------------------------------------------------------ */
+
+#ifdef MIX_VECEXT
+
+/*
+ * Generic vector extension. Used on
+ * CPUs for which there is no special
+ * implementation, the compiler maps
+ * it to whatever the target offers.
+ */
+typedef int mix_v4si __attribute__((vector_size(16)));
+
+static inline mix_v4si
+Mix_LoadV4(const void *p)
+{
+	mix_v4si v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline void
+Mix_StoreV4(void *p, mix_v4si v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static void
+Mix_Paint8_VecExt(portable_samplepair_t *out, const byte *sfx, int count, int lvol, int rvol)
+{
+	const signed char *data = (const signed char *)sfx;
+	const mix_v4si scale = { mix_scale[lvol], mix_scale[rvol], mix_scale[lvol], mix_scale[rvol] };
+	int i;
+
+	/* The scale table maps j >= 128 to j - 0xff,
+	   which is the signed sample plus one. */
+	for (i = 0; i + 2 <= count; i += 2)
+	{
+		int d0 = data[i] + (data[i] < 0);
+		int d1 = data[i + 1] + (data[i + 1] < 0);
+		mix_v4si v = { d0, d0, d1, d1 };
+
+		Mix_StoreV4(&out[i], Mix_LoadV4(&out[i]) + v * scale);
+	}
+
+	if (i < count)
+	{
+		Mix_Paint8_C(out + i, sfx + i, count - i, lvol, rvol);
+	}
+}
+
+static void
+Mix_Paint16_VecExt(portable_samplepair_t *out, const short *sfx, int count, int leftvol, int rightvol)
+{
+	const mix_v4si vol = { leftvol, rightvol, leftvol, rightvol };
+	int i;
+
+	for (i = 0; i + 2 <= count; i += 2)
+	{
+		mix_v4si v = { sfx[i], sfx[i], sfx[i + 1], sfx[i + 1] };
+
+		Mix_StoreV4(&out[i], Mix_LoadV4(&out[i]) + ((v * vol) >> 8));
+	}
+
+	if (i < count)
+	{
+		Mix_Paint16_C(out + i, sfx + i, count - i, leftvol, rightvol);
+	}
+}
+
+static void
+Mix_AddRaw_VecExt(portable_samplepair_t *out, const portable_samplepair_t *in, int count)
+{
+	int i;
+
+	for (i = 0; i + 2 <= count; i += 2)
+	{
+		Mix_StoreV4(&out[i], Mix_LoadV4(&out[i]) + Mix_LoadV4(&in[i]));
+	}
+
+	if (i < count)
+	{
+		Mix_AddRaw_C(out + i, in + i, count - i);
+	}
+}
+
+static void
+Mix_Clip16_VecExt(short *out, const int *in, int count)
+{
+	const mix_v4si hi = { 0x7fff, 0x7fff, 0x7fff, 0x7fff };
+	const mix_v4si lo = { -32768, -32768, -32768, -32768 };
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		mix_v4si v = Mix_LoadV4(&in[i]) >> 8;
+		mix_v4si m;
+
+		m = v > hi;
+		v = (v & ~m) | (hi & m);
+		m = v < lo;
+		v = (v & ~m) | (lo & m);
+
+		out[i] = v[0];
+		out[i + 1] = v[1];
+		out[i + 2] = v[2];
+		out[i + 3] = v[3];
+	}
+
+	if (i < count)
+	{
+		Mix_Clip16_C(out + i, in + i, count - i);
+	}
+}
+
+static const sndmixer_t mixer_vecext = {
+	"vector extension",
+	Mix_Paint8_VecExt,
+	Mix_Paint16_VecExt,
+	Mix_AddRaw_VecExt,
+	Mix_Lowpass_C, /* two channels, nothing to gain */
+	Mix_Clip16_VecExt
+};
+
+#endif /* MIX_VECEXT */
+
+/* ------------------------------------------------------------------ */
+
+#ifdef MIX_SSE2
+
+/*
+ * SSE2 has no 32 bit multiply keeping
+ * the low half, emulate it. The low 32
+ * bits are the same for signed and
+ * unsigned operands.
+ */
+static inline __m128i
+Mix_MulLo32_SSE2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/*
+ * Adds the given four left / right
+ * pairs to the paintbuffer.
+ */
+static inline void
+Mix_Accumulate_SSE2(portable_samplepair_t *out, __m128i v)
+{
+	__m128i o = _mm_loadu_si128((__m128i *)out);
+
+	_mm_storeu_si128((__m128i *)out, _mm_add_epi32(o, v));
+}
+
+static void
+Mix_Paint8_SSE2(portable_samplepair_t *out, const byte *sfx, int count, int lvol, int rvol)
+{
+	const __m128i scale = _mm_setr_epi32(mix_scale[lvol], mix_scale[rvol],
+			mix_scale[lvol], mix_scale[rvol]);
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i s, lo, hi;
+
+		/* sign extend to 16 bit and add one to negative
+		   samples, that's what the scale table does */
+		s = _mm_loadl_epi64((const __m128i *)(sfx + i));
+		s = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+		s = _mm_sub_epi16(s, _mm_srai_epi16(s, 15));
+
+		/* duplicate each sample for left and right */
+		lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+		hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+
+		Mix_Accumulate_SSE2(out + i, Mix_MulLo32_SSE2(_mm_unpacklo_epi32(lo, lo), scale));
+		Mix_Accumulate_SSE2(out + i + 2, Mix_MulLo32_SSE2(_mm_unpackhi_epi32(lo, lo), scale));
+		Mix_Accumulate_SSE2(out + i + 4, Mix_MulLo32_SSE2(_mm_unpacklo_epi32(hi, hi), scale));
+		Mix_Accumulate_SSE2(out + i + 6, Mix_MulLo32_SSE2(_mm_unpackhi_epi32(hi, hi), scale));
+	}
+
+	if (i < count)
+	{
+		Mix_Paint8_C(out + i, sfx + i, count - i, lvol, rvol);
+	}
+}
+
+static void
+Mix_Paint16_SSE2(portable_samplepair_t *out, const short *sfx, int count, int leftvol, int rightvol)
+{
+	const __m128i vol = _mm_setr_epi32(leftvol, rightvol, leftvol, rightvol);
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		__m128i s, v;
+
+		s = _mm_loadl_epi64((const __m128i *)(sfx + i));
+		s = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+
+		v = Mix_MulLo32_SSE2(_mm_unpacklo_epi32(s, s), vol);
+		Mix_Accumulate_SSE2(out + i, _mm_srai_epi32(v, 8));
+
+		v = Mix_MulLo32_SSE2(_mm_unpackhi_epi32(s, s), vol);
+		Mix_Accumulate_SSE2(out + i + 2, _mm_srai_epi32(v, 8));
+	}
+
+	if (i < count)
+	{
+		Mix_Paint16_C(out + i, sfx + i, count - i, leftvol, rightvol);
+	}
+}
+
+static void
+Mix_AddRaw_SSE2(portable_samplepair_t *out, const portable_samplepair_t *in, int count)
+{
+	int i;
+
+	for (i = 0; i + 2 <= count; i += 2)
+	{
+		Mix_Accumulate_SSE2(out + i, _mm_loadu_si128((const __m128i *)(in + i)));
+	}
+
+	if (i < count)
+	{
+		Mix_AddRaw_C(out + i, in + i, count - i);
+	}
+}
+
+static void
+Mix_Lowpass_SSE2(LpfContext *lpf, int count, portable_samplepair_t *samples)
+{
+	const __m128 a = _mm_set1_ps(lpf->a);
+	__m128i h0, h1;
+	int s;
+
+	/* left and right are filtered side by side,
+	   this is exactly the same math as the C code */
+	h0 = _mm_loadl_epi64((const __m128i *)&lpf->history[0]);
+	h1 = _mm_loadl_epi64((const __m128i *)&lpf->history[1]);
+
+	for (s = 0; s < count; s++)
+	{
+		__m128i y;
+		__m128 d;
+
+		y = _mm_loadl_epi64((const __m128i *)&samples[s]);
+
+		d = _mm_cvtepi32_ps(_mm_sub_epi32(h0, y));
+		h0 = _mm_cvttps_epi32(_mm_add_ps(_mm_cvtepi32_ps(y), _mm_mul_ps(a, d)));
+
+		d = _mm_cvtepi32_ps(_mm_sub_epi32(h1, h0));
+		h1 = _mm_cvttps_epi32(_mm_add_ps(_mm_cvtepi32_ps(h0), _mm_mul_ps(a, d)));
+
+		_mm_storel_epi64((__m128i *)&samples[s], h1);
+	}
+
+	_mm_storel_epi64((__m128i *)&lpf->history[0], h0);
+	_mm_storel_epi64((__m128i *)&lpf->history[1], h1);
+}
+
+static void
+Mix_Clip16_SSE2(short *out, const int *in, int count)
+{
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(in + i)), 8);
+		__m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(in + i + 4)), 8);
+
+		/* packs saturates to the 16 bit range */
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+	}
+
+	if (i < count)
+	{
+		Mix_Clip16_C(out + i, in + i, count - i);
+	}
+}
+
+static const sndmixer_t mixer_sse2 = {
+	"SSE2",
+	Mix_Paint8_SSE2,
+	Mix_Paint16_SSE2,
+	Mix_AddRaw_SSE2,
+	Mix_Lowpass_SSE2,
+	Mix_Clip16_SSE2
+};
+
+#endif /* MIX_SSE2 */
+
+/* ------------------------------------------------------------------ */
+
+#ifdef MIX_NEON
+
+static void
+Mix_Paint8_NEON(portable_samplepair_t *out, const byte *sfx, int count, int lvol, int rvol)
+{
+	const int32_t scalev[4] = { mix_scale[lvol], mix_scale[rvol], mix_scale[lvol], mix_scale[rvol] };
+	const int32x4_t scale = vld1q_s32(scalev);
+	int32_t *o = (int32_t *)out;
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		int16x8_t s;
+		int32x4x2_t lo, hi;
+
+		/* add one to negative samples,
+		   that's what the scale table does */
+		s = vmovl_s8(vld1_s8((const int8_t *)(sfx + i)));
+		s = vsubq_s16(s, vshrq_n_s16(s, 15));
+
+		lo = vzipq_s32(vmovl_s16(vget_low_s16(s)), vmovl_s16(vget_low_s16(s)));
+		hi = vzipq_s32(vmovl_s16(vget_high_s16(s)), vmovl_s16(vget_high_s16(s)));
+
+		vst1q_s32(o + i * 2, vmlaq_s32(vld1q_s32(o + i * 2), lo.val[0], scale));
+		vst1q_s32(o + i * 2 + 4, vmlaq_s32(vld1q_s32(o + i * 2 + 4), lo.val[1], scale));
+		vst1q_s32(o + i * 2 + 8, vmlaq_s32(vld1q_s32(o + i * 2 + 8), hi.val[0], scale));
+		vst1q_s32(o + i * 2 + 12, vmlaq_s32(vld1q_s32(o + i * 2 + 12), hi.val[1], scale));
+	}
+
+	if (i < count)
+	{
+		Mix_Paint8_C(out + i, sfx + i, count - i, lvol, rvol);
+	}
+}
+
+static void
+Mix_Paint16_NEON(portable_samplepair_t *out, const short *sfx, int count, int leftvol, int rightvol)
+{
+	const int32_t volv[4] = { leftvol, rightvol, leftvol, rightvol };
+	const int32x4_t vol = vld1q_s32(volv);
+	int32_t *o = (int32_t *)out;
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		int32x4_t s = vmovl_s16(vld1_s16(sfx + i));
+		int32x4x2_t d = vzipq_s32(s, s);
+
+		vst1q_s32(o + i * 2, vaddq_s32(vld1q_s32(o + i * 2),
+				vshrq_n_s32(vmulq_s32(d.val[0], vol), 8)));
+		vst1q_s32(o + i * 2 + 4, vaddq_s32(vld1q_s32(o + i * 2 + 4),
+				vshrq_n_s32(vmulq_s32(d.val[1], vol), 8)));
+	}
+
+	if (i < count)
+	{
+		Mix_Paint16_C(out + i, sfx + i, count - i, leftvol, rightvol);
+	}
+}
+
+static void
+Mix_AddRaw_NEON(portable_samplepair_t *out, const portable_samplepair_t *in, int count)
+{
+	int32_t *o = (int32_t *)out;
+	const int32_t *r = (const int32_t *)in;
+	int i;
+
+	for (i = 0; i + 2 <= count; i += 2)
+	{
+		vst1q_s32(o + i * 2, vaddq_s32(vld1q_s32(o + i * 2), vld1q_s32(r + i * 2)));
+	}
+
+	if (i < count)
+	{
+		Mix_AddRaw_C(out + i, in + i, count - i);
+	}
+}
+
+static void
+Mix_Lowpass_NEON(LpfContext *lpf, int count, portable_samplepair_t *samples)
+{
+	const float32x2_t a = vdup_n_f32(lpf->a);
+	int32x2_t h0, h1;
+	int s;
+
+	h0 = vld1_s32((const int32_t *)&lpf->history[0]);
+	h1 = vld1_s32((const int32_t *)&lpf->history[1]);
+
+	for (s = 0; s < count; s++)
+	{
+		int32x2_t y = vld1_s32((const int32_t *)&samples[s]);
+		float32x2_t d;
+
+		d = vcvt_f32_s32(vsub_s32(h0, y));
+		h0 = vcvt_s32_f32(vadd_f32(vcvt_f32_s32(y), vmul_f32(a, d)));
+
+		d = vcvt_f32_s32(vsub_s32(h1, h0));
+		h1 = vcvt_s32_f32(vadd_f32(vcvt_f32_s32(h0), vmul_f32(a, d)));
+
+		vst1_s32((int32_t *)&samples[s], h1);
+	}
+
+	vst1_s32((int32_t *)&lpf->history[0], h0);
+	vst1_s32((int32_t *)&lpf->history[1], h1);
+}
+
+static void
+Mix_Clip16_NEON(short *out, const int *in, int count)
+{
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		int16x4_t a = vqmovn_s32(vshrq_n_s32(vld1q_s32(in + i), 8));
+		int16x4_t b = vqmovn_s32(vshrq_n_s32(vld1q_s32(in + i + 4), 8));
+
+		vst1q_s16(out + i, vcombine_s16(a, b));
+	}
+
+	if (i < count)
+	{
+		Mix_Clip16_C(out + i, in + i, count - i);
+	}
+}
+
+static const sndmixer_t mixer_neon = {
+	"NEON",
+	Mix_Paint8_NEON,
+	Mix_Paint16_NEON,
+	Mix_AddRaw_NEON,
+	Mix_Lowpass_NEON,
+	Mix_Clip16_NEON
+};
+
+#endif /* MIX_NEON */
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * Returns all mixers usable on this
+ * CPU, the best one is returned last.
+ */
+static int
+SDL_MixerList(const sndmixer_t **list)
+{
+	int num = 0;
+
+	list[num++] = &mixer_c;
+
+#ifdef MIX_VECEXT
+	list[num++] = &mixer_vecext;
+#endif
+
+#ifdef MIX_SSE2
+	if (SDL_HasSSE2())
+	{
+		list[num++] = &mixer_sse2;
+	}
+#endif
+
+#ifdef MIX_NEON
+	if (SDL_HasNEON())
+	{
+		list[num++] = &mixer_neon;
+	}
+#endif
+
+	return num;
+}
+
+/*
+ * Selects the mixing kernels, either the
+ * reference ones or the best available.
+ */
+static void
+SDL_MixerSelect(void)
+{
+	const sndmixer_t *list[4];
+	int num;
+
+	num = SDL_MixerList(list);
+
+	if (s_mixsimd->value)
+	{
+		snd_mixer = list[num - 1];
+	}
+	else
+	{
+		snd_mixer = list[0];
+	}
+
+	s_mixsimd->modified = false;
+
+	Com_Printf("SDL audio mixer is \"%s\".\n", snd_mixer->name);
+}
+
+/*
+ * Rebuilds the volume tables. The 8 bit
+ * reference mixer uses mix_scaletable, the
+ * vectorized mixers multiply by mix_scale.
+ */
+void
+SDL_MixerSetVolume(float volume)
+{
+	int i;
+
+	for (i = 0; i < 32; i++)
+	{
+		int j, scale;
+
+		scale = (int)(i * 8 * 256 * volume);
+		mix_scale[i] = scale;
+
+		for (j = 0; j < 256; j++)
+		{
+			mix_scaletable[i][j] = ((j < 128) ? j : j - 0xff) * scale;
+		}
+	}
+}
+
+/*
+ * Switches mixers if s_mixsimd changed.
+ */
+void
+SDL_MixerUpdate(void)
+{
+	if (s_mixsimd->modified)
+	{
+		/* the mixer thread uses it */
+		SDL_StopMixThread();
+		SDL_MixerSelect();
+	}
+}
+
+/* ------------------------------------------------------------------ */
+
+void
+SDL_MixerTracePaint(const char *name, int width, int lvol, int rvol,
+		int pos, int count, int offset)
+{
+	fprintf(mix_tracefile, "p %d %d %d %d %d %d %s\n",
+			width, lvol, rvol, pos, count, offset, name);
+}
+
+void
+SDL_MixerTraceOp(char op, int count)
+{
+	fprintf(mix_tracefile, "%c %d\n", op, count);
+}
+
+static void
+SDL_MixerStopTrace(void)
+{
+	if (mix_tracefile)
+	{
+		fclose(mix_tracefile);
+		mix_tracefile = NULL;
+		snd_mixtracing = false;
+
+		Com_Printf("Mixer trace stopped.\n");
+	}
+}
+
+/*
+ * Records all mixing operations into
+ * a file. Without argument recording
+ * is stopped.
+ */
+static void
+SDL_MixTrace_f(void)
+{
+	char name[MAX_OSPATH];
+
+	/* the trace is written by the mixer thread */
+	SDL_StopMixThread();
+	SDL_MixerStopTrace();
+
+	if (Cmd_Argc() < 2)
+	{
+		return;
+	}
+
+	Com_sprintf(name, sizeof(name), "%s/%s", FS_Gamedir(), Cmd_Argv(1));
+	FS_CreatePath(name);
+
+	mix_tracefile = Q_fopen(name, "w");
+
+	if (!mix_tracefile)
+	{
+		Com_Printf("Couldn't open %s.\n", name);
+		return;
+	}
+
+	snd_mixtracing = true;
+	Com_Printf("Recording mixer trace to %s.\n", name);
+}
+
+typedef struct
+{
+	char op;
+	sfxcache_t *sc;
+	int lvol, rvol;
+	int pos;
+	int count;
+	int offset;
+} mixevent_t;
+
+/*
+ * Replays the trace with one mixer. Returns
+ * the time in microseconds, the checksum of
+ * the produced samples is written to crc.
+ */
+static long long
+SDL_MixerReplay(const sndmixer_t *mixer, const mixevent_t *events, int numevents,
+		int iterations, unsigned *crc)
+{
+	static portable_samplepair_t buffer[MAX_RAW_SAMPLES];
+	static portable_samplepair_t raw[MAX_RAW_SAMPLES];
+	static short out[MAX_RAW_SAMPLES * 2];
+	LpfContext lpf;
+	long long start;
+	int i, j;
+
+	/* some noise for the raw samples */
+	for (i = 0; i < MAX_RAW_SAMPLES; i++)
+	{
+		raw[i].left = ((i * 7919) & 0xffff) - 0x8000;
+		raw[i].right = ((i * 104729) & 0xffff) - 0x8000;
+	}
+
+	lpf_initialize(&lpf, 0.25f, sound.speed);
+	memset(lpf.history, 0, sizeof(lpf.history));
+
+	*crc = 2166136261u;
+	start = Sys_Microseconds();
+
+	for (j = 0; j < iterations; j++)
+	{
+		for (i = 0; i < numevents; i++)
+		{
+			const mixevent_t *ev = &events[i];
+
+			switch (ev->op)
+			{
+				case 'c':
+					memset(buffer, 0, ev->count * sizeof(portable_samplepair_t));
+					break;
+
+				case 'p':
+					if (ev->sc->width == 1)
+					{
+						mixer->paint8(buffer + ev->offset, ev->sc->data + ev->pos,
+								ev->count, ev->lvol, ev->rvol);
+					}
+					else
+					{
+						mixer->paint16(buffer + ev->offset, (short *)ev->sc->data + ev->pos,
+								ev->count, ev->lvol, ev->rvol);
+					}
+					break;
+
+				case 'r':
+					mixer->addraw(buffer, raw, ev->count);
+					break;
+
+				case 'l':
+					mixer->lowpass(&lpf, ev->count, buffer);
+					break;
+
+				case 't':
+					mixer->clip16(out, (int *)buffer, ev->count * 2);
+
+					if (j == 0)
+					{
+						int k;
+
+						for (k = 0; k < ev->count * 2; k++)
+						{
+							*crc = (*crc ^ (unsigned short)out[k]) * 16777619u;
+						}
+					}
+					break;
+			}
+		}
+	}
+
+	return Sys_Microseconds() - start;
+}
+
+/*
+ * Replays a mixer trace against all
+ * available mixers and prints the
+ * time each of them took.
+ */
+static void
+SDL_MixBench_f(void)
+{
+	const sndmixer_t *list[4];
+	char name[MAX_OSPATH];
+	char line[MAX_QPATH + 64];
+	mixevent_t *events;
+	int numevents, maxevents;
+	long long samples, reference;
+	unsigned refcrc;
+	int iterations;
+	int num, i;
+	FILE *f;
+
+	if (Cmd_Argc() < 2)
+	{
+		Com_Printf("Usage: s_mixbench <trace> [iterations]\n");
+		return;
+	}
+
+	iterations = (Cmd_Argc() > 2) ? (int)strtol(Cmd_Argv(2), NULL, 10) : 10;
+
+	if (iterations < 1)
+	{
+		iterations = 1;
+	}
+
+	Com_sprintf(name, sizeof(name), "%s/%s", FS_Gamedir(), Cmd_Argv(1));
+	f = Q_fopen(name, "r");
+
+	if (!f)
+	{
+		Com_Printf("Couldn't open %s.\n", name);
+		return;
+	}
+
+	maxevents = 4096;
+	numevents = 0;
+	samples = 0;
+	events = malloc(maxevents * sizeof(mixevent_t));
+	YQ2_COM_CHECK_OOM(events, "malloc()", maxevents * sizeof(mixevent_t))
+
+	while (fgets(line, sizeof(line), f))
+	{
+		mixevent_t ev = {0};
+		char sfxname[MAX_QPATH];
+		int width;
+
+		if (line[0] == 'p')
+		{
+			sfx_t *sfx;
+
+			if (sscanf(line, "p %d %d %d %d %d %d %63s", &width, &ev.lvol, &ev.rvol,
+						&ev.pos, &ev.count, &ev.offset, sfxname) != 7)
+			{
+				continue;
+			}
+
+			sfx = S_RegisterSound(sfxname);
+			ev.sc = sfx ? S_LoadSound(sfx) : NULL;
+
+			/* the sound may have changed since recording */
+			if (!ev.sc || (ev.sc->width != width) || (ev.pos + ev.count > ev.sc->length) ||
+				(ev.offset + ev.count > MAX_RAW_SAMPLES))
+			{
+				continue;
+			}
+		}
+		else if (sscanf(line, "%*c %d", &ev.count) != 1 ||
+				(ev.count < 0) || (ev.count > MAX_RAW_SAMPLES))
+		{
+			continue;
+		}
+
+		ev.op = line[0];
+
+		if (ev.op == 't')
+		{
+			samples += ev.count;
+		}
+
+		if (numevents == maxevents)
+		{
+			mixevent_t *tmp;
+
+			maxevents *= 2;
+			tmp = realloc(events, maxevents * sizeof(mixevent_t));
+			YQ2_COM_CHECK_OOM(tmp, "realloc()", maxevents * sizeof(mixevent_t))
+			events = tmp;
+		}
+
+		events[numevents++] = ev;
+	}
+
+	fclose(f);
+
+	if (!samples)
+	{
+		Com_Printf("%s contains no mixed samples.\n", name);
+		free(events);
+		return;
+	}
+
+	Com_Printf("Replaying %d operations, %lld samples, %d times.\n",
+			numevents, samples, iterations);
+
+	num = SDL_MixerList(list);
+	reference = 0;
+	refcrc = 0;
+
+	for (i = 0; i < num; i++)
+	{
+		long long usec;
+		unsigned crc;
+
+		usec = SDL_MixerReplay(list[i], events, numevents, iterations, &crc);
+
+		if (usec < 1)
+		{
+			usec = 1;
+		}
+
+		if (i == 0)
+		{
+			reference = usec;
+			refcrc = crc;
+		}
+
+		Com_Printf("%-17s %8lld usec %8.2f Msamples/s %5.2fx %s\n", list[i]->name, usec,
+				(double)samples * iterations / usec, (double)reference / usec,
+				(crc == refcrc) ? "" : "MISMATCH");
+	}
+
+	free(events);
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * Selects the mixer and registers
+ * the debugging commands.
+ */
+void
+SDL_MixerInit(void)
+{
+	s_mixsimd = Cvar_Get("s_mixsimd", "1", CVAR_ARCHIVE);
+
+	SDL_MixerSelect();
+
+	Cmd_AddCommand("s_mixtrace", SDL_MixTrace_f);
+	Cmd_AddCommand("s_mixbench", SDL_MixBench_f);
+}
+
+void
+SDL_MixerShutdown(void)
+{
+	SDL_MixerStopTrace();
+
+	Cmd_RemoveCommand("s_mixtrace");
+	Cmd_RemoveCommand("s_mixbench");
+}
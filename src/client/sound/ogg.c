@@ -34,12 +34,39 @@
 #include <errno.h>
 
 #include "../header/client.h"
+#include "../header/threads.h"
 #include "header/local.h"
 #include "header/vorbis.h"
 
 #define STB_VORBIS_NO_PUSHDATA_API
 #include "header/stb_vorbis.h"
 
+#define OGG_BLOCKSIZE 4096 /* shorts per block */
+#define OGG_NUMBLOCKS 32   /* must be a power of two */
+
+/*
+ * The decoder thread passes decoded samples and
+ * the end of a track or an error to the main
+ * thread in blocks.
+ */
+typedef enum
+{
+	OGG_BLOCK_PCM,
+	OGG_BLOCK_END,
+	OGG_BLOCK_ERROR
+} oggblocktype_t;
+
+typedef struct
+{
+	oggblocktype_t type;
+	int generation;   /* of the request it belongs to */
+	int rate;
+	int channels;
+	int samples;      /* per channel */
+	int error;        /* < 0: -errno, > 0: stb_vorbis error */
+	short data[OGG_BLOCKSIZE];
+} oggblock_t;
+
 static cvar_t *ogg_pausewithgame;       /* Pause music when the game is paused */
 static cvar_t *ogg_enabled;       /* Backend is enabled */
 static cvar_t *ogg_shuffle;       /* Shuffle playback */
@@ -50,9 +77,36 @@ static int ogg_numbufs;           /* Number of buffers for OpenAL */
 static int ogg_numsamples;        /* Number of sambles read from the current file */
 static int ogg_mapcdtrack;        /* Index of current map cdtrack */
 static ogg_status_t ogg_status;   /* Status indicator. */
-static stb_vorbis *ogg_file;      /* Ogg Vorbis file. */
 static qboolean ogg_started;      /* Initialization flag. */
 static qboolean ogg_mutemusic;    /* Mute music */
+static int ogg_generation;        /* Request the main thread waits for. */
+static int ogg_nexttrack;         /* Random track chosen in advance. */
+
+/* What the decoder should do, guarded by ogg_lock. */
+static struct
+{
+	int generation;              /* bumped by every new track or stop */
+	char path[MAX_OSPATH];       /* track to decode, empty for none */
+	int start;                   /* sample to seek to, -1 for none */
+	char nextpath[MAX_OSPATH];   /* track to open in advance */
+	qboolean quit;
+} ogg_request;
+
+/* Decoder thread. Only it touches the files. The
+   block ring has one producer (the decoder) and one
+   consumer (the main thread) and needs no lock. */
+static SDL_Thread *ogg_thread;
+static yq2_mutex_t *ogg_lock;
+static yq2_sem_t *ogg_wake;
+static oggblock_t ogg_blocks[OGG_NUMBLOCKS];
+static yq2_atomic_t ogg_blockhead;   /* written by the decoder */
+static yq2_atomic_t ogg_blocktail;   /* written by the main thread */
+static stb_vorbis *ogg_decfile;      /* Ogg Vorbis file being decoded. */
+static char ogg_decpath[MAX_OSPATH];
+static stb_vorbis *ogg_prefile;      /* Next file, already opened. */
+static char ogg_prepath[MAX_OSPATH];
+static int ogg_decgeneration;
+static int ogg_decerror;
 
 enum { MAX_NUM_OGGTRACKS = 128 };
 static char* ogg_tracks[MAX_NUM_OGGTRACKS];
@@ -237,38 +291,370 @@ OGG_InitTrackList(void)
 // --------
 
 /*
- * Play a portion of the currently opened file.
+ * Opens a file for decoding.
  */
-void
-static OGG_Read(void)
+static stb_vorbis *
+OGG_OpenFile(const char *path, int *error)
 {
-	short samples[4096] = {0};
-	float volume = (ogg_mutemusic == true) ? 0.0f : ogg_volume->value;
+	FILE *f = Q_fopen(path, "rb");
 
-	int read_samples = stb_vorbis_get_samples_short_interleaved(ogg_file, ogg_file->channels, samples,
-		sizeof(samples) / sizeof(short));
+	if (f == NULL)
+	{
+		*error = -errno;
+		return NULL;
+	}
 
-	if (read_samples > 0)
+	// fclose is not required on error with close_on_free=true
+	return stb_vorbis_open_file(f, true, error, NULL);
+}
+
+/*
+ * Without a decoder thread there's no
+ * lock and nothing to wake, see OGG_Init().
+ */
+static void
+OGG_Lock(void)
+{
+	if (ogg_lock)
 	{
-		ogg_numsamples += read_samples;
+		SDL_LockMutex(ogg_lock);
+	}
+}
 
-		S_RawSamples(read_samples, ogg_file->sample_rate, sizeof(short), ogg_file->channels,
-			(byte *)samples, volume);
+static void
+OGG_Unlock(void)
+{
+	if (ogg_lock)
+	{
+		SDL_UnlockMutex(ogg_lock);
+	}
+}
+
+static void
+OGG_Wake(void)
+{
+	if (ogg_wake)
+	{
+		YQ2_SemPost(ogg_wake);
+	}
+}
+
+/*
+ * Returns the next free block
+ * or NULL if the ring is full.
+ */
+static oggblock_t *
+OGG_ReserveBlock(void)
+{
+	int head = YQ2_AtomicGet(&ogg_blockhead);
+
+	if (head - YQ2_AtomicGet(&ogg_blocktail) >= OGG_NUMBLOCKS)
+	{
+		return NULL;
+	}
+
+	return &ogg_blocks[head & (OGG_NUMBLOCKS - 1)];
+}
+
+/*
+ * Hands the reserved block
+ * to the main thread.
+ */
+static void
+OGG_CommitBlock(void)
+{
+	YQ2_AtomicAdd(&ogg_blockhead, 1);
+}
+
+/*
+ * One step of the decoder: Picks up new requests
+ * and decodes one block. Returns false if there
+ * is nothing to do. Runs in the decoder thread
+ * or, if that couldn't be started, in OGG_Stream().
+ */
+static qboolean
+OGG_DecodeStep(void)
+{
+	char path[MAX_OSPATH];
+	char nextpath[MAX_OSPATH];
+	int generation, start, error;
+	oggblock_t *block;
+
+	OGG_Lock();
+	generation = ogg_request.generation;
+	start = ogg_request.start;
+	Q_strlcpy(path, ogg_request.path, sizeof(path));
+	Q_strlcpy(nextpath, ogg_request.nextpath, sizeof(nextpath));
+	OGG_Unlock();
+
+	if (generation != ogg_decgeneration)
+	{
+		ogg_decgeneration = generation;
+		ogg_decerror = 0;
+
+		/* a seek in the running track keeps the file */
+		if (!ogg_decfile || (start < 0) || strcmp(path, ogg_decpath))
+		{
+			if (ogg_decfile)
+			{
+				stb_vorbis_close(ogg_decfile);
+				ogg_decfile = NULL;
+			}
+
+			if (path[0] && ogg_prefile && !strcmp(path, ogg_prepath))
+			{
+				ogg_decfile = ogg_prefile;
+				ogg_prefile = NULL;
+				ogg_prepath[0] = '\0';
+			}
+			else if (path[0])
+			{
+				error = 0;
+				ogg_decfile = OGG_OpenFile(path, &error);
+
+				if (!ogg_decfile)
+				{
+					ogg_decerror = error ? error : VORBIS_unexpected_eof;
+				}
+			}
+
+			Q_strlcpy(ogg_decpath, path, sizeof(ogg_decpath));
+		}
+
+		if (ogg_decfile && (start >= 0))
+		{
+			stb_vorbis_seek_frame(ogg_decfile, start);
+		}
+
+		return true;
+	}
+
+	/* open the next track before the
+	   current one comes to its end */
+	if (strcmp(nextpath, ogg_prepath))
+	{
+		if (ogg_prefile)
+		{
+			stb_vorbis_close(ogg_prefile);
+			ogg_prefile = NULL;
+		}
+
+		if (nextpath[0])
+		{
+			/* errors are reported when the
+			   track is really played */
+			ogg_prefile = OGG_OpenFile(nextpath, &error);
+		}
+
+		Q_strlcpy(ogg_prepath, nextpath, sizeof(ogg_prepath));
+
+		return true;
+	}
+
+	if (!ogg_decfile && !ogg_decerror)
+	{
+		return false;
+	}
+
+	block = OGG_ReserveBlock();
+
+	if (!block)
+	{
+		return false;
+	}
+
+	block->generation = generation;
+
+	if (ogg_decerror)
+	{
+		block->type = OGG_BLOCK_ERROR;
+		block->error = ogg_decerror;
+		ogg_decerror = 0;
+
+		OGG_CommitBlock();
+		return true;
+	}
+
+	block->rate = ogg_decfile->sample_rate;
+	block->channels = ogg_decfile->channels;
+	block->samples = stb_vorbis_get_samples_short_interleaved(ogg_decfile,
+		ogg_decfile->channels, block->data, OGG_BLOCKSIZE);
+
+	if (block->samples > 0)
+	{
+		block->type = OGG_BLOCK_PCM;
 	}
 	else
 	{
-		// We cannot call OGG_Stop() here. It flushes the OpenAL sample
-		// queue, thus about 12 seconds of music are lost. Instead we
-		// just set the OGG state to stop and open a new file. The new
-		// files content is added to the sample queue after the remaining
-		// samples from the old file.
-		stb_vorbis_close(ogg_file);
+		block->type = OGG_BLOCK_END;
+
+		stb_vorbis_close(ogg_decfile);
+		ogg_decfile = NULL;
+		ogg_decpath[0] = '\0';
+	}
+
+	OGG_CommitBlock();
+	return true;
+}
+
+/*
+ * Closes all files of the decoder.
+ */
+static void
+OGG_CloseDecoder(void)
+{
+	if (ogg_decfile)
+	{
+		stb_vorbis_close(ogg_decfile);
+		ogg_decfile = NULL;
+	}
+
+	if (ogg_prefile)
+	{
+		stb_vorbis_close(ogg_prefile);
+		ogg_prefile = NULL;
+	}
+
+	ogg_decpath[0] = '\0';
+	ogg_prepath[0] = '\0';
+}
+
+/*
+ * The decoder thread. Keeps the block
+ * ring filled and sleeps otherwise.
+ */
+static int SDLCALL
+OGG_DecodeThread(void *data)
+{
+	qboolean quit;
+
+	do
+	{
+		if (!OGG_DecodeStep())
+		{
+			YQ2_SemWaitTimeout(ogg_wake, 100);
+		}
+
+		OGG_Lock();
+		quit = ogg_request.quit;
+		OGG_Unlock();
+	}
+	while (!quit);
+
+	OGG_CloseDecoder();
+
+	return 0;
+}
+
+/*
+ * Tells the decoder to play a file, to seek
+ * in it (start >= 0) or to stop (path NULL).
+ * Blocks of earlier requests are dropped.
+ */
+static void
+OGG_Request(const char *path, int start)
+{
+	OGG_Lock();
+	ogg_generation = ++ogg_request.generation;
+	Q_strlcpy(ogg_request.path, path ? path : "", sizeof(ogg_request.path));
+	ogg_request.start = start;
+	OGG_Unlock();
+
+	OGG_Wake();
+}
+
+/*
+ * Tells the decoder which file
+ * to open in advance.
+ */
+static void
+OGG_Prefetch(const char *path)
+{
+	OGG_Lock();
+	Q_strlcpy(ogg_request.nextpath, path ? path : "", sizeof(ogg_request.nextpath));
+	OGG_Unlock();
+
+	OGG_Wake();
+}
+
+/*
+ * Play a portion of the currently opened file.
+ * Returns false if no decoded samples are
+ * available.
+ */
+static qboolean
+OGG_Read(void)
+{
+	oggblock_t *block;
+	int tail;
+
+	tail = YQ2_AtomicGet(&ogg_blocktail);
+
+	if (tail == YQ2_AtomicGet(&ogg_blockhead))
+	{
+		return false;
+	}
+
+	block = &ogg_blocks[tail & (OGG_NUMBLOCKS - 1)];
+
+	if (block->generation != ogg_generation)
+	{
+		/* left over from an earlier track */
+		YQ2_AtomicSet(&ogg_blocktail, tail + 1);
+		return true;
+	}
+
+	if (block->type == OGG_BLOCK_PCM)
+	{
+		float volume = (ogg_mutemusic == true) ? 0.0f : ogg_volume->value;
+
+		ogg_numsamples += block->samples;
+
+		S_RawSamples(block->samples, block->rate, sizeof(short), block->channels,
+			(byte *)block->data, volume);
+
+		YQ2_AtomicSet(&ogg_blocktail, tail + 1);
+		return true;
+	}
+
+	YQ2_AtomicSet(&ogg_blocktail, tail + 1);
+
+	if (block->type == OGG_BLOCK_ERROR)
+	{
+		const char *name = ogg_tracks[ogg_curfile] ? ogg_tracks[ogg_curfile] : "?";
+
+		if (block->error < 0)
+		{
+			Com_Printf("%s: could not open file %s for track %d: %s.\n", __func__,
+				name, ogg_curfile, strerror(-block->error));
+
+			free(ogg_tracks[ogg_curfile]);
+			ogg_tracks[ogg_curfile] = NULL;
+		}
+		else
+		{
+			Com_Printf("%s: '%s' is not a valid Ogg Vorbis file (error %i).\n", __func__,
+				name, block->error);
+		}
+
 		ogg_status = STOP;
 		ogg_numbufs = 0;
-		ogg_numsamples = 0;
 
-		OGG_PlayTrack(ogg_curfile, false, false);
+		return false;
 	}
+
+	// We cannot call OGG_Stop() here. It flushes the OpenAL sample
+	// queue, thus about 12 seconds of music are lost. Instead we
+	// just set the OGG state to stop and open a new file. The new
+	// files content is added to the sample queue after the remaining
+	// samples from the old file. The decoder has closed the file.
+	ogg_status = STOP;
+	ogg_numbufs = 0;
+	ogg_numsamples = 0;
+
+	OGG_PlayTrack(ogg_curfile, false, false);
+
+	return true;
 }
 
 /*
@@ -304,6 +690,15 @@ OGG_Stream(void)
 
 	if (ogg_status == PLAY)
 	{
+		if (!ogg_thread)
+		{
+			/* no decoder thread, fill
+			   the ring ourself */
+			while (OGG_DecodeStep())
+			{
+			}
+		}
+
 #ifdef USE_OPENAL
 		if (sound_started == SS_OAL)
 		{
@@ -322,7 +717,10 @@ OGG_Stream(void)
 			   buffering normal sfx _and_ ogg/vorbis samples. */
 			while (active_buffers <= ogg_numbufs)
 			{
-				OGG_Read();
+				if (!OGG_Read())
+				{
+					break;
+				}
 			}
 		}
 		else /* using SDL */
@@ -334,12 +732,18 @@ OGG_Stream(void)
 				   were played since the last call to this function.
 				   This keeps the buffer at all times at an "optimal"
 				   fill level. */
-				while (paintedtime + MAX_RAW_SAMPLES - 2048 > s_rawend)
+				while (SDL_PaintedTime() + MAX_RAW_SAMPLES - 2048 > s_rawend)
 				{
-					OGG_Read();
+					if (!OGG_Read())
+					{
+						break;
+					}
 				}
 			}
 		}
+
+		/* there's space in the ring again */
+		OGG_Wake();
 	}
 
 	if (ogg_status == PLAY && ogg_shuffle->modified)
@@ -363,6 +767,62 @@ OGG_Stream(void)
 
 // --------
 
+/*
+ * Picks a random track other than curtrack.
+ */
+static int
+OGG_RandomTrack(int curtrack)
+{
+	int retries = 100;
+	int newtrack = 0;
+
+	while (retries-- > 0 && newtrack < 2)
+	{
+		newtrack = randk() % (ogg_maxfileindex + 1);
+
+		if (newtrack == curtrack)
+		{
+			newtrack = 0;
+		}
+	}
+
+	return newtrack;
+}
+
+/*
+ * Guesses the track OGG_PlayTrack() picks when
+ * curtrack has ended, so the decoder can open
+ * it in advance. A random track is chosen
+ * right now. Returns 0 if there's none.
+ */
+static int
+OGG_NextTrack(int curtrack)
+{
+	int newtrack;
+
+	switch ((int)ogg_shuffle->value)
+	{
+	case 0:			// default
+		newtrack = curtrack;
+		break;
+	case 2:			// sequential
+		newtrack = (curtrack + 1) % (ogg_maxfileindex + 1) != 0 ? (curtrack + 1) : 2;
+		break;
+	case 3:			// random
+		newtrack = ogg_nexttrack = OGG_RandomTrack(curtrack);
+		break;
+	default:
+		return 0;
+	}
+
+	if ((newtrack < 2) || (newtrack > ogg_maxfileindex))
+	{
+		return 0;
+	}
+
+	return newtrack;
+}
+
 /*
  * play the ogg file that corresponds to the CD track with the given number
  */
@@ -444,21 +904,22 @@ OGG_PlayTrack(int trackNo, qboolean cdtrack, qboolean immediate)
 	} break;
 	case 3:			// random
 	{
-		int retries = 100;
-		newtrack = 0;
-
-		while (retries-- > 0 && newtrack < 2)
+		/* the decoder may have opened
+		   it already, see OGG_NextTrack() */
+		if (ogg_nexttrack >= 2 && ogg_nexttrack <= ogg_maxfileindex &&
+			ogg_nexttrack != curtrack)
 		{
-			newtrack = randk() % (ogg_maxfileindex + 1);
-
-			if (newtrack == curtrack)
-			{
-				newtrack = 0;
-			}
+			newtrack = ogg_nexttrack;
+		}
+		else
+		{
+			newtrack = OGG_RandomTrack(curtrack);
 		}
 	} break;
 	}
 
+	ogg_nexttrack = 0;
+
 	trackNo = newtrack;
 
 	if (ogg_maxfileindex == -1)
@@ -497,33 +958,17 @@ OGG_PlayTrack(int trackNo, qboolean cdtrack, qboolean immediate)
 		return;
 	}
 
-	/* Open ogg vorbis file. */
-	FILE* f = Q_fopen(ogg_tracks[trackNo], "rb");
-
-	if (f == NULL)
-	{
-		Com_Printf("%s: could not open file %s for track %d: %s.\n", __func__, ogg_tracks[trackNo], trackNo, strerror(errno));
-		ogg_tracks[trackNo] = NULL;
-
-		return;
-	}
-
-	int res = 0;
-
-	// fclose is not required on error with close_on_free=true
-	ogg_file = stb_vorbis_open_file(f, true, &res, NULL);
-
-	if (res != 0)
-	{
-		Com_Printf("%s: '%s' is not a valid Ogg Vorbis file (error %i).\n", __func__, ogg_tracks[trackNo], res);
-
-		return;
-	}
+	/* Play file. The decoder opens it, errors
+	   are reported by OGG_Read(). */
+	OGG_Request(ogg_tracks[trackNo], -1);
 
-	/* Play file. */
 	ogg_curfile = trackNo;
 	ogg_numsamples = 0;
 	ogg_status = PLAY;
+
+	int nexttrack = OGG_NextTrack(trackNo);
+
+	OGG_Prefetch(nexttrack ? ogg_tracks[nexttrack] : NULL);
 }
 
 // ----
@@ -554,12 +999,12 @@ OGG_Info(void)
 	{
 		case PLAY:
 			Com_Printf("State: Playing file %d (%s) at %i samples.\n",
-			           ogg_curfile, ogg_tracks[ogg_curfile], stb_vorbis_get_sample_offset(ogg_file));
+			           ogg_curfile, ogg_tracks[ogg_curfile], ogg_numsamples);
 			break;
 
 		case PAUSE:
 			Com_Printf("State: Paused file %d (%s) at %i samples.\n",
-			           ogg_curfile, ogg_tracks[ogg_curfile], stb_vorbis_get_sample_offset(ogg_file));
+			           ogg_curfile, ogg_tracks[ogg_curfile], ogg_numsamples);
 			break;
 
 		case STOP:
@@ -594,7 +1039,7 @@ OGG_Stop(void)
 	}
 #endif
 
-	stb_vorbis_close(ogg_file);
+	OGG_Request(NULL, -1);
 	ogg_status = STOP;
 	ogg_numbufs = 0;
 }
@@ -728,8 +1173,12 @@ OGG_RecoverState(void)
 	Cvar_SetValue("ogg_shuffle", 0);
 
 	OGG_PlayTrack(ogg_saved_state.curfile, false, true);
-	stb_vorbis_seek_frame(ogg_file, ogg_saved_state.numsamples);
-	ogg_numsamples = ogg_saved_state.numsamples;
+
+	if (ogg_status == PLAY)
+	{
+		OGG_Request(ogg_tracks[ogg_curfile], ogg_saved_state.numsamples);
+		ogg_numsamples = ogg_saved_state.numsamples;
+	}
 
 	Cvar_SetValue("ogg_shuffle", shuffle_state);
 }
@@ -771,8 +1220,42 @@ OGG_Init(void)
 	ogg_status = STOP;
 
 	ogg_mapcdtrack = 0;
+	ogg_nexttrack = 0;
 
 	ogg_mutemusic = false;
+
+	// Decoder
+	memset(&ogg_request, 0, sizeof(ogg_request));
+	ogg_generation = ogg_decgeneration = 0;
+	YQ2_AtomicSet(&ogg_blockhead, 0);
+	YQ2_AtomicSet(&ogg_blocktail, 0);
+
+	ogg_lock = SDL_CreateMutex();
+	ogg_wake = SDL_CreateSemaphore(0);
+
+	if (ogg_lock && ogg_wake)
+	{
+		ogg_thread = SDL_CreateThread(OGG_DecodeThread, "yq2ogg", NULL);
+	}
+
+	if (!ogg_thread)
+	{
+		/* OGG_Stream() decodes instead */
+		Com_Printf("Couldn't start the Ogg Vorbis decoder thread: %s\n", SDL_GetError());
+
+		if (ogg_wake)
+		{
+			SDL_DestroySemaphore(ogg_wake);
+			ogg_wake = NULL;
+		}
+
+		if (ogg_lock)
+		{
+			SDL_DestroyMutex(ogg_lock);
+			ogg_lock = NULL;
+		}
+	}
+
 	ogg_started = true;
 }
 
@@ -790,6 +1273,32 @@ OGG_Shutdown(void)
 	// Music must be stopped.
 	OGG_Stop();
 
+	// Stop the decoder.
+	if (ogg_thread)
+	{
+		OGG_Lock();
+		ogg_request.quit = true;
+		OGG_Unlock();
+
+		OGG_Wake();
+		SDL_WaitThread(ogg_thread, NULL);
+		ogg_thread = NULL;
+	}
+
+	OGG_CloseDecoder();
+
+	if (ogg_wake)
+	{
+		SDL_DestroySemaphore(ogg_wake);
+		ogg_wake = NULL;
+	}
+
+	if (ogg_lock)
+	{
+		SDL_DestroyMutex(ogg_lock);
+		ogg_lock = NULL;
+	}
+
 	// Free file list.
 	for(int i=0; i<MAX_NUM_OGGTRACKS; ++i)
 	{
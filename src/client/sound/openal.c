@@ -897,7 +897,7 @@ AL_AddLoopSounds(void)
 		}
 
 		/* allocate a channel */
-		ch = S_PickChannel(0, 0);
+		ch = S_PickChannel(0, 0, cl.playernum + 1);
 
 		if (!ch)
 		{
@@ -944,7 +944,7 @@ AL_IssuePlaysounds(void)
 			break;
 		}
 
-		S_IssuePlaysound(ps);
+		S_IssuePlaysound(ps, cl.playernum + 1);
 	}
 }
 
@@ -42,15 +42,89 @@
 
 /* Local includes */
 #include "../../client/header/client.h"
+#include "../../client/header/threads.h"
 #include "../../client/sound/header/local.h"
 
 /* Defines */
 #define SDL_PAINTBUFFER_SIZE 2048
 #define SDL_FULLVOLUME 80
 #define SDL_LOOPATTENUATE 0.003
+#define MIX_NUMCMDS 256 /* must be a power of two */
+#define MIX_NUMFRAMES 4 /* must be a power of two */
+#define MIX_MAXISSUES 64
+
+/*
+ * Everything the mixer needs to know about
+ * the client, captured once per frame. When
+ * mixing in a thread it's passed through a
+ * small ring, so the mixer never reads
+ * client state that's changed under it.
+ */
+typedef struct
+{
+	vec3_t origin;          /* listener */
+	vec3_t right;
+	int playernum;
+	qboolean active;        /* cls.state == ca_active */
+	qboolean loading;       /* loading plaque is up, play nothing */
+	qboolean show;          /* s_show */
+	qboolean underwater;
+	qboolean testsound;
+	int volume;             /* s_volume * 256 */
+	float mixahead;         /* seconds */
+
+	int numloops;
+	struct
+	{
+		sfx_t *sfx;
+		int left;
+		int right;
+	} loops[MAX_CHANNELS];
+
+	qboolean hasorigins;    /* else use the client entities */
+	vec3_t entorigins[MAX_EDICTS];
+} mixframe_t;
+
+/*
+ * s_show output of the mixer
+ * thread, printed by the main
+ * thread.
+ */
+typedef struct
+{
+	int numissues;
+	int issues[MIX_MAXISSUES];  /* begin of the issued playsounds */
+	int numchannels;
+	struct
+	{
+		int left;
+		int right;
+		char name[MAX_QPATH];
+	} channels[MAX_CHANNELS];
+	int painted;
+} mixshow_t;
+
+/*
+ * Commands for the mixer thread
+ */
+typedef enum
+{
+	MIXCMD_PLAY,
+	MIXCMD_STOPALL,
+	MIXCMD_QUIT
+} mixcmdtype_t;
+
+typedef struct
+{
+	mixcmdtype_t type;
+	pssort_t sorting;
+	playsound_t ps;
+} mixcmd_t;
 
 /* Globals */
 static cvar_t *s_sdldriver;
+static cvar_t *s_mixthread;
+static cvar_t *s_mixthread_ahead;
 static int *snd_p;
 static sound_t *backend;
 static portable_samplepair_t paintbuffer[SDL_PAINTBUFFER_SIZE];
@@ -58,26 +132,43 @@ static int beginofs;
 static int playpos = 0;
 static int samplesize = 0;
 static int snd_inited = 0;
-static int snd_scaletable[32][256];
 static int snd_vol;
 static int soundtime;
+qboolean snd_threaded;
+
+/* The frame of the non threaded mixer and
+   the frame the mixer currently works with */
+static mixframe_t sdl_frame;
+static const mixframe_t *mix_frame = &sdl_frame;
+
+/* Mixer thread. The command and the frame
+   ring have exactly one producer (the main
+   thread) and one consumer (the mixer), so
+   they get along without locks. */
+static SDL_Thread *mix_thread;
+static yq2_sem_t *mix_wake;
+static mixcmd_t mix_cmds[MIX_NUMCMDS];
+static yq2_atomic_t mix_cmdhead;    /* written by the main thread */
+static yq2_atomic_t mix_cmdtail;    /* written by the mixer */
+static mixframe_t mix_frames[MIX_NUMFRAMES];
+static yq2_atomic_t mix_framehead;  /* frames published by the main thread */
+static yq2_atomic_t mix_frametail;  /* frame in use by the mixer */
+static int mix_frameseen;
+static yq2_atomic_t mix_painted;    /* paintedtime, published by the mixer */
+static yq2_atomic_t mix_rawend;     /* s_rawend, published by the main thread */
+static mixshow_t mix_show;
+static yq2_atomic_t mix_showready;  /* mix_show belongs to the main thread */
+static int mix_rawdropped;
 
 /* ------------------------------------------------------------------ */
 
-typedef struct {
-	float a;
-	float gain_hf;
-	portable_samplepair_t history[2];
-	qboolean is_history_initialized;
-} LpfContext;
-
 static const int lpf_reference_frequency = 5000;
 static const float lpf_default_gain_hf = 0.25F;
 
 static LpfContext lpf_context;
 static qboolean lpf_is_enabled;
 
-static void
+void
 lpf_initialize(LpfContext* lpf_context, float gain_hf, int target_frequency)
 {
 	assert(target_frequency > 0);
@@ -123,8 +214,6 @@ lpf_update_samples(LpfContext* lpf_context,int sample_count, portable_samplepair
 	assert(samples);
 
 	int s;
-	float a;
-	portable_samplepair_t y;
 	portable_samplepair_t* history;
 
 	if (sample_count <= 0)
@@ -132,7 +221,6 @@ lpf_update_samples(LpfContext* lpf_context,int sample_count, portable_samplepair
 		return;
 	}
 
-	a = lpf_context->a;
 	history = lpf_context->history;
 
 	if (!lpf_context->is_history_initialized)
@@ -146,30 +234,7 @@ lpf_update_samples(LpfContext* lpf_context,int sample_count, portable_samplepair
 		}
 	}
 
-	for (s = 0; s < sample_count; ++s)
-	{
-		/* Update left channel */
-		y.left = samples[s].left;
-
-		y.left = (int)(y.left + a * (history[0].left - y.left));
-		history[0].left = y.left;
-
-		y.left = (int)(y.left + a * (history[1].left - y.left));
-		history[1].left = y.left;
-
-
-		/* Update right channel */
-		y.right = samples[s].right;
-
-		y.right = (int)(y.right + a * (history[0].right - y.right));
-		history[0].right = y.right;
-
-		y.right = (int)(y.right + a * (history[1].right - y.right));
-		history[1].right = y.right;
-
-		/* Update sample */
-		samples[s] = y;
-	}
+	snd_mixer->lowpass(lpf_context, sample_count, samples);
 }
 
 /*
@@ -186,7 +251,7 @@ SDL_TransferPaintBuffer(int endtime)
 
 	pbuf = sound.buffer;
 
-	if (s_testsound->value)
+	if (mix_frame->testsound)
 	{
 		int i;
 		int count;
@@ -210,7 +275,6 @@ SDL_TransferPaintBuffer(int endtime)
 
 		while (ls_paintedtime < endtime)
 		{
-			int i;
 			short *snd_out;
 			int snd_linear_count;
 			int lpos;
@@ -228,38 +292,7 @@ SDL_TransferPaintBuffer(int endtime)
 
 			snd_linear_count <<= 1;
 
-			for (i = 0; i < snd_linear_count; i += 2)
-			{
-				val = snd_p[i] >> 8;
-
-				if (val > 0x7fff)
-				{
-					snd_out[i] = 0x7fff;
-				}
-				else if (val < -32768)
-				{
-					snd_out[i] = -32768;
-				}
-				else
-				{
-					snd_out[i] = val;
-				}
-
-				val = snd_p[i + 1] >> 8;
-
-				if (val > 0x7fff)
-				{
-					snd_out[i + 1] = 0x7fff;
-				}
-				else if (val < -32768)
-				{
-					snd_out[i + 1] = -32768;
-				}
-				else
-				{
-					snd_out[i + 1] = val;
-				}
-			}
+			snd_mixer->clip16(snd_out, snd_p, snd_linear_count);
 
 			snd_p += snd_linear_count;
 			ls_paintedtime += (snd_linear_count >> 1);
@@ -334,11 +367,6 @@ SDL_TransferPaintBuffer(int endtime)
 static void
 SDL_PaintChannelFrom8(channel_t *ch, sfxcache_t *sc, int count, int offset)
 {
-	int *lscale, *rscale;
-	unsigned char *sfx;
-	int i;
-	portable_samplepair_t *samp;
-
 	if (ch->leftvol > 255)
 	{
 		ch->leftvol = 255;
@@ -349,21 +377,15 @@ SDL_PaintChannelFrom8(channel_t *ch, sfxcache_t *sc, int count, int offset)
 		ch->rightvol = 255;
 	}
 
-	lscale = snd_scaletable[ch->leftvol >> 3];
-	rscale = snd_scaletable[ch->rightvol >> 3];
-	sfx = sc->data + ch->pos;
-
-	samp = &paintbuffer[offset];
-
-	for (i = 0; i < count; i++, samp++)
+	if (snd_mixtracing)
 	{
-		int data;
-
-		data = sfx[i];
-		samp->left += lscale[data];
-		samp->right += rscale[data];
+		SDL_MixerTracePaint(ch->sfx->name, 1, ch->leftvol >> 3,
+				ch->rightvol >> 3, ch->pos, count, offset);
 	}
 
+	snd_mixer->paint8(&paintbuffer[offset], sc->data + ch->pos, count,
+			ch->leftvol >> 3, ch->rightvol >> 3);
+
 	ch->pos += count;
 }
 
@@ -374,28 +396,19 @@ static void
 SDL_PaintChannelFrom16(channel_t *ch, sfxcache_t *sc, int count, int offset)
 {
 	int leftvol, rightvol;
-	signed short *sfx;
-	int i;
-	portable_samplepair_t *samp;
 
 	leftvol = ch->leftvol * snd_vol;
 	rightvol = ch->rightvol * snd_vol;
-	sfx = (signed short *)sc->data + ch->pos;
 
-	samp = &paintbuffer[offset];
-
-	for (i = 0; i < count; i++, samp++)
+	if (snd_mixtracing)
 	{
-		int data;
-		int left, right;
-
-		data = sfx[i];
-		left = (data * leftvol) >> 8;
-		right = (data * rightvol) >> 8;
-		samp->left += left;
-		samp->right += right;
+		SDL_MixerTracePaint(ch->sfx->name, 2, leftvol, rightvol,
+				ch->pos, count, offset);
 	}
 
+	snd_mixer->paint16(&paintbuffer[offset], (short *)sc->data + ch->pos,
+			count, leftvol, rightvol);
+
 	ch->pos += count;
 }
 
@@ -412,11 +425,12 @@ SDL_PaintChannels(int endtime)
 	int ltime, count;
 	playsound_t *ps;
 
-	snd_vol = (int)(s_volume->value * 256);
+	snd_vol = mix_frame->volume;
 
 	while (paintedtime < endtime)
 	{
 		int end;
+		int rawend;
 
 		/* if paintbuffer is smaller than SDL buffer */
 		end = endtime;
@@ -443,7 +457,7 @@ SDL_PaintChannels(int endtime)
 
 			if (ps->begin <= paintedtime)
 			{
-				S_IssuePlaysound(ps);
+				S_IssuePlaysound(ps, mix_frame->playernum + 1);
 				continue;
 			}
 
@@ -457,6 +471,11 @@ SDL_PaintChannels(int endtime)
 
 		memset(paintbuffer, 0, (end - paintedtime) * sizeof(portable_samplepair_t));
 
+		if (snd_mixtracing)
+		{
+			SDL_MixerTraceOp('c', end - paintedtime);
+		}
+
 		/* paint in the channels. */
 		ch = channels;
 
@@ -480,7 +499,8 @@ SDL_PaintChannels(int endtime)
 					count = ch->end - ltime;
 				}
 
-				sc = S_LoadSound(ch->sfx);
+				/* the mixer thread must not load anything */
+				sc = snd_threaded ? ch->sfx->cache : S_LoadSound(ch->sfx);
 
 				if (!sc)
 				{
@@ -524,8 +544,13 @@ SDL_PaintChannels(int endtime)
 			}
 		}
 
-		if (lpf_is_enabled && snd_is_underwater)
+		if (lpf_is_enabled && mix_frame->underwater)
 		{
+			if (snd_mixtracing)
+			{
+				SDL_MixerTraceOp('l', end - paintedtime);
+			}
+
 			lpf_update_samples(&lpf_context, end - paintedtime, paintbuffer);
 		}
 		else
@@ -533,23 +558,46 @@ SDL_PaintChannels(int endtime)
 			lpf_context.is_history_initialized = false;
 		}
 
-		if (s_rawend >= paintedtime)
+		/* the raw samples written before
+		   s_rawend was published are valid */
+		rawend = snd_threaded ? YQ2_AtomicGet(&mix_rawend) : s_rawend;
+
+		if (rawend >= paintedtime)
 		{
 			/* add from the streaming sound source */
 			int stop;
 
-			stop = (end < s_rawend) ? end : s_rawend;
+			stop = (end < rawend) ? end : rawend;
+
+			if (snd_mixtracing)
+			{
+				SDL_MixerTraceOp('r', stop - paintedtime);
+			}
 
-			for (i = paintedtime; i < stop; i++)
+			/* the raw samples are a ring buffer,
+			   mix them in at most two runs */
+			for (i = paintedtime; i < stop; )
 			{
-				int s;
+				int s, run;
 
 				s = i & (MAX_RAW_SAMPLES - 1);
-				paintbuffer[i - paintedtime].left += s_rawsamples[s].left;
-				paintbuffer[i - paintedtime].right += s_rawsamples[s].right;
+				run = MAX_RAW_SAMPLES - s;
+
+				if (run > stop - i)
+				{
+					run = stop - i;
+				}
+
+				snd_mixer->addraw(&paintbuffer[i - paintedtime], &s_rawsamples[s], run);
+				i += run;
 			}
 		}
 
+		if (snd_mixtracing)
+		{
+			SDL_MixerTraceOp('t', end - paintedtime);
+		}
+
 		/* transfer out according to SDL format */
 		SDL_TransferPaintBuffer(end);
 		paintedtime = end;
@@ -565,16 +613,17 @@ SDL_PaintChannels(int endtime)
 int
 SDL_DriftBeginofs(float timeofs)
 {
+	int painted = SDL_PaintedTime();
 	int start = (int)(cl.frame.servertime * 0.001f * sound.speed + beginofs);
 
-	if (start < paintedtime)
+	if (start < painted)
 	{
-		start = paintedtime;
+		start = painted;
 		beginofs = (int)(start - (cl.frame.servertime * 0.001f * sound.speed));
 	}
-	else if (start > paintedtime + 0.3f * sound.speed)
+	else if (start > painted + 0.3f * sound.speed)
 	{
-		start = (int)(paintedtime + 0.1f * sound.speed);
+		start = (int)(painted + 0.1f * sound.speed);
 		beginofs = (int)(start - (cl.frame.servertime * 0.001f * sound.speed));
 	}
 	else
@@ -582,28 +631,44 @@ SDL_DriftBeginofs(float timeofs)
 		beginofs -= 10;
 	}
 
-	return timeofs ? start + timeofs * sound.speed : paintedtime;
+	return timeofs ? start + timeofs * sound.speed : painted;
+}
+
+/*
+ * Returns paintedtime. The mixer thread
+ * publishes it after each mixing pass.
+ */
+int
+SDL_PaintedTime(void)
+{
+	if (snd_threaded)
+	{
+		return YQ2_AtomicGet(&mix_painted);
+	}
+
+	return paintedtime;
 }
 
 /*
  * Spatialize a sound effect based on it's origin.
  */
 static void
-SDL_SpatializeOrigin(vec3_t origin, float master_vol, float dist_mult, int *left_vol, int *right_vol)
+SDL_SpatializeOrigin(const mixframe_t *frame, vec3_t origin, float master_vol,
+		float dist_mult, int *left_vol, int *right_vol)
 {
 	vec_t dot;
 	vec_t dist;
 	vec_t lscale, rscale, scale;
 	vec3_t source_vec;
 
-	if (cls.state != ca_active)
+	if (!frame->active)
 	{
 		*left_vol = *right_vol = 255;
 		return;
 	}
 
 	/* Calculate stereo seperation and distance attenuation */
-	VectorSubtract(origin, listener_origin, source_vec);
+	VectorSubtract(origin, frame->origin, source_vec);
 
 	dist = VectorNormalize(source_vec);
 	dist -= SDL_FULLVOLUME;
@@ -614,7 +679,7 @@ SDL_SpatializeOrigin(vec3_t origin, float master_vol, float dist_mult, int *left
 	}
 
 	dist *= dist_mult;
-	dot = DotProduct(listener_right, source_vec);
+	dot = DotProduct(frame->right, source_vec);
 
 	if ((sound.channels == 1) || !dist_mult)
 	{
@@ -655,7 +720,7 @@ SDL_Spatialize(channel_t *ch)
 
 	/* Anything coming from the view entity
 	   will always be full volume */
-	if (ch->entnum == cl.playernum + 1)
+	if (ch->entnum == mix_frame->playernum + 1)
 	{
 		ch->leftvol = ch->master_vol;
 		ch->rightvol = ch->master_vol;
@@ -666,31 +731,38 @@ SDL_Spatialize(channel_t *ch)
 	{
 		VectorCopy(ch->origin, origin);
 	}
+	else if (mix_frame->hasorigins)
+	{
+		VectorCopy(mix_frame->entorigins[ch->entnum], origin);
+	}
 	else
 	{
 		CL_GetEntitySoundOrigin(ch->entnum, origin);
 	}
 
-	SDL_SpatializeOrigin(origin, (float)ch->master_vol, ch->dist_mult, &ch->leftvol, &ch->rightvol);
+	SDL_SpatializeOrigin(mix_frame, origin, (float)ch->master_vol,
+			ch->dist_mult, &ch->leftvol, &ch->rightvol);
 }
 
 /*
  * Entities with a "sound" field will generated looped sounds
  * that are automatically started, stopped, and merged together
- * as the entities are sent to the client
+ * as the entities are sent to the client. This collects them,
+ * SDL_ApplyFrame() puts them into channels.
  */
-void
-SDL_AddLoopSounds(void)
+static void
+SDL_BuildLoopSounds(mixframe_t *frame)
 {
 	int i, j;
 	int sounds[MAX_EDICTS];
 	int left, right, left_total, right_total;
-	channel_t *ch;
 	sfx_t *sfx;
 	sfxcache_t *sc;
 	int num;
 	entity_state_t *ent;
 
+	frame->numloops = 0;
+
 	if ((cls.state != ca_active) || (cl_paused->value && cl_audiopaused->value) ||
 	    !cl.sound_prepped || !s_ambient->value)
 	{
@@ -725,7 +797,8 @@ SDL_AddLoopSounds(void)
 		ent = &cl_parse_entities[num];
 
 		/* find the total contribution of all sounds of this type */
-		SDL_SpatializeOrigin(ent->origin, 255.0f, SDL_LOOPATTENUATE, &left_total, &right_total);
+		SDL_SpatializeOrigin(frame, ent->origin, 255.0f, SDL_LOOPATTENUATE,
+				&left_total, &right_total);
 
 		for (j = i + 1; j < cl.frame.num_entities; j++)
 		{
@@ -738,7 +811,8 @@ SDL_AddLoopSounds(void)
 			num = (cl.frame.parse_entities + j) & (MAX_PARSE_ENTITIES - 1);
 			ent = &cl_parse_entities[num];
 
-			SDL_SpatializeOrigin(ent->origin, 255.0f, SDL_LOOPATTENUATE, &left, &right);
+			SDL_SpatializeOrigin(frame, ent->origin, 255.0f, SDL_LOOPATTENUATE,
+					&left, &right);
 
 			left_total += left;
 			right_total += right;
@@ -749,10 +823,8 @@ SDL_AddLoopSounds(void)
 			continue; /* not audible */
 		}
 
-		/* allocate a channel */
-		ch = S_PickChannel(0, 0);
-
-		if (!ch)
+		/* there can't be more than one per channel */
+		if (frame->numloops == MAX_CHANNELS)
 		{
 			return;
 		}
@@ -767,17 +839,127 @@ SDL_AddLoopSounds(void)
 			right_total = 255;
 		}
 
-		ch->leftvol = left_total;
-		ch->rightvol = right_total;
+		frame->loops[frame->numloops].sfx = sfx;
+		frame->loops[frame->numloops].left = left_total;
+		frame->loops[frame->numloops].right = right_total;
+		frame->numloops++;
+	}
+}
+
+/*
+ * Captures the client state
+ * the mixer works with.
+ */
+static void
+SDL_BuildFrame(mixframe_t *frame)
+{
+	int i;
+
+	VectorCopy(listener_origin, frame->origin);
+	VectorCopy(listener_right, frame->right);
+	frame->playernum = cl.playernum;
+	frame->active = (cls.state == ca_active);
+	frame->loading = cls.disable_screen;
+	frame->show = (s_show->value != 0);
+	frame->underwater = snd_is_underwater;
+	frame->testsound = (s_testsound->value != 0);
+	frame->volume = (int)(s_volume->value * 256);
+
+	if (snd_threaded)
+	{
+		frame->mixahead = s_mixthread_ahead->value;
+
+		/* the mixer thread can't ask the client */
+		for (i = 0; i < MAX_EDICTS; i++)
+		{
+			VectorCopy(cl_entities[i].lerp_origin, frame->entorigins[i]);
+		}
+
+		frame->hasorigins = true;
+	}
+	else
+	{
+		frame->mixahead = s_mixahead->value;
+		frame->hasorigins = false;
+	}
+
+	if (frame->loading)
+	{
+		frame->numloops = 0;
+	}
+	else
+	{
+		SDL_BuildLoopSounds(frame);
+	}
+}
+
+/*
+ * Makes a frame the current one, updates the
+ * spatialization of all channels and starts
+ * the loop sounds.
+ */
+static void
+SDL_ApplyFrame(const mixframe_t *frame)
+{
+	channel_t *ch;
+	sfxcache_t *sc;
+	int i;
+
+	mix_frame = frame;
+
+	/* update spatialization
+	   for dynamic sounds */
+	ch = channels;
+
+	for (i = 0; i < s_numchannels; i++, ch++)
+	{
+		if (!ch->sfx)
+		{
+			continue;
+		}
+
+		if (ch->autosound)
+		{
+			/* autosounds are regenerated
+			   fresh each frame */
+			memset(ch, 0, sizeof(*ch));
+			continue;
+		}
+
+		/* respatialize channel */
+		SDL_Spatialize(ch);
+
+		if (!ch->leftvol && !ch->rightvol)
+		{
+			memset(ch, 0, sizeof(*ch));
+			continue;
+		}
+	}
+
+	/* add loopsounds */
+	for (i = 0; i < frame->numloops; i++)
+	{
+		/* allocate a channel */
+		ch = S_PickChannel(0, 0, frame->playernum + 1);
+
+		if (!ch)
+		{
+			return;
+		}
+
+		sc = frame->loops[i].sfx->cache;
+
+		ch->leftvol = frame->loops[i].left;
+		ch->rightvol = frame->loops[i].right;
 		ch->autosound = true; /* remove next frame */
-		ch->sfx = sfx;
+		ch->sfx = frame->loops[i].sfx;
 
 		/* Sometimes, the sc->length argument can become 0,
 		   and in that case we get a SIGFPE in the next
 		   modulo operation. The workaround checks for this
 		   situation and in that case, sets the pos and end
 		   parameters to 0. */
-		if (sc->length == 0)
+		if (!sc || (sc->length == 0))
 		{
 			ch->pos = 0;
 			ch->end = 0;
@@ -791,21 +973,13 @@ SDL_AddLoopSounds(void)
 }
 
 /*
- * Clears the playback buffer so
- * that all playback stops.
+ * Silences the playback buffer.
  */
-void
-SDL_ClearBuffer(void)
+static void
+SDL_ClearDMA(void)
 {
 	int clear;
 
-	if (sound_started == SS_NOT)
-	{
-		return;
-	}
-
-	s_rawend = 0;
-
 	if (sound.samplebits == 8)
 	{
 		clear = 0x80;
@@ -838,6 +1012,44 @@ SDL_ClearBuffer(void)
 #endif
 }
 
+/*
+ * Clears the playback buffer so
+ * that all playback stops.
+ */
+void
+SDL_ClearBuffer(void)
+{
+	if (sound_started == SS_NOT)
+	{
+		return;
+	}
+
+	s_rawend = 0;
+
+	if (snd_threaded)
+	{
+		/* the mixer thread keeps the
+		   playback buffer up to date */
+		YQ2_AtomicSet(&mix_rawend, s_rawend);
+		return;
+	}
+
+	SDL_ClearDMA();
+}
+
+/*
+ * Stops all channels and playsounds,
+ * the raw samples are left alone. Runs
+ * in the mixer thread if there's one.
+ */
+static void
+SDL_StopChannels(void)
+{
+	S_ClearPlaysounds();
+	SDL_ClearDMA();
+	memset(channels, 0, sizeof(channels));
+}
+
 /*
  * Calculates the absolute timecode
  * of current playback.
@@ -862,7 +1074,15 @@ SDL_UpdateSoundtime(void)
 			/* time to chop things off to avoid 32 bit limits */
 			buffers = 0;
 			paintedtime = fullsamples;
-			S_StopAllSounds();
+
+			if (snd_threaded)
+			{
+				SDL_StopChannels();
+			}
+			else
+			{
+				S_StopAllSounds();
+			}
 		}
 	}
 
@@ -877,7 +1097,8 @@ SDL_UpdateSoundtime(void)
 static void
 SDL_UpdateScaletable(void)
 {
-	int i;
+	/* the mixer thread reads the tables */
+	SDL_StopMixThread();
 
 	if (s_volume->value > 2.0f)
 	{
@@ -890,17 +1111,7 @@ SDL_UpdateScaletable(void)
 
 	s_volume->modified = false;
 
-	for (i = 0; i < 32; i++)
-	{
-		int j, scale;
-
-		scale = (int)(i * 8 * 256 * s_volume->value);
-
-		for (j = 0; j < 256; j++)
-		{
-			snd_scaletable[i][j] = ((j < 128) ? j : j - 0xff) * scale;
-		}
-	}
+	SDL_MixerSetVolume(s_volume->value);
 }
 
 /*
@@ -1015,9 +1226,53 @@ SDL_RawSamples(int samples, int rate, int width, int channels, byte *data, float
 	int i;
 	int src;
 	int intVolume;
+	int painted;
+	int limit;
+
+	painted = SDL_PaintedTime();
 
+	if (s_rawend < painted)
+	{
+		s_rawend = painted;
+	}
+
+	limit = 0x7fffffff;
 	scale = (float)rate / sound.speed;
 	intVolume = (int)(256 * volume);
+	src = 0;
+
+	if (snd_threaded)
+	{
+		int needed, wait;
+
+		/* paintedtime wrapped around */
+		if (s_rawend > painted + MAX_RAW_SAMPLES)
+		{
+			s_rawend = painted;
+		}
+
+		/* The mixer may still read everything after
+		   paintedtime, so it mustn't be overwritten.
+		   If the samples don't fit, the main thread
+		   is ahead of the mixer. Wait a bit for it
+		   to make room instead of dropping them. */
+		needed = (int)(samples / scale) + 1;
+
+		if (needed > MAX_RAW_SAMPLES)
+		{
+			needed = MAX_RAW_SAMPLES;
+		}
+
+		for (wait = 0; (wait < 250) && (s_rawend + needed > painted + MAX_RAW_SAMPLES); wait++)
+		{
+			YQ2_SemPost(mix_wake);
+			SDL_Delay(1);
+
+			painted = SDL_PaintedTime();
+		}
+
+		limit = painted + MAX_RAW_SAMPLES;
+	}
 
 	if ((channels == 2) && (width == 2))
 	{
@@ -1025,7 +1280,7 @@ SDL_RawSamples(int samples, int rate, int width, int channels, byte *data, float
 		{
 			src = (int)(i * scale);
 
-			if (src >= samples)
+			if ((src >= samples) || (s_rawend >= limit))
 			{
 				break;
 			}
@@ -1042,7 +1297,7 @@ SDL_RawSamples(int samples, int rate, int width, int channels, byte *data, float
 		{
 			src = (int)(i * scale);
 
-			if (src >= samples)
+			if ((src >= samples) || (s_rawend >= limit))
 			{
 				break;
 			}
@@ -1061,7 +1316,7 @@ SDL_RawSamples(int samples, int rate, int width, int channels, byte *data, float
 		{
 			src = (int)(i * scale);
 
-			if (src >= samples)
+			if ((src >= samples) || (s_rawend >= limit))
 			{
 				break;
 			}
@@ -1082,7 +1337,7 @@ SDL_RawSamples(int samples, int rate, int width, int channels, byte *data, float
 		{
 			src = (int)(i * scale);
 
-			if (src >= samples)
+			if ((src >= samples) || (s_rawend >= limit))
 			{
 				break;
 			}
@@ -1093,147 +1348,564 @@ SDL_RawSamples(int samples, int rate, int width, int channels, byte *data, float
 			s_rawsamples[dst].right = (((byte *)data)[src] - 128) * intVolume;
 		}
 	}
+
+	if (snd_threaded)
+	{
+		/* hand the new samples to the mixer */
+		YQ2_AtomicSet(&mix_rawend, s_rawend);
+
+		if ((s_rawend >= limit) && (src < samples))
+		{
+			mix_rawdropped += (int)((samples - src) / scale);
+
+			Com_DPrintf("%s: mixer thread stalled, %i raw samples dropped so far\n",
+				__func__, mix_rawdropped);
+		}
+	}
 }
 
 /*
- * Runs every frame, handles all necessary
- * sound calculations and fills the play-
- * back buffer.
+ * Mixes from paintedtime up to mixahead
+ * seconds after the current playback
+ * position.
  */
-void
-SDL_Update(void)
+static void
+SDL_MixAhead(float mixahead)
 {
-	channel_t *ch;
-	int i;
 	int samps;
 	unsigned int endtime;
 
-	if (s_underwater->modified) {
-		s_underwater->modified = false;
-		lpf_is_enabled = ((int)s_underwater->value != 0);
+	if (!sound.buffer)
+	{
+		return;
 	}
 
-	if (s_underwater_gain_hf->modified) {
-		s_underwater_gain_hf->modified = false;
+#ifndef USE_SDL3
+	SDL_LockAudio();
+#endif
 
-		lpf_initialize(
-			&lpf_context, s_underwater_gain_hf->value,
-			backend->speed);
+	/* Updates SDL time */
+	SDL_UpdateSoundtime();
+
+	if (!soundtime)
+	{
+#ifndef USE_SDL3
+		SDL_UnlockAudio();
+#endif
+		return;
 	}
 
-	/* if the loading plaque is up, clear everything
-	   out to make sure we aren't looping a dirty
-	   SDL buffer while loading */
-	if (cls.disable_screen)
+	/* check to make sure that we haven't overshot */
+	if (paintedtime < soundtime)
+	{
+		if (!snd_threaded)
+		{
+			Com_DPrintf("%s: overflow\n", __func__);
+		}
+
+		paintedtime = soundtime;
+	}
+
+	/* mix ahead of current position */
+	endtime = (int)(soundtime + mixahead * sound.speed);
+
+	/* mix to an even submission block size */
+	endtime = (endtime + sound.submission_chunk - 1) & ~(sound.submission_chunk - 1);
+	samps = sound.samples >> (sound.channels - 1);
+
+	if (endtime - soundtime > samps)
+	{
+		endtime = soundtime + samps;
+	}
+
+	SDL_PaintChannels(endtime);
+#ifndef USE_SDL3
+	SDL_UnlockAudio();
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * Queues a command for the mixer thread.
+ * Returns false if the queue is full.
+ */
+static qboolean
+SDL_PostCommand(const mixcmd_t *cmd)
+{
+	int head;
+
+	head = YQ2_AtomicGet(&mix_cmdhead);
+
+	if (head - YQ2_AtomicGet(&mix_cmdtail) >= MIX_NUMCMDS)
+	{
+		return false;
+	}
+
+	mix_cmds[head & (MIX_NUMCMDS - 1)] = *cmd;
+
+	/* publishes the command */
+	YQ2_AtomicSet(&mix_cmdhead, head + 1);
+
+	return true;
+}
+
+/*
+ * Like SDL_PostCommand(), but waits for the
+ * mixer thread if the queue is full. For
+ * commands that mustn't get lost.
+ */
+static void
+SDL_PostCommandWait(const mixcmd_t *cmd)
+{
+	while (!SDL_PostCommand(cmd))
+	{
+		YQ2_SemPost(mix_wake);
+		SDL_Delay(1);
+	}
+
+	YQ2_SemPost(mix_wake);
+}
+
+/*
+ * Starts a playsound in the mixer thread.
+ * If the queue is full the sound is
+ * dropped, just like when running out
+ * of playsounds.
+ */
+void
+SDL_PostPlaysound(const playsound_t *ps, pssort_t sorting)
+{
+	mixcmd_t cmd;
+
+	cmd.type = MIXCMD_PLAY;
+	cmd.sorting = sorting;
+	cmd.ps = *ps;
+
+	SDL_PostCommand(&cmd);
+}
+
+/*
+ * Stops all sounds played by
+ * the mixer thread.
+ */
+void
+SDL_PostStopAll(void)
+{
+	mixcmd_t cmd;
+
+	s_rawend = 0;
+	YQ2_AtomicSet(&mix_rawend, s_rawend);
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.type = MIXCMD_STOPALL;
+
+	SDL_PostCommandWait(&cmd);
+}
+
+/*
+ * Runs all queued commands. Returns
+ * true if the mixer thread must quit.
+ */
+static qboolean
+SDL_RunCommands(void)
+{
+	int head, tail;
+	qboolean quit;
+	mixcmd_t *cmd;
+
+	quit = false;
+	head = YQ2_AtomicGet(&mix_cmdhead);
+
+	for (tail = YQ2_AtomicGet(&mix_cmdtail); tail != head; tail++)
+	{
+		cmd = &mix_cmds[tail & (MIX_NUMCMDS - 1)];
+
+		switch (cmd->type)
+		{
+			case MIXCMD_PLAY:
+				S_QueuePlaysound(&cmd->ps, cmd->sorting);
+				break;
+
+			case MIXCMD_STOPALL:
+				SDL_StopChannels();
+				break;
+
+			case MIXCMD_QUIT:
+				quit = true;
+				break;
+		}
+	}
+
+	/* hands the slots back to the main thread */
+	YQ2_AtomicSet(&mix_cmdtail, tail);
+
+	return quit;
+}
+
+/*
+ * Captures the current frame into the
+ * frame ring. The slot used by the mixer
+ * thread is never written, if the mixer
+ * lags behind the frame is dropped.
+ */
+static void
+SDL_PostFrame(void)
+{
+	int head;
+
+	head = YQ2_AtomicGet(&mix_framehead);
+
+	if (head - YQ2_AtomicGet(&mix_frametail) >= MIX_NUMFRAMES)
 	{
-		SDL_ClearBuffer();
 		return;
 	}
 
-	/* rebuild scale tables if
-	   volume is modified */
-	if (s_volume->modified)
+	SDL_BuildFrame(&mix_frames[head & (MIX_NUMFRAMES - 1)]);
+	YQ2_AtomicSet(&mix_framehead, head + 1);
+}
+
+/*
+ * Switches the mixer thread to the newest
+ * frame, older ones are skipped. The
+ * frame stays in use until a newer one
+ * arrives.
+ */
+static void
+SDL_TakeFrame(void)
+{
+	int head;
+
+	head = YQ2_AtomicGet(&mix_framehead);
+
+	if (head == mix_frameseen)
 	{
-		SDL_UpdateScaletable();
+		return;
 	}
 
-	/* update spatialization
-	   for dynamic sounds */
+	mix_frameseen = head;
+	YQ2_AtomicSet(&mix_frametail, head - 1);
+
+	SDL_ApplyFrame(&mix_frames[(head - 1) & (MIX_NUMFRAMES - 1)]);
+}
+
+/*
+ * Notes a playsound for s_show. Called by
+ * S_IssuePlaysound() in the mixer thread.
+ */
+void
+SDL_ShowIssue(int begin)
+{
+	if (!mix_frame->show || YQ2_AtomicGet(&mix_showready))
+	{
+		return;
+	}
+
+	if (mix_show.numissues < MIX_MAXISSUES)
+	{
+		mix_show.issues[mix_show.numissues++] = begin;
+	}
+}
+
+/*
+ * Hands the audible channels
+ * to the main thread for s_show.
+ */
+static void
+SDL_PublishShow(void)
+{
+	channel_t *ch;
+	int i;
+
+	if (!mix_frame->show || YQ2_AtomicGet(&mix_showready))
+	{
+		return;
+	}
+
+	mix_show.numchannels = 0;
 	ch = channels;
 
 	for (i = 0; i < s_numchannels; i++, ch++)
 	{
-		if (!ch->sfx)
+		if (ch->sfx && (ch->leftvol || ch->rightvol))
 		{
-			continue;
+			int n = mix_show.numchannels++;
+
+			mix_show.channels[n].left = ch->leftvol;
+			mix_show.channels[n].right = ch->rightvol;
+			Q_strlcpy(mix_show.channels[n].name, ch->sfx->name,
+				sizeof(mix_show.channels[n].name));
 		}
+	}
 
-		if (ch->autosound)
+	mix_show.painted = paintedtime;
+
+	YQ2_AtomicSet(&mix_showready, 1);
+}
+
+/*
+ * Prints what the mixer thread
+ * published for s_show.
+ */
+static void
+SDL_PrintShow(void)
+{
+	int i;
+
+	if (!YQ2_AtomicGet(&mix_showready))
+	{
+		return;
+	}
+
+	for (i = 0; i < mix_show.numchannels; i++)
+	{
+		Com_Printf("%3i %3i %s\n", mix_show.channels[i].left,
+				mix_show.channels[i].right, mix_show.channels[i].name);
+	}
+
+	Com_Printf("----(%i)---- painted: %i\n", mix_show.numchannels, mix_show.painted);
+
+	for (i = 0; i < mix_show.numissues; i++)
+	{
+		Com_Printf("Issue %i\n", mix_show.issues[i]);
+	}
+
+	mix_show.numissues = 0;
+
+	/* back to the mixer */
+	YQ2_AtomicSet(&mix_showready, 0);
+}
+
+/*
+ * The mixer thread. Wakes up several times
+ * during s_mixthread_ahead and keeps the
+ * playback buffer filled, no matter what
+ * the main thread is doing.
+ */
+static int SDLCALL
+SDL_MixThread(void *data)
+{
+	qboolean quit;
+	int timeout;
+
+	YQ2_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+
+	do
+	{
+		timeout = (int)(mix_frame->mixahead * 250);
+
+		if (timeout < 1)
 		{
-			/* autosounds are regenerated
-			   fresh each frame */
-			memset(ch, 0, sizeof(*ch));
-			continue;
+			timeout = 1;
 		}
 
-		/* respatialize channel */
-		SDL_Spatialize(ch);
+		YQ2_SemWaitTimeout(mix_wake, timeout);
 
-		if (!ch->leftvol && !ch->rightvol)
+		quit = SDL_RunCommands();
+		SDL_TakeFrame();
+
+		if (mix_frame->loading)
 		{
-			memset(ch, 0, sizeof(*ch));
-			continue;
+			/* make sure we aren't looping a dirty
+			   SDL buffer while loading */
+			SDL_ClearDMA();
 		}
+		else
+		{
+			SDL_MixAhead(mix_frame->mixahead);
+			SDL_PublishShow();
+		}
+
+		YQ2_AtomicSet(&mix_painted, paintedtime);
 	}
+	while (!quit);
 
-	/* add loopsounds */
-	SDL_AddLoopSounds();
+	return 0;
+}
 
-	/* debugging output */
-	if (s_show->value)
+/*
+ * Starts the mixer thread. From here on
+ * it owns the channels, the playsounds
+ * and paintedtime.
+ */
+static void
+SDL_StartMixThread(void)
+{
+	if (!mix_wake)
 	{
-		int total;
-
-		total = 0;
-		ch = channels;
+		mix_wake = SDL_CreateSemaphore(0);
 
-		for (i = 0; i < s_numchannels; i++, ch++)
+		if (!mix_wake)
 		{
-			if (ch->sfx && (ch->leftvol || ch->rightvol))
-			{
-				Com_Printf("%3i %3i %s\n", ch->leftvol,
-						ch->rightvol, ch->sfx->name);
-				total++;
-			}
+			Com_Printf("Couldn't create the mixer semaphore: %s\n", SDL_GetError());
+			Cvar_Set("s_mixthread", "0");
+			return;
 		}
+	}
 
-		Com_Printf("----(%i)---- painted: %i\n", total, paintedtime);
+	YQ2_AtomicSet(&mix_cmdhead, 0);
+	YQ2_AtomicSet(&mix_cmdtail, 0);
+	YQ2_AtomicSet(&mix_framehead, 0);
+	YQ2_AtomicSet(&mix_frametail, 0);
+	mix_frameseen = 0;
+
+	YQ2_AtomicSet(&mix_painted, paintedtime);
+	YQ2_AtomicSet(&mix_rawend, s_rawend);
+	YQ2_AtomicSet(&mix_showready, 0);
+	mix_show.numissues = 0;
+
+	snd_threaded = true;
+
+	/* the mixer thread uses this
+	   until the first frame from
+	   the ring arrives */
+	SDL_BuildFrame(&sdl_frame);
+	mix_frame = &sdl_frame;
+
+	mix_thread = SDL_CreateThread(SDL_MixThread, "yq2mixer", NULL);
+
+	if (!mix_thread)
+	{
+		snd_threaded = false;
+		Com_Printf("Couldn't start the mixer thread: %s\n", SDL_GetError());
+		Cvar_Set("s_mixthread", "0");
 	}
+}
 
-	/* stream music */
-	OGG_Stream();
+/*
+ * Stops the mixer thread after it has
+ * run all queued commands.
+ */
+void
+SDL_StopMixThread(void)
+{
+	mixcmd_t cmd;
 
-	if (!sound.buffer)
+	if (!mix_thread)
 	{
 		return;
 	}
 
-	/* Mix the samples */
-#ifndef USE_SDL3
-	SDL_LockAudio();
-#endif
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.type = MIXCMD_QUIT;
 
-	/* Updates SDL time */
-	SDL_UpdateSoundtime();
+	SDL_PostCommandWait(&cmd);
+	SDL_WaitThread(mix_thread, NULL);
 
-	if (!soundtime)
+	mix_thread = NULL;
+	snd_threaded = false;
+	mix_frame = &sdl_frame;
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+ * Runs every frame, handles all necessary
+ * sound calculations and fills the play-
+ * back buffer.
+ */
+void
+SDL_Update(void)
+{
+	channel_t *ch;
+	int i;
+
+	/* the settings below are used
+	   by the mixer thread, it's
+	   stopped while they change */
+	if (s_underwater->modified) {
+		SDL_StopMixThread();
+		s_underwater->modified = false;
+		lpf_is_enabled = ((int)s_underwater->value != 0);
+	}
+
+	SDL_MixerUpdate();
+
+	if (s_underwater_gain_hf->modified) {
+		SDL_StopMixThread();
+		s_underwater_gain_hf->modified = false;
+
+		lpf_initialize(
+			&lpf_context, s_underwater_gain_hf->value,
+			backend->speed);
+	}
+
+	/* rebuild scale tables if
+	   volume is modified */
+	if (s_volume->modified)
 	{
-		return;
+		SDL_UpdateScaletable();
 	}
 
-	/* check to make sure that we haven't overshot */
-	if (paintedtime < soundtime)
+	if (s_mixthread->value && !mix_thread)
 	{
-		Com_DPrintf("%s: overflow\n", __func__);
-		paintedtime = soundtime;
+		SDL_StartMixThread();
+	}
+	else if (!s_mixthread->value && mix_thread)
+	{
+		SDL_StopMixThread();
 	}
 
-	/* mix ahead of current position */
-	endtime = (int)(soundtime + s_mixahead->value * sound.speed);
+	if (snd_threaded)
+	{
+		/* while the loading plaque is up
+		   the mixer thread gets frames
+		   telling it to play nothing */
+		SDL_PostFrame();
 
-	/* mix to an even submission block size */
-	endtime = (endtime + sound.submission_chunk - 1) & ~(sound.submission_chunk - 1);
-	samps = sound.samples >> (sound.channels - 1);
+		if (cls.disable_screen)
+		{
+			SDL_ClearBuffer();
+		}
+		else
+		{
+			OGG_Stream();
+		}
 
-	if (endtime - soundtime > samps)
+		SDL_PrintShow();
+
+		YQ2_SemPost(mix_wake);
+		return;
+	}
+
+	/* if the loading plaque is up, clear everything
+	   out to make sure we aren't looping a dirty
+	   SDL buffer while loading */
+	if (cls.disable_screen)
 	{
-		endtime = soundtime + samps;
+		SDL_ClearBuffer();
+		return;
 	}
 
-	SDL_PaintChannels(endtime);
-#ifndef USE_SDL3
-	SDL_UnlockAudio();
-#endif
+	SDL_BuildFrame(&sdl_frame);
+	SDL_ApplyFrame(&sdl_frame);
+
+	/* debugging output */
+	if (s_show->value)
+	{
+		int total;
+
+		total = 0;
+		ch = channels;
+
+		for (i = 0; i < s_numchannels; i++, ch++)
+		{
+			if (ch->sfx && (ch->leftvol || ch->rightvol))
+			{
+				Com_Printf("%3i %3i %s\n", ch->leftvol,
+						ch->rightvol, ch->sfx->name);
+				total++;
+			}
+		}
+
+		Com_Printf("----(%i)---- painted: %i\n", total, paintedtime);
+	}
+
+	/* stream music */
+	OGG_Stream();
+
+	/* Mix the samples */
+	SDL_MixAhead(sdl_frame.mixahead);
 }
 
 /* ------------------------------------------------------------------ */
@@ -1468,6 +2140,10 @@ SDL_BackendInit(void)
 	s_underwater_gain_hf->modified = true;
 	lpf_initialize(&lpf_context, lpf_default_gain_hf, backend->speed);
 
+	s_mixthread = Cvar_Get("s_mixthread", "1", CVAR_ARCHIVE);
+	s_mixthread_ahead = Cvar_Get("s_mixthread_ahead", "0.04", CVAR_ARCHIVE);
+
+	SDL_MixerInit();
 	SDL_UpdateScaletable();
 	SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(stream));
 
@@ -1485,6 +2161,14 @@ SDL_BackendInit(void)
 void
 SDL_BackendShutdown(void)
 {
+	SDL_StopMixThread();
+
+	if (mix_wake)
+	{
+		SDL_DestroySemaphore(mix_wake);
+		mix_wake = NULL;
+	}
+
 	Com_Printf("Closing SDL audio device...\n");
 	SDL_PauseAudioDevice(SDL_GetAudioStreamDevice(stream));
 	SDL_DestroyAudioStream(stream);
@@ -1493,6 +2177,7 @@ SDL_BackendShutdown(void)
 	backend->buffer = NULL;
 	playpos = samplesize = 0;
 	snd_inited = 0;
+	SDL_MixerShutdown();
 	Com_Printf("SDL audio device shut down.\n");
 }
 #else
@@ -1640,6 +2325,10 @@ SDL_BackendInit(void)
 	s_underwater_gain_hf->modified = true;
 	lpf_initialize(&lpf_context, lpf_default_gain_hf, backend->speed);
 
+	s_mixthread = Cvar_Get("s_mixthread", "1", CVAR_ARCHIVE);
+	s_mixthread_ahead = Cvar_Get("s_mixthread_ahead", "0.04", CVAR_ARCHIVE);
+
+	SDL_MixerInit();
 	SDL_UpdateScaletable();
 	SDL_PauseAudio(0);
 
@@ -1657,6 +2346,14 @@ SDL_BackendInit(void)
 void
 SDL_BackendShutdown(void)
 {
+	SDL_StopMixThread();
+
+	if (mix_wake)
+	{
+		SDL_DestroySemaphore(mix_wake);
+		mix_wake = NULL;
+	}
+
 	Com_Printf("Closing SDL audio device...\n");
 	SDL_PauseAudio(1);
 	SDL_CloseAudio();
@@ -1665,6 +2362,7 @@ SDL_BackendShutdown(void)
 	backend->buffer = NULL;
 	playpos = samplesize = 0;
 	snd_inited = 0;
+	SDL_MixerShutdown();
 	Com_Printf("SDL audio device shut down.\n");
 }
 #endif
@@ -40,6 +40,15 @@
 #define MAX_SFX (MAX_SOUNDS * 2)
 #define MAX_PLAYSOUNDS 128
 
+/* Size of the sfx name hash, must be a power of two. */
+#define SFX_HASH_SIZE 256
+
+/* Number of different '*' sounds whose per
+   client resolution is cached. Quake II uses
+   about 20 of them, anything above that is
+   resolved each time it's played. */
+#define MAX_SEXED_SOUNDS 32
+
 /* Maximum length (seconds) of audio data to test for silence. */
 #define S_MAX_LEN_TO_TEST_FOR_SILENCE_S (2)
 
@@ -76,6 +85,7 @@ cvar_t* s_occlusion_strength;
 cvar_t* s_reverb_preset;
 static cvar_t* s_ps_sorting;
 static cvar_t* s_feedback_kind;
+static cvar_t* s_preload_sexed;
 
 channel_t channels[MAX_CHANNELS];
 static int num_sfx;
@@ -86,6 +96,7 @@ int s_rawend;
 static int s_registration_sequence = 0;
 portable_samplepair_t s_rawsamples[MAX_RAW_SAMPLES];
 static sfx_t known_sfx[MAX_SFX];
+static sfx_t *sfx_hash[SFX_HASH_SIZE];
 sndstarted_t sound_started = SS_NOT;
 sound_t sound;
 static qboolean s_registering;
@@ -93,6 +104,15 @@ qboolean s_active;
 
 qboolean snd_is_underwater;
 qboolean snd_is_underwater_enabled;
+
+/* '*' sounds by their sexedindex and what
+   they resolve to for each player. Only the
+   main thread touches these. */
+static sfx_t *s_sexedsounds[MAX_SEXED_SOUNDS];
+static int s_numsexed;
+static sfx_t *s_clientsounds[MAX_CLIENTS][MAX_SEXED_SOUNDS];
+
+static void S_FreePlaysound(playsound_t *ps);
 /* ----------------------------------------------------------------- */
 
 static qboolean
@@ -560,6 +580,92 @@ S_LoadSound(sfx_t *s)
 	return sc;
 }
 
+/*
+ * Hashes a sound name for sfx_hash.
+ */
+static unsigned
+S_HashName(const char *name)
+{
+	unsigned hash = 0;
+
+	while (*name)
+	{
+		hash = hash * 31 + (unsigned char)*name++;
+	}
+
+	return hash & (SFX_HASH_SIZE - 1);
+}
+
+/*
+ * Puts a freshly named sfx into the hash and,
+ * if it's a '*' sound, gives it a slot in the
+ * per client sound cache.
+ */
+static void
+S_LinkName(sfx_t *sfx)
+{
+	unsigned hash = S_HashName(sfx->name);
+
+	sfx->hashnext = sfx_hash[hash];
+	sfx_hash[hash] = sfx;
+
+	sfx->sexedindex = -1;
+
+	if ((sfx->name[0] == '*') && (s_numsexed < MAX_SEXED_SOUNDS))
+	{
+		sfx->sexedindex = s_numsexed;
+		s_sexedsounds[s_numsexed++] = sfx;
+	}
+}
+
+/*
+ * Removes a sfx from the hash. Must be
+ * called before its name is cleared.
+ */
+static void
+S_UnlinkName(sfx_t *sfx)
+{
+	sfx_t **prev;
+
+	for (prev = &sfx_hash[S_HashName(sfx->name)]; *prev; prev = &(*prev)->hashnext)
+	{
+		if (*prev == sfx)
+		{
+			*prev = sfx->hashnext;
+			break;
+		}
+	}
+
+	sfx->hashnext = NULL;
+}
+
+/*
+ * Forgets all per client resolutions of '*'
+ * sounds and hands out new cache slots.
+ * Needed after sfx were freed, because the
+ * cache may point to them.
+ */
+static void
+S_ResetSexedSounds(void)
+{
+	sfx_t *sfx;
+	int i;
+
+	memset(s_clientsounds, 0, sizeof(s_clientsounds));
+	s_numsexed = 0;
+
+	for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++)
+	{
+		sfx->sexedindex = -1;
+
+		if ((sfx->name[0] == '*') && (s_numsexed < MAX_SEXED_SOUNDS))
+		{
+			sfx->sexedindex = s_numsexed;
+			s_sexedsounds[s_numsexed++] = sfx;
+		}
+	}
+}
+
 /*
  * Returns the name of a sound
  */
@@ -586,11 +692,11 @@ S_FindName(char *name, qboolean create)
 	}
 
 	/* see if already loaded */
-	for (i = 0; i < num_sfx; i++)
+	for (sfx = sfx_hash[S_HashName(name)]; sfx; sfx = sfx->hashnext)
 	{
-		if (!strcmp(known_sfx[i].name, name))
+		if (!strcmp(sfx->name, name))
 		{
-			return &known_sfx[i];
+			return sfx;
 		}
 	}
 
@@ -623,6 +729,7 @@ S_FindName(char *name, qboolean create)
 	strcpy(sfx->name, name);
 	sfx->registration_sequence = s_registration_sequence;
 	sfx->is_silenced_muzzle_flash = false;
+	S_LinkName(sfx);
 
 	return sfx;
 }
@@ -665,6 +772,8 @@ S_AliasName(char *aliasname, char *truename)
 	strcpy(sfx->name, aliasname);
 	sfx->registration_sequence = s_registration_sequence;
 	sfx->truename = s;
+	sfx->is_silenced_muzzle_flash = false;
+	S_LinkName(sfx);
 
 	return sfx;
 }
@@ -705,7 +814,7 @@ S_RegisterSound(char *name)
 }
 
 static struct sfx_s *
-S_RegisterSexedSound(entity_state_t *ent, char *base)
+S_RegisterSexedSound(int playernum, char *base)
 {
 	int n;
 	struct sfx_s *sfx;
@@ -714,7 +823,7 @@ S_RegisterSexedSound(entity_state_t *ent, char *base)
 
 	/* determine what model the client is using */
 	model[0] = 0;
-	n = CS_PLAYERSKINS + ent->number - 1;
+	n = CS_PLAYERSKINS + playernum;
 
 	if (cl.configstrings[n][0])
 	{
@@ -771,6 +880,93 @@ S_RegisterSexedSound(entity_state_t *ent, char *base)
 	return sfx;
 }
 
+/*
+ * Returns what the '*' sound base resolves
+ * to for the given player. The result is
+ * cached until the player changes the skin
+ * or sounds are freed.
+ */
+static sfx_t *
+S_FindSexedSound(int playernum, sfx_t *base)
+{
+	sfx_t **cached;
+
+	if ((playernum < 0) || (playernum >= MAX_CLIENTS) || (base->sexedindex < 0))
+	{
+		return S_RegisterSexedSound(playernum, base->name);
+	}
+
+	cached = &s_clientsounds[playernum][base->sexedindex];
+
+	if (!*cached)
+	{
+		*cached = S_RegisterSexedSound(playernum, base->name);
+	}
+
+	return *cached;
+}
+
+/*
+ * Resolves and registers all known '*'
+ * sounds for the given player, so none
+ * of them is loaded from disk mid game.
+ */
+static void
+S_PreloadSexedSounds(int playernum)
+{
+	sfx_t *sfx;
+	int i;
+
+	if (!cl.configstrings[CS_PLAYERSKINS + playernum][0])
+	{
+		return;
+	}
+
+	for (i = 0; i < s_numsexed; i++)
+	{
+		/* leave room for the sounds
+		   the server precaches later */
+		if (num_sfx >= MAX_SFX - MAX_SOUNDS)
+		{
+			return;
+		}
+
+		sfx = S_FindSexedSound(playernum, s_sexedsounds[i]);
+
+		if (sfx)
+		{
+			sfx->registration_sequence = s_registration_sequence;
+
+			if (!s_registering)
+			{
+				S_LoadSound(sfx);
+			}
+		}
+	}
+}
+
+/*
+ * Called when the skin of a player changed.
+ * Drops the cached '*' sound resolutions and
+ * optionally loads the sounds of the new model.
+ */
+void
+S_RegisterClientSounds(int playernum)
+{
+	if ((sound_started == SS_NOT) ||
+		(playernum < 0) || (playernum >= MAX_CLIENTS))
+	{
+		return;
+	}
+
+	memset(s_clientsounds[playernum], 0, sizeof(s_clientsounds[playernum]));
+
+	if (s_preload_sexed->value)
+	{
+		S_PreloadSexedSounds(playernum);
+	}
+}
+
 static qboolean
 S_HasFreeSpace(void)
 {
@@ -802,6 +998,37 @@ S_HasFreeSpace(void)
 	return (num_sfx + used) < MAX_SFX;
 }
 
+/*
+ * Removes pending playsounds and stops
+ * channels of sounds that were freed.
+ * The freed sfx_t may be reused for
+ * another sound.
+ */
+static void
+S_DropFreedSounds(void)
+{
+	playsound_t *ps, *next;
+	int i;
+
+	for (ps = s_pendingplays.next; ps != &s_pendingplays; ps = next)
+	{
+		next = ps->next;
+
+		if (!ps->sfx->name[0])
+		{
+			S_FreePlaysound(ps);
+		}
+	}
+
+	for (i = 0; i < s_numchannels; i++)
+	{
+		if (channels[i].sfx && !channels[i].sfx->name[0])
+		{
+			memset(&channels[i], 0, sizeof(channels[i]));
+		}
+	}
+}
+
 /*
  * Called after registering of
  * sound has ended
@@ -814,6 +1041,13 @@ S_EndRegistration(void)
 
 	if (!S_HasFreeSpace())
 	{
+		if (sound_started == SS_SDL)
+		{
+			/* the mixer thread must not
+			   see sounds vanishing */
+			SDL_StopMixThread();
+		}
+
 		/* free any sounds not from this registration sequence */
 		for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++)
 		{
@@ -835,10 +1069,27 @@ S_EndRegistration(void)
 					Z_Free(sfx->truename);
 				}
 
+				S_UnlinkName(sfx);
 				sfx->cache = NULL;
+				sfx->truename = NULL;
 				sfx->name[0] = 0;
 			}
 		}
+
+		S_ResetSexedSounds();
+
+		if (sound_started == SS_SDL)
+		{
+			S_DropFreedSounds();
+		}
+	}
+
+	if (s_preload_sexed->value)
+	{
+		for (i = 0; i < MAX_CLIENTS; i++)
+		{
+			S_PreloadSexedSounds(i);
+		}
 	}
 
 	/* load everything in */
@@ -861,7 +1112,7 @@ S_EndRegistration(void)
  * Picks a free channel
  */
 channel_t *
-S_PickChannel(int entnum, int entchannel)
+S_PickChannel(int entnum, int entchannel, int playerent)
 {
 	int ch_idx;
 	int first_to_die;
@@ -890,8 +1141,8 @@ S_PickChannel(int entnum, int entchannel)
 		}
 
 		/* don't let monster sounds override player sounds */
-		if ((channels[ch_idx].entnum == cl.playernum + 1) &&
-			(entnum != cl.playernum + 1) && channels[ch_idx].sfx)
+		if ((channels[ch_idx].entnum == playerent) &&
+			(entnum != playerent) && channels[ch_idx].sfx)
 		{
 			continue;
 		}
@@ -969,7 +1220,7 @@ S_FreePlaysound(playsound_t *ps)
  * by the update loop.
  */
 void
-S_IssuePlaysound(playsound_t *ps)
+S_IssuePlaysound(playsound_t *ps, int playerent)
 {
 	channel_t *ch;
 	sfxcache_t *sc;
@@ -979,19 +1230,17 @@ S_IssuePlaysound(playsound_t *ps)
 		return;
 	}
 
-	if (s_show->value)
+	if (snd_threaded)
 	{
-		Com_Printf("Issue %i\n", ps->begin);
+		SDL_ShowIssue(ps->begin);
 	}
-
-	if (s_ps_sorting->value == 3 && ps->sfx->is_silenced_muzzle_flash)
+	else if (s_show->value)
 	{
-		S_FreePlaysound(ps);
-		return;
+		Com_Printf("Issue %i\n", ps->begin);
 	}
 
 	/* pick a channel to play on */
-	ch = S_PickChannel(ps->entnum, ps->entchannel);
+	ch = S_PickChannel(ps->entnum, ps->entchannel, playerent);
 
 	if (!ch)
 	{
@@ -999,11 +1248,17 @@ S_IssuePlaysound(playsound_t *ps)
 		return;
 	}
 
-	sc = S_LoadSound(ps->sfx);
+	/* the mixer thread must not load anything,
+	   S_StartSound() made sure that it's cached */
+	sc = snd_threaded ? ps->sfx->cache : S_LoadSound(ps->sfx);
 
 	if (!sc)
 	{
-		Com_Printf("S_IssuePlaysound: couldn't load %s\n", ps->sfx->name);
+		if (!snd_threaded)
+		{
+			Com_Printf("S_IssuePlaysound: couldn't load %s\n", ps->sfx->name);
+		}
+
 		S_FreePlaysound(ps);
 		return;
 	}
@@ -1060,7 +1315,8 @@ S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t *sfx,
 		float fvol, float attenuation, float timeofs)
 {
 	sfxcache_t *sc;
-	playsound_t *ps, *sort;
+	playsound_t playsound, *ps;
+	pssort_t sorting;
 
 	if (sound_started == SS_NOT)
 	{
@@ -1081,7 +1337,7 @@ S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t *sfx,
 
 	if (sfx->name[0] == '*')
 	{
-		sfx = S_RegisterSexedSound(&cl_entities[entnum].current, sfx->name);
+		sfx = S_FindSexedSound(cl_entities[entnum].current.number - 1, sfx);
 
 		if (!sfx)
 		{
@@ -1098,14 +1354,18 @@ S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t *sfx,
 		return;
 	}
 
-	/* make the playsound_t */
-	ps = S_AllocPlaysound();
-
-	if (!ps)
+	/* the mixer thread allocates its
+	   playsounds on its own */
+	if (!snd_threaded && (s_freeplays.next == &s_freeplays))
 	{
+		/* no free playsounds */
 		return;
 	}
 
+	/* make the playsound_t */
+	ps = &playsound;
+	memset(ps, 0, sizeof(*ps));
+
 	if (origin)
 	{
 		VectorCopy(origin, ps->origin);
@@ -1235,9 +1495,75 @@ S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t *sfx,
 		(strcmp(game->string, "rogue") == 0) ||
 		(strcmp(game->string, "xatrix") == 0);
 
+	if (s_ps_sorting->value == 3 && sfx->is_silenced_muzzle_flash)
+	{
+		return;
+	}
+
 	if ((s_ps_sorting->value == 1 && is_mission_pack) ||
 			s_ps_sorting->value == 2 ||
 			s_ps_sorting->value == 3)
+	{
+		sorting = PS_SORT_AFTER;
+	}
+	else if (!is_mission_pack && s_ps_sorting->value == 1)
+	{
+		sorting = PS_SORT_BEFORE;
+	}
+	else
+	{
+		sorting = PS_APPEND;
+	}
+
+	if (snd_threaded)
+	{
+		/* S_PickChannel() and CL_GetEntitySoundOrigin()
+		   would throw these in the mixer thread */
+		if (entchannel < 0)
+		{
+			Com_Error(ERR_DROP, "%s: entchannel<0", __func__);
+		}
+
+		if (!ps->fixed_origin && ((entnum < 0) || (entnum >= MAX_EDICTS)))
+		{
+			Com_Error(ERR_DROP, "%s: bad ent", __func__);
+		}
+
+		SDL_PostPlaysound(ps, sorting);
+	}
+	else
+	{
+		S_QueuePlaysound(ps, sorting);
+	}
+}
+
+/*
+ * Copies a playsound into the list
+ * of pending playsounds. Runs in the
+ * mixer thread if there's one.
+ */
+void
+S_QueuePlaysound(const playsound_t *src, pssort_t sorting)
+{
+	playsound_t *ps, *sort;
+
+	ps = S_AllocPlaysound();
+
+	if (!ps)
+	{
+		return;
+	}
+
+	ps->sfx = src->sfx;
+	ps->volume = src->volume;
+	ps->attenuation = src->attenuation;
+	ps->entnum = src->entnum;
+	ps->entchannel = src->entchannel;
+	ps->fixed_origin = src->fixed_origin;
+	VectorCopy(src->origin, ps->origin);
+	ps->begin = src->begin;
+
+	if (sorting == PS_SORT_AFTER)
 	{
 		for (sort = s_pendingplays.next;
 				sort != &s_pendingplays && sort->begin <= ps->begin;
@@ -1245,7 +1571,7 @@ S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t *sfx,
 		{
 		}
 	}
-	else if (!is_mission_pack && s_ps_sorting->value == 1)
+	else if (sorting == PS_SORT_BEFORE)
 	{
 		for (sort = s_pendingplays.next;
 				sort != &s_pendingplays && sort->begin < ps->begin;
@@ -1293,19 +1619,13 @@ S_StartLocalSound(char *sound)
 }
 
 /*
- * Stops all sounds
+ * Frees all playsounds
  */
 void
-S_StopAllSounds(void)
+S_ClearPlaysounds(void)
 {
 	int i;
 
-	if (sound_started == SS_NOT)
-	{
-		return;
-	}
-
-	/* clear all the playsounds */
 	memset(s_playsounds, 0, sizeof(s_playsounds));
 	s_freeplays.next = s_freeplays.prev = &s_freeplays;
 	s_pendingplays.next = s_pendingplays.prev = &s_pendingplays;
@@ -1317,6 +1637,29 @@ S_StopAllSounds(void)
 		s_playsounds[i].prev->next = &s_playsounds[i];
 		s_playsounds[i].next->prev = &s_playsounds[i];
 	}
+}
+
+/*
+ * Stops all sounds
+ */
+void
+S_StopAllSounds(void)
+{
+	if (sound_started == SS_NOT)
+	{
+		return;
+	}
+
+	if (snd_threaded)
+	{
+		/* the playsounds and channels
+		   belong to the mixer thread */
+		SDL_PostStopAll();
+		return;
+	}
+
+	/* clear all the playsounds */
+	S_ClearPlaysounds();
 
 #if USE_OPENAL
 	if (sound_started == SS_OAL)
@@ -1386,14 +1729,14 @@ S_RawSamples(int samples, int rate, int width,
 		return;
 	}
 
-	if (s_rawend < paintedtime)
-	{
-		s_rawend = paintedtime;
-	}
-
 #if USE_OPENAL
 	if (sound_started == SS_OAL)
 	{
+		if (s_rawend < paintedtime)
+		{
+			s_rawend = paintedtime;
+		}
+
 		AL_RawSamples(samples, rate, width, channels, data, volume);
 	}
 	else
@@ -1626,6 +1969,7 @@ S_Init(void)
 	s_occlusion_strength = Cvar_Get("s_occlusion_strength", "0", CVAR_ARCHIVE);
 	/* Feedback kind: 0 - rumble, 1 - haptic */
 	s_feedback_kind = Cvar_Get("s_feedback_kind", "0", CVAR_ARCHIVE);
+	s_preload_sexed = Cvar_Get("s_preload_sexed", "0", CVAR_ARCHIVE);
 
 	Cmd_AddCommand("play", S_Play);
 	Cmd_AddCommand("stopsound", S_StopAllSounds);
@@ -1654,6 +1998,8 @@ S_Init(void)
 	}
 
 	num_sfx = 0;
+	memset(sfx_hash, 0, sizeof(sfx_hash));
+	S_ResetSexedSounds();
 	paintedtime = 0;
 	sound_max = 0;
 	s_active = true;
@@ -1684,6 +2030,11 @@ S_Shutdown(void)
 	S_StopAllSounds();
 	OGG_Shutdown();
 
+	if (sound_started == SS_SDL)
+	{
+		SDL_StopMixThread();
+	}
+
 	/* free all sounds */
 	for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++)
 	{
@@ -1711,7 +2062,9 @@ S_Shutdown(void)
 	}
 
 	memset(known_sfx, 0, sizeof(known_sfx));
+	memset(sfx_hash, 0, sizeof(sfx_hash));
 	num_sfx = 0;
+	S_ResetSexedSounds();
 
 #if USE_OPENAL
 	if (sound_started == SS_OAL)
@@ -39,6 +39,7 @@ static cvar_t *vid_displayrefreshrate;
 static cvar_t *vid_displayindex;
 static cvar_t *vid_highdpiaware;
 static cvar_t *vid_rate;
+static cvar_t *vid_headless;
 
 #ifndef __WIIU__
 static int last_flags = 0;
@@ -396,6 +397,49 @@ ShutdownGraphics(void)
 // --------
 #endif
 
+#ifndef __WIIU__
+/*
+ * SDL_HINT_VIDEODRIVER is new in SDL 2.0.22.
+ */
+static void
+SetVideoDriver(const char *driver)
+{
+#if SDL_VERSION_ATLEAST(2, 0, 22)
+	SDL_SetHint(SDL_HINT_VIDEODRIVER, driver);
+#else
+	SDL_setenv("SDL_VIDEODRIVER", driver, 1);
+#endif
+}
+
+/*
+ * Initializes SDL video without a display, everything is
+ * rendered into an offscreen target. SDLs offscreen driver
+ * brings an EGL context (Mesa renders surfaceless with
+ * EGL_PLATFORM=surfaceless), the dummy driver is enough
+ * for the software renderer. SDL_VIDEODRIVER still wins.
+ */
+static qboolean
+InitHeadless(void)
+{
+	if (SDL_getenv("SDL_VIDEODRIVER"))
+	{
+		return SDL_Init(SDL_INIT_VIDEO) == 0;
+	}
+
+	SetVideoDriver("offscreen");
+
+	if (SDL_Init(SDL_INIT_VIDEO) == 0)
+	{
+		return true;
+	}
+
+	Com_Printf("Couldn't init SDL offscreen video: %s, trying dummy.\n", SDL_GetError());
+	SetVideoDriver("dummy");
+
+	return SDL_Init(SDL_INIT_VIDEO) == 0;
+}
+#endif
+
 /*
  * Initializes the SDL video subsystem. Must
  * be called before anything else.
@@ -407,12 +451,22 @@ GLimp_Init(void)
 	vid_displayindex = Cvar_Get("vid_displayindex", "0", CVAR_ARCHIVE);
 	vid_highdpiaware = Cvar_Get("vid_highdpiaware", "0", CVAR_ARCHIVE);
 	vid_rate = Cvar_Get("vid_rate", "-1", CVAR_ARCHIVE);
+	vid_headless = Cvar_Get("vid_headless", "0", CVAR_NOSET);
 
 #ifdef __WIIU__
 #else
 	if (!SDL_WasInit(SDL_INIT_VIDEO))
 	{
-		if (SDL_Init(SDL_INIT_VIDEO) == -1)
+		if (vid_headless->value)
+		{
+			if (!InitHeadless())
+			{
+				Com_Printf("Couldn't init headless SDL video: %s.\n", SDL_GetError());
+
+				return false;
+			}
+		}
+		else if (SDL_Init(SDL_INIT_VIDEO) == -1)
 		{
 			Com_Printf("Couldn't init SDL video: %s.\n", SDL_GetError());
 
@@ -577,6 +631,14 @@ GLimp_InitGraphics(int fullscreen, int *pwidth, int *pheight)
 		flags |= fs_flag;
 	}
 
+	/* Nobody's watching. */
+	if (vid_headless->value)
+	{
+		flags = (flags & ~fs_flag) | SDL_WINDOW_HIDDEN;
+		fs_flag = 0;
+		fullscreen = 0;
+	}
+
 	/* Check for high dpi support. */
 	flags = Glimp_DetermineHighDPISupport(flags);
 
@@ -33,6 +33,7 @@
 #define	MAX_DLIGHTS		32
 #define	MAX_ENTITIES	128
 #define	MAX_PARTICLES	4096
+#define	MAX_PARTICLES_LIMIT	32768 /* renderers may ask for up to this many */
 #define	MAX_LIGHTSTYLES	256
 
 #define POWERSUIT_SCALE		4.0F
@@ -124,8 +125,18 @@ typedef enum {
 	RESTART_PARTIAL
 } ref_restart_t;
 
-// FIXME: bump API_VERSION?
-#define	API_VERSION		7
+// Parts of a frame timed by the timedemo
+// CSV. A mark ends the previous part.
+typedef enum {
+	PHASE_WORLD,
+	PHASE_ENTITIES,
+	PHASE_PARTICLES,
+	PHASE_2D,
+	PHASE_PRESENT,
+	PHASE_NUM
+} ref_phase_t;
+
+#define	API_VERSION		9
 #define EXPORT
 #define IMPORT
 
@@ -142,6 +153,10 @@ typedef struct
 	// mixed.
 	int		framework_version;
 
+	// how many particles the renderer can draw per frame,
+	// MAX_PARTICLES up to MAX_PARTICLES_LIMIT
+	int		max_particles;
+
 	// called when the library is loaded
 	qboolean (EXPORT *Init) (void);
 
@@ -257,6 +272,9 @@ typedef struct
 	qboolean	(IMPORT *GLimp_GetDesktopMode)(int *pwidth, int *pheight);
 
 	void		(IMPORT *Vid_RequestRestart)(ref_restart_t rs);
+
+	// marks the start of a part of the frame
+	void		(IMPORT *Vid_MarkPhase)(ref_phase_t phase);
 } refimport_t;
 
 // this is the only function actually exported at the linker level
@@ -294,4 +312,9 @@ void R_BeginFrame(float camera_separation);
 qboolean R_EndWorldRenderpass(void);
 void R_EndFrame(void);
 
+void VID_SetScreenshotName(const char *name);
+void VID_BeginFrameTimings(void);
+void VID_MarkPhase(ref_phase_t phase);
+float VID_EndFrameTimings(float *times);
+
 #endif
@@ -63,6 +63,18 @@ compress_for_stbiw(unsigned char *data, int data_len, int *out_len, int quality)
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "header/stb_image_write.h"
 
+static char vid_screenshotname[64];
+
+/*
+ * Gives the next screenshot a fixed name instead of
+ * the first free q2_XXXX. Used for reference shots.
+ */
+void
+VID_SetScreenshotName(const char *name)
+{
+	Q_strlcpy(vid_screenshotname, name, sizeof(vid_screenshotname));
+}
+
 /*
  * Writes a screenshot. This function is called with raw image data of
  * width*height pixels, each pixel has comp bytes. Must be 3 or 4, for
@@ -145,8 +157,16 @@ void VID_WriteScreenshot(int width, int height, int comp, const void* data)
 		}
 	}
 
+	/* a name was requested for this screenshot */
+	if (vid_screenshotname[0])
+	{
+		Com_sprintf(picname, sizeof(picname), "%s.%s", vid_screenshotname, supportedFormats[format]);
+		Com_sprintf(checkname, sizeof(checkname), "%s/scrnshot/%s", gameDir, picname);
+		vid_screenshotname[0] = '\0';
+		i = 0;
+	}
 	/* find a file name to save it to */
-	for (i = 0; i <= 9999; i++)
+	else for (i = 0; i <= 9999; i++)
 	{
 		FILE *f;
 		Com_sprintf(checkname, sizeof(checkname), "%s/scrnshot/q2_%04d.%s", gameDir, i, supportedFormats[format]);
@@ -196,6 +216,66 @@ void VID_WriteScreenshot(int width, int height, int comp, const void* data)
 
 // --------
 
+// Frame timings
+// -------------
+
+static long long vid_framestart;
+static long long vid_phasestart;
+static long long vid_phasetime[PHASE_NUM];
+static int vid_phase = -1;
+
+/*
+ * Starts timing a new frame.
+ */
+void
+VID_BeginFrameTimings(void)
+{
+	vid_framestart = Sys_Microseconds();
+	vid_phase = -1;
+	memset(vid_phasetime, 0, sizeof(vid_phasetime));
+}
+
+/*
+ * Ends the current part of the frame and starts the
+ * given one. Called by the renderers and the client.
+ */
+void
+VID_MarkPhase(ref_phase_t phase)
+{
+	long long now = Sys_Microseconds();
+
+	/* PHASE_NUM marks time that isn't counted */
+	if ((vid_phase >= 0) && (vid_phase < PHASE_NUM))
+	{
+		vid_phasetime[vid_phase] += now - vid_phasestart;
+	}
+
+	vid_phase = phase;
+	vid_phasestart = now;
+}
+
+/*
+ * Ends the frame. Fills times with the milliseconds
+ * spend in each part and returns the whole frame time.
+ */
+float
+VID_EndFrameTimings(float *times)
+{
+	int i;
+
+	VID_MarkPhase(PHASE_NUM);
+	vid_phase = -1;
+
+	for (i = 0; i < PHASE_NUM; i++)
+	{
+		times[i] = vid_phasetime[i] / 1000.0f;
+	}
+
+	return (vid_phasestart - vid_framestart) / 1000.0f;
+}
+
+// --------
+
 // Video mode array
 // ----------------
 
@@ -454,6 +534,7 @@ VID_LoadRenderer(void)
 	ri.Vid_MenuInit = VID_MenuInit;
 	ri.Vid_WriteScreenshot = VID_WriteScreenshot;
 	ri.Vid_RequestRestart = VID_RequestRestart;
+	ri.Vid_MarkPhase = VID_MarkPhase;
 
 	// Exchange our export struct with the renderers import struct.
 	re = GetRefAPI(ri);
@@ -493,6 +574,8 @@ VID_LoadRenderer(void)
 	/* Ensure that all key states are cleared */
 	Key_MarkAllUp();
 
+	CL_SetMaxParticles(re.max_particles);
+
 	Com_Printf("Successfully loaded %s as rendering backend.\n", reflib_name);
 	Com_Printf("------------------------------------\n\n");
 
@@ -49,6 +49,21 @@ typedef struct cmdalias_s
 	char *value;
 } cmdalias_t;
 
+/* commands, aliases and cvars are looked up in one
+   hash table, the lists above keep them in order for
+   listing and completion */
+#define SYMBOL_HASH_SIZE 1024
+
+typedef struct symbol_s
+{
+	struct symbol_s *next;
+	const char *name;
+	symtype_t type;
+	void *data;
+} symbol_t;
+
+static symbol_t *cmd_symbols[SYMBOL_HASH_SIZE];
+
 char retval[256];
 int alias_count; /* for detecting runaway loops */
 cmdalias_t *cmd_alias;
@@ -397,6 +412,106 @@ Cmd_Exec_f(void)
 	FS_FreeFile(f);
 }
 
+/*
+ * Executes a script file right away, count times, and
+ * prints how long that took. A benchmark for the command
+ * execution, 'wait' is ignored. Commands that were already
+ * in the buffer are executed afterwards, as usual.
+ */
+static void
+Cmd_ExecTime_f(void)
+{
+	char name[MAX_QPATH];
+	char *f, *f2, *saved;
+	int len, savedsize;
+	int count, i, start, msec;
+
+	if ((Cmd_Argc() < 2) || (Cmd_Argc() > 3))
+	{
+		Com_Printf("exectime <filename> [count] : execute a script file and time it\n");
+		return;
+	}
+
+	count = (Cmd_Argc() == 3) ? (int)strtol(Cmd_Argv(2), (char **)NULL, 10) : 1;
+
+	if (count < 1)
+	{
+		count = 1;
+	}
+
+	/* the commands in the file overwrite the arguments */
+	Q_strlcpy(name, Cmd_Argv(1), sizeof(name));
+
+	len = FS_LoadFile(name, (void **)&f);
+
+	if (!f)
+	{
+		Com_Printf("couldn't exec %s\n", name);
+		return;
+	}
+
+	f2 = Z_Malloc(len + 2);
+	memcpy(f2, f, len);
+	f2[len] = '\n';
+	f2[len+1] = '\0';
+
+	FS_FreeFile(f);
+
+	/* set the rest of the buffer aside, so only the file is timed */
+	savedsize = cmd_text.cursize;
+	saved = Z_Malloc(savedsize + 1);
+	memcpy(saved, cmd_text.data, savedsize);
+	SZ_Clear(&cmd_text);
+
+	start = Sys_Milliseconds();
+
+	for (i = 0; i < count; i++)
+	{
+		char *p = f2;
+
+		/* big files are fed to the buffer in chunks of whole lines */
+		while (*p)
+		{
+			int chunk = strlen(p);
+
+			if (chunk > cmd_text.maxsize / 2)
+			{
+				chunk = cmd_text.maxsize / 2;
+
+				while ((chunk > 1) && (p[chunk - 1] != '\n'))
+				{
+					chunk--;
+				}
+
+				if (chunk == 1)
+				{
+					chunk = cmd_text.maxsize / 2;
+				}
+			}
+
+			SZ_Write(&cmd_text, p, chunk);
+			p += chunk;
+
+			while (cmd_text.cursize)
+			{
+				cmd_wait = 0;
+				Cbuf_Execute();
+			}
+		}
+	}
+
+	msec = Sys_Milliseconds() - start;
+
+	cmd_wait = 0;
+	SZ_Write(&cmd_text, saved, savedsize);
+
+	Com_Printf("execed %s %i times in %i ms, %.3f ms each.\n", name,
+		count, msec, msec / (float)count);
+
+	Z_Free(saved);
+	Z_Free(f2);
+}
+
 /*
  * Inserts the current value of a variable as command text
  */
@@ -428,6 +543,103 @@ Cmd_Echo_f(void)
 	Com_Printf("\n");
 }
 
+/*
+ * Case insensitive, like Q_strcasecmp()
+ */
+static unsigned
+Cmd_HashName(const char *name)
+{
+	unsigned hash = 0;
+	int c;
+
+	while ((c = *name++))
+	{
+		if ((c >= 'a') && (c <= 'z'))
+		{
+			c -= ('a' - 'A');
+		}
+
+		hash = hash * 31 + c;
+	}
+
+	return hash & (SYMBOL_HASH_SIZE - 1);
+}
+
+/*
+ * Adds a symbol, name must stay valid until it's removed.
+ * Lookups that ignore the case find the first match, so
+ * commands are kept in the same order as cmd_functions
+ * and aliases in the same order as cmd_alias.
+ */
+void
+Cmd_AddSymbol(const char *name, symtype_t type, void *data)
+{
+	symbol_t **pos;
+	symbol_t *sym;
+
+	sym = Z_Malloc(sizeof(symbol_t));
+	sym->name = name;
+	sym->type = type;
+	sym->data = data;
+
+	pos = &cmd_symbols[Cmd_HashName(name)];
+
+	if (type == SYM_COMMAND)
+	{
+		while (*pos && ((*pos)->type != SYM_COMMAND ||
+				strcmp((*pos)->name, name) < 0))
+		{
+			pos = &(*pos)->next;
+		}
+	}
+
+	sym->next = *pos;
+	*pos = sym;
+}
+
+void
+Cmd_RemoveSymbol(const char *name, symtype_t type, void *data)
+{
+	symbol_t **pos;
+	symbol_t *sym;
+
+	for (pos = &cmd_symbols[Cmd_HashName(name)]; *pos; pos = &(*pos)->next)
+	{
+		sym = *pos;
+
+		if ((sym->type == type) && (sym->data == data))
+		{
+			*pos = sym->next;
+			Z_Free(sym);
+			return;
+		}
+	}
+}
+
+/*
+ * Returns the data of the symbol or NULL
+ */
+void *
+Cmd_FindSymbol(const char *name, symtype_t type, qboolean matchcase)
+{
+	symbol_t *sym;
+
+	for (sym = cmd_symbols[Cmd_HashName(name)]; sym; sym = sym->next)
+	{
+		if (sym->type != type)
+		{
+			continue;
+		}
+
+		if (matchcase ? !strcmp(name, sym->name) : !Q_strcasecmp(name, sym->name))
+		{
+			return sym->data;
+		}
+	}
+
+	return NULL;
+}
+
 /*
  * Creates a new command that executes
  * a command string (possibly ; seperated)
@@ -461,23 +673,21 @@ Cmd_Alias_f(void)
 	}
 
 	/* if the alias already exists, reuse it */
-	for (a = cmd_alias; a; a = a->next)
+	a = Cmd_FindSymbol(s, SYM_ALIAS, true);
+
+	if (a)
 	{
-		if (!strcmp(s, a->name))
-		{
-			Z_Free(a->value);
-			break;
-		}
+		Z_Free(a->value);
 	}
-
-	if (!a)
+	else
 	{
 		a = Z_Malloc(sizeof(cmdalias_t));
 		a->next = cmd_alias;
 		cmd_alias = a;
-	}
 
-	strcpy(a->name, s);
+		strcpy(a->name, s);
+		Cmd_AddSymbol(a->name, SYM_ALIAS, a);
+	}
 
 	/* copy the rest of the command line */
 	cmd[0] = 0; /* start out with a null string */
@@ -712,13 +922,10 @@ Cmd_AddCommand(char *cmd_name, xcommand_t function)
 	}
 
 	/* fail if the command already exists */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	if (Cmd_FindSymbol(cmd_name, SYM_COMMAND, true))
 	{
-		if (!strcmp(cmd_name, cmd->name))
-		{
-			Com_Printf("Cmd_AddCommand: %s already defined\n", cmd_name);
-			return;
-		}
+		Com_Printf("Cmd_AddCommand: %s already defined\n", cmd_name);
+		return;
 	}
 
 	cmd = Z_Malloc(sizeof(cmd_function_t));
@@ -733,6 +940,8 @@ Cmd_AddCommand(char *cmd_name, xcommand_t function)
 	}
 	cmd->next = *pos;
 	*pos = cmd;
+
+	Cmd_AddSymbol(cmd->name, SYM_COMMAND, cmd);
 }
 
 void
@@ -755,6 +964,7 @@ Cmd_RemoveCommand(char *cmd_name)
 		if (!strcmp(cmd_name, cmd->name))
 		{
 			*back = cmd->next;
+			Cmd_RemoveSymbol(cmd->name, SYM_COMMAND, cmd);
 			Z_Free(cmd);
 			return;
 		}
@@ -766,17 +976,7 @@ Cmd_RemoveCommand(char *cmd_name)
 qboolean
 Cmd_Exists(char *cmd_name)
 {
-	cmd_function_t *cmd;
-
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
-	{
-		if (!strcmp(cmd_name, cmd->name))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	return Cmd_FindSymbol(cmd_name, SYM_COMMAND, true) != NULL;
 }
 
 char *
@@ -797,28 +997,19 @@ Cmd_CompleteCommand(char *partial)
 	}
 
 	/* check for exact match */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	if ((cmd = Cmd_FindSymbol(partial, SYM_COMMAND, true)))
 	{
-		if (!strcmp(partial, cmd->name))
-		{
-			return cmd->name;
-		}
+		return cmd->name;
 	}
 
-	for (a = cmd_alias; a; a = a->next)
+	if ((a = Cmd_FindSymbol(partial, SYM_ALIAS, true)))
 	{
-		if (!strcmp(partial, a->name))
-		{
-			return a->name;
-		}
+		return a->name;
 	}
 
-	for (cvar = cvar_vars; cvar; cvar = cvar->next)
+	if ((cvar = Cmd_FindSymbol(partial, SYM_CVAR, true)))
 	{
-		if (!strcmp(partial, cvar->name))
-		{
-			return cvar->name;
-		}
+		return cvar->name;
 	}
 
 	for (i = 0; i < 1024; i++)
@@ -989,36 +1180,10 @@ Cmd_CompleteMapCommand(char *partial)
 qboolean
 Cmd_IsComplete(char *command)
 {
-	cmd_function_t *cmd;
-	cmdalias_t *a;
-	cvar_t *cvar;
-
 	/* check for exact match */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
-	{
-		if (!strcmp(command, cmd->name))
-		{
-			return true;
-		}
-	}
-
-	for (a = cmd_alias; a; a = a->next)
-	{
-		if (!strcmp(command, a->name))
-		{
-			return true;
-		}
-	}
-
-	for (cvar = cvar_vars; cvar; cvar = cvar->next)
-	{
-		if (!strcmp(command, cvar->name))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	return Cmd_FindSymbol(command, SYM_COMMAND, true) ||
+		Cmd_FindSymbol(command, SYM_ALIAS, true) ||
+		Cmd_FindSymbol(command, SYM_CVAR, true);
 }
 
 /* ugly hack to suppress warnings from default.cfg in Key_Bind_f() */
@@ -1048,38 +1213,36 @@ Cmd_ExecuteString(char *text)
 	}
 
 	/* check functions */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	cmd = Cmd_FindSymbol(cmd_argv[0], SYM_COMMAND, false);
+
+	if (cmd)
 	{
-		if (!Q_strcasecmp(cmd_argv[0], cmd->name))
+		if (!cmd->function)
 		{
-			if (!cmd->function)
-			{
-				/* forward to server command */
-				Cmd_ExecuteString(va("cmd %s", text));
-			}
-			else
-			{
-				cmd->function();
-			}
-
-			return;
+			/* forward to server command */
+			Cmd_ExecuteString(va("cmd %s", text));
 		}
+		else
+		{
+			cmd->function();
+		}
+
+		return;
 	}
 
 	/* check alias */
-	for (a = cmd_alias; a; a = a->next)
+	a = Cmd_FindSymbol(cmd_argv[0], SYM_ALIAS, false);
+
+	if (a)
 	{
-		if (!Q_strcasecmp(cmd_argv[0], a->name))
+		if (++alias_count == ALIAS_LOOP_COUNT)
 		{
-			if (++alias_count == ALIAS_LOOP_COUNT)
-			{
-				Com_Printf("ALIAS_LOOP_COUNT\n");
-				return;
-			}
-
-			Cbuf_InsertText(a->value);
+			Com_Printf("ALIAS_LOOP_COUNT\n");
 			return;
 		}
+
+		Cbuf_InsertText(a->value);
+		return;
 	}
 
 	/* check cvars */
@@ -1116,6 +1279,7 @@ Cmd_Init(void)
 	/* register our commands */
 	Cmd_AddCommand("cmdlist", Cmd_List_f);
 	Cmd_AddCommand("exec", Cmd_Exec_f);
+	Cmd_AddCommand("exectime", Cmd_ExecTime_f);
 	Cmd_AddCommand("vstr", Cmd_Vstr_f);
 	Cmd_AddCommand("echo", Cmd_Echo_f);
 	Cmd_AddCommand("alias", Cmd_Alias_f);
@@ -1130,6 +1294,7 @@ Cmd_Shutdown(void)
 	while (cmd_alias != NULL)
 	{
 		next = cmd_alias->next;
+		Cmd_RemoveSymbol(cmd_alias->name, SYM_ALIAS, cmd_alias);
 		Z_Free(cmd_alias->value);
 		Z_Free(cmd_alias);
 		cmd_alias = next;
@@ -95,6 +95,11 @@ replacement_t replacements[] = {
 };
 
 
+/* the info strings are only rebuilt after an info cvar changed */
+static char cvar_userinfo[MAX_INFO_STRING];
+static char cvar_serverinfo[MAX_INFO_STRING];
+static int cvar_infodirty = CVAR_USERINFO | CVAR_SERVERINFO;
+
 static qboolean
 Cvar_InfoValidate(const char *s)
 {
@@ -116,32 +121,72 @@ Cvar_InfoValidate(const char *s)
 	return true;
 }
 
-static cvar_t *
-Cvar_FindVar(const char *var_name)
+/*
+ * Adds the old names to the symbol table. Replacements
+ * that are replaced again later in the list are resolved
+ * to the final name right away.
+ */
+static void
+Cvar_AddReplacements(void)
 {
-	cvar_t *var;
-	int i;
+	const int num = sizeof(replacements) / sizeof(replacement_t);
+	int i, j;
 
-	/* An ugly hack to rewrite changed CVARs */
-	for (i = 0; i < sizeof(replacements) / sizeof(replacement_t); i++)
+	for (i = 0; i < num; i++)
 	{
-		if (!strcmp(var_name, replacements[i].old))
+		for (j = i + 1; j < num; j++)
 		{
-			Com_Printf("cvar %s is deprecated, use %s instead\n", replacements[i].old, replacements[i].new);
-
-			var_name = replacements[i].new;
+			if (!strcmp(replacements[i].new, replacements[j].old))
+			{
+				replacements[i].new = replacements[j].new;
+			}
 		}
 	}
 
-	for (var = cvar_vars; var; var = var->next)
+	/* backwards, so the first one wins if an old name is in there twice */
+	for (i = num - 1; i >= 0; i--)
 	{
-		if (!strcmp(var_name, var->name))
-		{
-			return var;
-		}
+		Cmd_AddSymbol(replacements[i].old, SYM_DEPRECATED, &replacements[i]);
 	}
+}
+
+/*
+ * An ugly hack to rewrite changed CVARs
+ */
+static const char *
+Cvar_ReplaceName(const char *var_name, qboolean warn)
+{
+	replacement_t *r;
+
+	r = Cmd_FindSymbol(var_name, SYM_DEPRECATED, true);
 
-	return NULL;
+	if (!r)
+	{
+		return var_name;
+	}
+
+	if (warn)
+	{
+		Com_Printf("cvar %s is deprecated, use %s instead\n", r->old, r->new);
+	}
+
+	return r->new;
+}
+
+static cvar_t *
+Cvar_FindVar(const char *var_name)
+{
+	return Cmd_FindSymbol(Cvar_ReplaceName(var_name, true), SYM_CVAR, true);
+}
+
+/*
+ * Called when a cvar was added or changed its value or
+ * flags, so the info strings are rebuilt if necessary
+ */
+static void
+Cvar_InfoChanged(int flags)
+{
+	cvar_infodirty |= flags & (CVAR_USERINFO | CVAR_SERVERINFO);
 }
 
 static qboolean
@@ -230,6 +275,7 @@ Cvar_Get(const char *var_name, char *var_value, int flags)
 
 	if (var)
 	{
+		Cvar_InfoChanged(flags & ~var->flags);
 		var->flags |= flags;
 
 		if (var->default_string)
@@ -284,7 +330,10 @@ Cvar_Get(const char *var_name, char *var_value, int flags)
 	var->next = *pos;
 	*pos = var;
 
+	Cmd_AddSymbol(var->name, SYM_CVAR, var);
+
 	var->flags = flags;
+	Cvar_InfoChanged(flags);
 
 	return var;
 }
@@ -354,6 +403,7 @@ Cvar_Set2(const char *var_name, char *value, qboolean force)
 			{
 				var->string = CopyString(value);
 				var->value = (float)strtod(var->string, (char **)NULL);
+				Cvar_InfoChanged(var->flags);
 
 				if (!strcmp(var->name, "game"))
 				{
@@ -389,6 +439,7 @@ Cvar_Set2(const char *var_name, char *value, qboolean force)
 
 	var->string = CopyString(value);
 	var->value = strtod(var->string, (char **)NULL);
+	Cvar_InfoChanged(var->flags);
 
 	return var;
 }
@@ -436,6 +487,7 @@ Cvar_FullSet(const char *var_name, char *value, int flags)
 	var->string = CopyString(value);
 	var->value = (float)strtod(var->string, (char **)NULL);
 
+	Cvar_InfoChanged(var->flags | flags);
 	var->flags = flags;
 
 	return var;
@@ -478,6 +530,7 @@ Cvar_GetLatchedVars(void)
 		var->string = var->latched_string;
 		var->latched_string = NULL;
 		var->value = strtod(var->string, (char **)NULL);
+		Cvar_InfoChanged(var->flags);
 
 		if (!strcmp(var->name, "game"))
 		{
@@ -528,7 +581,7 @@ void
 Cvar_Set_f(void)
 {
 	char *firstarg;
-	int c, i;
+	int c;
 
 	c = Cmd_Argc();
 
@@ -538,16 +591,7 @@ Cvar_Set_f(void)
 		return;
 	}
 
-	firstarg = Cmd_Argv(1);
-
-	/* An ugly hack to rewrite changed CVARs */
-	for (i = 0; i < sizeof(replacements) / sizeof(replacement_t); i++)
-	{
-		if (!strcmp(firstarg, replacements[i].old))
-		{
-			firstarg = replacements[i].new;
-		}
-	}
+	firstarg = (char *)Cvar_ReplaceName(Cmd_Argv(1), false);
 
 	if (c == 4)
 	{
@@ -667,10 +711,9 @@ Cvar_List_f(void)
 
 qboolean userinfo_modified;
 
-char *
-Cvar_BitInfo(int bit)
+static void
+Cvar_BitInfo(char *info, int bit)
 {
-	static char info[MAX_INFO_STRING];
 	cvar_t *var;
 
 	info[0] = 0;
@@ -682,8 +725,6 @@ Cvar_BitInfo(int bit)
 			Info_SetValueForKey(info, var->name, var->string);
 		}
 	}
-
-	return info;
 }
 
 /*
@@ -693,7 +734,13 @@ Cvar_BitInfo(int bit)
 char *
 Cvar_Userinfo(void)
 {
-	return Cvar_BitInfo(CVAR_USERINFO);
+	if (cvar_infodirty & CVAR_USERINFO)
+	{
+		Cvar_BitInfo(cvar_userinfo, CVAR_USERINFO);
+		cvar_infodirty &= ~CVAR_USERINFO;
+	}
+
+	return cvar_userinfo;
 }
 
 /*
@@ -703,7 +750,13 @@ Cvar_Userinfo(void)
 char *
 Cvar_Serverinfo(void)
 {
-	return Cvar_BitInfo(CVAR_SERVERINFO);
+	if (cvar_infodirty & CVAR_SERVERINFO)
+	{
+		Cvar_BitInfo(cvar_serverinfo, CVAR_SERVERINFO);
+		cvar_infodirty &= ~CVAR_SERVERINFO;
+	}
+
+	return cvar_serverinfo;
 }
 
 /*
@@ -865,6 +918,8 @@ Cvar_Init(void)
 	Cmd_AddCommand("resetall", Cvar_ResetAll_f);
 	Cmd_AddCommand("set", Cvar_Set_f);
 	Cmd_AddCommand("toggle", Cvar_Toggle_f);
+
+	Cvar_AddReplacements();
 }
 
 /*
@@ -874,10 +929,12 @@ void
 Cvar_Fini(void)
 {
 	cvar_t *var;
+	int i;
 
 	for (var = cvar_vars; var;)
 	{
 		cvar_t *c = var->next;
+		Cmd_RemoveSymbol(var->name, SYM_CVAR, var);
 		Z_Free(var->string);
 		Z_Free(var->name);
 		Z_Free(var->default_string);
@@ -892,5 +949,13 @@ Cvar_Fini(void)
 	Cmd_RemoveCommand("resetall");
 	Cmd_RemoveCommand("set");
 	Cmd_RemoveCommand("toggle");
+
+	for (i = 0; i < sizeof(replacements) / sizeof(replacement_t); i++)
+	{
+		Cmd_RemoveSymbol(replacements[i].old, SYM_DEPRECATED, &replacements[i]);
+	}
+
+	cvar_vars = NULL;
+	Cvar_InfoChanged(CVAR_USERINFO | CVAR_SERVERINFO);
 }
 
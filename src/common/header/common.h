@@ -400,6 +400,22 @@ qboolean Cmd_Exists(char *cmd_name);
 
 /* used by the cvar code to check for cvar / command name overlap */
 
+typedef enum
+{
+	SYM_COMMAND,
+	SYM_ALIAS,
+	SYM_CVAR,
+	SYM_DEPRECATED /* old cvar names */
+} symtype_t;
+
+void Cmd_AddSymbol(const char *name, symtype_t type, void *data);
+void Cmd_RemoveSymbol(const char *name, symtype_t type, void *data);
+void *Cmd_FindSymbol(const char *name, symtype_t type, qboolean matchcase);
+
+/* commands, aliases and cvars share one hash table for lookups. */
+/* matchcase false finds the same symbol Q_strcasecmp() would */
+/* find first in the command or alias list. */
+
 char *Cmd_CompleteCommand(char *partial);
 
 char *Cmd_CompleteMapCommand(char *partial);